@@ -0,0 +1,131 @@
+// Shared pieces of the benchmarks: timing, heap allocation counts and the
+// report every suite adds its results to, printed as a table and
+// optionally written as JSON so runs can be compared over time.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// heap allocations by any thread since the program started, counted by the operator new replacements in bench_main.cpp
+int64_t Allocations();
+
+// keeps the compiler from dropping a result that is never used
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+#if defined(_MSC_VER)
+    static volatile const void *sink;
+    sink = &value;
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+struct Options {
+    // each measurement repeats until it has run this long
+    double minSeconds = 0.2;
+    int nThreads = 1;
+    // BVH suite scene sizes: just prims if set, else powers of ten from 1k up to maxPrims
+    int prims = 0;
+    int maxPrims = 1000000;
+    int nRays = 1 << 20;
+};
+
+struct Result {
+    std::string suite, name;
+    // what one operation is: "op" for a kernel call, "ray", "prim" for a build, "sample" for a pixel sample
+    std::string unit = "op";
+    // primitives in the scene, 0 where there is none
+    int64_t prims = 0;
+    int64_t ops = 0;
+    double seconds = 0;
+    int64_t allocations = 0;
+
+    double NsPerOp() const { return ops > 0 ? seconds * 1e9 / ops : 0; }
+    // million operations per second, Mrays/s for rays
+    double MopsPerSecond() const { return seconds > 0 ? ops / seconds * 1e-6 : 0; }
+};
+
+/*
+ *  Runs batch(), which performs opsPerBatch operations, until
+ *  options.minSeconds have passed, at least once. Allocations are those
+ *  of all runs together.
+ */
+template <typename F>
+Result Measure(const Options &options, std::string suite, std::string name, std::string unit, int64_t prims,
+               int64_t opsPerBatch, F &&batch) {
+    Result result;
+    result.suite = std::move(suite);
+    result.name = std::move(name);
+    result.unit = std::move(unit);
+    result.prims = prims;
+    int64_t allocations = Allocations();
+    Clock::time_point start = Clock::now();
+    do {
+        batch();
+        result.ops += opsPerBatch;
+        result.seconds = SecondsSince(start);
+    } while (result.seconds < options.minSeconds);
+    result.allocations = Allocations() - allocations;
+    return result;
+}
+
+class Report {
+  public:
+    // prints the result as it comes in, so long runs show progress
+    void Add(const Result &r) {
+        if (results.empty())
+            std::printf("%-8s %-34s %10s %-6s %12s %12s %10s\n", "suite", "benchmark", "prims", "unit", "ns/op",
+                        "Mops/s", "allocs");
+        std::printf("%-8s %-34s %10lld %-6s %12.3f %12.3f %10lld\n", r.suite.c_str(), r.name.c_str(),
+                    (long long)r.prims, r.unit.c_str(), r.NsPerOp(), r.MopsPerSecond(), (long long)r.allocations);
+        std::fflush(stdout);
+        results.push_back(r);
+    }
+
+    bool WriteJSON(const std::string &filename, const Options &options, const char *simd, int simdWidth) const {
+        std::FILE *f = std::fopen(filename.c_str(), "w");
+        if (!f)
+            return false;
+        std::fprintf(f, "{\n  \"simd\": \"%s\",\n  \"simd_width\": %d,\n  \"threads\": %d,\n  \"results\": [\n", simd,
+                     simdWidth, options.nThreads);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result &r = results[i];
+            std::fprintf(f,
+                         "    {\"suite\": \"%s\", \"name\": \"%s\", \"unit\": \"%s\", \"prims\": %lld, "
+                         "\"ops\": %lld, \"seconds\": %.6g, \"ns_per_op\": %.6g, ",
+                         r.suite.c_str(), r.name.c_str(), r.unit.c_str(), (long long)r.prims, (long long)r.ops,
+                         r.seconds, r.NsPerOp());
+            if (r.unit == "ray")
+                std::fprintf(f, "\"mrays_per_s\": %.6g, ", r.MopsPerSecond());
+            std::fprintf(f, "\"allocations\": %lld}%s\n", (long long)r.allocations,
+                         i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(f, "  ]\n}\n");
+        return std::fclose(f) == 0;
+    }
+
+  private:
+    std::vector<Result> results;
+};
+
+void RunVecmathBenchmarks(const Options &options, Report &report);
+void RunKernelBenchmarks(const Options &options, Report &report);
+void RunBVHBenchmarks(const Options &options, Report &report);
+void RunFrameBenchmarks(const Options &options, Report &report);
+
+// refit against rebuild of an animated triangle soup, printed as its own table
+void RunAnimationBenchmark(const Options &options, int nFrames);
+
+} // namespace bench
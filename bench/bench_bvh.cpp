@@ -0,0 +1,218 @@
+// BVH build and trace on procedural triangle soups of 1k primitives up to
+// --maxprims (10M takes a few GB): build time per primitive for every
+// builder, then incoherent single rays and coherent packets through the
+// SAH tree, and writing that tree to a cache file and mapping it back. The
+// animation benchmark compares refitting an animated soup
+// against rebuilding it every frame, in frames per minute.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/vecmath.hpp"
+#include "scene/bvh.hpp"
+#include "scene/cache.hpp"
+#include "scene/triangle.hpp"
+#include "util/math.hpp"
+#include "util/parallel.hpp"
+
+namespace {
+
+using bench::Clock;
+using bench::SecondsSince;
+
+// small random triangles scattered through a unit cube, like a particle
+// cloud of foliage; the worst case for a builder is uneven density, so half
+// of them are packed into a corner
+std::shared_ptr<const tfrt::TriangleMesh> TriangleSoup(int nTriangles, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    float size = 2.f / std::cbrt(float(nTriangles));
+    std::vector<tfrt::Point3f> p;
+    std::vector<int> indices;
+    p.reserve(3 * size_t(nTriangles));
+    indices.reserve(3 * size_t(nTriangles));
+    for (int i = 0; i < nTriangles; ++i) {
+        float scale = (i & 1) ? 1.f : 0.2f;
+        tfrt::Point3f c(u(rng) * scale, u(rng) * scale, u(rng) * scale);
+        for (int v = 0; v < 3; ++v) {
+            indices.push_back(int(p.size()));
+            p.push_back(c + tfrt::Vector3f(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) - 0.5f) * (size * scale));
+        }
+    }
+    return std::make_shared<tfrt::TriangleMesh>(std::move(indices), std::move(p));
+}
+
+// n rays from random points on a sphere around the scene towards its interior
+std::vector<tfrt::Ray> Rays(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    std::vector<tfrt::Ray> rays(n);
+    for (tfrt::Ray &ray : rays) {
+        tfrt::Vector3f dir;
+        do
+            dir = tfrt::Vector3f(u(rng), u(rng), u(rng));
+        while (tfrt::LengthSquared(dir) > 1 || tfrt::LengthSquared(dir) < 1e-4f);
+        tfrt::Point3f o = tfrt::Point3f(0.5f, 0.5f, 0.5f) + tfrt::Normalize(dir) * 2.f;
+        tfrt::Point3f target(0.5f + 0.4f * u(rng), 0.5f + 0.4f * u(rng), 0.5f + 0.4f * u(rng));
+        ray = tfrt::Ray(o, tfrt::Normalize(target - o));
+    }
+    return rays;
+}
+
+// a pinhole grid of rays looking at the soup, rows of SIMDWidth neighbours packed into packets
+std::vector<tfrt::RayPacket> CoherentPackets(int nRays) {
+    int width = std::max(tfrt::SIMDWidth, int(std::sqrt(float(nRays))) / tfrt::SIMDWidth * tfrt::SIMDWidth);
+    int height = std::max(1, nRays / width);
+    tfrt::Point3f eye(0.5f, 0.5f, -1.5f);
+    std::vector<tfrt::RayPacket> packets;
+    packets.reserve(size_t(width / tfrt::SIMDWidth) * height);
+    tfrt::Ray row[tfrt::SIMDWidth];
+    for (int y = 0; y < height; ++y) {
+        for (int x0 = 0; x0 < width; x0 += tfrt::SIMDWidth) {
+            for (int i = 0; i < tfrt::SIMDWidth; ++i) {
+                tfrt::Point3f target((x0 + i + 0.5f) / width, (y + 0.5f) / height, 0.5f);
+                row[i] = tfrt::Ray(eye, tfrt::Normalize(target - eye));
+            }
+            packets.emplace_back(row, tfrt::SIMDWidth);
+        }
+    }
+    return packets;
+}
+
+// the soup twisted about the vertical axis through its center, more at the top
+std::shared_ptr<const tfrt::TriangleMesh> Twisted(const tfrt::TriangleMesh &mesh, float amount) {
+    auto posed = std::make_shared<tfrt::TriangleMesh>(mesh);
+    for (tfrt::Point3f &p : posed->p) {
+        float angle = amount * p.y;
+        float s = std::sin(angle), c = std::cos(angle);
+        float x = p.x - 0.5f, z = p.z - 0.5f;
+        p.x = 0.5f + c * x - s * z;
+        p.z = 0.5f + s * x + c * z;
+    }
+    return posed;
+}
+
+// traces all rays in parallel and returns the number of hits
+int Trace(const tfrt::TriangleBVH &bvh, const std::vector<tfrt::Ray> &rays) {
+    std::atomic<int> nHits{0};
+    constexpr int raysPerTask = 4096;
+    int nRays = int(rays.size());
+    tfrt::ParallelFor(0, (nRays + raysPerTask - 1) / raysPerTask, [&](int64_t task) {
+        int hits = 0;
+        int end = std::min(nRays, int(task + 1) * raysPerTask);
+        for (int i = int(task) * raysPerTask; i < end; ++i)
+            hits += bvh.Intersect(rays[i]).has_value();
+        nHits += hits;
+    });
+    return nHits;
+}
+
+// traces all packets in parallel and returns the number of hits
+int TracePackets(const tfrt::TriangleBVH &bvh, const std::vector<tfrt::RayPacket> &packets) {
+    std::atomic<int> nHits{0};
+    constexpr int packetsPerTask = 512;
+    int nPackets = int(packets.size());
+    tfrt::ParallelFor(0, (nPackets + packetsPerTask - 1) / packetsPerTask, [&](int64_t task) {
+        int hits = 0;
+        int end = std::min(nPackets, int(task + 1) * packetsPerTask);
+        for (int i = int(task) * packetsPerTask; i < end; ++i)
+            hits += tfrt::PopCount(bvh.Intersect(packets[i]).valid.Bits());
+        nHits += hits;
+    });
+    return nHits;
+}
+
+// per frame: move the mesh, update the BVH, trace; refit or rebuild from scratch
+void Animate(const std::shared_ptr<const tfrt::TriangleMesh> &mesh,
+             const std::vector<tfrt::Ray> &rays, int nFrames) {
+    std::vector<std::shared_ptr<const tfrt::TriangleMesh>> poses;
+    for (int frame = 1; frame <= nFrames; ++frame)
+        poses.push_back(Twisted(*mesh, 0.02f * frame));
+
+    std::printf("%-8s %10s %10s %10s %10s\n", "update", "update ms", "trace ms", "rebuilds",
+                "frames/min");
+    for (bool refit : {false, true}) {
+        tfrt::TriangleBVH bvh(mesh);
+        double updateSeconds = 0, traceSeconds = 0;
+        int nRebuilds = 0;
+        for (const auto &pose : poses) {
+            Clock::time_point start = Clock::now();
+            if (refit)
+                nRebuilds += bvh.Update(pose);
+            else
+                bvh = tfrt::TriangleBVH(pose);
+            updateSeconds += SecondsSince(start);
+
+            start = Clock::now();
+            Trace(bvh, rays);
+            traceSeconds += SecondsSince(start);
+        }
+        std::printf("%-8s %10.2f %10.2f %10d %10.1f\n", refit ? "refit" : "rebuild",
+                    updateSeconds * 1000 / nFrames, traceSeconds * 1000 / nFrames, nRebuilds,
+                    nFrames * 60 / (updateSeconds + traceSeconds));
+    }
+}
+
+} // namespace
+
+void bench::RunBVHBenchmarks(const Options &options, Report &report) {
+    std::vector<int> sizes;
+    if (options.prims > 0)
+        sizes.push_back(options.prims);
+    else
+        for (int n = 1000; n <= options.maxPrims; n *= 10)
+            sizes.push_back(n);
+
+    std::vector<tfrt::Ray> rays = Rays(options.nRays, 2);
+    std::vector<tfrt::RayPacket> packets = CoherentPackets(options.nRays);
+    const std::pair<const char *, tfrt::BVHBuildMethod> methods[] = {
+        {"build sah", tfrt::BVHBuildMethod::SAH},
+        {"build lbvh", tfrt::BVHBuildMethod::LBVH},
+        {"build hlbvh", tfrt::BVHBuildMethod::HLBVH}};
+    for (int nPrims : sizes) {
+        std::shared_ptr<const tfrt::TriangleMesh> mesh = TriangleSoup(nPrims, 1);
+        std::unique_ptr<tfrt::TriangleBVH> bvh;
+        for (const auto &[name, method] : methods)
+            report.Add(Measure(options, "bvh", name, "prim", nPrims, nPrims, [&] {
+                bvh.reset();
+                bvh = std::make_unique<tfrt::TriangleBVH>(mesh, method);
+            }));
+
+        // trace the SAH tree, the default
+        bvh = std::make_unique<tfrt::TriangleBVH>(mesh);
+        report.Add(Measure(options, "bvh", "trace incoherent rays", "ray", nPrims, int64_t(rays.size()),
+                           [&] { DoNotOptimize(Trace(*bvh, rays)); }));
+        report.Add(Measure(options, "bvh", "trace coherent packets", "ray", nPrims,
+                           int64_t(packets.size()) * tfrt::SIMDWidth,
+                           [&] { DoNotOptimize(TracePackets(*bvh, packets)); }));
+
+        // time to a traceable tree on a later run: mapping only, pages are read as rays need them
+        const char *filename = "tfrt_bench_cache.tfrtbvh";
+        report.Add(Measure(options, "bvh", "cache write", "prim", nPrims, nPrims,
+                           [&] { DoNotOptimize(tfrt::WriteTriangleCache(filename, *bvh, 1)); }));
+        std::shared_ptr<const tfrt::TriangleBVH> mapped;
+        report.Add(Measure(options, "bvh", "cache map", "prim", nPrims, nPrims, [&] {
+            mapped.reset();
+            mapped = tfrt::MapTriangleCache(filename, 1);
+        }));
+        std::remove(filename);
+    }
+}
+
+void bench::RunAnimationBenchmark(const Options &options, int nFrames) {
+    int nPrims = options.prims > 0 ? options.prims : options.maxPrims;
+    std::shared_ptr<const tfrt::TriangleMesh> mesh = TriangleSoup(nPrims, 1);
+    std::vector<tfrt::Ray> rays = Rays(options.nRays, 2);
+    std::printf("%d triangles, %d rays, %d frames\n", nPrims, options.nRays, nFrames);
+    Animate(mesh, rays, nFrames);
+}
@@ -0,0 +1,93 @@
+// Whole frames: a 400 x 400 view of 10k spheres on a ground plane, path
+// traced with 4 samples per pixel and up to 5 bounces by each integrator,
+// tiles in parallel as in tfrt, and direct lighting alone by the generic and
+// the specialized wavefront kernel. One op is one pixel sample.
+
+#include <memory>
+#include <vector>
+
+#include "bench.hpp"
+#include "camera/camera.hpp"
+#include "core/bounds.hpp"
+#include "core/features.hpp"
+#include "core/transform.hpp"
+#include "film/film.hpp"
+#include "render/integrator.hpp"
+#include "render/wavefront.hpp"
+#include "sampler/rng.hpp"
+#include "sampler/sampler.hpp"
+#include "scene/scene.hpp"
+#include "scene/sphere.hpp"
+#include "scene/triangle.hpp"
+#include "util/parallel.hpp"
+
+namespace {
+
+constexpr int Width = 400, Height = 400, SamplesPerPixel = 4;
+
+tfrt::Scene MakeScene() {
+    tfrt::CounterRNG rng(3);
+    std::vector<tfrt::Sphere> spheres;
+    for (int i = 0; i < 100; ++i) {
+        for (int j = 0; j < 100; ++j) {
+            tfrt::Point2i p(i, j);
+            float r = 0.05f + 0.1f * rng.Uniform(p, 0, 0);
+            spheres.push_back(tfrt::Sphere(
+                tfrt::Point3f(i * 0.4f - 20 + 0.2f * rng.Uniform(p, 0, 1), r, j * 0.4f - 20 + 0.2f * rng.Uniform(p, 0, 2)),
+                r));
+        }
+    }
+    std::vector<tfrt::Point3f> p{{-30, 0, -30}, {30, 0, -30}, {30, 0, 30}, {-30, 0, 30}};
+    auto ground = std::make_shared<const tfrt::TriangleMesh>(std::vector<int>{0, 1, 2, 0, 2, 3}, p);
+    return tfrt::Scene(spheres, {ground});
+}
+
+template <typename Integrator>
+void RenderFrame(tfrt::Film &film, const Integrator &integrator) {
+    tfrt::ParallelForTiles(film.PixelBounds(), 16, [&](tfrt::Bounds2i b) {
+        tfrt::FilmTile tile = film.GetFilmTile(b);
+        integrator.RenderTile(tile, 0, SamplesPerPixel);
+        film.MergeFilmTile(tile);
+    });
+}
+
+} // namespace
+
+void bench::RunFrameBenchmarks(const Options &options, Report &report) {
+    tfrt::Scene scene;
+    report.Add(Measure(options, "frame", "scene build", "prim", 10002, 10002, [&] { scene = MakeScene(); }));
+
+    tfrt::PerspectiveCamera camera(
+        tfrt::Inverse(tfrt::LookAt(tfrt::Point3f(0, 4, -22), tfrt::Point3f(0, 0, 0), tfrt::Vector3f(0, 1, 0))),
+        tfrt::Point2i(Width, Height), 50);
+    tfrt::SobolSampler sampler(SamplesPerPixel, 0);
+    tfrt::PathSettings settings;
+    tfrt::Film film(Width, Height);
+    int64_t samplesPerFrame = int64_t(Width) * Height * SamplesPerPixel;
+
+    tfrt::RecursivePathIntegrator recursive(scene, camera, sampler, settings);
+    report.Add(Measure(options, "frame", "path trace recursive", "sample", 10002, samplesPerFrame,
+                       [&] { RenderFrame(film, recursive); }));
+
+    tfrt::WavefrontPathIntegrator wavefront(scene, camera, sampler, settings);
+    report.Add(Measure(options, "frame", "path trace wavefront", "sample", 10002, samplesPerFrame,
+                       [&] { RenderFrame(film, wavefront); }));
+
+    tfrt::WavefrontOptions sorted;
+    sorted.sortRays = true;
+    tfrt::WavefrontPathIntegrator wavefrontSorted(scene, camera, sampler, settings, sorted);
+    report.Add(Measure(options, "frame", "path trace wavefront, sorted", "sample", 10002, samplesPerFrame,
+                       [&] { RenderFrame(film, wavefrontSorted); }));
+
+    // what tfrt dispatches to for --maxdepth 1 against the kernel for every feature
+    tfrt::PathSettings direct = settings;
+    direct.maxDepth = 1;
+    tfrt::WavefrontPathIntegrator generic(scene, camera, sampler, direct);
+    report.Add(Measure(options, "frame", "direct wavefront, generic", "sample", 10002, samplesPerFrame,
+                       [&] { RenderFrame(film, generic); }));
+    tfrt::DispatchFeatures(tfrt::PathFeatures(scene, direct), [&](auto features) {
+        tfrt::WavefrontPathIntegrator<decltype(features)> specialized(scene, camera, sampler, direct);
+        report.Add(Measure(options, "frame", "direct wavefront, specialized", "sample", 10002,
+                           samplesPerFrame, [&] { RenderFrame(film, specialized); }));
+    });
+}
@@ -0,0 +1,150 @@
+// Ray-primitive kernels on 4096 random ray-primitive pairs, about half of
+// them hits. One op is one ray-primitive test, so a packet or wide call
+// counts SIMDWidth ops.
+
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "bench.hpp"
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/vecmath.hpp"
+#include "scene/sphere.hpp"
+#include "scene/triangle.hpp"
+#include "util/math.hpp"
+
+namespace {
+
+constexpr int N = 4096;
+
+// rays from around (0, 0, -3) towards the unit cube at the origin, and a primitive near each ray's target
+struct Data {
+    std::vector<tfrt::Ray> rays;
+    std::vector<tfrt::TraversalRay> traversalRays;
+    std::vector<tfrt::TriangleRay> triangleRays;
+    std::vector<tfrt::Point3f> centers;
+    std::vector<float> radii;
+    std::vector<tfrt::Bounds3f> boxes;
+    std::vector<tfrt::Point3f> triangles;
+};
+
+Data MakeData() {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    Data d;
+    for (int i = 0; i < N; ++i) {
+        tfrt::Point3f o(0.2f * u(rng), 0.2f * u(rng), -3);
+        tfrt::Point3f target(u(rng), u(rng), u(rng));
+        tfrt::Ray ray(o, tfrt::Normalize(target - o));
+        d.rays.push_back(ray);
+        d.traversalRays.emplace_back(ray);
+        d.triangleRays.emplace_back(ray);
+
+        // primitives about their size away from the target
+        tfrt::Point3f c = target + tfrt::Vector3f(u(rng), u(rng), u(rng)) * 0.15f;
+        d.centers.push_back(c);
+        d.radii.push_back(0.15f);
+        d.boxes.emplace_back(c - tfrt::Vector3f(0.15f, 0.15f, 0.15f), c + tfrt::Vector3f(0.15f, 0.15f, 0.15f));
+        for (int v = 0; v < 3; ++v)
+            d.triangles.push_back(c + tfrt::Vector3f(u(rng), u(rng), 0.1f * u(rng)) * 0.3f);
+    }
+    return d;
+}
+
+} // namespace
+
+void bench::RunKernelBenchmarks(const Options &options, Report &report) {
+    Data d = MakeData();
+    constexpr int W = tfrt::SIMDWidth;
+
+    // packets of W consecutive rays, and W consecutive primitives in SoA form
+    std::vector<tfrt::RayPacket> packets;
+    std::vector<tfrt::Vector3fN> packetOC;
+    std::vector<tfrt::Bounds3fN> wideBoxes;
+    std::vector<tfrt::TriangleGroup> groups;
+    for (int i = 0; i < N; i += W) {
+        packets.emplace_back(&d.rays[i], W);
+        alignas(32) float oc[3][W];
+        for (int l = 0; l < W; ++l)
+            for (int c = 0; c < 3; ++c)
+                oc[c][l] = d.rays[i + l].o[c] - d.centers[i + l][c];
+        packetOC.emplace_back(tfrt::FloatN::Load(oc[0]), tfrt::FloatN::Load(oc[1]), tfrt::FloatN::Load(oc[2]));
+        wideBoxes.emplace_back(&d.boxes[i], W);
+
+        tfrt::TriangleGroup g;
+        g.count = W;
+        for (int v = 0; v < 3; ++v) {
+            alignas(32) float lanes[3][W];
+            for (int l = 0; l < W; ++l)
+                for (int c = 0; c < 3; ++c)
+                    lanes[c][l] = d.triangles[3 * (i + l) + v][c];
+            for (int c = 0; c < 3; ++c)
+                g.p[v][c] = tfrt::FloatN::Load(lanes[c]);
+        }
+        for (int l = 0; l < W; ++l)
+            g.triIndex[l] = uint32_t(i + l);
+        groups.push_back(g);
+    }
+
+    report.Add(Measure(options, "kernels", "ray-sphere", "op", 0, N, [&] {
+        int hits = 0;
+        for (int i = 0; i < N; ++i)
+            hits += tfrt::IntersectSphere(d.rays[i].o - d.centers[i], d.rays[i].d, d.radii[i], 0, tfrt::Infinity)
+                        .has_value();
+        DoNotOptimize(hits);
+    }));
+    report.Add(Measure(options, "kernels", "ray-sphere packet", "op", 0, N, [&] {
+        int hits = 0;
+        tfrt::FloatN tHit;
+        for (size_t p = 0; p < packets.size(); ++p)
+            hits += tfrt::PopCount(tfrt::IntersectSphereLanes(packetOC[p], packets[p].d, tfrt::FloatN(0.15f),
+                                                              tfrt::FloatN(0.f), tfrt::FloatN(tfrt::Infinity), &tHit)
+                                       .Bits());
+        DoNotOptimize(hits);
+    }));
+
+    report.Add(Measure(options, "kernels", "ray-box", "op", 0, N, [&] {
+        int hits = 0;
+        for (int i = 0; i < N; ++i)
+            hits += d.boxes[i].IntersectP(d.traversalRays[i], tfrt::Infinity);
+        DoNotOptimize(hits);
+    }));
+    report.Add(Measure(options, "kernels", "ray-box packet (1 box, W rays)", "op", 0, N, [&] {
+        int hits = 0;
+        for (size_t p = 0; p < packets.size(); ++p) {
+            const tfrt::RayPacket &r = packets[p];
+            tfrt::Vector3fN invDir(1 / r.d.x, 1 / r.d.y, 1 / r.d.z);
+            hits += tfrt::PopCount(tfrt::IntersectP(d.boxes[p * W], r.o, r.tMin, r.tMax, invDir).Bits());
+        }
+        DoNotOptimize(hits);
+    }));
+    report.Add(Measure(options, "kernels", "ray-box wide (W boxes, 1 ray)", "op", 0, N, [&] {
+        int hits = 0;
+        for (size_t p = 0; p < wideBoxes.size(); ++p)
+            hits +=
+                tfrt::PopCount(tfrt::IntersectP(wideBoxes[p], d.traversalRays[p * W], tfrt::Infinity).Bits());
+        DoNotOptimize(hits);
+    }));
+
+    report.Add(Measure(options, "kernels", "ray-triangle", "op", 0, N, [&] {
+        int hits = 0;
+        for (int i = 0; i < N; ++i)
+            hits += tfrt::IntersectTriangle(d.triangleRays[i], 0, tfrt::Infinity, d.triangles[3 * i],
+                                            d.triangles[3 * i + 1], d.triangles[3 * i + 2])
+                        .has_value();
+        DoNotOptimize(hits);
+    }));
+    report.Add(Measure(options, "kernels", "ray-triangle group (W tris, 1 ray)", "op", 0, N, [&] {
+        int hits = 0;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            tfrt::MaskN zeroEdge;
+            tfrt::MaskN hit =
+                tfrt::IntersectTriangleLanes(groups[g], d.triangleRays[g * W], 0, tfrt::Infinity, &zeroEdge);
+            hits += tfrt::PopCount(hit.Bits());
+        }
+        DoNotOptimize(hits);
+    }));
+}
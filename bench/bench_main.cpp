@@ -0,0 +1,113 @@
+// Microbenchmarks of the hot paths: vector math, ray-primitive kernels,
+// BVH build and trace from 1k to 10M primitives, and whole frames. Every
+// result reports ns/op, Mops/s (Mrays/s for rays) and heap allocations;
+// --json writes them to a file for tracking over time.
+//
+//     tfrt_bench [--suite all|vecmath|kernels|bvh|frame] [--json file]
+//                [--mintime seconds] [--prims n] [--maxprims n] [--rays n]
+//                [--nthreads n] [--frames n]
+//
+// --frames n runs the refit against rebuild comparison of an animated BVH
+// over n frames instead.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "bench.hpp"
+#include "core/simd.hpp"
+#include "util/parallel.hpp"
+
+namespace {
+
+std::atomic<int64_t> heapAllocations{0};
+
+void *CountedAlloc(std::size_t size, std::size_t align) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    size = size == 0 ? align : (size + align - 1) / align * align;
+    if (void *p = align <= alignof(std::max_align_t) ? std::malloc(size) : std::aligned_alloc(align, size))
+        return p;
+    throw std::bad_alloc();
+}
+
+const char *SIMDName() {
+#if defined(TFRT_SIMD_AVX2)
+    return "AVX2";
+#elif defined(TFRT_SIMD_SSE)
+    return "SSE2";
+#else
+    return "NONE";
+#endif
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return CountedAlloc(size, alignof(std::max_align_t)); }
+void *operator new(std::size_t size, std::align_val_t align) { return CountedAlloc(size, std::size_t(align)); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+int64_t bench::Allocations() { return heapAllocations.load(std::memory_order_relaxed); }
+
+int main(int argc, char *argv[]) {
+    bench::Options options;
+    options.nThreads = tfrt::AvailableCores();
+    std::string suite = "all", jsonFile;
+    int nFrames = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--suite")
+            suite = argv[i + 1];
+        else if (arg == "--json")
+            jsonFile = argv[i + 1];
+        else if (arg == "--mintime")
+            options.minSeconds = std::stod(argv[i + 1]);
+        else if (arg == "--prims")
+            options.prims = std::stoi(argv[i + 1]);
+        else if (arg == "--maxprims")
+            options.maxPrims = std::stoi(argv[i + 1]);
+        else if (arg == "--rays")
+            options.nRays = std::stoi(argv[i + 1]);
+        else if (arg == "--nthreads")
+            options.nThreads = std::stoi(argv[i + 1]);
+        else if (arg == "--frames")
+            nFrames = std::stoi(argv[i + 1]);
+        else {
+            std::fprintf(stderr,
+                         "usage: tfrt_bench [--suite all|vecmath|kernels|bvh|frame] [--json file]\n"
+                         "                  [--mintime seconds] [--prims n] [--maxprims n] [--rays n]\n"
+                         "                  [--nthreads n] [--frames n]\n");
+            return 1;
+        }
+    }
+    tfrt::ParallelInit(options.nThreads);
+    std::printf("%s x%d, %d threads\n", SIMDName(), tfrt::SIMDWidth, options.nThreads);
+
+    if (nFrames > 0) {
+        bench::RunAnimationBenchmark(options, nFrames);
+        tfrt::ParallelCleanup();
+        return 0;
+    }
+
+    bench::Report report;
+    if (suite == "all" || suite == "vecmath")
+        bench::RunVecmathBenchmarks(options, report);
+    if (suite == "all" || suite == "kernels")
+        bench::RunKernelBenchmarks(options, report);
+    if (suite == "all" || suite == "bvh")
+        bench::RunBVHBenchmarks(options, report);
+    if (suite == "all" || suite == "frame")
+        bench::RunFrameBenchmarks(options, report);
+
+    tfrt::ParallelCleanup();
+    if (!jsonFile.empty() && !report.WriteJSON(jsonFile, options, SIMDName(), tfrt::SIMDWidth)) {
+        std::fprintf(stderr, "Error writing %s.\n", jsonFile.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Vector math over arrays of 4096 elements, scalar and SIMDWidth lanes at a
+// time. One op is one element, so scalar and packet rows compare directly.
+// The transcendentals of util/math.hpp run in both tiers, Exp against
+// FastExp and so on.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/vecmath.hpp"
+#include "util/math.hpp"
+
+namespace {
+
+constexpr int N = 4096;
+
+struct Data {
+    std::vector<tfrt::Vector3f> a, b, out;
+    // the same vectors in SoA form, plus scalars for FMA
+    std::vector<float> ax, ay, az, bx, by, bz, ox, oy, oz;
+};
+
+Data MakeData() {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    Data d;
+    d.out.resize(N);
+    for (std::vector<float> *v : {&d.ox, &d.oy, &d.oz})
+        v->resize(N);
+    for (int i = 0; i < N; ++i) {
+        d.a.emplace_back(u(rng), u(rng), u(rng) + 2);
+        d.b.emplace_back(u(rng), u(rng), u(rng));
+        d.ax.push_back(d.a[i].x);
+        d.ay.push_back(d.a[i].y);
+        d.az.push_back(d.a[i].z);
+        d.bx.push_back(d.b[i].x);
+        d.by.push_back(d.b[i].y);
+        d.bz.push_back(d.b[i].z);
+    }
+    return d;
+}
+
+tfrt::Vector3fN LoadN(const std::vector<float> &x, const std::vector<float> &y, const std::vector<float> &z, int i) {
+    return tfrt::Vector3fN(tfrt::FloatN::Load(&x[i]), tfrt::FloatN::Load(&y[i]), tfrt::FloatN::Load(&z[i]));
+}
+
+// a generic lambda turns a function template of util/math.hpp into one callable with float and FloatN
+#define TFRT_LANES(F) [](auto x) { return tfrt::F(x); }
+
+// a function of util/math.hpp in its exact and fast tier, float and FloatN, over N arguments in [lo, hi]
+template <typename Exact, typename Fast>
+void MeasureTiers(const bench::Options &options, bench::Report &report, Data &d, const std::string &name, float lo,
+                  float hi, Exact exact, Fast fast) {
+    for (int i = 0; i < N; ++i)
+        d.ax[i] = lo + (hi - lo) * (i + 0.5f) / N;
+    auto measure = [&](const std::string &tier, auto f) {
+        report.Add(bench::Measure(options, "vecmath", tier + name + " float", "op", 0, N, [&] {
+            for (int i = 0; i < N; ++i)
+                d.ox[i] = f(d.ax[i]);
+            bench::DoNotOptimize(d.ox[0]);
+        }));
+        report.Add(bench::Measure(options, "vecmath", tier + name + " FloatN", "op", 0, N, [&] {
+            for (int i = 0; i < N; i += tfrt::SIMDWidth)
+                f(tfrt::FloatN::Load(&d.ax[i])).Store(&d.ox[i]);
+            bench::DoNotOptimize(d.ox[0]);
+        }));
+    };
+    measure("", exact);
+    measure("Fast", fast);
+}
+
+} // namespace
+
+void bench::RunVecmathBenchmarks(const Options &options, Report &report) {
+    Data d = MakeData();
+
+    report.Add(Measure(options, "vecmath", "Dot Vector3f", "op", 0, N, [&] {
+        float sum = 0;
+        for (int i = 0; i < N; ++i)
+            sum += tfrt::Dot(d.a[i], d.b[i]);
+        DoNotOptimize(sum);
+    }));
+    report.Add(Measure(options, "vecmath", "Dot Vector3fN", "op", 0, N, [&] {
+        tfrt::FloatN sum(0.f);
+        for (int i = 0; i < N; i += tfrt::SIMDWidth)
+            sum += tfrt::Dot(LoadN(d.ax, d.ay, d.az, i), LoadN(d.bx, d.by, d.bz, i));
+        DoNotOptimize(sum);
+    }));
+
+    report.Add(Measure(options, "vecmath", "Normalize Vector3f", "op", 0, N, [&] {
+        for (int i = 0; i < N; ++i)
+            d.out[i] = tfrt::Normalize(d.a[i]);
+        DoNotOptimize(d.out[0]);
+    }));
+    report.Add(Measure(options, "vecmath", "Normalize Vector3fN", "op", 0, N, [&] {
+        for (int i = 0; i < N; i += tfrt::SIMDWidth) {
+            tfrt::Vector3fN v = tfrt::Normalize(LoadN(d.ax, d.ay, d.az, i));
+            v.x.Store(&d.ox[i]);
+            v.y.Store(&d.oy[i]);
+            v.z.Store(&d.oz[i]);
+        }
+        DoNotOptimize(d.ox[0]);
+    }));
+
+    report.Add(Measure(options, "vecmath", "FastNormalize Vector3f", "op", 0, N, [&] {
+        for (int i = 0; i < N; ++i)
+            d.out[i] = tfrt::FastNormalize(d.a[i]);
+        DoNotOptimize(d.out[0]);
+    }));
+    report.Add(Measure(options, "vecmath", "FastNormalize Vector3fN", "op", 0, N, [&] {
+        for (int i = 0; i < N; i += tfrt::SIMDWidth) {
+            tfrt::Vector3fN v = tfrt::FastNormalize(LoadN(d.ax, d.ay, d.az, i));
+            v.x.Store(&d.ox[i]);
+            v.y.Store(&d.oy[i]);
+            v.z.Store(&d.oz[i]);
+        }
+        DoNotOptimize(d.ox[0]);
+    }));
+
+    report.Add(Measure(options, "vecmath", "FMA float", "op", 0, N, [&] {
+        for (int i = 0; i < N; ++i)
+            d.ox[i] = tfrt::FMA(d.ax[i], d.bx[i], d.ay[i]);
+        DoNotOptimize(d.ox[0]);
+    }));
+    report.Add(Measure(options, "vecmath", "FMA FloatN", "op", 0, N, [&] {
+        for (int i = 0; i < N; i += tfrt::SIMDWidth)
+            FMA(tfrt::FloatN::Load(&d.ax[i]), tfrt::FloatN::Load(&d.bx[i]), tfrt::FloatN::Load(&d.ay[i]))
+                .Store(&d.ox[i]);
+        DoNotOptimize(d.ox[0]);
+    }));
+
+    // each function in both tiers, on arguments inside the domain of the fast one
+    MeasureTiers(options, report, d, "RSqrt", 1e-3f, 1e3f, TFRT_LANES(RSqrt), TFRT_LANES(FastRSqrt));
+    MeasureTiers(options, report, d, "Exp", -80, 80, TFRT_LANES(Exp), TFRT_LANES(FastExp));
+    MeasureTiers(options, report, d, "Log", 1e-3f, 1e3f, TFRT_LANES(Log), TFRT_LANES(FastLog));
+    MeasureTiers(
+        options, report, d, "Pow", 1e-3f, 10, [](auto x) { return tfrt::Pow(x, decltype(x)(2.5f)); },
+        [](auto x) { return tfrt::FastPow(x, decltype(x)(2.5f)); });
+    MeasureTiers(options, report, d, "Sin", -10, 10, TFRT_LANES(Sin), TFRT_LANES(FastSin));
+    MeasureTiers(options, report, d, "Cos", -10, 10, TFRT_LANES(Cos), TFRT_LANES(FastCos));
+    MeasureTiers(
+        options, report, d, "ATan2", -10, 10, [](auto y) { return tfrt::ATan2(y, decltype(y)(0.5f) - y); },
+        [](auto y) { return tfrt::FastATan2(y, decltype(y)(0.5f) - y); });
+    MeasureTiers(options, report, d, "ACos", -1, 1, TFRT_LANES(ACos), TFRT_LANES(FastACos));
+}
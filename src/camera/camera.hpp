@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/transform.hpp"
+#include "core/vecmath.hpp"
+
+namespace tfrt
+{
+    /*
+     *  Camera rays of a tile in SoA form, pixels in scanline order. The
+     *  storage is owned by the caller, so one buffer can be reused for
+     *  every tile a thread renders.
+     */
+    struct RayDifferentialSoA
+    {
+        static constexpr int FloatsPerRay = 18;
+
+        // storage must hold FloatsPerRay * capacity floats
+        RayDifferentialSoA(float *storage, int capacity) : capacity(capacity)
+        {
+            for (float **array : {o, d, rxOrigin, rxDirection, ryOrigin, ryDirection})
+                for (int c = 0; c < 3; ++c, storage += capacity)
+                    array[c] = storage;
+        }
+
+        RayDifferential operator[](int i) const
+        {
+            RayDifferential ray(Point3f(o[0][i], o[1][i], o[2][i]), Vector3f(d[0][i], d[1][i], d[2][i]),
+                                time);
+            if (!hasDifferentials)
+                return ray;
+            ray.hasDifferentials = true;
+            ray.rxOrigin = Point3f(rxOrigin[0][i], rxOrigin[1][i], rxOrigin[2][i]);
+            ray.ryOrigin = Point3f(ryOrigin[0][i], ryOrigin[1][i], ryOrigin[2][i]);
+            ray.rxDirection = Vector3f(rxDirection[0][i], rxDirection[1][i], rxDirection[2][i]);
+            ray.ryDirection = Vector3f(ryDirection[0][i], ryDirection[1][i], ryDirection[2][i]);
+            return ray;
+        }
+
+        // rays first .. first + n - 1 as a packet, loaded without a gather
+        RayPacket Packet(int first, int n) const
+        {
+            DCHECK(n > 0 && n <= SIMDWidth && first + n <= count);
+            auto load = [&](const float *array) {
+                if (n == SIMDWidth)
+                    return FloatN::Load(array + first);
+                // partial packets repeat the first ray, as RayPacket(rays, n) does
+                alignas(32) float lanes[SIMDWidth];
+                for (int i = 0; i < SIMDWidth; ++i)
+                    lanes[i] = array[first + (i < n ? i : 0)];
+                return FloatN::Load(lanes);
+            };
+            RayPacket packet;
+            packet.o = Point3fN(load(o[0]), load(o[1]), load(o[2]));
+            packet.d = Vector3fN(load(d[0]), load(d[1]), load(d[2]));
+            packet.tMax = Select(MaskN::FromBits((1u << n) - 1), FloatN(Infinity), FloatN(-Infinity));
+            packet.time = FloatN(time);
+            return packet;
+        }
+
+        float *o[3], *d[3];
+        float *rxOrigin[3], *rxDirection[3], *ryOrigin[3], *ryDirection[3];
+        int capacity = 0, count = 0;
+        Float time = 0;
+        // false when the rx and ry arrays were not written
+        bool hasDifferentials = true;
+    };
+
+    // [-aspect, aspect] x [-1, 1] for wide images, [-1, 1] x [-1/aspect, 1/aspect] for tall ones
+    inline Bounds2f DefaultScreenWindow(Point2i resolution)
+    {
+        Float frame = Float(resolution.x) / resolution.y;
+        if (frame > 1)
+            return Bounds2f(Point2f(-frame, -1), Point2f(frame, 1));
+        return Bounds2f(Point2f(-1, -1 / frame), Point2f(1, 1 / frame));
+    }
+
+    /*
+     *  Cameras whose rays are affine in raster position: the origin and
+     *  the unnormalized direction of the ray through raster point (x, y)
+     *  are base + x * dx + y * dy. The six render-space vectors are derived
+     *  once from the raster-to-camera and camera-to-render transforms, so a
+     *  ray costs six FMAs and a normalization, and each differential one
+     *  more add and normalization.
+     */
+    class ProjectiveCamera
+    {
+    public:
+        Point2i Resolution() const { return resolution; }
+
+        const Transform &RenderFromCamera() const { return renderFromCamera; }
+
+        // ray through raster position pFilm, with y pointing down
+        Ray GenerateRay(Point2f pFilm, Float time = 0) const
+        {
+            Point3f o = oBase + FMA(pFilm.x, oDx, pFilm.y * oDy);
+            Vector3f d = FMA(pFilm.x, dDx, FMA(pFilm.y, dDy, dBase));
+            return Ray(o, Normalize(d), time);
+        }
+
+        // differentials point at the neighbouring pixels in x and y
+        RayDifferential GenerateRayDifferential(Point2f pFilm, Float time = 0) const
+        {
+            Point3f o = oBase + FMA(pFilm.x, oDx, pFilm.y * oDy);
+            Vector3f d = FMA(pFilm.x, dDx, FMA(pFilm.y, dDy, dBase));
+            RayDifferential ray(o, Normalize(d), time);
+            ray.hasDifferentials = true;
+            ray.rxOrigin = o + oDx;
+            ray.ryOrigin = o + oDy;
+            ray.rxDirection = Normalize(d + dDx);
+            ray.ryDirection = Normalize(d + dDy);
+            return ray;
+        }
+
+        /*
+         *  Writes the rays of every pixel of tile, sampled at
+         *  pixel + sampleOffset, SIMDWidth pixels of a row at a time.
+         *  Without Differentials only origins and directions are written.
+         */
+        template <bool Differentials = true>
+        void GenerateTile(const Bounds2i &tile, RayDifferentialSoA &rays,
+                          Point2f sampleOffset = Point2f(0.5f, 0.5f), Float time = 0) const
+        {
+            generateTile<Differentials>(tile, rays, time, [&](Point2i) {
+                return std::make_pair(FloatN(sampleOffset.x), FloatN(sampleOffset.y));
+            });
+        }
+
+        // the same with each pixel's offset from dimensions 0 and 1 of its sampleIndex-th sample
+        template <bool Differentials = true, typename Sampler>
+        void GenerateTile(const Bounds2i &tile, RayDifferentialSoA &rays, const Sampler &sampler,
+                          int sampleIndex, Float time = 0) const
+        {
+            generateTile<Differentials>(tile, rays, time, [&](Point2i p) {
+                return std::make_pair(sampler.Sample1DN(p, sampleIndex, 0),
+                                      sampler.Sample1DN(p, sampleIndex, 1));
+            });
+        }
+
+    protected:
+        ProjectiveCamera(const Transform &renderFromCamera, Point2i resolution,
+                         const Transform &screenFromCamera, const Bounds2f &screenWindow)
+            : renderFromCamera(renderFromCamera), resolution(resolution)
+        {
+            // screen window to raster, flipping y so that raster y points down
+            Transform ndcFromScreen =
+                Scale(1 / (screenWindow.pMax.x - screenWindow.pMin.x),
+                      1 / (screenWindow.pMax.y - screenWindow.pMin.y), 1) *
+                Translate(Vector3f(-screenWindow.pMin.x, -screenWindow.pMax.y, 0));
+            Transform rasterFromNDC = Scale(Float(resolution.x), -Float(resolution.y), 1);
+            cameraFromRaster = Inverse(screenFromCamera) * Inverse(rasterFromNDC * ndcFromScreen);
+        }
+
+        // the point that raster position (x, y, 0) maps to in camera space
+        Point3f cameraPoint(Float x, Float y) const { return cameraFromRaster(Point3f(x, y, 0)); }
+
+        // base, dx and dy of the origins and unnormalized directions, in render space
+        Point3f oBase;
+        Vector3f oDx, oDy;
+        Vector3f dBase, dDx, dDy;
+
+        Transform renderFromCamera, cameraFromRaster;
+        Point2i resolution;
+
+    private:
+        // offsets(p) gives the sample offsets of pixels p .. p + (SIMDWidth - 1, 0)
+        template <bool Differentials, typename Offsets>
+        void generateTile(const Bounds2i &tile, RayDifferentialSoA &rays, Float time,
+                          Offsets offsets) const
+        {
+            int width = tile.pMax.x - tile.pMin.x;
+            rays.count = width * (tile.pMax.y - tile.pMin.y);
+            rays.time = time;
+            rays.hasDifferentials = Differentials;
+            DCHECK(rays.count <= rays.capacity);
+
+            alignas(32) static const float laneOffsets[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+            FloatN lane = FloatN::Load(laneOffsets);
+            for (int y = tile.pMin.y; y < tile.pMax.y; ++y)
+            {
+                for (int x = tile.pMin.x; x < tile.pMax.x; x += SIMDWidth)
+                {
+                    auto [dx, dy] = offsets(Point2i(x, y));
+                    FloatN fx = FloatN(Float(x)) + lane + dx;
+                    FloatN fy = FloatN(Float(y)) + dy;
+                    Point3fN o = Broadcast(oBase) + Broadcast(oDx) * fx + Broadcast(oDy) * fy;
+                    Vector3fN d = Broadcast(dBase) + Broadcast(dDx) * fx + Broadcast(dDy) * fy;
+                    int i = (y - tile.pMin.y) * width + (x - tile.pMin.x);
+                    int n = std::min(SIMDWidth, tile.pMax.x - x);
+                    store(rays.o, i, n, o);
+                    store(rays.d, i, n, normalize(d));
+                    if constexpr (!Differentials)
+                        continue;
+                    store(rays.rxOrigin, i, n, o + Broadcast(oDx));
+                    store(rays.ryOrigin, i, n, o + Broadcast(oDy));
+                    store(rays.rxDirection, i, n, normalize(d + Broadcast(dDx)));
+                    store(rays.ryDirection, i, n, normalize(d + Broadcast(dDy)));
+                }
+            }
+        }
+
+        static Vector3fN normalize(const Vector3fN &v) { return v * RSqrt(LengthSquared(v)); }
+
+        template <typename T>
+        static void store(float *const array[3], int i, int n, const T &v)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                if (n == SIMDWidth)
+                    v[c].Store(array[c] + i);
+                else
+                {
+                    alignas(32) float lanes[SIMDWidth];
+                    v[c].Store(lanes);
+                    std::copy(lanes, lanes + n, array[c] + i);
+                }
+            }
+        }
+    };
+
+    /*
+     *  Pinhole camera looking down +z in camera space. fov is the full
+     *  field of view of the shorter image axis, in degrees.
+     */
+    class PerspectiveCamera : public ProjectiveCamera
+    {
+    public:
+        PerspectiveCamera(const Transform &renderFromCamera, Point2i resolution, Float fov,
+                          const Bounds2f &screenWindow)
+            : ProjectiveCamera(renderFromCamera, resolution, Perspective(fov, 1e-2f, 1000.f), screenWindow)
+        {
+            // every ray starts at the eye; directions run through the near plane
+            oBase = renderFromCamera(Point3f(0, 0, 0));
+            oDx = oDy = Vector3f(0, 0, 0);
+            Point3f p00 = cameraPoint(0, 0);
+            dBase = renderFromCamera(Vector3f(p00));
+            dDx = renderFromCamera(cameraPoint(1, 0) - p00);
+            dDy = renderFromCamera(cameraPoint(0, 1) - p00);
+        }
+
+        PerspectiveCamera(const Transform &renderFromCamera, Point2i resolution, Float fov)
+            : PerspectiveCamera(renderFromCamera, resolution, fov, DefaultScreenWindow(resolution)) {}
+    };
+
+    // parallel rays along +z in camera space, the screen window is in camera-space units
+    class OrthographicCamera : public ProjectiveCamera
+    {
+    public:
+        OrthographicCamera(const Transform &renderFromCamera, Point2i resolution,
+                           const Bounds2f &screenWindow)
+            : ProjectiveCamera(renderFromCamera, resolution, Orthographic(0, 1), screenWindow)
+        {
+            Point3f p00 = cameraPoint(0, 0);
+            oBase = renderFromCamera(p00);
+            oDx = renderFromCamera(cameraPoint(1, 0) - p00);
+            oDy = renderFromCamera(cameraPoint(0, 1) - p00);
+            dBase = renderFromCamera(Vector3f(0, 0, 1));
+            dDx = dDy = Vector3f(0, 0, 0);
+        }
+
+        OrthographicCamera(const Transform &renderFromCamera, Point2i resolution)
+            : OrthographicCamera(renderFromCamera, resolution, DefaultScreenWindow(resolution)) {}
+    };
+}
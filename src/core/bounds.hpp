@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include "ray.hpp"
+#include "vecmath.hpp"
+
+namespace tfrt
+{
+    template <typename T>
+    class Bounds2
+    {
+    public:
+        Point2<T> pMin, pMax;
+
+    public:
+        // constructors
+        Bounds2()
+        {
+            T minNum = std::numeric_limits<T>::lowest();
+            T maxNum = std::numeric_limits<T>::max();
+            pMin = Point2<T>(maxNum, maxNum);
+            pMax = Point2<T>(minNum, minNum);
+        }
+
+        Bounds2(Point2<T> p1, Point2<T> p2)
+            : pMin(std::min(p1.x, p2.x), std::min(p1.y, p2.y)),
+              pMax(std::max(p1.x, p2.x), std::max(p1.y, p2.y)) {}
+
+        Vector2<T> Diagonal() const { return pMax - pMin; }
+
+        T Area() const
+        {
+            Vector2<T> d = pMax - pMin;
+            return d.x * d.y;
+        }
+
+        bool IsEmpty() const { return pMin.x >= pMax.x || pMin.y >= pMax.y; }
+
+        bool operator==(const Bounds2<T> &b) const
+        {
+            return pMin.x == b.pMin.x && pMin.y == b.pMin.y &&
+                   pMax.x == b.pMax.x && pMax.y == b.pMax.y;
+        }
+        bool operator!=(const Bounds2<T> &b) const { return !(*this == b); }
+
+        std::string ToString() const
+        {
+            return "[ " + pMin.ToString() + " - " + pMax.ToString() + " ]";
+        }
+    };
+
+    using Bounds2f = Bounds2<Float>;
+    using Bounds2i = Bounds2<int>;
+
+    template <typename T>
+    inline Bounds2<T> Intersect(const Bounds2<T> &b1, const Bounds2<T> &b2)
+    {
+        Bounds2<T> b;
+        b.pMin = Point2<T>(std::max(b1.pMin.x, b2.pMin.x), std::max(b1.pMin.y, b2.pMin.y));
+        b.pMax = Point2<T>(std::min(b1.pMax.x, b2.pMax.x), std::min(b1.pMax.y, b2.pMax.y));
+        return b;
+    }
+
+    template <typename T>
+    class Bounds3
+    {
+    public:
+        Point3<T> pMin, pMax;
+
+    public:
+        // constructors
+        Bounds3()
+        {
+            T minNum = std::numeric_limits<T>::lowest();
+            T maxNum = std::numeric_limits<T>::max();
+            pMin = Point3<T>(maxNum, maxNum, maxNum);
+            pMax = Point3<T>(minNum, minNum, minNum);
+        }
+
+        explicit Bounds3(Point3<T> p) : pMin(p), pMax(p) {}
+
+        Bounds3(Point3<T> p1, Point3<T> p2)
+            : pMin(Min(p1, p2)), pMax(Max(p1, p2)) {}
+
+        // index access, 0 for pMin and 1 for pMax
+        Point3<T> operator[](int i) const
+        {
+            DCHECK(i == 0 || i == 1);
+            return (i == 0) ? pMin : pMax;
+        }
+
+        Point3<T> &operator[](int i)
+        {
+            DCHECK(i == 0 || i == 1);
+            return (i == 0) ? pMin : pMax;
+        }
+
+        bool IsEmpty() const
+        {
+            return pMin.x >= pMax.x || pMin.y >= pMax.y || pMin.z >= pMax.z;
+        }
+
+        bool IsDegenerate() const
+        {
+            return pMin.x > pMax.x || pMin.y > pMax.y || pMin.z > pMax.z;
+        }
+
+        Vector3<T> Diagonal() const { return pMax - pMin; }
+
+        Point3<T> Centroid() const { return pMin * T(0.5) + pMax * T(0.5); }
+
+        T SurfaceArea() const
+        {
+            Vector3<T> d = Diagonal();
+            return 2 * (d.x * d.y + d.x * d.z + d.y * d.z);
+        }
+
+        // axis of the longest extent
+        int MaxDimension() const
+        {
+            Vector3<T> d = Diagonal();
+            if (d.x > d.y && d.x > d.z)
+                return 0;
+            else if (d.y > d.z)
+                return 1;
+            else
+                return 2;
+        }
+
+        // position of p relative to the corners, (0,0,0) at pMin and (1,1,1) at pMax
+        Vector3<T> Offset(Point3<T> p) const
+        {
+            Vector3<T> o = p - pMin;
+            if (pMax.x > pMin.x)
+                o.x /= pMax.x - pMin.x;
+            if (pMax.y > pMin.y)
+                o.y /= pMax.y - pMin.y;
+            if (pMax.z > pMin.z)
+                o.z /= pMax.z - pMin.z;
+            return o;
+        }
+
+        // slab test of [ray.tMin, raytMax), raytMax is passed separately as
+        // it shrinks during traversal
+        bool IntersectP(const TraversalRay &ray, Float raytMax) const;
+
+        bool operator==(const Bounds3<T> &b) const
+        {
+            return pMin.x == b.pMin.x && pMin.y == b.pMin.y && pMin.z == b.pMin.z &&
+                   pMax.x == b.pMax.x && pMax.y == b.pMax.y && pMax.z == b.pMax.z;
+        }
+        bool operator!=(const Bounds3<T> &b) const { return !(*this == b); }
+
+        std::string ToString() const
+        {
+            return "[ " + pMin.ToString() + " - " + pMax.ToString() + " ]";
+        }
+    };
+
+    using Bounds3f = Bounds3<Float>;
+    using Bounds3i = Bounds3<int>;
+
+    /*
+     *  ------------- Bounds3 Inline Functions -------------
+     */
+
+    template <typename T>
+    inline Bounds3<T> Union(const Bounds3<T> &b, Point3<T> p)
+    {
+        Bounds3<T> ret;
+        ret.pMin = Min(b.pMin, p);
+        ret.pMax = Max(b.pMax, p);
+        return ret;
+    }
+
+    template <typename T>
+    inline Bounds3<T> Union(const Bounds3<T> &b1, const Bounds3<T> &b2)
+    {
+        Bounds3<T> ret;
+        ret.pMin = Min(b1.pMin, b2.pMin);
+        ret.pMax = Max(b1.pMax, b2.pMax);
+        return ret;
+    }
+
+    template <typename T>
+    inline bool Inside(Point3<T> p, const Bounds3<T> &b)
+    {
+        return (p.x >= b.pMin.x && p.x <= b.pMax.x && p.y >= b.pMin.y &&
+                p.y <= b.pMax.y && p.z >= b.pMin.z && p.z <= b.pMax.z);
+    }
+
+    template <typename T>
+    inline bool Bounds3<T>::IntersectP(const TraversalRay &ray, Float raytMax) const
+    {
+        const Bounds3<T> &bounds = *this;
+        Float tx0 = (bounds[ray.dirIsNeg[0]].x - ray.o.x) * ray.invDir.x;
+        Float tx1 = (bounds[1 - ray.dirIsNeg[0]].x - ray.o.x) * ray.invDir.x;
+        Float ty0 = (bounds[ray.dirIsNeg[1]].y - ray.o.y) * ray.invDir.y;
+        Float ty1 = (bounds[1 - ray.dirIsNeg[1]].y - ray.o.y) * ray.invDir.y;
+        Float tz0 = (bounds[ray.dirIsNeg[2]].z - ray.o.z) * ray.invDir.z;
+        Float tz1 = (bounds[1 - ray.dirIsNeg[2]].z - ray.o.z) * ray.invDir.z;
+
+        // the candidate goes first so a NaN slab (origin on the plane of a
+        // zero direction component) leaves the interval alone; compiles to
+        // maxss/minss
+        Float t0 = ray.tMin, t1 = Infinity;
+        t0 = tx0 > t0 ? tx0 : t0;
+        t0 = ty0 > t0 ? ty0 : t0;
+        t0 = tz0 > t0 ? tz0 : t0;
+        t1 = tx1 < t1 ? tx1 : t1;
+        t1 = ty1 < t1 ? ty1 : t1;
+        t1 = tz1 < t1 ? tz1 : t1;
+
+        // widen the exit distance to cover the rounding error of the slab distances
+        t1 *= 1 + 2 * gamma(3);
+        return t0 <= t1 && t0 < raytMax;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <utility>
+
+#include "tfrt.hpp"
+
+namespace tfrt
+{
+    /*
+     *  What a render kernel has to handle, fixed at compile time. Kernels
+     *  test the flags with if constexpr, so whatever a render does not use
+     *  is compiled out of their inner loops instead of branched around:
+     *
+     *    spheres        the scene has spheres
+     *    triangles      the scene has triangle meshes or instances
+     *    bounces        paths continue past their first vertex, maxDepth > 1
+     *    differentials  camera rays carry differentials
+     *
+     *  Float is what kernels accumulate path throughput and radiance in;
+     *  geometry and traversal stay in float either way. Motion blur needs
+     *  no flag, every BVH picks its static or moving traversal once per
+     *  ray or packet.
+     */
+    template <bool Spheres, bool Triangles, bool Bounces, bool Differentials, typename FloatType = Float>
+    struct KernelFeatures
+    {
+        static constexpr bool spheres = Spheres;
+        static constexpr bool triangles = Triangles;
+        static constexpr bool bounces = Bounces;
+        static constexpr bool differentials = Differentials;
+        using Float = FloatType;
+    };
+
+    // what kernels handle when they are not specialized
+    using AllFeatures = KernelFeatures<true, true, true, true>;
+
+    // the same flags at runtime, for DispatchFeatures to pick the instantiation
+    struct FeatureSet
+    {
+        bool spheres = true, triangles = true, bounces = true, differentials = true;
+    };
+
+    namespace detail
+    {
+        // turns the flags after the ones already fixed into template arguments, one at a time
+        template <typename Float, bool... Fixed, typename Kernel>
+        decltype(auto) DispatchFlags(const bool (&flags)[4], Kernel &&kernel)
+        {
+            if constexpr (sizeof...(Fixed) == 4)
+                return kernel(KernelFeatures<Fixed..., Float>{});
+            else if (flags[sizeof...(Fixed)])
+                return DispatchFlags<Float, Fixed..., true>(flags, std::forward<Kernel>(kernel));
+            else
+                return DispatchFlags<Float, Fixed..., false>(flags, std::forward<Kernel>(kernel));
+        }
+    }
+
+    /*
+     *  Calls kernel(KernelFeatures<...>{}) with the instantiation that
+     *  matches features, and returns what it returns, which must be the
+     *  same type for all of them. Each of the 16 combinations of flags is
+     *  compiled once per Float.
+     */
+    template <typename Float = tfrt::Float, typename Kernel>
+    decltype(auto) DispatchFeatures(const FeatureSet &features, Kernel &&kernel)
+    {
+        const bool flags[4] = {features.spheres, features.triangles, features.bounces, features.differentials};
+        return detail::DispatchFlags<Float>(flags, std::forward<Kernel>(kernel));
+    }
+}
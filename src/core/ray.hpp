@@ -11,7 +11,7 @@ namespace tfrt
     public:
         Point3f o;
         Vector3f d;
-        Float tMin, tMax;
+        Float tMin = 0, tMax = Infinity;
         Float time = 0;
 
     public:
@@ -43,4 +43,28 @@ namespace tfrt
             ryDirection = d + (ryDirection - d) * s;
         }
     };
+
+    /*
+     *  Traversal-side form of a ray. The reciprocal direction and direction
+     *  signs are computed once per traversal, so each box test is a handful
+     *  of multiplies and min/max with no divisions or branches.
+     */
+    class TraversalRay
+    {
+    public:
+        Point3f o;
+        Vector3f invDir;
+        int dirIsNeg[3];
+        Float tMin;
+
+    public:
+        TraversalRay() = default;
+        explicit TraversalRay(const Ray &ray)
+            : o(ray.o), invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z), tMin(ray.tMin)
+        {
+            dirIsNeg[0] = int(invDir.x < 0);
+            dirIsNeg[1] = int(invDir.y < 0);
+            dirIsNeg[2] = int(invDir.z < 0);
+        }
+    };
 }
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+
+#include "bounds.hpp"
+#include "ray.hpp"
+#include "simd.hpp"
+#include "vecmath.hpp"
+
+namespace tfrt
+{
+    // lengths of packet vectors stay one value per lane
+    template <>
+    struct TupleLength<FloatN> {
+        using type = FloatN;
+    };
+
+    // SoA bundles, lane i of x, y and z together form one vector
+    using Point3fN = Point3<FloatN>;
+    using Vector3fN = Vector3<FloatN>;
+
+    /*
+     *  SIMDWidth rays traced together. Coherent rays, such as primary rays
+     *  from neighbouring pixels, mostly visit the same BVH nodes, so one node
+     *  fetch serves the whole packet.
+     */
+    class RayPacket
+    {
+    public:
+        Point3fN o;
+        Vector3fN d;
+        FloatN tMin = 0, tMax = Infinity;
+        FloatN time = 0;
+
+    public:
+        RayPacket() = default;
+
+        // gathers n <= SIMDWidth rays, the remaining lanes never report a hit
+        RayPacket(const Ray *rays, int n)
+        {
+            DCHECK(n > 0 && n <= SIMDWidth);
+            alignas(32) float lanes[9][SIMDWidth];
+            for (int i = 0; i < SIMDWidth; ++i)
+            {
+                const Ray &r = rays[i < n ? i : 0];
+                lanes[0][i] = r.o.x;
+                lanes[1][i] = r.o.y;
+                lanes[2][i] = r.o.z;
+                lanes[3][i] = r.d.x;
+                lanes[4][i] = r.d.y;
+                lanes[5][i] = r.d.z;
+                lanes[6][i] = r.tMin;
+                lanes[7][i] = i < n ? r.tMax : -Infinity;
+                lanes[8][i] = r.time;
+            }
+            o = Point3fN(FloatN::Load(lanes[0]), FloatN::Load(lanes[1]), FloatN::Load(lanes[2]));
+            d = Vector3fN(FloatN::Load(lanes[3]), FloatN::Load(lanes[4]), FloatN::Load(lanes[5]));
+            tMin = FloatN::Load(lanes[6]);
+            tMax = FloatN::Load(lanes[7]);
+            time = FloatN::Load(lanes[8]);
+        }
+
+        Point3fN operator()(FloatN t) const { return o + d * t; }
+    };
+
+    // closest hits of a packet, per-lane fields are only meaningful in valid lanes
+    struct RayPacketHit
+    {
+        FloatN tHit = Infinity;
+        FloatN u = 0, v = 0;
+        uint32_t primIndex[SIMDWidth] = {};
+        uint32_t geomIndex[SIMDWidth] = {};
+        MaskN valid = MaskN(false);
+    };
+
+    inline Point3fN Broadcast(Point3f p) { return Point3fN(p.x, p.y, p.z); }
+    inline Vector3fN Broadcast(Vector3f v) { return Vector3fN(v.x, v.y, v.z); }
+
+    /*
+     *  Slab test of one box per lane, e.g. a moving box interpolated to each
+     *  lane's time. Each lane picks its near and far planes by the sign of
+     *  its direction, and NaN slabs and rounding are handled as in the
+     *  scalar test, so a lane hits exactly the boxes its ray would alone.
+     */
+    inline MaskN IntersectP(const Point3fN &pMin, const Point3fN &pMax, const Point3fN &o,
+                            FloatN tMin, FloatN tMax, const Vector3fN &invDir)
+    {
+        MaskN negX = invDir.x < FloatN(0.f), negY = invDir.y < FloatN(0.f), negZ = invDir.z < FloatN(0.f);
+        FloatN tx0 = (Select(negX, pMax.x, pMin.x) - o.x) * invDir.x;
+        FloatN tx1 = (Select(negX, pMin.x, pMax.x) - o.x) * invDir.x;
+        FloatN ty0 = (Select(negY, pMax.y, pMin.y) - o.y) * invDir.y;
+        FloatN ty1 = (Select(negY, pMin.y, pMax.y) - o.y) * invDir.y;
+        FloatN tz0 = (Select(negZ, pMax.z, pMin.z) - o.z) * invDir.z;
+        FloatN tz1 = (Select(negZ, pMin.z, pMax.z) - o.z) * invDir.z;
+
+        // NaN slabs are dropped as in the scalar test
+        FloatN t0 = Select(tx0 > tMin, tx0, tMin);
+        t0 = Select(ty0 > t0, ty0, t0);
+        t0 = Select(tz0 > t0, tz0, t0);
+        FloatN t1 = Select(tx1 < FloatN(Infinity), tx1, FloatN(Infinity));
+        t1 = Select(ty1 < t1, ty1, t1);
+        t1 = Select(tz1 < t1, tz1, t1);
+        t1 *= FloatN(1 + 2 * gamma(3));
+        return (t0 <= t1) & (t0 < tMax);
+    }
+
+    // slab test of one box against every lane
+    inline MaskN IntersectP(const Bounds3f &b, const Point3fN &o, FloatN tMin, FloatN tMax,
+                            const Vector3fN &invDir)
+    {
+        return IntersectP(Broadcast(b.pMin), Broadcast(b.pMax), o, tMin, tMax, invDir);
+    }
+
+    /*
+     *  SIMDWidth boxes in SoA form, lane i of each coordinate belongs to box
+     *  i. Lanes past the loaded boxes are empty and never hit.
+     */
+    class Bounds3fN
+    {
+    public:
+        Point3fN pMin = Point3fN(Infinity, Infinity, Infinity);
+        Point3fN pMax = Point3fN(-Infinity, -Infinity, -Infinity);
+
+    public:
+        Bounds3fN() = default;
+
+        Bounds3fN(const Bounds3f *boxes, int n)
+        {
+            DCHECK(n >= 0 && n <= SIMDWidth);
+            alignas(32) float lanes[6][SIMDWidth];
+            for (int i = 0; i < SIMDWidth; ++i)
+            {
+                Bounds3f b = i < n ? boxes[i] : Bounds3f();
+                for (int c = 0; c < 3; ++c)
+                {
+                    lanes[c][i] = b.pMin[c];
+                    lanes[3 + c][i] = b.pMax[c];
+                }
+            }
+            pMin = Point3fN(FloatN::Load(lanes[0]), FloatN::Load(lanes[1]), FloatN::Load(lanes[2]));
+            pMax = Point3fN(FloatN::Load(lanes[3]), FloatN::Load(lanes[4]), FloatN::Load(lanes[5]));
+        }
+
+        const Point3fN &operator[](int i) const { return (i == 0) ? pMin : pMax; }
+    };
+
+    /*
+     *  Slab test of one ray against SIMDWidth boxes at once, e.g. all children
+     *  of a wide node or all instances of a leaf. Returns the boxes that
+     *  overlap [ray.tMin, raytMax); tEntry, if given, receives the entry
+     *  distances so the caller can visit hits front to back.
+     */
+    inline MaskN IntersectP(const Bounds3fN &b, const TraversalRay &ray, Float raytMax,
+                            FloatN *tEntry = nullptr)
+    {
+        FloatN tx0 = (b[ray.dirIsNeg[0]].x - FloatN(ray.o.x)) * FloatN(ray.invDir.x);
+        FloatN tx1 = (b[1 - ray.dirIsNeg[0]].x - FloatN(ray.o.x)) * FloatN(ray.invDir.x);
+        FloatN ty0 = (b[ray.dirIsNeg[1]].y - FloatN(ray.o.y)) * FloatN(ray.invDir.y);
+        FloatN ty1 = (b[1 - ray.dirIsNeg[1]].y - FloatN(ray.o.y)) * FloatN(ray.invDir.y);
+        FloatN tz0 = (b[ray.dirIsNeg[2]].z - FloatN(ray.o.z)) * FloatN(ray.invDir.z);
+        FloatN tz1 = (b[1 - ray.dirIsNeg[2]].z - FloatN(ray.o.z)) * FloatN(ray.invDir.z);
+
+        // NaN slabs are dropped as in the scalar test
+        FloatN t0 = Select(tx0 > FloatN(ray.tMin), tx0, FloatN(ray.tMin));
+        t0 = Select(ty0 > t0, ty0, t0);
+        t0 = Select(tz0 > t0, tz0, t0);
+        FloatN t1 = Select(tx1 < FloatN(Infinity), tx1, FloatN(Infinity));
+        t1 = Select(ty1 < t1, ty1, t1);
+        t1 = Select(tz1 < t1, tz1, t1);
+        t1 *= FloatN(1 + 2 * gamma(3));
+
+        if (tEntry)
+            *tEntry = t0;
+        return (t0 <= t1) & (t0 < FloatN(raytMax));
+    }
+}
@@ -0,0 +1,714 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "tfrt.hpp"
+
+/*
+    ---------- SIMD backend, picked from the compiler's target flags -----------
+
+    TFRT_SIMD_AVX2   one 256-bit register per FloatN
+    TFRT_SIMD_SSE    two 128-bit registers per FloatN (SSE2)
+    otherwise        plain arrays, also forced by defining TFRT_NO_SIMD
+*/
+
+#if !defined(TFRT_NO_SIMD) && defined(__AVX2__)
+#define TFRT_SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(TFRT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define TFRT_SIMD_SSE
+#include <emmintrin.h>
+#if defined(__FMA__)
+#include <immintrin.h>
+#endif
+#endif
+
+namespace tfrt
+{
+    // number of lanes in FloatN and MaskN, independent of the backend
+    static constexpr int SIMDWidth = 8;
+
+    inline const char *SIMDBackendName()
+    {
+#if defined(TFRT_SIMD_AVX2)
+        return "avx2";
+#elif defined(TFRT_SIMD_SSE)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    class FloatN;
+    class UInt32N;
+
+    // per-lane boolean, the result of comparing two FloatNs
+    class MaskN
+    {
+    public:
+        MaskN() = default;
+
+        explicit MaskN(bool b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            v = _mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0));
+#elif defined(TFRT_SIMD_SSE)
+            lo = hi = _mm_castsi128_ps(_mm_set1_epi32(b ? -1 : 0));
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                v[i] = b;
+#endif
+        }
+
+        // lane i is set when bit i is set
+        static MaskN FromBits(uint32_t bits)
+        {
+            MaskN m;
+#if defined(TFRT_SIMD_AVX2)
+            const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            __m256i b = _mm256_and_si256(_mm256_set1_epi32(int(bits)), lanes);
+            m.v = _mm256_castsi256_ps(_mm256_cmpeq_epi32(b, lanes));
+#elif defined(TFRT_SIMD_SSE)
+            const __m128i lanesLo = _mm_setr_epi32(1, 2, 4, 8);
+            const __m128i lanesHi = _mm_setr_epi32(16, 32, 64, 128);
+            __m128i b = _mm_set1_epi32(int(bits));
+            m.lo = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, lanesLo), lanesLo));
+            m.hi = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, lanesHi), lanesHi));
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                m.v[i] = (bits >> i) & 1;
+#endif
+            return m;
+        }
+
+        // bit i holds lane i
+        uint32_t Bits() const
+        {
+#if defined(TFRT_SIMD_AVX2)
+            return uint32_t(_mm256_movemask_ps(v));
+#elif defined(TFRT_SIMD_SSE)
+            return uint32_t(_mm_movemask_ps(lo) | (_mm_movemask_ps(hi) << 4));
+#else
+            uint32_t bits = 0;
+            for (int i = 0; i < SIMDWidth; ++i)
+                bits |= uint32_t(v[i]) << i;
+            return bits;
+#endif
+        }
+
+        bool Any() const { return Bits() != 0; }
+        bool All() const { return Bits() == (1u << SIMDWidth) - 1; }
+        bool None() const { return Bits() == 0; }
+
+        bool operator[](int i) const { return (Bits() >> i) & 1; }
+
+        // holds when the condition holds in every lane, meant for DCHECKs
+        explicit operator bool() const { return All(); }
+
+        friend MaskN operator&(MaskN a, MaskN b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_and_ps(a.v, b.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_and_ps(a.lo, b.lo);
+            a.hi = _mm_and_ps(a.hi, b.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] = a.v[i] && b.v[i];
+#endif
+            return a;
+        }
+
+        friend MaskN operator|(MaskN a, MaskN b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_or_ps(a.v, b.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_or_ps(a.lo, b.lo);
+            a.hi = _mm_or_ps(a.hi, b.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] = a.v[i] || b.v[i];
+#endif
+            return a;
+        }
+
+        // lanes of a that are not set in b
+        friend MaskN AndNot(MaskN a, MaskN b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_andnot_ps(b.v, a.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_andnot_ps(b.lo, a.lo);
+            a.hi = _mm_andnot_ps(b.hi, a.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] = a.v[i] && !b.v[i];
+#endif
+            return a;
+        }
+
+        MaskN operator!() const { return AndNot(MaskN(true), *this); }
+
+        MaskN &operator&=(MaskN b) { return *this = *this & b; }
+        MaskN &operator|=(MaskN b) { return *this = *this | b; }
+
+    private:
+        friend class FloatN;
+        friend FloatN Select(MaskN mask, FloatN t, FloatN f);
+#if defined(TFRT_SIMD_AVX2)
+        __m256 v;
+#elif defined(TFRT_SIMD_SSE)
+        __m128 lo, hi;
+#else
+        bool v[SIMDWidth];
+#endif
+    };
+
+    /*
+     *  SIMDWidth floats processed in lockstep. Arithmetic mirrors Float, so
+     *  the Tuple3 templates work unchanged on Vector3<FloatN>; comparisons
+     *  return a MaskN and Select() replaces branches.
+     */
+    class FloatN
+    {
+    public:
+        FloatN() : FloatN(0.f) {}
+
+        // broadcast
+        FloatN(float f)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            v = _mm256_set1_ps(f);
+#elif defined(TFRT_SIMD_SSE)
+            lo = hi = _mm_set1_ps(f);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                v[i] = f;
+#endif
+        }
+
+        // reads SIMDWidth floats, p need not be aligned
+        static FloatN Load(const float *p)
+        {
+            FloatN r(Uninitialized{});
+#if defined(TFRT_SIMD_AVX2)
+            r.v = _mm256_loadu_ps(p);
+#elif defined(TFRT_SIMD_SSE)
+            r.lo = _mm_loadu_ps(p);
+            r.hi = _mm_loadu_ps(p + 4);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                r.v[i] = p[i];
+#endif
+            return r;
+        }
+
+        void Store(float *p) const
+        {
+#if defined(TFRT_SIMD_AVX2)
+            _mm256_storeu_ps(p, v);
+#elif defined(TFRT_SIMD_SSE)
+            _mm_storeu_ps(p, lo);
+            _mm_storeu_ps(p + 4, hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                p[i] = v[i];
+#endif
+        }
+
+        float operator[](int i) const
+        {
+            alignas(32) float lanes[SIMDWidth];
+            Store(lanes);
+            return lanes[i];
+        }
+
+        std::string ToString() const
+        {
+            std::string s = "[";
+            for (int i = 0; i < SIMDWidth; ++i)
+                s += std::to_string((*this)[i]) + (i + 1 < SIMDWidth ? "," : "]");
+            return s;
+        }
+
+        // arithmetic
+        friend FloatN operator+(FloatN a, FloatN b) { return binary(a, b, Add{}); }
+        friend FloatN operator-(FloatN a, FloatN b) { return binary(a, b, Sub{}); }
+        friend FloatN operator*(FloatN a, FloatN b) { return binary(a, b, Mul{}); }
+        friend FloatN operator/(FloatN a, FloatN b) { return binary(a, b, Div{}); }
+        FloatN operator-() const;
+
+        FloatN &operator+=(FloatN b) { return *this = *this + b; }
+        FloatN &operator-=(FloatN b) { return *this = *this - b; }
+        FloatN &operator*=(FloatN b) { return *this = *this * b; }
+        FloatN &operator/=(FloatN b) { return *this = *this / b; }
+
+        // comparisons, NaN lanes compare false
+        friend MaskN operator<(FloatN a, FloatN b) { return compare(a, b, Lt{}); }
+        friend MaskN operator<=(FloatN a, FloatN b) { return compare(a, b, Le{}); }
+        friend MaskN operator>(FloatN a, FloatN b) { return compare(b, a, Lt{}); }
+        friend MaskN operator>=(FloatN a, FloatN b) { return compare(b, a, Le{}); }
+        friend MaskN operator==(FloatN a, FloatN b) { return compare(a, b, Eq{}); }
+        friend MaskN operator!=(FloatN a, FloatN b) { return !(a == b); }
+
+        // min/max are found by ADL before std::min/std::max in the Tuple3 helpers
+        friend FloatN min(FloatN a, FloatN b) { return binary(a, b, Min{}); }
+        friend FloatN max(FloatN a, FloatN b) { return binary(a, b, Max{}); }
+
+        friend FloatN sqrt(FloatN a)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_sqrt_ps(a.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_sqrt_ps(a.lo);
+            a.hi = _mm_sqrt_ps(a.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] = std::sqrt(a.v[i]);
+#endif
+            return a;
+        }
+
+        friend FloatN abs(FloatN a) { return Select(a < FloatN(0.f), -a, a); }
+
+        // a * b + c, a single rounding only when the target has FMA instructions
+        friend FloatN FMA(FloatN a, FloatN b, FloatN c)
+        {
+#if defined(TFRT_SIMD_AVX2) && defined(__FMA__)
+            a.v = _mm256_fmadd_ps(a.v, b.v, c.v);
+            return a;
+#elif defined(TFRT_SIMD_SSE) && defined(__FMA__)
+            a.lo = _mm_fmadd_ps(a.lo, b.lo, c.lo);
+            a.hi = _mm_fmadd_ps(a.hi, b.hi, c.hi);
+            return a;
+#elif !defined(TFRT_SIMD_AVX2) && !defined(TFRT_SIMD_SSE)
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] = std::fma(a.v[i], b.v[i], c.v[i]);
+            return a;
+#else
+            return a * b + c;
+#endif
+        }
+
+        // a * b + c, like FMA, but never a libm call per lane
+        friend FloatN MulAdd(FloatN a, FloatN b, FloatN c)
+        {
+#if defined(TFRT_SIMD_AVX2) || defined(TFRT_SIMD_SSE) || defined(__FMA__)
+            return FMA(a, b, c);
+#else
+            return a * b + c;
+#endif
+        }
+
+        // 1 / sqrt(a) to about 12 bits, the start for a Newton step
+        friend FloatN RSqrtEstimate(FloatN a)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_rsqrt_ps(a.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_rsqrt_ps(a.lo);
+            a.hi = _mm_rsqrt_ps(a.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] = 1 / std::sqrt(a.v[i]);
+#endif
+            return a;
+        }
+
+        // mask ? t : f per lane
+        friend FloatN Select(MaskN mask, FloatN t, FloatN f)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            f.v = _mm256_blendv_ps(f.v, t.v, mask.v);
+#elif defined(TFRT_SIMD_SSE)
+            f.lo = _mm_or_ps(_mm_and_ps(mask.lo, t.lo), _mm_andnot_ps(mask.lo, f.lo));
+            f.hi = _mm_or_ps(_mm_and_ps(mask.hi, t.hi), _mm_andnot_ps(mask.hi, f.hi));
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                f.v[i] = mask.v[i] ? t.v[i] : f.v[i];
+#endif
+            return f;
+        }
+
+        friend float ReduceMin(FloatN a)
+        {
+            alignas(32) float lanes[SIMDWidth];
+            a.Store(lanes);
+            float m = lanes[0];
+            for (int i = 1; i < SIMDWidth; ++i)
+                m = std::min(m, lanes[i]);
+            return m;
+        }
+
+        friend float ReduceMax(FloatN a)
+        {
+            alignas(32) float lanes[SIMDWidth];
+            a.Store(lanes);
+            float m = lanes[0];
+            for (int i = 1; i < SIMDWidth; ++i)
+                m = std::max(m, lanes[i]);
+            return m;
+        }
+
+    private:
+        friend FloatN ToFloat(UInt32N a);
+        friend UInt32N FloatToBits(FloatN a);
+        friend FloatN BitsToFloat(UInt32N a);
+
+        struct Uninitialized {};
+        explicit FloatN(Uninitialized) {}
+
+        struct Add {};
+        struct Sub {};
+        struct Mul {};
+        struct Div {};
+        struct Min {};
+        struct Max {};
+        struct Lt {};
+        struct Le {};
+        struct Eq {};
+
+#if defined(TFRT_SIMD_AVX2)
+        static __m256 op(__m256 a, __m256 b, Add) { return _mm256_add_ps(a, b); }
+        static __m256 op(__m256 a, __m256 b, Sub) { return _mm256_sub_ps(a, b); }
+        static __m256 op(__m256 a, __m256 b, Mul) { return _mm256_mul_ps(a, b); }
+        static __m256 op(__m256 a, __m256 b, Div) { return _mm256_div_ps(a, b); }
+        static __m256 op(__m256 a, __m256 b, Min) { return _mm256_min_ps(a, b); }
+        static __m256 op(__m256 a, __m256 b, Max) { return _mm256_max_ps(a, b); }
+        static __m256 op(__m256 a, __m256 b, Lt) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static __m256 op(__m256 a, __m256 b, Le) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static __m256 op(__m256 a, __m256 b, Eq) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+#elif defined(TFRT_SIMD_SSE)
+        static __m128 op(__m128 a, __m128 b, Add) { return _mm_add_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Sub) { return _mm_sub_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Mul) { return _mm_mul_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Div) { return _mm_div_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Min) { return _mm_min_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Max) { return _mm_max_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Lt) { return _mm_cmplt_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Le) { return _mm_cmple_ps(a, b); }
+        static __m128 op(__m128 a, __m128 b, Eq) { return _mm_cmpeq_ps(a, b); }
+#else
+        static float op(float a, float b, Add) { return a + b; }
+        static float op(float a, float b, Sub) { return a - b; }
+        static float op(float a, float b, Mul) { return a * b; }
+        static float op(float a, float b, Div) { return a / b; }
+        static float op(float a, float b, Min) { return a < b ? a : b; }
+        static float op(float a, float b, Max) { return a > b ? a : b; }
+        static bool op(float a, float b, Lt) { return a < b; }
+        static bool op(float a, float b, Le) { return a <= b; }
+        static bool op(float a, float b, Eq) { return a == b; }
+#endif
+
+        template <typename Op>
+        static FloatN binary(FloatN a, FloatN b, Op o)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = op(a.v, b.v, o);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = op(a.lo, b.lo, o);
+            a.hi = op(a.hi, b.hi, o);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] = op(a.v[i], b.v[i], o);
+#endif
+            return a;
+        }
+
+        template <typename Op>
+        static MaskN compare(FloatN a, FloatN b, Op o)
+        {
+            MaskN m;
+#if defined(TFRT_SIMD_AVX2)
+            m.v = op(a.v, b.v, o);
+#elif defined(TFRT_SIMD_SSE)
+            m.lo = op(a.lo, b.lo, o);
+            m.hi = op(a.hi, b.hi, o);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                m.v[i] = op(a.v[i], b.v[i], o);
+#endif
+            return m;
+        }
+
+    private:
+#if defined(TFRT_SIMD_AVX2)
+        __m256 v;
+#elif defined(TFRT_SIMD_SSE)
+        __m128 lo, hi;
+#else
+        float v[SIMDWidth];
+#endif
+    };
+
+    // true if any lane is NaN
+    inline bool IsNaN(FloatN v) { return (v != v).Any(); }
+
+    /*
+     *  SIMDWidth uint32_ts with wrapping arithmetic, for the integer side of
+     *  lane-parallel work such as hashing. Lane i matches the same uint32_t
+     *  expression evaluated on lane i alone, on every backend.
+     */
+    class UInt32N
+    {
+    public:
+        UInt32N() : UInt32N(0u) {}
+
+        // broadcast
+        UInt32N(uint32_t u)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            v = _mm256_set1_epi32(int(u));
+#elif defined(TFRT_SIMD_SSE)
+            lo = hi = _mm_set1_epi32(int(u));
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                v[i] = u;
+#endif
+        }
+
+        // reads SIMDWidth values, p need not be aligned
+        static UInt32N Load(const uint32_t *p)
+        {
+            UInt32N r;
+#if defined(TFRT_SIMD_AVX2)
+            r.v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+#elif defined(TFRT_SIMD_SSE)
+            r.lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            r.hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 4));
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                r.v[i] = p[i];
+#endif
+            return r;
+        }
+
+        void Store(uint32_t *p) const
+        {
+#if defined(TFRT_SIMD_AVX2)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+#elif defined(TFRT_SIMD_SSE)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(p), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 4), hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                p[i] = v[i];
+#endif
+        }
+
+        uint32_t operator[](int i) const
+        {
+            alignas(32) uint32_t lanes[SIMDWidth];
+            Store(lanes);
+            return lanes[i];
+        }
+
+        friend UInt32N operator+(UInt32N a, UInt32N b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_add_epi32(a.v, b.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_add_epi32(a.lo, b.lo);
+            a.hi = _mm_add_epi32(a.hi, b.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] += b.v[i];
+#endif
+            return a;
+        }
+
+        // low 32 bits of the product
+        friend UInt32N operator*(UInt32N a, UInt32N b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_mullo_epi32(a.v, b.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = mullo(a.lo, b.lo);
+            a.hi = mullo(a.hi, b.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] *= b.v[i];
+#endif
+            return a;
+        }
+
+        friend UInt32N operator&(UInt32N a, UInt32N b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_and_si256(a.v, b.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_and_si128(a.lo, b.lo);
+            a.hi = _mm_and_si128(a.hi, b.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] &= b.v[i];
+#endif
+            return a;
+        }
+
+        friend UInt32N operator|(UInt32N a, UInt32N b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_or_si256(a.v, b.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_or_si128(a.lo, b.lo);
+            a.hi = _mm_or_si128(a.hi, b.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] |= b.v[i];
+#endif
+            return a;
+        }
+
+        friend UInt32N operator^(UInt32N a, UInt32N b)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_xor_si256(a.v, b.v);
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_xor_si128(a.lo, b.lo);
+            a.hi = _mm_xor_si128(a.hi, b.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] ^= b.v[i];
+#endif
+            return a;
+        }
+
+        // logical shifts of every lane by the same count, 0 <= n < 32
+        friend UInt32N operator<<(UInt32N a, int n)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_sll_epi32(a.v, _mm_cvtsi32_si128(n));
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_sll_epi32(a.lo, _mm_cvtsi32_si128(n));
+            a.hi = _mm_sll_epi32(a.hi, _mm_cvtsi32_si128(n));
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] <<= n;
+#endif
+            return a;
+        }
+
+        friend UInt32N operator>>(UInt32N a, int n)
+        {
+#if defined(TFRT_SIMD_AVX2)
+            a.v = _mm256_srl_epi32(a.v, _mm_cvtsi32_si128(n));
+#elif defined(TFRT_SIMD_SSE)
+            a.lo = _mm_srl_epi32(a.lo, _mm_cvtsi32_si128(n));
+            a.hi = _mm_srl_epi32(a.hi, _mm_cvtsi32_si128(n));
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                a.v[i] >>= n;
+#endif
+            return a;
+        }
+
+        UInt32N &operator+=(UInt32N b) { return *this = *this + b; }
+        UInt32N &operator*=(UInt32N b) { return *this = *this * b; }
+        UInt32N &operator&=(UInt32N b) { return *this = *this & b; }
+        UInt32N &operator|=(UInt32N b) { return *this = *this | b; }
+        UInt32N &operator^=(UInt32N b) { return *this = *this ^ b; }
+
+        // lanes as floats, exact below 2^24 and correctly rounded below 2^31
+        friend FloatN ToFloat(UInt32N a)
+        {
+            FloatN r(FloatN::Uninitialized{});
+#if defined(TFRT_SIMD_AVX2)
+            r.v = _mm256_cvtepi32_ps(a.v);
+#elif defined(TFRT_SIMD_SSE)
+            r.lo = _mm_cvtepi32_ps(a.lo);
+            r.hi = _mm_cvtepi32_ps(a.hi);
+#else
+            for (int i = 0; i < SIMDWidth; ++i)
+                r.v[i] = float(int32_t(a.v[i]));
+#endif
+            return r;
+        }
+
+        // the bits of each lane, and back
+        friend UInt32N FloatToBits(FloatN a)
+        {
+            UInt32N r;
+#if defined(TFRT_SIMD_AVX2)
+            r.v = _mm256_castps_si256(a.v);
+#elif defined(TFRT_SIMD_SSE)
+            r.lo = _mm_castps_si128(a.lo);
+            r.hi = _mm_castps_si128(a.hi);
+#else
+            std::memcpy(r.v, a.v, sizeof(r.v));
+#endif
+            return r;
+        }
+
+        friend FloatN BitsToFloat(UInt32N a)
+        {
+            FloatN r(FloatN::Uninitialized{});
+#if defined(TFRT_SIMD_AVX2)
+            r.v = _mm256_castsi256_ps(a.v);
+#elif defined(TFRT_SIMD_SSE)
+            r.lo = _mm_castsi128_ps(a.lo);
+            r.hi = _mm_castsi128_ps(a.hi);
+#else
+            std::memcpy(r.v, a.v, sizeof(r.v));
+#endif
+            return r;
+        }
+
+    private:
+#if defined(TFRT_SIMD_SSE)
+        // SSE2 has no 32-bit multiply, so even and odd lanes go through the 64-bit one
+        static __m128i mullo(__m128i a, __m128i b)
+        {
+            __m128i even = _mm_mul_epu32(a, b);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+#endif
+
+#if defined(TFRT_SIMD_AVX2)
+        __m256i v;
+#elif defined(TFRT_SIMD_SSE)
+        __m128i lo, hi;
+#else
+        uint32_t v[SIMDWidth];
+#endif
+    };
+
+    // f applied to each lane, for functions that have no lane-parallel form
+    template <typename F>
+    inline FloatN MapLanes(FloatN a, F &&f)
+    {
+        alignas(32) float lanes[SIMDWidth];
+        a.Store(lanes);
+        for (int i = 0; i < SIMDWidth; ++i)
+            lanes[i] = f(lanes[i]);
+        return FloatN::Load(lanes);
+    }
+
+    template <typename F>
+    inline FloatN MapLanes(FloatN a, FloatN b, F &&f)
+    {
+        alignas(32) float la[SIMDWidth], lb[SIMDWidth];
+        a.Store(la);
+        b.Store(lb);
+        for (int i = 0; i < SIMDWidth; ++i)
+            la[i] = f(la[i], lb[i]);
+        return FloatN::Load(la);
+    }
+
+    // flips the sign bit like float negation, so -0 stays distinct from 0 - 0
+    inline FloatN FloatN::operator-() const { return BitsToFloat(FloatToBits(*this) ^ UInt32N(0x80000000u)); }
+
+    // mag with the sign bit of sign, lane by lane like std::copysign
+    inline FloatN CopySign(FloatN mag, FloatN sign)
+    {
+        return BitsToFloat((FloatToBits(mag) & UInt32N(0x7fffffffu)) | (FloatToBits(sign) & UInt32N(0x80000000u)));
+    }
+
+    inline FloatN SafeSqrt(FloatN x) { return sqrt(max(FloatN(0.f), x)); }
+}
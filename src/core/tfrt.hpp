@@ -1,5 +1,7 @@
 #pragma once
 
+#include <limits>
+
 /* 
     ---------- Macros and Forward decalarations -----------
 */
@@ -8,6 +10,15 @@ namespace tfrt {
 
 using Float = float;
 
+static constexpr Float Infinity = std::numeric_limits<Float>::infinity();
+
+static constexpr Float MachineEpsilon = std::numeric_limits<Float>::epsilon() * 0.5;
+
+// bound on the relative error of n chained floating-point operations
+inline constexpr Float gamma(int n) {
+    return (n * MachineEpsilon) / (1 - n * MachineEpsilon);
+}
+
 template <typename T>
 class Vector2;
 template <typename T>
@@ -16,7 +27,16 @@ template <typename T>
 class Point3;
 template <typename T>
 class Point2;
+template <typename T>
+class Normal3;
+template <typename T>
+class Bounds2;
+template <typename T>
+class Bounds3;
+
+class Ray;
+class RayDifferential;
 
 // and more ...
 
-}
\ No newline at end of file
+}
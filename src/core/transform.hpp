@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+
+#include "bounds.hpp"
+#include "ray.hpp"
+#include "raypacket.hpp"
+#include "simd.hpp"
+#include "vecmath.hpp"
+#include "util/math.hpp"
+
+namespace tfrt
+{
+    class SurfaceInteraction;
+
+    /*
+     *  4x4 affine or projective transformation. The inverse is stored next
+     *  to the matrix, so Inverse() is free and normals, which transform by
+     *  the inverse transpose, cost the same as vectors.
+     */
+    class Transform
+    {
+    public:
+        Transform() = default;
+
+        // singular matrices get a NaN inverse
+        Transform(const SquareMatrix<4> &m) : m(m)
+        {
+            std::optional<SquareMatrix<4>> inv = tfrt::Inverse(m);
+            if (inv)
+                mInv = *inv;
+            else
+            {
+                float NaN = std::numeric_limits<float>::quiet_NaN();
+                for (int i = 0; i < 4; ++i)
+                    for (int j = 0; j < 4; ++j)
+                        mInv[i][j] = NaN;
+            }
+            updateAffine();
+        }
+
+        Transform(const SquareMatrix<4> &m, const SquareMatrix<4> &mInv) : m(m), mInv(mInv)
+        {
+            updateAffine();
+        }
+
+        const SquareMatrix<4> &GetMatrix() const { return m; }
+        const SquareMatrix<4> &GetInverseMatrix() const { return mInv; }
+
+        bool operator==(const Transform &t) const { return t.m == m; }
+        bool operator!=(const Transform &t) const { return t.m != m; }
+        bool IsIdentity() const { return m.IsIdentity(); }
+
+        // true if the last row is (0, 0, 0, 1) and points need no divide
+        bool IsAffine() const { return affine; }
+
+        Transform operator*(const Transform &t2) const
+        {
+            return Transform(m * t2.m, t2.mInv * mInv);
+        }
+
+        Point3f operator()(Point3f p) const { return applyPoint(m, affine, p); }
+        Vector3f operator()(Vector3f v) const { return applyVector(m, v); }
+        Normal3f operator()(Normal3f n) const { return applyNormal(mInv, n); }
+
+        // the direction is not renormalized, so t values along the ray stay valid
+        Ray operator()(const Ray &r) const
+        {
+            Ray ret = r;
+            ret.o = (*this)(r.o);
+            ret.d = (*this)(r.d);
+            return ret;
+        }
+
+        RayDifferential operator()(const RayDifferential &r) const
+        {
+            RayDifferential ret(static_cast<const Ray &>(r));
+            ret.o = (*this)(r.o);
+            ret.d = (*this)(r.d);
+            ret.hasDifferentials = r.hasDifferentials;
+            ret.rxOrigin = (*this)(r.rxOrigin);
+            ret.ryOrigin = (*this)(r.ryOrigin);
+            ret.rxDirection = (*this)(r.rxDirection);
+            ret.ryDirection = (*this)(r.ryDirection);
+            return ret;
+        }
+
+        Bounds3f operator()(const Bounds3f &b) const;
+
+        // defined in scene/interaction.hpp
+        SurfaceInteraction operator()(const SurfaceInteraction &si) const;
+
+        Point3f ApplyInverse(Point3f p) const { return applyPoint(mInv, inverseAffine, p); }
+        Vector3f ApplyInverse(Vector3f v) const { return applyVector(mInv, v); }
+        Normal3f ApplyInverse(Normal3f n) const { return applyNormal(m, n); }
+        Ray ApplyInverse(const Ray &r) const
+        {
+            Ray ret = r;
+            ret.o = ApplyInverse(r.o);
+            ret.d = ApplyInverse(r.d);
+            return ret;
+        }
+
+        // all lanes at once, e.g. a packet entering an instance
+        RayPacket operator()(const RayPacket &r) const
+        {
+            RayPacket ret = r;
+            ret.o = applyPoint(m, affine, r.o);
+            ret.d = applyVector(m, r.d);
+            return ret;
+        }
+
+        RayPacket ApplyInverse(const RayPacket &r) const
+        {
+            RayPacket ret = r;
+            ret.o = applyPoint(mInv, inverseAffine, r.o);
+            ret.d = applyVector(mInv, r.d);
+            return ret;
+        }
+
+        /*
+         *  Batch forms for whole arrays, e.g. mesh vertices or refit bounds.
+         *  SIMDWidth elements are transformed per step; in may equal out.
+         */
+        void ApplyPoints(const Point3f *in, Point3f *out, size_t n) const;
+        void ApplyVectors(const Vector3f *in, Vector3f *out, size_t n) const;
+        void ApplyNormals(const Normal3f *in, Normal3f *out, size_t n) const;
+
+        std::string ToString() const { return "[ m: " + m.ToString() + " mInv: " + mInv.ToString() + " ]"; }
+
+    private:
+        static bool isAffine(const SquareMatrix<4> &m)
+        {
+            return m[3][0] == 0 && m[3][1] == 0 && m[3][2] == 0 && m[3][3] == 1;
+        }
+
+        void updateAffine()
+        {
+            affine = isAffine(m);
+            inverseAffine = isAffine(mInv);
+        }
+
+        // T is Float, or FloatN for packets
+        template <typename T>
+        static Point3<T> applyPoint(const SquareMatrix<4> &m, bool affine, Point3<T> p)
+        {
+            T xp = FMA(T(m[0][0]), p.x, FMA(T(m[0][1]), p.y, FMA(T(m[0][2]), p.z, T(m[0][3]))));
+            T yp = FMA(T(m[1][0]), p.x, FMA(T(m[1][1]), p.y, FMA(T(m[1][2]), p.z, T(m[1][3]))));
+            T zp = FMA(T(m[2][0]), p.x, FMA(T(m[2][1]), p.y, FMA(T(m[2][2]), p.z, T(m[2][3]))));
+            if (affine)
+                return Point3<T>(xp, yp, zp);
+            T invW = 1 / FMA(T(m[3][0]), p.x, FMA(T(m[3][1]), p.y, FMA(T(m[3][2]), p.z, T(m[3][3]))));
+            return Point3<T>(xp * invW, yp * invW, zp * invW);
+        }
+
+        template <typename T>
+        static Vector3<T> applyVector(const SquareMatrix<4> &m, Vector3<T> v)
+        {
+            return Vector3<T>(FMA(T(m[0][0]), v.x, FMA(T(m[0][1]), v.y, T(m[0][2]) * v.z)),
+                              FMA(T(m[1][0]), v.x, FMA(T(m[1][1]), v.y, T(m[1][2]) * v.z)),
+                              FMA(T(m[2][0]), v.x, FMA(T(m[2][1]), v.y, T(m[2][2]) * v.z)));
+        }
+
+        // normals take the transpose of the inverse, mInv is read column-wise
+        static Normal3f applyNormal(const SquareMatrix<4> &mInv, Normal3f n)
+        {
+            return Normal3f(FMA(mInv[0][0], n.x, FMA(mInv[1][0], n.y, mInv[2][0] * n.z)),
+                            FMA(mInv[0][1], n.x, FMA(mInv[1][1], n.y, mInv[2][1] * n.z)),
+                            FMA(mInv[0][2], n.x, FMA(mInv[1][2], n.y, mInv[2][2] * n.z)));
+        }
+
+        // transforms SIMDWidth tuples in SoA form; w is the homogeneous
+        // coordinate, 1 for points and 0 for vectors and normals
+        template <typename Tuple>
+        static void applyBatch(const SquareMatrix<4> &m, bool transposed, Float w, bool divide,
+                               const Tuple *in, Tuple *out, size_t n)
+        {
+            // row i of the 3x4 part, read column-wise for normals
+            auto at = [&](int i, int j) { return transposed ? m[j][i] : m[i][j]; };
+            alignas(32) float lanes[3][SIMDWidth];
+            for (size_t start = 0; start < n; start += SIMDWidth)
+            {
+                int count = int(std::min<size_t>(SIMDWidth, n - start));
+                for (int i = 0; i < SIMDWidth; ++i)
+                {
+                    const Tuple &t = in[start + (i < count ? i : 0)];
+                    lanes[0][i] = t.x;
+                    lanes[1][i] = t.y;
+                    lanes[2][i] = t.z;
+                }
+                FloatN x = FloatN::Load(lanes[0]), y = FloatN::Load(lanes[1]),
+                       z = FloatN::Load(lanes[2]);
+
+                FloatN r[3];
+                for (int i = 0; i < 3; ++i)
+                    r[i] = FMA(FloatN(at(i, 0)), x,
+                               FMA(FloatN(at(i, 1)), y, FMA(FloatN(at(i, 2)), z, FloatN(at(i, 3) * w))));
+                if (divide)
+                {
+                    FloatN invW = 1 / FMA(FloatN(m[3][0]), x,
+                                          FMA(FloatN(m[3][1]), y, FMA(FloatN(m[3][2]), z, FloatN(m[3][3]))));
+                    for (int i = 0; i < 3; ++i)
+                        r[i] *= invW;
+                }
+
+                for (int i = 0; i < 3; ++i)
+                    r[i].Store(lanes[i]);
+                for (int i = 0; i < count; ++i)
+                    out[start + i] = Tuple(lanes[0][i], lanes[1][i], lanes[2][i]);
+            }
+        }
+
+    private:
+        SquareMatrix<4> m, mInv;
+        bool affine = true, inverseAffine = true;
+    };
+
+    /*
+     *  ------------- Transform Inline Functions -------------
+     */
+
+    inline Transform Inverse(const Transform &t)
+    {
+        return Transform(t.GetInverseMatrix(), t.GetMatrix());
+    }
+
+    inline Transform Transpose(const Transform &t)
+    {
+        return Transform(Transpose(t.GetMatrix()), Transpose(t.GetInverseMatrix()));
+    }
+
+    // For affine transforms each output axis is a sum of per-axis terms, so
+    // its extent follows from the smaller and larger term of each input axis
+    // (Arvo 1990) instead of transforming all eight corners.
+    inline Bounds3f Transform::operator()(const Bounds3f &b) const
+    {
+        if (b.IsDegenerate())
+            return Bounds3f();
+        if (!affine)
+        {
+            Bounds3f ret;
+            for (int i = 0; i < 8; ++i)
+                ret = Union(ret, (*this)(Point3f(b[i & 1].x, b[(i >> 1) & 1].y, b[(i >> 2) & 1].z)));
+            return ret;
+        }
+
+        Bounds3f ret;
+        for (int i = 0; i < 3; ++i)
+        {
+            Float lo = m[i][3], hi = m[i][3];
+            for (int j = 0; j < 3; ++j)
+            {
+                Float a = m[i][j] * b.pMin[j], c = m[i][j] * b.pMax[j];
+                lo += std::min(a, c);
+                hi += std::max(a, c);
+            }
+            ret.pMin[i] = lo;
+            ret.pMax[i] = hi;
+        }
+        return ret;
+    }
+
+    inline void Transform::ApplyPoints(const Point3f *in, Point3f *out, size_t n) const
+    {
+        applyBatch(m, false, 1, !affine, in, out, n);
+    }
+
+    inline void Transform::ApplyVectors(const Vector3f *in, Vector3f *out, size_t n) const
+    {
+        applyBatch(m, false, 0, false, in, out, n);
+    }
+
+    inline void Transform::ApplyNormals(const Normal3f *in, Normal3f *out, size_t n) const
+    {
+        applyBatch(mInv, true, 0, false, in, out, n);
+    }
+
+    inline Transform Translate(Vector3f delta)
+    {
+        SquareMatrix<4> m(1, 0, 0, delta.x,
+                          0, 1, 0, delta.y,
+                          0, 0, 1, delta.z,
+                          0, 0, 0, 1);
+        SquareMatrix<4> minv(1, 0, 0, -delta.x,
+                             0, 1, 0, -delta.y,
+                             0, 0, 1, -delta.z,
+                             0, 0, 0, 1);
+        return Transform(m, minv);
+    }
+
+    inline Transform Scale(Float x, Float y, Float z)
+    {
+        SquareMatrix<4> m(x, 0, 0, 0,
+                          0, y, 0, 0,
+                          0, 0, z, 0,
+                          0, 0, 0, 1);
+        SquareMatrix<4> minv(1 / x, 0, 0, 0,
+                             0, 1 / y, 0, 0,
+                             0, 0, 1 / z, 0,
+                             0, 0, 0, 1);
+        return Transform(m, minv);
+    }
+
+    // rotation by theta degrees about an arbitrary axis
+    inline Transform Rotate(Float theta, Vector3f axis)
+    {
+        Vector3f a = Normalize(axis);
+        Float sinTheta = std::sin(Radians(theta)), cosTheta = std::cos(Radians(theta));
+        SquareMatrix<4> m;
+        m[0][0] = a.x * a.x + (1 - a.x * a.x) * cosTheta;
+        m[0][1] = a.x * a.y * (1 - cosTheta) - a.z * sinTheta;
+        m[0][2] = a.x * a.z * (1 - cosTheta) + a.y * sinTheta;
+        m[0][3] = 0;
+        m[1][0] = a.x * a.y * (1 - cosTheta) + a.z * sinTheta;
+        m[1][1] = a.y * a.y + (1 - a.y * a.y) * cosTheta;
+        m[1][2] = a.y * a.z * (1 - cosTheta) - a.x * sinTheta;
+        m[1][3] = 0;
+        m[2][0] = a.x * a.z * (1 - cosTheta) - a.y * sinTheta;
+        m[2][1] = a.y * a.z * (1 - cosTheta) + a.x * sinTheta;
+        m[2][2] = a.z * a.z + (1 - a.z * a.z) * cosTheta;
+        m[2][3] = 0;
+        // rotations are orthogonal, the inverse is the transpose
+        return Transform(m, Transpose(m));
+    }
+
+    inline Transform RotateX(Float theta) { return Rotate(theta, Vector3f(1, 0, 0)); }
+    inline Transform RotateY(Float theta) { return Rotate(theta, Vector3f(0, 1, 0)); }
+    inline Transform RotateZ(Float theta) { return Rotate(theta, Vector3f(0, 0, 1)); }
+
+    // world-from-camera is the inverse; camera space looks down +z with +y up
+    inline Transform LookAt(Point3f pos, Point3f look, Vector3f up)
+    {
+        SquareMatrix<4> worldFromCamera;
+        worldFromCamera[0][3] = pos.x;
+        worldFromCamera[1][3] = pos.y;
+        worldFromCamera[2][3] = pos.z;
+
+        Vector3f dir = Normalize(look - pos);
+        Vector3f right = Normalize(Cross(Normalize(up), dir));
+        Vector3f newUp = Cross(dir, right);
+        for (int i = 0; i < 3; ++i)
+        {
+            worldFromCamera[i][0] = right[i];
+            worldFromCamera[i][1] = newUp[i];
+            worldFromCamera[i][2] = dir[i];
+        }
+
+        std::optional<SquareMatrix<4>> cameraFromWorld = tfrt::Inverse(worldFromCamera);
+        DCHECK(cameraFromWorld.has_value());
+        return Transform(*cameraFromWorld, worldFromCamera);
+    }
+
+    // maps z in [zNear, zFar] to [0, 1]
+    inline Transform Orthographic(Float zNear, Float zFar)
+    {
+        return Scale(1, 1, 1 / (zFar - zNear)) * Translate(Vector3f(0, 0, -zNear));
+    }
+
+    // projects onto z = 1 with the given full field of view in degrees
+    inline Transform Perspective(Float fov, Float n, Float f)
+    {
+        SquareMatrix<4> persp(1, 0, 0, 0,
+                              0, 1, 0, 0,
+                              0, 0, f / (f - n), -f * n / (f - n),
+                              0, 0, 1, 0);
+        Float invTanAng = 1 / std::tan(Radians(fov) / 2);
+        return Scale(invTanAng, invTanAng, 1) * Transform(persp);
+    }
+}
@@ -50,7 +50,7 @@ namespace tfrt
         Tuple2() = default;
         Tuple2(T x, T y) : x(x), y(y) { DCHECK(!HasNaN()); }
 
-        bool HasNaN() const { return IsNaN(x) || IsNan(y); }
+        bool HasNaN() const { return IsNaN(x) || IsNaN(y); }
 
         // addition
         template <typename U>
@@ -73,14 +73,14 @@ namespace tfrt
         template <typename U>
         auto operator-(Child<U> c) const -> Child<decltype(T{} - U{})>
         {
-            DCHECK(!c.HasNan());
+            DCHECK(!c.HasNaN());
             return {x - c.x, y - c.y};
         }
 
         template <typename U>
         Child<T> &operator-=(Child<U> c)
         {
-            DCHECK(!c.HasNan());
+            DCHECK(!c.HasNaN());
             x -= c.x;
             y -= c.y;
             return static_cast<Child<T> &>(*this);
@@ -280,10 +280,8 @@ namespace tfrt
         }
 
         // equality operators
-        template <typename U>
         bool operator==(Child<T> c) const { return x == c.x && y == c.y && z == c.z; }
 
-        template <typename U>
         bool operator!=(Child<T> c) const { return x != c.x || y != c.y || z != c.z; }
 
         // multiply operator
@@ -296,7 +294,7 @@ namespace tfrt
         template <typename U>
         Child<T> &operator*=(U s)
         {
-            DCHECK(IsNaN(s));
+            DCHECK(!IsNaN(s));
             x *= s;
             y *= s;
             z *= s;
@@ -364,6 +362,39 @@ namespace tfrt
         return {min(t0.x, t1.x), min(t0.y, t1.y), min(t0.z, t1.z)};
     }
 
+    template <template <class> class C, typename T>
+    inline T MaxComponentValue(Tuple3<C, T> t)
+    {
+        using std::max;
+        return max(t.x, max(t.y, t.z));
+    }
+
+    template <template <class> class C, typename T>
+    inline int MaxComponentIndex(Tuple3<C, T> t)
+    {
+        return (t.x > t.y) ? ((t.x > t.z) ? 0 : 2) : ((t.y > t.z) ? 1 : 2);
+    }
+
+    template <template <class> class C, typename T>
+    inline C<T> Permute(Tuple3<C, T> t, const int perm[3])
+    {
+        return {t[perm[0]], t[perm[1]], t[perm[2]]};
+    }
+
+    template <template <class> class C, typename T>
+    inline C<T> Max(Tuple3<C, T> t0, Tuple3<C, T> t1)
+    {
+        using std::max;
+        return {max(t0.x, t1.x), max(t0.y, t1.y), max(t0.z, t1.z)};
+    }
+
+    // t at unit length through FastRSqrt, within a few ulps of Normalize and cheaper than its divide
+    template <template <class> class C, typename T>
+    inline C<T> FastNormalize(Tuple3<C, T> t)
+    {
+        return t * FastRSqrt(Sqr(t.x) + Sqr(t.y) + Sqr(t.z));
+    }
+
     template <template <class> class C, typename T>
     inline C<T> FMA(Float a, Tuple3<C, T> b, Tuple3<C, T> c) {
         return {FMA(a, b.x, c.x), FMA(a, b.y, c.y), FMA(a, b.z, c.z)};
@@ -389,6 +420,9 @@ namespace tfrt
         explicit Vector2(Vector2<U> v) : Tuple2<tfrt::Vector2, T>(T(v.x), T(v.y)) {}
     };
 
+    template <typename T>
+    class Normal3;
+
     template <typename T>
     class Vector3 : public Tuple3<Vector3, T>
     {
@@ -405,6 +439,9 @@ namespace tfrt
 
         template <typename U>
         explicit Vector3(Point3<U> p);
+
+        template <typename U>
+        explicit Vector3(Normal3<U> n);
     };
 
     using Vector2f = Vector2<Float>;
@@ -468,7 +505,7 @@ namespace tfrt
         }
 
         // negate
-        Point2<T> &operator-() const
+        Point2<T> operator-() const
         {
             return {-x, -y};
         }
@@ -629,4 +666,126 @@ namespace tfrt
     template <typename T>
     template <typename U> 
     Vector3<T>::Vector3(Point3<U> p) : Tuple3<tfrt::Vector3, T>(T(p.x), T(p.y), T(p.z)) {}
-}
\ No newline at end of file
+
+    template <typename T>
+    inline auto Dot(Vector3<T> v1, Vector3<T> v2) ->
+        typename TupleLength<T>::type {
+        DCHECK(!v1.HasNaN() && !v2.HasNaN());
+        return FMA(v1.x, v2.x, SumOfProducts(v1.y, v2.y, v1.z, v2.z));
+    }
+
+    template <typename T>
+    inline auto AbsDot(Vector3<T> v1, Vector3<T> v2) ->
+        typename TupleLength<T>::type {
+        DCHECK(!v1.HasNaN() && !v2.HasNaN());
+        return std::abs(Dot(v1, v2));
+    }
+
+    template <typename T>
+    inline Vector3<T> Cross(Vector3<T> v1, Vector3<T> v2) {
+        DCHECK(!v1.HasNaN() && !v2.HasNaN());
+        return {DifferenceOfProducts(v1.y, v2.z, v1.z, v2.y),
+                DifferenceOfProducts(v1.z, v2.x, v1.x, v2.z),
+                DifferenceOfProducts(v1.x, v2.y, v1.y, v2.x)};
+    }
+
+    template <typename T>
+    inline auto LengthSquared(Vector3<T> v) ->
+        typename TupleLength<T>::type {
+        return Sqr(v.x) + Sqr(v.y) + Sqr(v.z);
+    }
+
+    template <typename T>
+    inline auto Length(Vector3<T> v) ->
+        typename TupleLength<T>::type {
+        using std::sqrt;
+        return sqrt(LengthSquared(v));
+    }
+
+    template <typename T>
+    inline Vector3<T> Normalize(Vector3<T> v) {
+        return v / Length(v);
+    }
+
+    template <typename T>
+    inline auto Distance(Point3<T> p1, Point3<T> p2) ->
+        typename TupleLength<T>::type {
+        return Length(p1 - p2);
+    }
+
+    template <typename T>
+    inline auto DistanceSquared(Point3<T> p1, Point3<T> p2) ->
+        typename TupleLength<T>::type {
+        return LengthSquared(p1 - p2);
+    }
+
+    // v2 and v3 complete the unit vector v1 to an orthonormal basis
+    template <typename T>
+    inline void CoordinateSystem(Vector3<T> v1, Vector3<T> *v2, Vector3<T> *v3) {
+        T sign = CopySign(T(1), v1.z);
+        T a = -1 / (sign + v1.z);
+        T b = v1.x * v1.y * a;
+        *v2 = Vector3<T>(1 + sign * Sqr(v1.x) * a, sign * b, -sign * v1.x);
+        *v3 = Vector3<T>(b, sign + Sqr(v1.y) * a, -v1.y);
+    }
+
+    /*
+     *  ------------- Normal3 Inline Functions -------------
+     */
+
+    template <typename T>
+    template <typename U>
+    Vector3<T>::Vector3(Normal3<U> n) : Tuple3<tfrt::Vector3, T>(T(n.x), T(n.y), T(n.z)) {}
+
+    template <typename T>
+    inline T Dot(Normal3<T> n, Vector3<T> v) {
+        DCHECK(!n.HasNaN() && !v.HasNaN());
+        return FMA(n.x, v.x, SumOfProducts(n.y, v.y, n.z, v.z));
+    }
+
+    template <typename T>
+    inline T Dot(Vector3<T> v, Normal3<T> n) {
+        return Dot(n, v);
+    }
+
+    template <typename T>
+    inline T Dot(Normal3<T> n1, Normal3<T> n2) {
+        return Dot(n1, Vector3<T>(n2));
+    }
+
+    template <typename T>
+    inline T AbsDot(Normal3<T> n, Vector3<T> v) {
+        return std::abs(Dot(n, v));
+    }
+
+    template <typename T>
+    inline T AbsDot(Normal3<T> n1, Normal3<T> n2) {
+        return std::abs(Dot(n1, n2));
+    }
+
+    template <typename T>
+    inline T LengthSquared(Normal3<T> n) {
+        return Sqr(n.x) + Sqr(n.y) + Sqr(n.z);
+    }
+
+    template <typename T>
+    inline T Length(Normal3<T> n) {
+        return std::sqrt(LengthSquared(n));
+    }
+
+    template <typename T>
+    inline Normal3<T> Normalize(Normal3<T> n) {
+        return n / Length(n);
+    }
+
+    // n flipped, if needed, into the hemisphere around v
+    template <typename T>
+    inline Normal3<T> FaceForward(Normal3<T> n, Vector3<T> v) {
+        return (Dot(n, v) < 0) ? -n : n;
+    }
+
+    template <typename T>
+    inline Normal3<T> FaceForward(Normal3<T> n, Normal3<T> n2) {
+        return (Dot(n, n2) < 0) ? -n : n;
+    }
+}
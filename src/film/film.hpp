@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/vecmath.hpp"
+#include "util/color.hpp"
+#include "util/parallel.hpp"
+
+namespace tfrt
+{
+    // weighted sum of the samples that landed in a pixel
+    struct alignas(16) FilmPixel
+    {
+        float rgbSum[3];
+        float weightSum;
+    };
+
+    static_assert(sizeof(FilmPixel) == 16, "FilmPixel should be four packed floats");
+
+    /*
+     *  Running mean and variance of the sample values of a pixel (Welford),
+     *  so adaptive sampling can tell converged pixels from noisy ones
+     *  without keeping the samples. Merge combines the estimates of two
+     *  disjoint sample sets (Chan et al.).
+     */
+    struct VarianceEstimator
+    {
+        Float mean = 0, m2 = 0;
+        Float count = 0;
+
+        void Add(Float x)
+        {
+            count += 1;
+            Float delta = x - mean;
+            mean += delta / count;
+            m2 += delta * (x - mean);
+        }
+
+        void Merge(const VarianceEstimator &ve)
+        {
+            if (ve.count == 0)
+                return;
+            Float total = count + ve.count;
+            Float delta = ve.mean - mean;
+            mean += delta * (ve.count / total);
+            m2 += ve.m2 + delta * delta * (count * ve.count / total);
+            count = total;
+        }
+
+        Float Variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+
+        // standard error of the mean over the mean; dark pixels are measured against minMean
+        Float RelativeError(Float minMean) const
+        {
+            if (count < 2)
+                return Infinity;
+            return std::sqrt(Variance() / count) / std::max(mean, minMean);
+        }
+    };
+
+    /*
+     *  Private accumulation buffer for one tile. Workers add samples here and
+     *  hand the tile back to the Film once the tile is done. Reset moves a
+     *  tile to new bounds and keeps its storage, so a worker that reuses
+     *  its tile (ThreadFilmTile) stops allocating after the largest tile.
+     */
+    class FilmTile
+    {
+    public:
+        FilmTile() = default;
+        explicit FilmTile(const Bounds2i &pixelBounds)
+            : pixelBounds(pixelBounds), pixels(size_t(std::max(0, pixelBounds.Area()))),
+              variances(pixels.size()) {}
+
+        Bounds2i PixelBounds() const { return pixelBounds; }
+
+        // zeroed pixels over pixelBounds, reusing the storage when it is large enough
+        void Reset(const Bounds2i &pixelBounds)
+        {
+            this->pixelBounds = pixelBounds;
+            pixels.assign(size_t(std::max(0, pixelBounds.Area())), FilmPixel());
+            variances.assign(pixels.size(), VarianceEstimator());
+        }
+
+        void AddSample(Point2i p, RGB L, Float weight = 1)
+        {
+            size_t i = offset(p);
+            FilmPixel &pixel = pixels[i];
+            pixel.rgbSum[0] += weight * L.r;
+            pixel.rgbSum[1] += weight * L.g;
+            pixel.rgbSum[2] += weight * L.b;
+            pixel.weightSum += weight;
+            variances[i].Add(L.Average());
+        }
+
+        FilmPixel &GetPixel(Point2i p) { return pixels[offset(p)]; }
+        const FilmPixel &GetPixel(Point2i p) const { return pixels[offset(p)]; }
+
+        // spread of the sample averages of RGB in p
+        const VarianceEstimator &GetVariance(Point2i p) const { return variances[offset(p)]; }
+
+    private:
+        size_t offset(Point2i p) const
+        {
+            DCHECK(p.x >= pixelBounds.pMin.x && p.x < pixelBounds.pMax.x);
+            DCHECK(p.y >= pixelBounds.pMin.y && p.y < pixelBounds.pMax.y);
+            int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+            return size_t(p.y - pixelBounds.pMin.y) * width + (p.x - pixelBounds.pMin.x);
+        }
+
+        Bounds2i pixelBounds;
+        std::vector<FilmPixel> pixels;
+        std::vector<VarianceEstimator> variances;
+    };
+
+    // the calling thread's tile; whatever renders a tile on the thread resets it with GetFilmTile
+    inline FilmTile &ThreadFilmTile()
+    {
+        thread_local FilmTile tile;
+        return tile;
+    }
+
+    /*
+     *  Framebuffer stored as one contiguous, row-major, cache line aligned
+     *  array of FilmPixels. Tiles handed out by GetFilmTile never overlap, so
+     *  MergeFilmTile can write back without any locking. A second array
+     *  tracks the variance of each pixel's samples for adaptive sampling.
+     */
+    class Film
+    {
+    public:
+        Film(int width, int height)
+            : resolution(width, height),
+              pixels(static_cast<FilmPixel *>(::operator new(
+                  sizeof(FilmPixel) * size_t(width) * size_t(height), std::align_val_t(64)))),
+              variances(size_t(width) * size_t(height))
+        {
+            Clear();
+        }
+
+        Point2i FullResolution() const { return resolution; }
+
+        Bounds2i PixelBounds() const { return Bounds2i(Point2i(0, 0), resolution); }
+
+        // zeroes every pixel, one row per task
+        void Clear()
+        {
+            size_t rowBytes = sizeof(FilmPixel) * size_t(resolution.x);
+            ParallelFor(0, resolution.y, [&](int64_t y) {
+                std::memset(pixels.get() + y * resolution.x, 0, rowBytes);
+                std::fill_n(variances.begin() + y * resolution.x, resolution.x, VarianceEstimator());
+            });
+        }
+
+        void AddSample(Point2i p, RGB L, Float weight = 1)
+        {
+            FilmPixel &pixel = GetPixel(p);
+            pixel.rgbSum[0] += weight * L.r;
+            pixel.rgbSum[1] += weight * L.g;
+            pixel.rgbSum[2] += weight * L.b;
+            pixel.weightSum += weight;
+            variances[size_t(p.y) * resolution.x + p.x].Add(L.Average());
+        }
+
+        // weighted average of the samples in p, black if it has none
+        RGB GetPixelRGB(Point2i p) const
+        {
+            const FilmPixel &pixel = GetPixel(p);
+            if (pixel.weightSum == 0)
+                return RGB();
+            Float invWeight = 1 / pixel.weightSum;
+            return RGB(pixel.rgbSum[0] * invWeight, pixel.rgbSum[1] * invWeight,
+                       pixel.rgbSum[2] * invWeight);
+        }
+
+        FilmTile GetFilmTile(const Bounds2i &tileBounds) const
+        {
+            return FilmTile(Intersect(tileBounds, PixelBounds()));
+        }
+
+        // the same, but resets *tile in place, e.g. the thread's ThreadFilmTile
+        void GetFilmTile(const Bounds2i &tileBounds, FilmTile *tile) const
+        {
+            tile->Reset(Intersect(tileBounds, PixelBounds()));
+        }
+
+        void MergeFilmTile(const FilmTile &tile)
+        {
+            Bounds2i b = tile.PixelBounds();
+            for (int y = b.pMin.y; y < b.pMax.y; ++y)
+            {
+                for (int x = b.pMin.x; x < b.pMax.x; ++x)
+                {
+                    const FilmPixel &src = tile.GetPixel(Point2i(x, y));
+                    FilmPixel &dst = GetPixel(Point2i(x, y));
+                    for (int c = 0; c < 3; ++c)
+                        dst.rgbSum[c] += src.rgbSum[c];
+                    dst.weightSum += src.weightSum;
+                    variances[size_t(y) * resolution.x + x].Merge(tile.GetVariance(Point2i(x, y)));
+                }
+            }
+        }
+
+        FilmPixel &GetPixel(Point2i p)
+        {
+            DCHECK(p.x >= 0 && p.x < resolution.x && p.y >= 0 && p.y < resolution.y);
+            return pixels[size_t(p.y) * resolution.x + p.x];
+        }
+
+        const FilmPixel &GetPixel(Point2i p) const
+        {
+            DCHECK(p.x >= 0 && p.x < resolution.x && p.y >= 0 && p.y < resolution.y);
+            return pixels[size_t(p.y) * resolution.x + p.x];
+        }
+
+        const VarianceEstimator &GetVariance(Point2i p) const
+        {
+            DCHECK(p.x >= 0 && p.x < resolution.x && p.y >= 0 && p.y < resolution.y);
+            return variances[size_t(p.y) * resolution.x + p.x];
+        }
+
+        // largest RelativeError of the pixels in bounds, how far the region is from converged
+        Float MaxRelativeError(const Bounds2i &bounds, Float minMean) const
+        {
+            Float error = 0;
+            for (int y = bounds.pMin.y; y < bounds.pMax.y; ++y)
+                for (int x = bounds.pMin.x; x < bounds.pMax.x; ++x)
+                    error = std::max(error, GetVariance(Point2i(x, y)).RelativeError(minMean));
+            return error;
+        }
+
+        // first pixel of row y, rows are resolution.x pixels long
+        const FilmPixel *Row(int y) const { return pixels.get() + size_t(y) * resolution.x; }
+
+    private:
+        struct AlignedDelete
+        {
+            void operator()(FilmPixel *ptr) const { ::operator delete(ptr, std::align_val_t(64)); }
+        };
+
+        Point2i resolution;
+        std::unique_ptr<FilmPixel[], AlignedDelete> pixels;
+        std::vector<VarianceEstimator> variances;
+    };
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "film/film.hpp"
+#include "util/color.hpp"
+
+namespace tfrt
+{
+    enum class ImageFormat
+    {
+        PPM, // binary P6, 8-bit sRGB
+        PFM  // little-endian float RGB, linear
+    };
+
+    inline ImageFormat ImageFormatFromFilename(const std::string &filename)
+    {
+        size_t dot = filename.rfind('.');
+        if (dot != std::string::npos && filename.compare(dot, std::string::npos, ".pfm") == 0)
+            return ImageFormat::PFM;
+        return ImageFormat::PPM;
+    }
+
+    inline std::string ImageHeader(ImageFormat format, Point2i resolution)
+    {
+        std::string size = std::to_string(resolution.x) + " " + std::to_string(resolution.y) + "\n";
+        if (format == ImageFormat::PFM)
+            return "PF\n" + size + "-1\n"; // negative scale means little-endian
+        return "P6\n" + size + "255\n";
+    }
+
+    inline size_t ImageBytesPerPixel(ImageFormat format)
+    {
+        return format == ImageFormat::PFM ? 3 * sizeof(float) : 3;
+    }
+
+    // byte offset of row y from the end of the header, PFM rows run bottom to top
+    inline size_t ImageRowOffset(ImageFormat format, Point2i resolution, int y)
+    {
+        int fileRow = (format == ImageFormat::PFM) ? resolution.y - 1 - y : y;
+        return size_t(fileRow) * resolution.x * ImageBytesPerPixel(format);
+    }
+
+    // encodes one finished row of film into out, which must hold a full file row
+    inline void EncodeImageRow(ImageFormat format, const Film &film, int y, uint8_t *out)
+    {
+        const FilmPixel *row = film.Row(y);
+        int width = film.FullResolution().x;
+        if (format == ImageFormat::PFM)
+        {
+            float *rgb = reinterpret_cast<float *>(out);
+            for (int x = 0; x < width; ++x)
+            {
+                float invWeight = row[x].weightSum == 0 ? 0 : 1 / row[x].weightSum;
+                for (int c = 0; c < 3; ++c)
+                    rgb[3 * x + c] = row[x].rgbSum[c] * invWeight;
+            }
+        }
+        else
+        {
+            const std::array<uint8_t, 16384> &table = SRGB8Table();
+            const float scale = float(table.size() - 1);
+            for (int x = 0; x < width; ++x)
+            {
+                float invWeight = row[x].weightSum == 0 ? 0 : scale / row[x].weightSum;
+                for (int c = 0; c < 3; ++c)
+                {
+                    // clamp to the table, NaNs fall through to 0
+                    float v = row[x].rgbSum[c] * invWeight;
+                    v = (v > 0) ? (v < scale ? v : scale) : 0;
+                    out[3 * x + c] = table[size_t(v + 0.5f)];
+                }
+            }
+        }
+    }
+
+    /*
+     *  Writes an image on a background thread. Rows of the film are handed
+     *  over with WriteRows as soon as the renderer is done with them, in any
+     *  order, and each band is encoded and written at its place in the file
+     *  while rendering continues.
+     */
+    class ImageWriter
+    {
+    public:
+        ImageWriter(const std::string &filename, const Film &film)
+            : ImageWriter(filename, film, ImageFormatFromFilename(filename)) {}
+
+        ImageWriter(const std::string &filename, const Film &film, ImageFormat format)
+            : film(film), format(format),
+              out(filename, std::ofstream::binary | std::ofstream::trunc)
+        {
+            std::string header = ImageHeader(format, film.FullResolution());
+            headerSize = header.size();
+            out.write(header.data(), std::streamsize(header.size()));
+            thread = std::thread(&ImageWriter::writerLoop, this);
+        }
+
+        ~ImageWriter() { Finish(); }
+
+        ImageWriter(const ImageWriter &) = delete;
+        ImageWriter &operator=(const ImageWriter &) = delete;
+
+        // rows [y0, y1) of the film are final
+        void WriteRows(int y0, int y1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.emplace_back(y0, y1);
+            }
+            cv.notify_one();
+        }
+
+        // waits for all queued rows, returns false if anything failed to write
+        bool Finish()
+        {
+            if (thread.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done = true;
+                }
+                cv.notify_one();
+                thread.join();
+                out.close();
+            }
+            return !out.fail();
+        }
+
+    private:
+        void writerLoop()
+        {
+            Point2i resolution = film.FullResolution();
+            std::vector<uint8_t> buffer;
+            while (true)
+            {
+                std::pair<int, int> rows;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [this] { return done || !pending.empty(); });
+                    if (pending.empty())
+                        return;
+                    rows = pending.front();
+                    pending.pop_front();
+                }
+
+                size_t rowBytes = resolution.x * ImageBytesPerPixel(format);
+                buffer.resize(rowBytes * (rows.second - rows.first));
+                for (int y = rows.first; y < rows.second; ++y)
+                {
+                    // PFM rows are stored bottom to top, keep the band contiguous on disk
+                    int bandRow = (format == ImageFormat::PFM) ? rows.second - 1 - y : y - rows.first;
+                    EncodeImageRow(format, film, y, buffer.data() + bandRow * rowBytes);
+                }
+
+                // film row that comes first in the file
+                int firstRow = (format == ImageFormat::PFM) ? rows.second - 1 : rows.first;
+                out.seekp(std::streamoff(headerSize + ImageRowOffset(format, resolution, firstRow)));
+                out.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+            }
+        }
+
+    private:
+        const Film &film;
+        ImageFormat format;
+        std::ofstream out;
+        size_t headerSize = 0;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::pair<int, int>> pending;
+        bool done = false;
+    };
+
+    // writes the whole film to filename, the format follows the extension
+    inline bool WriteImage(const std::string &filename, const Film &film)
+    {
+        ImageWriter writer(filename, film);
+        writer.WriteRows(0, film.FullResolution().y);
+        return writer.Finish();
+    }
+
+    /*
+     *  Writes one value per tileSize x tileSize tile of an image of the
+     *  given resolution as a false-colour map, e.g. the render time of
+     *  every tile: black for 0, then red and yellow up to white for the
+     *  largest value. Tiles are numbered row by row.
+     */
+    inline bool WriteHeatmap(const std::string &filename, Point2i resolution, int tileSize,
+                             const std::vector<double> &tileValues)
+    {
+        Film film(resolution.x, resolution.y);
+        int tilesPerRow = (resolution.x + tileSize - 1) / tileSize;
+        double largest = 0;
+        for (double v : tileValues)
+            largest = std::max(largest, v);
+        for (int y = 0; y < resolution.y; ++y)
+        {
+            for (int x = 0; x < resolution.x; ++x)
+            {
+                double v = tileValues[size_t(y / tileSize) * tilesPerRow + x / tileSize];
+                Float t = largest > 0 ? Float(3 * v / largest) : 0;
+                film.AddSample(Point2i(x, y), RGB(Clamp(t, 0, 1), Clamp(t - 1, 0, 1), Clamp(t - 2, 0, 1)));
+            }
+        }
+        return WriteImage(filename, film);
+    }
+}
@@ -1,215 +1,312 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <vector>
-#include <ostream>
 #include <iostream>
-#include <fstream>
 #include <string>
 
 #include <cmath>
 #include <cstdint>
-
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+#include "camera/camera.hpp"
+#include "core/bounds.hpp"
+#include "core/features.hpp"
+#include "core/raypacket.hpp"
+#include "core/transform.hpp"
 #include "core/vecmath.hpp"
-
-struct Vec3
+#include "film/film.hpp"
+#include "film/imageio.hpp"
+#include "render/integrator.hpp"
+#include "render/progressive.hpp"
+#include "render/wavefront.hpp"
+#include "sampler/sampler.hpp"
+#include "scene/scene.hpp"
+#include "scene/sphere.hpp"
+#include "util/color.hpp"
+#include "util/memory.hpp"
+#include "util/parallel.hpp"
+#include "util/stats.hpp"
+
+/*
+ *  Adds samples firstSample .. firstSample + nSamples - 1 of every pixel of
+ *  tile, with the queries and camera rays specialized for Features.
+ */
+template <typename Features>
+void RenderTile(tfrt::FilmTile &tile,
+                int firstSample,
+                int nSamples,
+                const tfrt::Scene &scene,
+                const tfrt::PerspectiveCamera &camera,
+                const tfrt::SobolSampler &sampler,
+                const tfrt::RGB color,
+                const tfrt::RGB background)
 {
-    float x, y, z;
-
-    Vec3() : x(0), y(0), z(0) {}
-    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
-
-    void operator+=(float v)
+    // ray storage comes from the thread's scratch buffer and is released with the tile
+    tfrt::Bounds2i tileBounds = tile.PixelBounds();
+    tfrt::ScratchBuffer &scratch = tfrt::ThreadScratchBuffer();
+    tfrt::RayDifferentialSoA rays(
+        scratch.AllocArray<float>(size_t(tfrt::RayDifferentialSoA::FloatsPerRay) * tileBounds.Area()),
+        tileBounds.Area());
+
+    int width = tileBounds.pMax.x - tileBounds.pMin.x;
+    tfrt::CountRays(tfrt::RayKind::Camera, int64_t(tileBounds.Area()) * nSamples);
+    for (int sampleIndex = firstSample; sampleIndex < firstSample + nSamples; sampleIndex++)
     {
-        x += v;
-        y += v;
-        z += v;
-    }
+        camera.GenerateTile<Features::differentials>(tileBounds, rays, sampler, sampleIndex);
+        for (int y = tileBounds.pMin.y; y < tileBounds.pMax.y; y++)
+        {
+            // trace each row of the tile in packets of neighbouring pixels
+            int row = (y - tileBounds.pMin.y) * width;
+            for (int x0 = tileBounds.pMin.x; x0 < tileBounds.pMax.x; x0 += tfrt::SIMDWidth)
+            {
+                int nRays = std::min(tfrt::SIMDWidth, tileBounds.pMax.x - x0);
 
-    void operator-=(float v)
-    {
-        x -= v;
-        y -= v;
-        z -= v;
+                // only coverage is shaded, so the any-hit query is enough
+                tfrt::MaskN hits = scene.IntersectP<Features>(rays.Packet(row + x0 - tileBounds.pMin.x, nRays));
+                for (int i = 0; i < nRays; i++)
+                    tile.AddSample(tfrt::Point2i(x0 + i, y), hits[i] ? color : background);
+            }
+        }
     }
-};
-
-Vec3 normalize_vec3(Vec3 v) {
-    float magnitude = 1 / std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
-    return Vec3(v.x * magnitude, v.y * magnitude, v.z * magnitude);
-}
-
-std::string vec3_to_string(Vec3 v) {
-    return std::to_string(v.x) + " " + 
-        std::to_string(v.y) + " " + 
-        std::to_string(v.z);
+    scratch.Reset();
 }
 
-Vec3 operator+(Vec3 a, Vec3 b)
+// renders every tile once with all samples, streaming finished rows to the writer
+void Render(tfrt::Film &film,
+            const int tile_size,
+            tfrt::ImageWriter &writer,
+            const std::function<void(tfrt::FilmTile &)> &renderTile)
 {
-    return Vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+    // a band of rows goes to the writer once all tiles in it are merged
+    tfrt::Point2i resolution = film.FullResolution();
+    int tilesPerRow = (resolution.x + tile_size - 1) / tile_size;
+    int nTileRows = (resolution.y + tile_size - 1) / tile_size;
+    std::vector<std::atomic<int>> tilesLeft(nTileRows);
+    for (auto &count : tilesLeft)
+        count = tilesPerRow;
+
+    tfrt::ParallelForTiles(film.PixelBounds(), tile_size, [&](tfrt::Bounds2i tileBounds) {
+        tfrt::FilmTile &tile = tfrt::ThreadFilmTile();
+        film.GetFilmTile(tileBounds, &tile);
+        renderTile(tile);
+        film.MergeFilmTile(tile);
+
+        int tileRow = tileBounds.pMin.y / tile_size;
+        if (--tilesLeft[tileRow] == 0)
+            writer.WriteRows(tileBounds.pMin.y, tileBounds.pMax.y);
+    });
 }
 
-Vec3 operator-(Vec3 a, Vec3 b)
+/*
+ *  Reads s into *value if it is a number of type T no less than minValue,
+ *  otherwise returns false and leaves *value alone. Integers are read as
+ *  long long first, so that negative and too large values are caught
+ *  rather than wrapped.
+ */
+template <typename T>
+bool ParseNumber(const char *s, T minValue, T *value)
 {
-    return Vec3(a.x - b.x, a.y - b.y, a.z - b.z);
-}
-
-struct Ray
-{
-    Vec3 pos;
-    Vec3 dir;
-
-    Ray() : pos(0, 0, 0), dir(0, 0, 1) {}
-    Ray(Vec3 p, Vec3 t) : pos(p.x, p.y, p.z), dir(t - p) {}
-};
-
-
-struct Sphere
-{
-    Vec3 p;
-    float radius = 5;
-    Vec3 color = Vec3(255, 0, 0);
-
-    Sphere() {}
-    Sphere(Vec3 p, float r) : p(p.x, p.y, p.z), radius(r) {}
-};
-
-bool isIntersect(const Sphere& s, const Ray& r)
-{
-    // assuming sphere is sitting at the center of the world.
-
-    // solve quadratic formula
-    float dx = r.dir.x;
-    float dy = r.dir.y;
-    float dz = r.dir.z;
-    float ox = r.pos.x;
-    float oy = r.pos.y;
-    float oz = r.pos.z;
-
-    float a = dx * dx + dy * dy + dz * dz;
-    float b = 2 * (ox * dx + oy * dy + oz * dz);
-    float c = ox * ox + oy * oy + oz * oz - s.radius * s.radius;
-
-    // compute the 3 terms of quadratic formula
-    // float t1 = -b;
-    float t2 = b * b - 4 * a * c;
-    // std::cout << "t2: " << std::to_string(t2) << "\n";
-    // no hit
-    if (t2 < 0)
+    using Wide = std::conditional_t<std::is_integral_v<T>, long long, double>;
+    std::istringstream in(s);
+    Wide parsed;
+    if (!(in >> parsed) || !in.eof() || parsed < Wide(minValue) || parsed > Wide(std::numeric_limits<T>::max()))
         return false;
-    else
-        return true;
-
-    // no need to solve the t for current simple scene with one bounce.
-
-    // float t3 = 0.5 * 1/a;
-
-    // float tp = (t1 + t2) * t3;
-    // float tn = (t1 - t2) * t3;
-    // float t_final = std::min(tp, tn);
+    *value = T(parsed);
     return true;
 }
 
-void WritePPM(const char *filename,
-              std::vector<std::vector<Vec3>> &image,
-              const Sphere &sphere,
-              const int focal_length,
-              const int WIDTH,
-              const int HEIGHT,
-              const Vec3 camera_pos)
+int Usage()
 {
-    float width_offset = WIDTH * 0.5;
-    float height_offset = HEIGHT * 0.5;
-    // pixel width and height
-    float pixel_x = 0.1;
-    float pixel_y = 0.1;
+    std::cerr << "usage: tfrt [--nthreads n] [--tilesize n] [--spp n] [--seed n]"
+                 " [--error e] [--time seconds] [--maxspp n]"
+                 " [--outfile name.ppm|name.pfm] [--heatmap name.ppm|name.pfm] [--bvh sah|lbvh|hlbvh]"
+                 " [--integrator recursive|wavefront] [--maxdepth n] [--raysort 0|1]"
+                 " [--precision float|double]\n";
+    return 1;
+}
 
-    for (int r = 0; r < WIDTH; r++)
+int main(int argc, char *argv[])
+{
+    // options
+    int nThreads = tfrt::AvailableCores();
+    int tileSize = 16;
+    int spp = 16;
+    uint32_t seed = 0;
+    bool progressive = false;
+    tfrt::ProgressiveOptions progressiveOptions;
+    std::string outFile = "output.ppm";
+    // per-tile render times as an image, none if empty
+    std::string heatmapFile;
+    tfrt::BVHBuildMethod bvhMethod = tfrt::BVHBuildMethod::SAH;
+    // empty for the coverage image, otherwise the path integrator to shade with
+    std::string integrator;
+    tfrt::PathSettings pathSettings;
+    tfrt::WavefrontOptions wavefrontOptions;
+    // what path throughput and radiance are accumulated in
+    bool doublePrecision = false;
+    // every option takes a value
+    if (argc % 2 == 0)
+        return Usage();
+    for (int i = 1; i + 1 < argc; i += 2)
     {
-        for (int c = 0; c < HEIGHT; c++)
+        std::string arg = argv[i];
+        const char *value = argv[i + 1];
+        // whether value is one the option takes
+        bool ok = true;
+        if (arg == "--nthreads")
+            ok = ParseNumber(value, 1, &nThreads);
+        else if (arg == "--tilesize")
+            ok = ParseNumber(value, 1, &tileSize);
+        else if (arg == "--spp")
+            ok = ParseNumber(value, 0, &spp);
+        else if (arg == "--seed")
+            ok = ParseNumber(value, 0u, &seed);
+        else if (arg == "--error")
         {
-            // find correct pixel position
-            float x_offset = (-width_offset + 0.5 + r) * pixel_x; 
-            float y_offset = (height_offset - 0.5 - c) * pixel_y; 
-            float x_pos = x_offset + camera_pos.x;
-            float y_pos = y_offset + camera_pos.y;
-            Vec3 pixel_center(x_pos, y_pos, camera_pos.z + focal_length);
-
-            // std::cout << vec3_to_string(pixel_center) << std::endl;
-            // std::cout << x_offset << " " << y_offset << "\n";
-
-            // gather color from ray and update image vector
-            // calculate current ray direction
-            Vec3 dir = pixel_center - camera_pos;
-            Ray ray;
-            ray.pos = pixel_center;
-            ray.dir = normalize_vec3(dir);
-            // std::cout << vec3_to_string(pixel_center) 
-                // << ", " << vec3_to_string(camera_pos) << "\n";
-            // std::cout << vec3_to_string(ray.dir) << "\n";
-            // determine if ray hits an object
-            if (isIntersect(sphere, ray) == true)
-            {
-                image[r][c] = sphere.color;
-            }
+            progressive = true;
+            ok = ParseNumber(value, tfrt::Float(0), &progressiveOptions.errorThreshold);
         }
-    }
-
-    // write color information to .ppm file
-    std::ofstream out("output.ppm", std::ofstream::trunc);
-    if (!out.is_open())
-    {
-        std::cerr << "Error opening file." << std::endl;
-        return;
-    }
-    out << "P3\n";
-    out << WIDTH << " " << HEIGHT << "\n";
-    out << "255\n";
-
-    for (auto r = 0; r < WIDTH; r++)
-    {
-        for (auto c = 0; c < HEIGHT; c++)
+        else if (arg == "--time")
         {
-            out << image[r][c].x << " "
-                << image[r][c].y << " "
-                << image[r][c].z << "\n";
+            progressive = true;
+            ok = ParseNumber(value, 0., &progressiveOptions.timeBudget);
         }
+        else if (arg == "--maxspp")
+            ok = ParseNumber(value, 1, &progressiveOptions.maxSamples);
+        else if (arg == "--outfile")
+            outFile = value;
+        else if (arg == "--heatmap")
+            heatmapFile = value;
+        else if (arg == "--bvh" && tfrt::ParseBVHBuildMethod(value))
+            bvhMethod = *tfrt::ParseBVHBuildMethod(value);
+        else if (arg == "--integrator" && (std::string(value) == "recursive" || std::string(value) == "wavefront"))
+            integrator = value;
+        else if (arg == "--maxdepth")
+            ok = ParseNumber(value, 0, &pathSettings.maxDepth);
+        else if (arg == "--raysort" && (std::string(value) == "0" || std::string(value) == "1"))
+            wavefrontOptions.sortRays = std::string(value) == "1";
+        else if (arg == "--precision" && (std::string(value) == "float" || std::string(value) == "double"))
+            doublePrecision = std::string(value) == "double";
+        else
+            ok = false;
+        if (!ok)
+            return Usage();
     }
-    out.close(); 
-    std::cout << "successfully write to file.\n";
-}
+    // a progressive pass has to add samples to get anywhere
+    if (progressive && spp == 0)
+        return Usage();
+    tfrt::ParallelInit(nThreads);
 
-int main()
-{
     // image properties
     const int WIDTH = 400;
     const int HEIGHT = 400;
-    std::vector<std::vector<Vec3>> image;
+    tfrt::Film film(WIDTH, HEIGHT);
+
+    // camera, framing a 40 x 40 window at distance 3
+    tfrt::Transform cameraFromRender =
+        tfrt::LookAt(tfrt::Point3f(0, 0, -8), tfrt::Point3f(0, 0, 0), tfrt::Vector3f(0, 1, 0));
+    tfrt::Float fov = 2 * tfrt::Degrees(std::atan(20.f / 3));
+    tfrt::PerspectiveCamera camera(tfrt::Inverse(cameraFromRender), tfrt::Point2i(WIDTH, HEIGHT), fov);
+    tfrt::SobolSampler sampler(spp, seed);
+
+    // scene
+    std::vector<tfrt::Sphere> spheres;
+    spheres.push_back(tfrt::Sphere(tfrt::Point3f(0, 0, 0), 3)); // sphere at origin
+    tfrt::Scene scene(spheres, {}, {}, bvhMethod);
+
+    // sRGB gray background
+    tfrt::Float gray = tfrt::SRGBToLinear(128.f / 255);
+    // render time of every tile, summed over progressive passes, for the heatmap
+    int tilesPerRow = (WIDTH + tileSize - 1) / tileSize;
+    std::vector<double> tileSeconds(size_t(tilesPerRow) * ((HEIGHT + tileSize - 1) / tileSize));
+    tfrt::ImageWriter writer(outFile, film);
+
+    /*
+     *  Everything that touches the scene runs in the kernel instantiation
+     *  for what this render uses: no bounces below --maxdepth 2 and only
+     *  the kinds of geometry the scene has. The coverage image needs
+     *  neither bounces nor ray differentials.
+     */
+    tfrt::FeatureSet features = tfrt::PathFeatures(scene, pathSettings);
+    if (integrator.empty())
+        features.bounces = false;
+    auto render = [&](auto kernelFeatures) {
+        using Features = decltype(kernelFeatures);
+        tfrt::RecursivePathIntegrator<Features> recursive(scene, camera, sampler, pathSettings);
+        tfrt::WavefrontPathIntegrator<Features> wavefront(scene, camera, sampler, pathSettings,
+                                                          wavefrontOptions);
+        auto renderTile = [&](tfrt::FilmTile &tile, int firstSample, int nSamples) {
+            auto start = std::chrono::steady_clock::now();
+            if (integrator == "recursive")
+                recursive.RenderTile(tile, firstSample, nSamples);
+            else if (integrator == "wavefront")
+                wavefront.RenderTile(tile, firstSample, nSamples);
+            else
+                RenderTile<Features>(tile, firstSample, nSamples, scene, camera, sampler, tfrt::RGB(1, 0, 0),
+                                     tfrt::RGB(gray, gray, gray));
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            tfrt::CountTile(seconds);
+            tfrt::Point2i pMin = tile.PixelBounds().pMin;
+            tileSeconds[size_t(pMin.y / tileSize) * tilesPerRow + pMin.x / tileSize] += seconds;
+        };
+
+        if (progressive)
+        {
+            // --spp samples per pass until the error target, the time budget or --maxspp
+            progressiveOptions.samplesPerPass = spp;
+            tfrt::ProgressiveStats stats =
+                tfrt::RenderProgressive(film, tileSize, progressiveOptions, renderTile);
+            writer.WriteRows(0, HEIGHT);
+            std::cout << stats.passes << " passes, "
+                      << double(stats.pixelSamples) / (WIDTH * HEIGHT) << " samples per pixel, "
+                      << stats.convergedTiles << "/" << stats.nTiles << " tiles converged in "
+                      << stats.seconds << " s\n";
+        }
+        else
+        {
+            auto start = std::chrono::steady_clock::now();
+            Render(film, tileSize, writer, [&](tfrt::FilmTile &tile) { renderTile(tile, 0, spp); });
+            std::cout << "rendered in "
+                      << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+                      << " s\n";
+        }
+        if (tfrt::StatsEnabled)
+            tfrt::GatherStats().Print(std::cout, tfrt::SIMDWidth);
+        if (integrator == "wavefront")
+        {
+            tfrt::WavefrontStats stats = wavefront.Stats();
+            std::cout << "bounce rays: " << stats.rays << ", "
+                      << stats.rays / std::max(stats.traceSeconds, 1e-9) * 1e-6 << " Mrays/s, "
+                      << stats.NodeVisitsPerRay() << " node visits per ray, "
+                      << 100 * stats.LaneUtilization() << "% of lanes active per node, sorting took "
+                      << stats.sortSeconds << " s\n";
+        }
+    };
+    if (doublePrecision)
+        tfrt::DispatchFeatures<double>(features, render);
+    else
+        tfrt::DispatchFeatures(features, render);
 
-    // write gray color in framebuffer as background
-    for (uint32_t row = 0; row < WIDTH; row++)
+    if (!writer.Finish())
+    {
+        std::cerr << "Error writing " << outFile << "." << std::endl;
+        return 1;
+    }
+    std::cout << "successfully write to " << outFile << ".\n";
+    if (!heatmapFile.empty())
     {
-        std::vector<Vec3> curr;
-        for (uint32_t col = 0; col < HEIGHT; col++)
+        if (!tfrt::WriteHeatmap(heatmapFile, tfrt::Point2i(WIDTH, HEIGHT), tileSize, tileSeconds))
         {
-            curr.push_back(Vec3(128, 128, 128));
+            std::cerr << "Error writing " << heatmapFile << "." << std::endl;
+            return 1;
         }
-        image.push_back(curr);
+        std::cout << "tile time heatmap written to " << heatmapFile << ".\n";
     }
 
-    // camera
-    Vec3 camPos(0, 0, -8);
-    Vec3 target(0, 0, 0); // camera target position
-    int focal_length = 3;
-
-    // sphere
-    Sphere s(Vec3(0, 0, 0), 3); // unit sphere at origin
-
-    WritePPM("../output.ppm", 
-            image, 
-            s, 
-            focal_length, 
-            WIDTH, 
-            HEIGHT, 
-            camPos);
-
+    tfrt::ParallelCleanup();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <optional>
+
+#include "camera/camera.hpp"
+#include "core/features.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/vecmath.hpp"
+#include "film/film.hpp"
+#include "sampler/sampler.hpp"
+#include "scene/interaction.hpp"
+#include "scene/scene.hpp"
+#include "util/color.hpp"
+#include "util/math.hpp"
+#include "util/sampling.hpp"
+#include "util/stats.hpp"
+
+namespace tfrt
+{
+    /*
+     *  What the path integrators shade with while the scene carries no
+     *  materials or lights: every surface is diffuse with one albedo, lit
+     *  by a distant sun and a uniform sky that escaped paths see.
+     */
+    struct PathSettings
+    {
+        // surface vertices per path, 1 is direct lighting only
+        int maxDepth = 5;
+        RGB albedo = RGB(0.6f, 0.6f, 0.6f);
+        // unit vector towards the sun
+        Vector3f sunDirection = Normalize(Vector3f(1, 2, -1));
+        RGB sunIrradiance = RGB(3, 3, 3);
+        RGB skyRadiance = RGB(0.4f, 0.5f, 0.7f);
+    };
+
+    /*
+     *  What a path integrator needs of scene with settings, for
+     *  DispatchFeatures. Neither integrator uses ray differentials.
+     */
+    inline FeatureSet PathFeatures(const Scene &scene, const PathSettings &settings)
+    {
+        FeatureSet features;
+        features.spheres = scene.HasSpheres();
+        features.triangles = scene.HasTriangles();
+        features.bounces = settings.maxDepth > 1;
+        features.differentials = false;
+        return features;
+    }
+
+    // dimensions 0 and 1 are the pixel offset, bounce i uses 2 + 2i and 3 + 2i
+    inline int PathBounceDimension(int depth) { return 2 + 2 * depth; }
+
+    // sun light a diffuse surface facing n reflects, before the shadow test
+    inline RGB DiffuseSunLight(const PathSettings &settings, Normal3f n)
+    {
+        Float cosTheta = Dot(n, settings.sunDirection);
+        if (cosTheta <= 0)
+            return RGB();
+        return settings.albedo * settings.sunIrradiance * (cosTheta / Pi);
+    }
+
+    // cosine-distributed direction about n; f cos / pdf of the diffuse surface is then just the albedo
+    inline Vector3f SampleDiffuseBounce(Normal3f n, Point2f u)
+    {
+        Vector3f s, t, nv(n);
+        CoordinateSystem(nv, &s, &t);
+        Vector3f w = SampleCosineHemisphere(u);
+        return s * w.x + t * w.y + nv * w.z;
+    }
+
+    // DiffuseSunLight and SampleDiffuseBounce for SIMDWidth normals, lane i the scalar result for lane i
+    inline RGBT<FloatN> DiffuseSunLight(const PathSettings &settings, Vector3fN n)
+    {
+        FloatN cosTheta = Dot(n, Broadcast(settings.sunDirection));
+        FloatN scale = Select(cosTheta <= FloatN(0.f), FloatN(0.f), cosTheta / Pi);
+        RGB sun = settings.albedo * settings.sunIrradiance;
+        return RGBT<FloatN>(scale * sun.r, scale * sun.g, scale * sun.b);
+    }
+
+    inline Vector3fN SampleDiffuseBounce(Vector3fN n, FloatN u0, FloatN u1)
+    {
+        Vector3fN s, t;
+        CoordinateSystem(n, &s, &t);
+        Vector3fN w = SampleCosineHemisphere(u0, u1);
+        return s * w.x + t * w.y + n * w.z;
+    }
+
+    /*
+     *  Megakernel path tracer: one path at a time, each vertex a recursive
+     *  call that intersects, shades, traces the shadow ray and recurses for
+     *  the bounce. Simple, and the reference the wavefront integrator is
+     *  checked and timed against.
+     *
+     *  Features, a KernelFeatures, says what the scene and settings need;
+     *  an instantiation for less than AllFeatures drops the rest from the
+     *  loops and accumulates radiance in Features::Float.
+     */
+    template <typename Features = AllFeatures>
+    class RecursivePathIntegrator
+    {
+    public:
+        using Spectrum = RGBT<typename Features::Float>;
+
+        RecursivePathIntegrator(const Scene &scene, const ProjectiveCamera &camera,
+                                const SobolSampler &sampler, const PathSettings &settings)
+            : scene(scene), camera(camera), sampler(sampler), settings(settings)
+        {
+            DCHECK(Features::bounces || settings.maxDepth <= 1);
+        }
+
+        // adds samples firstSample .. firstSample + nSamples - 1 of every pixel of tile
+        void RenderTile(FilmTile &tile, int firstSample, int nSamples) const
+        {
+            Bounds2i b = tile.PixelBounds();
+            for (int sampleIndex = firstSample; sampleIndex < firstSample + nSamples; ++sampleIndex)
+            {
+                for (int y = b.pMin.y; y < b.pMax.y; ++y)
+                {
+                    for (int x = b.pMin.x; x < b.pMax.x; ++x)
+                    {
+                        Point2i pixel(x, y);
+                        Point2f pFilm(x + sampler.Sample1D(pixel, sampleIndex, 0),
+                                      y + sampler.Sample1D(pixel, sampleIndex, 1));
+                        tile.AddSample(pixel, RGB(Li(camera.GenerateRay(pFilm), pixel, sampleIndex, 0)));
+                    }
+                }
+            }
+        }
+
+        // radiance arriving along ray, whose first vertex is vertex depth of its path
+        Spectrum Li(const Ray &ray, Point2i pixel, int sampleIndex, int depth) const
+        {
+            CountRays(depth == 0 ? RayKind::Camera : RayKind::Bounce, 1);
+            std::optional<ShapeHit> hit = scene.Intersect<Features>(ray);
+            if (!hit)
+            {
+                CountPathLength(depth);
+                return Spectrum(settings.skyRadiance);
+            }
+
+            SurfaceInteraction si = scene.Interaction(ray, *hit);
+            Normal3f n = FaceForward(si.n, si.wo);
+            Spectrum L;
+            RGB sun = DiffuseSunLight(settings, n);
+            if (sun != RGB())
+            {
+                CountRays(RayKind::Shadow, 1);
+                if (!scene.IntersectP<Features>(si.SpawnRay(settings.sunDirection)))
+                    L += Spectrum(sun);
+            }
+
+            if constexpr (Features::bounces)
+            {
+                if (depth + 1 < settings.maxDepth)
+                {
+                    int dim = PathBounceDimension(depth);
+                    Point2f u(sampler.Sample1D(pixel, sampleIndex, dim),
+                              sampler.Sample1D(pixel, sampleIndex, dim + 1));
+                    Ray bounce = si.SpawnRay(SampleDiffuseBounce(n, u));
+                    L += Spectrum(settings.albedo) * Li(bounce, pixel, sampleIndex, depth + 1);
+                    return L;
+                }
+            }
+            CountPathLength(depth + 1);
+            return L;
+        }
+
+    private:
+        const Scene &scene;
+        const ProjectiveCamera &camera;
+        const SobolSampler &sampler;
+        PathSettings settings;
+    };
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "film/film.hpp"
+#include "util/parallel.hpp"
+
+namespace tfrt
+{
+    struct ProgressiveOptions
+    {
+        // samples a tile gets per pass; tiles are first judged after one pass
+        int samplesPerPass = 16;
+        // per-pixel cap, a tile that reaches it stops even if still noisy
+        int maxSamples = 1024;
+        // a tile is done once every pixel's relative error is below this, 0 never stops early
+        Float errorThreshold = 0;
+        // pixels darker than this are judged against it, so black regions converge
+        Float minMean = 0.01f;
+        // wall-clock limit in seconds, 0 for none
+        double timeBudget = 0;
+    };
+
+    struct ProgressiveStats
+    {
+        int passes = 0;
+        int64_t pixelSamples = 0;
+        int convergedTiles = 0, nTiles = 0;
+        double seconds = 0;
+    };
+
+    /*
+     *  Renders in passes until every tile has converged, hit maxSamples or
+     *  the time budget is spent. Each pass gives samplesPerPass more
+     *  samples to every tile that is still active, noisiest tiles first;
+     *  tiles whose error is below the threshold drop out, so later passes
+     *  spend the remaining budget where the noise is.
+     *
+     *  renderTile(filmTile, firstSample, nSamples) adds samples
+     *  firstSample .. firstSample + nSamples - 1 of every pixel of the
+     *  tile. Without a time budget the image depends only on the
+     *  options, not on the thread count.
+     */
+    inline ProgressiveStats RenderProgressive(
+        Film &film, int tileSize, const ProgressiveOptions &options,
+        const std::function<void(FilmTile &, int, int)> &renderTile)
+    {
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point start = Clock::now();
+        auto elapsed = [&] { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+        std::vector<Bounds2i> tiles = GenerateTiles(film.PixelBounds(), tileSize);
+        std::vector<int> tileSamples(tiles.size(), 0);
+        std::vector<Float> tileError(tiles.size(), Infinity);
+        std::vector<int> active(tiles.size());
+        std::iota(active.begin(), active.end(), 0);
+
+        ProgressiveStats stats;
+        stats.nTiles = int(tiles.size());
+        std::atomic<bool> outOfTime{false};
+        while (!active.empty() && !outOfTime)
+        {
+            // noisiest first, so a pass cut short by the budget has helped where it matters most
+            std::stable_sort(active.begin(), active.end(),
+                             [&](int a, int b) { return tileError[a] > tileError[b]; });
+
+            ParallelFor(0, int64_t(active.size()), [&](int64_t i) {
+                if (outOfTime || (options.timeBudget > 0 && elapsed() > options.timeBudget))
+                {
+                    outOfTime = true;
+                    return;
+                }
+                int t = active[i];
+                int nSamples = std::min(options.samplesPerPass, options.maxSamples - tileSamples[t]);
+                FilmTile &filmTile = ThreadFilmTile();
+                film.GetFilmTile(tiles[t], &filmTile);
+                renderTile(filmTile, tileSamples[t], nSamples);
+                film.MergeFilmTile(filmTile);
+                tileSamples[t] += nSamples;
+                tileError[t] = film.MaxRelativeError(tiles[t], options.minMean);
+            });
+            ++stats.passes;
+
+            active.erase(std::remove_if(active.begin(), active.end(),
+                                        [&](int t) {
+                                            bool converged = tileError[t] < options.errorThreshold;
+                                            stats.convergedTiles += converged;
+                                            return converged || tileSamples[t] >= options.maxSamples;
+                                        }),
+                         active.end());
+        }
+
+        for (size_t t = 0; t < tiles.size(); ++t)
+            stats.pixelSamples += int64_t(tileSamples[t]) * tiles[t].Area();
+        stats.seconds = elapsed();
+        return stats;
+    }
+}
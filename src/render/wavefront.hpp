@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "camera/camera.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "film/film.hpp"
+#include "render/integrator.hpp"
+#include "sampler/sampler.hpp"
+#include "scene/interaction.hpp"
+#include "scene/scene.hpp"
+#include "util/color.hpp"
+#include "util/math.hpp"
+#include "util/memory.hpp"
+#include "util/stats.hpp"
+
+namespace tfrt
+{
+    struct WavefrontOptions
+    {
+        // paths in flight per batch, larger tiles are rendered in several batches
+        int maxPaths = 1 << 14;
+        // reorder the rays of every bounce by direction octant and origin before tracing them
+        bool sortRays = false;
+    };
+
+    // closest-hit work of the bounce rays, camera rays are coherent anyway
+    struct WavefrontStats
+    {
+        int64_t rays = 0;
+        // packet node fetches and the lanes that needed them, only counted with TFRT_STATS
+        int64_t nodeVisits = 0, laneHits = 0;
+        double traceSeconds = 0, sortSeconds = 0;
+
+        double NodeVisitsPerRay() const { return rays > 0 ? double(nodeVisits) / rays : 0; }
+        // share of the lanes of each node fetch that needed the node
+        double LaneUtilization() const
+        {
+            return nodeVisits > 0 ? double(laneHits) / (double(nodeVisits) * SIMDWidth) : 0;
+        }
+    };
+
+    /*
+     *  Wavefront path tracer. Instead of following one path to the end, a
+     *  batch of paths advances one stage at a time through explicit SoA
+     *  queues:
+     *
+     *    camera     rays for every pixel sample of the batch
+     *    closest    the ray queue in packets; misses pick up the sky, hits
+     *               go to the hit queue
+     *    shade      interactions of the hits; sun rays go to the shadow
+     *               queue, bounces to the next ray queue
+     *    shadow     the shadow queue in packets; unblocked rays add light
+     *    next       the bounce queue becomes the ray queue
+     *
+     *  Each stage runs one small loop over its queue, so the intersection
+     *  stages trace full packets no matter how paths diverged and the
+     *  working set of each stage stays in cache. Paths are ordered by
+     *  sample, then pixel, and draw the same sample dimensions as in
+     *  RecursivePathIntegrator, so both estimate the same image.
+     *
+     *  Bounce rays leave their surfaces in all directions, so packets of
+     *  neighbouring queue entries share few nodes. With sortRays the queue
+     *  is first radix sorted on the direction octant and the Morton code
+     *  of the origin, which makes packets of rays that start close together
+     *  and traverse children in the same order. The sort only permutes the
+     *  queue, the image does not change.
+     *
+     *  A tile is rendered as one or more batches of at most maxPaths
+     *  paths, on the calling thread; tiles provide the parallelism.
+     *
+     *  Features is a KernelFeatures as for RecursivePathIntegrator. The
+     *  throughput and radiance queues hold Features::Float.
+     */
+    template <typename Features = AllFeatures>
+    class WavefrontPathIntegrator
+    {
+    public:
+        WavefrontPathIntegrator(const Scene &scene, const ProjectiveCamera &camera,
+                                const SobolSampler &sampler, const PathSettings &settings,
+                                const WavefrontOptions &options = {})
+            : scene(scene), camera(camera), sampler(sampler), settings(settings), options(options),
+              sceneBounds(scene.Bounds())
+        {
+            DCHECK(Features::bounces || settings.maxDepth <= 1);
+        }
+
+        // adds samples firstSample .. firstSample + nSamples - 1 of every pixel of tile
+        void RenderTile(FilmTile &tile, int firstSample, int nSamples) const
+        {
+            // queues live in the thread's scratch buffer until the tile is done
+            ScratchBuffer &scratch = ThreadScratchBuffer();
+            Bounds2i b = tile.PixelBounds();
+            int area = b.Area();
+            int samplesPerBatch = std::max(1, std::min(nSamples, options.maxPaths / std::max(1, area)));
+            Queues q(scratch, area * samplesPerBatch);
+            RayDifferentialSoA cameraRays(scratch.AllocArray<float>(size_t(RayDifferentialSoA::FloatsPerRay) * area),
+                                          area);
+            for (int first = firstSample; first < firstSample + nSamples; first += samplesPerBatch)
+            {
+                int batchSamples = std::min(samplesPerBatch, firstSample + nSamples - first);
+                q.Reset(area * batchSamples);
+                generateCameraRays(b, first, batchSamples, cameraRays, q);
+                CountRays(RayKind::Camera, q.rays.size);
+                for (int depth = 0; q.rays.size > 0; ++depth)
+                {
+                    if constexpr (Features::bounces)
+                    {
+                        if (depth == 0)
+                            intersectClosest(q);
+                        else
+                            intersectBounce(q);
+                    }
+                    else
+                        intersectClosest(q);
+                    // misses end their paths here, hits too once the path is maxDepth long
+                    CountPathLength(depth, q.rays.size - q.nHits);
+                    if (depth + 1 >= settings.maxDepth)
+                        CountPathLength(depth + 1, q.nHits);
+                    shade(depth, q);
+                    traceShadowRays(q);
+                    std::swap(q.rays, q.nextRays);
+                    q.nextRays.Clear();
+                }
+
+                for (int path = 0; path < area * batchSamples; ++path)
+                    tile.AddSample(Point2i(q.px[path], q.py[path]),
+                                   RGB(Float(q.L[0][path]), Float(q.L[1][path]), Float(q.L[2][path])));
+            }
+            scratch.Reset();
+        }
+
+        // totals over every RenderTile call so far
+        WavefrontStats Stats() const
+        {
+            WavefrontStats stats;
+            stats.rays = totals.rays;
+            stats.nodeVisits = totals.nodeVisits;
+            stats.laneHits = totals.laneHits;
+            stats.traceSeconds = totals.traceNanoseconds * 1e-9;
+            stats.sortSeconds = totals.sortNanoseconds * 1e-9;
+            return stats;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        using Real = typename Features::Float;
+        using Spectrum = RGBT<Real>;
+
+        // rays in SoA form, each tagged with its path
+        struct RayQueue
+        {
+            float *o[3], *d[3];
+            uint32_t *path;
+            int size = 0;
+
+            RayQueue(ScratchBuffer &scratch, int capacity)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    o[c] = scratch.AllocArray<float>(capacity);
+                    d[c] = scratch.AllocArray<float>(capacity);
+                }
+                path = scratch.AllocArray<uint32_t>(capacity);
+            }
+
+            void Clear() { size = 0; }
+
+            void Push(const Ray &ray, uint32_t p)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    o[c][size] = ray.o[c];
+                    d[c][size] = ray.d[c];
+                }
+                path[size++] = p;
+            }
+
+            Ray Get(int i) const
+            {
+                return Ray(Point3f(o[0][i], o[1][i], o[2][i]), Vector3f(d[0][i], d[1][i], d[2][i]));
+            }
+
+            // rays first .. first + n - 1; missing lanes repeat the first ray and never hit
+            RayPacket Packet(int first, int n) const
+            {
+                auto load = [&](const float *array) {
+                    if (n == SIMDWidth)
+                        return FloatN::Load(array + first);
+                    alignas(32) float lanes[SIMDWidth];
+                    for (int i = 0; i < SIMDWidth; ++i)
+                        lanes[i] = array[first + (i < n ? i : 0)];
+                    return FloatN::Load(lanes);
+                };
+                RayPacket packet;
+                packet.o = Point3fN(load(o[0]), load(o[1]), load(o[2]));
+                packet.d = Vector3fN(load(d[0]), load(d[1]), load(d[2]));
+                packet.tMax = Select(MaskN::FromBits((1u << n) - 1), FloatN(Infinity), FloatN(-Infinity));
+                return packet;
+            }
+        };
+
+        // every queue of a batch of up to capacity paths
+        struct Queues
+        {
+            // per path: pixel, sample index, throughput and radiance so far
+            int *px, *py, *sampleIndex;
+            Real *beta[3], *L[3];
+
+            RayQueue rays, nextRays;
+
+            // hits of the current rays
+            uint32_t *hitRay, *hitPrim, *hitGeom;
+            float *hitT, *hitU, *hitV;
+            int nHits = 0;
+
+            // sun rays and the radiance each adds to its path when unblocked
+            RayQueue shadowRays;
+            Real *shadowL[3];
+
+            // sort key in the high half, ray index in the low half
+            uint64_t *sortKeys, *sortScratch;
+
+            Queues(ScratchBuffer &scratch, int capacity)
+                : rays(scratch, capacity), nextRays(scratch, capacity), shadowRays(scratch, capacity)
+            {
+                for (int **v : {&px, &py, &sampleIndex})
+                    *v = scratch.AllocArray<int>(capacity);
+                for (int c = 0; c < 3; ++c)
+                {
+                    beta[c] = scratch.AllocArray<Real>(capacity);
+                    L[c] = scratch.AllocArray<Real>(capacity);
+                    shadowL[c] = scratch.AllocArray<Real>(capacity);
+                }
+                for (uint32_t **v : {&hitRay, &hitPrim, &hitGeom})
+                    *v = scratch.AllocArray<uint32_t>(capacity);
+                for (float **v : {&hitT, &hitU, &hitV})
+                    *v = scratch.AllocArray<float>(capacity);
+                sortKeys = scratch.AllocArray<uint64_t>(capacity);
+                sortScratch = scratch.AllocArray<uint64_t>(capacity);
+            }
+
+            // starts a batch of nPaths <= capacity paths
+            void Reset(int nPaths)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    std::fill_n(beta[c], nPaths, Real(1));
+                    std::fill_n(L[c], nPaths, Real(0));
+                }
+                for (RayQueue *queue : {&rays, &nextRays, &shadowRays})
+                    queue->Clear();
+                nHits = 0;
+            }
+        };
+
+        void generateCameraRays(const Bounds2i &b, int firstSample, int nSamples, RayDifferentialSoA &cameraRays,
+                                Queues &q) const
+        {
+            int area = b.Area(), width = b.pMax.x - b.pMin.x;
+            for (int s = 0; s < nSamples; ++s)
+            {
+                camera.GenerateTile<Features::differentials>(b, cameraRays, sampler, firstSample + s);
+                int base = s * area;
+                for (int c = 0; c < 3; ++c)
+                {
+                    std::copy(cameraRays.o[c], cameraRays.o[c] + area, q.rays.o[c] + base);
+                    std::copy(cameraRays.d[c], cameraRays.d[c] + area, q.rays.d[c] + base);
+                }
+                for (int i = 0; i < area; ++i)
+                {
+                    q.rays.path[base + i] = uint32_t(base + i);
+                    q.px[base + i] = b.pMin.x + i % width;
+                    q.py[base + i] = b.pMin.y + i / width;
+                    q.sampleIndex[base + i] = firstSample + s;
+                }
+            }
+            q.rays.size = area * nSamples;
+        }
+
+        void intersectClosest(Queues &q) const
+        {
+            q.nHits = 0;
+            for (int i = 0; i < q.rays.size; i += SIMDWidth)
+            {
+                int n = std::min(SIMDWidth, q.rays.size - i);
+                RayPacketHit hit = scene.Intersect<Features>(q.rays.Packet(i, n));
+                alignas(32) float t[SIMDWidth], u[SIMDWidth], v[SIMDWidth];
+                hit.tHit.Store(t);
+                hit.u.Store(u);
+                hit.v.Store(v);
+                uint32_t valid = hit.valid.Bits();
+                for (int lane = 0; lane < n; ++lane)
+                {
+                    if ((valid >> lane) & 1)
+                    {
+                        int h = q.nHits++;
+                        q.hitRay[h] = uint32_t(i + lane);
+                        q.hitT[h] = t[lane];
+                        q.hitU[h] = u[lane];
+                        q.hitV[h] = v[lane];
+                        q.hitPrim[h] = hit.primIndex[lane];
+                        q.hitGeom[h] = hit.geomIndex[lane];
+                    }
+                    else
+                    {
+                        // escaped, the sky ends the path
+                        uint32_t path = q.rays.path[i + lane];
+                        for (int c = 0; c < 3; ++c)
+                            q.L[c][path] += q.beta[c][path] * settings.skyRadiance[c];
+                    }
+                }
+            }
+        }
+
+        // closest hits of bounce rays, sorted first if asked to, with the work counted
+        void intersectBounce(Queues &q) const
+        {
+            Clock::time_point start = Clock::now();
+            if (options.sortRays)
+            {
+                sortRays(q);
+                Clock::time_point sorted = Clock::now();
+                totals.sortNanoseconds += std::chrono::nanoseconds(sorted - start).count();
+                start = sorted;
+            }
+            const RenderStats &stats = ThreadStats();
+            int64_t nodeVisits = stats.packetNodeVisits, laneHits = stats.laneHits;
+            intersectClosest(q);
+            totals.traceNanoseconds += std::chrono::nanoseconds(Clock::now() - start).count();
+            totals.rays += q.rays.size;
+            totals.nodeVisits += stats.packetNodeVisits - nodeVisits;
+            totals.laneHits += stats.laneHits - laneHits;
+            CountRays(RayKind::Bounce, q.rays.size);
+        }
+
+        /*
+         *  Permutes the ray queue by direction octant, then by the 27-bit
+         *  Morton code of the origin in the scene bounds. Three stable
+         *  counting passes of 10 bits over the 30-bit key, linear in the
+         *  number of rays and cheap next to tracing them.
+         */
+        void sortRays(Queues &q) const
+        {
+            int n = q.rays.size;
+            const RayQueue &rays = q.rays;
+            for (int i = 0; i < n; ++i)
+            {
+                uint32_t octant = uint32_t(rays.d[0][i] < 0) | uint32_t(rays.d[1][i] < 0) << 1 |
+                                  uint32_t(rays.d[2][i] < 0) << 2;
+                Vector3f o = sceneBounds.Offset(Point3f(rays.o[0][i], rays.o[1][i], rays.o[2][i]));
+                uint32_t morton = EncodeMorton3(Clamp(o.x * 512, 0, 511), Clamp(o.y * 512, 0, 511),
+                                                Clamp(o.z * 512, 0, 511));
+                q.sortKeys[i] = uint64_t(octant << 27 | morton) << 32 | uint32_t(i);
+            }
+
+            constexpr int bitsPerPass = 10, nBuckets = 1 << bitsPerPass;
+            uint64_t *in = q.sortKeys, *out = q.sortScratch;
+            for (int pass = 0; pass < 3; ++pass)
+            {
+                int shift = 32 + pass * bitsPerPass;
+                int offsets[nBuckets + 1] = {};
+                for (int i = 0; i < n; ++i)
+                    ++offsets[((in[i] >> shift) & (nBuckets - 1)) + 1];
+                for (int b = 0; b < nBuckets; ++b)
+                    offsets[b + 1] += offsets[b];
+                for (int i = 0; i < n; ++i)
+                    out[offsets[(in[i] >> shift) & (nBuckets - 1)]++] = in[i];
+                std::swap(in, out);
+            }
+
+            // gather into the empty next-bounce queue, which then takes the place of the rays
+            RayQueue &sorted = q.nextRays;
+            for (int i = 0; i < n; ++i)
+            {
+                uint32_t r = uint32_t(in[i]);
+                for (int c = 0; c < 3; ++c)
+                {
+                    sorted.o[c][i] = rays.o[c][r];
+                    sorted.d[c][i] = rays.d[c][r];
+                }
+                sorted.path[i] = rays.path[r];
+            }
+            sorted.size = n;
+            std::swap(q.rays, q.nextRays);
+            q.nextRays.Clear();
+        }
+
+        /*
+         *  Shades the hits SIMDWidth at a time. Only fetching the interaction
+         *  depends on the primitive and goes hit by hit; facing the normal,
+         *  the sun term, spawning the shadow and bounce rays and the
+         *  throughput update then run on all lanes at once, lane i the same
+         *  arithmetic RecursivePathIntegrator does for that hit.
+         */
+        void shade(int depth, Queues &q) const
+        {
+            q.shadowRays.Clear();
+            bool bounce = Features::bounces && depth + 1 < settings.maxDepth;
+            int dim = PathBounceDimension(depth);
+            for (int first = 0; first < q.nHits; first += SIMDWidth)
+            {
+                int n = std::min(SIMDWidth, q.nHits - first);
+
+                // per lane: p, n and wo of the interaction, the bounce sample and the path's throughput
+                alignas(32) float lanes[11][SIMDWidth];
+                alignas(32) Real beta[3][SIMDWidth];
+                uint32_t path[SIMDWidth];
+                for (int lane = 0; lane < SIMDWidth; ++lane)
+                {
+                    // missing lanes repeat the first hit, nothing is pushed for them
+                    int h = first + (lane < n ? lane : 0);
+                    int r = int(q.hitRay[h]);
+                    path[lane] = q.rays.path[r];
+                    ShapeHit hit;
+                    hit.tHit = q.hitT[h];
+                    hit.u = q.hitU[h];
+                    hit.v = q.hitV[h];
+                    hit.primIndex = q.hitPrim[h];
+                    hit.geomIndex = q.hitGeom[h];
+                    SurfaceInteraction si = scene.Interaction(q.rays.Get(r), hit);
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        lanes[c][lane] = si.p[c];
+                        lanes[3 + c][lane] = si.n[c];
+                        lanes[6 + c][lane] = si.wo[c];
+                        beta[c][lane] = q.beta[c][path[lane]];
+                    }
+                    if (bounce)
+                    {
+                        Point2i pixel(q.px[path[lane]], q.py[path[lane]]);
+                        lanes[9][lane] = sampler.Sample1D(pixel, q.sampleIndex[path[lane]], dim);
+                        lanes[10][lane] = sampler.Sample1D(pixel, q.sampleIndex[path[lane]], dim + 1);
+                    }
+                }
+                Point3fN p(FloatN::Load(lanes[0]), FloatN::Load(lanes[1]), FloatN::Load(lanes[2]));
+                Vector3fN ns(FloatN::Load(lanes[3]), FloatN::Load(lanes[4]), FloatN::Load(lanes[5]));
+                Vector3fN wo(FloatN::Load(lanes[6]), FloatN::Load(lanes[7]), FloatN::Load(lanes[8]));
+
+                // FaceForward(si.n, si.wo)
+                MaskN back = Dot(ns, wo) < FloatN(0.f);
+                Vector3fN nf(Select(back, -ns.x, ns.x), Select(back, -ns.y, ns.y), Select(back, -ns.z, ns.z));
+
+                // SpawnRay(d): off the surface along the unfaced normal, to the side d leaves on
+                FloatN offset = 1e-4f * (1 + max(abs(p.x), max(abs(p.y), abs(p.z))));
+                auto spawnOrigin = [&](Vector3fN d) {
+                    FloatN side = Select(Dot(ns, d) < FloatN(0.f), -offset, offset);
+                    return p + ns * side;
+                };
+
+                RGBT<FloatN> sun = DiffuseSunLight(settings, nf);
+                uint32_t lit = ((sun.r != FloatN(0.f)) | (sun.g != FloatN(0.f)) | (sun.b != FloatN(0.f))).Bits();
+                if (lit & ((1u << n) - 1))
+                {
+                    Point3fN o = spawnOrigin(Broadcast(settings.sunDirection));
+                    alignas(32) float origin[3][SIMDWidth];
+                    alignas(32) Real contribution[3][SIMDWidth];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        o[c].Store(origin[c]);
+                        multiplyLanes(beta[c], sun[c], contribution[c]);
+                    }
+                    for (int lane = 0; lane < n; ++lane)
+                    {
+                        if (!(lit & (1u << lane)))
+                            continue;
+                        int s = q.shadowRays.size;
+                        q.shadowRays.Push(Ray(Point3f(origin[0][lane], origin[1][lane], origin[2][lane]),
+                                              settings.sunDirection),
+                                          path[lane]);
+                        for (int c = 0; c < 3; ++c)
+                            q.shadowL[c][s] = contribution[c][lane];
+                    }
+                }
+
+                if (!bounce)
+                    continue;
+                Vector3fN d = SampleDiffuseBounce(nf, FloatN::Load(lanes[9]), FloatN::Load(lanes[10]));
+                Point3fN o = spawnOrigin(d);
+                alignas(32) float ray[6][SIMDWidth];
+                for (int c = 0; c < 3; ++c)
+                {
+                    o[c].Store(ray[c]);
+                    d[c].Store(ray[3 + c]);
+                    multiplyLanes(beta[c], settings.albedo[c], beta[c]);
+                }
+                for (int lane = 0; lane < n; ++lane)
+                {
+                    q.nextRays.Push(Ray(Point3f(ray[0][lane], ray[1][lane], ray[2][lane]),
+                                        Vector3f(ray[3][lane], ray[4][lane], ray[5][lane])),
+                                    path[lane]);
+                    for (int c = 0; c < 3; ++c)
+                        q.beta[c][path[lane]] = beta[c][lane];
+                }
+            }
+        }
+
+        // out[i] = a[i] * b[i]; FloatN has no double counterpart, so double throughput goes lane by lane
+        static void multiplyLanes(const Real *a, FloatN b, Real *out)
+        {
+            if constexpr (std::is_same_v<Real, float>)
+                (FloatN::Load(a) * b).Store(out);
+            else
+            {
+                alignas(32) float lanes[SIMDWidth];
+                b.Store(lanes);
+                for (int i = 0; i < SIMDWidth; ++i)
+                    out[i] = a[i] * lanes[i];
+            }
+        }
+
+        void traceShadowRays(Queues &q) const
+        {
+            CountRays(RayKind::Shadow, q.shadowRays.size);
+            for (int i = 0; i < q.shadowRays.size; i += SIMDWidth)
+            {
+                int n = std::min(SIMDWidth, q.shadowRays.size - i);
+                uint32_t blocked = scene.IntersectP<Features>(q.shadowRays.Packet(i, n)).Bits();
+                for (int lane = 0; lane < n; ++lane)
+                {
+                    if ((blocked >> lane) & 1)
+                        continue;
+                    uint32_t path = q.shadowRays.path[i + lane];
+                    for (int c = 0; c < 3; ++c)
+                        q.L[c][path] += q.shadowL[c][i + lane];
+                }
+            }
+        }
+
+        const Scene &scene;
+        const ProjectiveCamera &camera;
+        const SobolSampler &sampler;
+        PathSettings settings;
+        WavefrontOptions options;
+        Bounds3f sceneBounds;
+
+        // added to once per stage and batch, times in nanoseconds
+        struct Totals
+        {
+            std::atomic<int64_t> rays{0}, nodeVisits{0}, laneHits{0};
+            std::atomic<int64_t> traceNanoseconds{0}, sortNanoseconds{0};
+        };
+        mutable Totals totals;
+    };
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/simd.hpp"
+#include "core/tfrt.hpp"
+#include "core/vecmath.hpp"
+
+namespace tfrt
+{
+    /*
+     *  32-bit integer finalizer (Wellons' lowbias32): every input bit flips
+     *  each output bit with probability close to 1/2. T is uint32_t or
+     *  UInt32N, the lanes of which hash exactly like the scalar version.
+     */
+    template <typename T>
+    inline T Mix32(T x)
+    {
+        x ^= x >> 16;
+        x *= T(0x7feb352du);
+        x ^= x >> 15;
+        x *= T(0x846ca68bu);
+        x ^= x >> 16;
+        return x;
+    }
+
+    // the top 24 bits as a float in [0, 1), the same value for a uint32_t and its lane
+    inline Float UnitFloat(uint32_t bits) { return Float(bits >> 8) * 0x1p-24f; }
+    inline FloatN UnitFloat(UInt32N bits) { return ToFloat(bits >> 8) * FloatN(0x1p-24f); }
+
+    /*
+     *  Counter-based random numbers: the value for a key (pixel, sample
+     *  index, dimension) is a hash of the key and the seed. Nothing is
+     *  carried from one call to the next, so threads share no state and a
+     *  sample comes out the same whichever thread renders its pixel and
+     *  in whatever order.
+     *
+     *  The pixel x coordinate is hashed last, so the SIMD versions hash the
+     *  rest of the key once and finish SIMDWidth neighbouring pixels of a
+     *  row together.
+     */
+    class CounterRNG
+    {
+    public:
+        explicit CounterRNG(uint32_t seed = 0) : seed(seed) {}
+
+        uint32_t Seed() const { return seed; }
+
+        uint32_t Uniform32(Point2i p, uint32_t sampleIndex, uint32_t dimension) const
+        {
+            return Mix32(prefix(p.y, sampleIndex, dimension) ^ uint32_t(p.x));
+        }
+
+        // value of pixels p .. p + (SIMDWidth - 1, 0), lane i for pixel p.x + i
+        UInt32N Uniform32N(Point2i p, uint32_t sampleIndex, uint32_t dimension) const
+        {
+            alignas(32) static const uint32_t laneOffsets[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+            UInt32N x = UInt32N(uint32_t(p.x)) + UInt32N::Load(laneOffsets);
+            return Mix32(UInt32N(prefix(p.y, sampleIndex, dimension)) ^ x);
+        }
+
+        Float Uniform(Point2i p, uint32_t sampleIndex, uint32_t dimension) const
+        {
+            return UnitFloat(Uniform32(p, sampleIndex, dimension));
+        }
+
+        FloatN UniformN(Point2i p, uint32_t sampleIndex, uint32_t dimension) const
+        {
+            return UnitFloat(Uniform32N(p, sampleIndex, dimension));
+        }
+
+    private:
+        uint32_t prefix(int y, uint32_t sampleIndex, uint32_t dimension) const
+        {
+            uint32_t h = Mix32(seed + 0x9e3779b9u);
+            h = Mix32(h ^ uint32_t(y));
+            h = Mix32(h ^ sampleIndex);
+            return Mix32(h ^ dimension);
+        }
+
+        uint32_t seed;
+    };
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/simd.hpp"
+#include "core/tfrt.hpp"
+#include "core/vecmath.hpp"
+#include "sampler/rng.hpp"
+#include "sampler/sobol.hpp"
+
+namespace tfrt
+{
+    /*
+     *  Samplers hand out the sample values of dimension d of sample i of
+     *  pixel p as a pure function of (p, i, d) and the seed, so a tile can
+     *  be rendered by any thread, in any order, and still produce the same
+     *  image. Sample1D is the scalar query and Sample1DN the same query for
+     *  SIMDWidth neighbouring pixels of a row; lane i equals
+     *  Sample1D(p + (i, 0), ...) bit for bit. Dimensions 0 and 1 are the
+     *  position inside the pixel.
+     *
+     *  StartPixelSample/Get1D/Get2D walk the dimensions of one sample for
+     *  code that draws them one after the other, e.g. along a path.
+     */
+
+    // uniform random samples, the reference the low-discrepancy samplers are measured against
+    class IndependentSampler
+    {
+    public:
+        explicit IndependentSampler(int samplesPerPixel, uint32_t seed = 0)
+            : samplesPerPixel(samplesPerPixel), rng(seed) {}
+
+        int SamplesPerPixel() const { return samplesPerPixel; }
+
+        Float Sample1D(Point2i p, int sampleIndex, int dimension) const
+        {
+            return rng.Uniform(p, uint32_t(sampleIndex), uint32_t(dimension));
+        }
+
+        FloatN Sample1DN(Point2i p, int sampleIndex, int dimension) const
+        {
+            return rng.UniformN(p, uint32_t(sampleIndex), uint32_t(dimension));
+        }
+
+        void StartPixelSample(Point2i p, int index, int dim = 0)
+        {
+            pixel = p;
+            sampleIndex = index;
+            dimension = dim;
+        }
+
+        Float Get1D() { return Sample1D(pixel, sampleIndex, dimension++); }
+
+        Point2f Get2D()
+        {
+            dimension += 2;
+            return Point2f(Sample1D(pixel, sampleIndex, dimension - 2),
+                           Sample1D(pixel, sampleIndex, dimension - 1));
+        }
+
+        // offset of the sample inside its pixel
+        Point2f GetPixel2D() { return Point2f(Sample1D(pixel, sampleIndex, 0), Sample1D(pixel, sampleIndex, 1)); }
+
+    private:
+        int samplesPerPixel;
+        CounterRNG rng;
+        Point2i pixel;
+        int sampleIndex = 0, dimension = 0;
+    };
+
+    /*
+     *  The first samplesPerPixel points of the Sobol sequence in every pixel,
+     *  Owen scrambled with a seed hashed from the pixel and the dimension.
+     *  Every dimension on its own is stratified at each power-of-two prefix,
+     *  and the pixel offset (dimensions 0 and 1) is a (0, 2)-sequence, so
+     *  error falls faster than with independent samples. The scramble keeps
+     *  pixels uncorrelated.
+     *  Past NSobolDimensions the matrices repeat with fresh scrambles.
+     *  Power-of-two sample counts stratify best.
+     */
+    class SobolSampler
+    {
+    public:
+        explicit SobolSampler(int samplesPerPixel, uint32_t seed = 0)
+            : samplesPerPixel(samplesPerPixel), rng(seed) {}
+
+        int SamplesPerPixel() const { return samplesPerPixel; }
+
+        Float Sample1D(Point2i p, int sampleIndex, int dimension) const
+        {
+            uint32_t v = SobolSample32(uint32_t(sampleIndex), dimension % NSobolDimensions);
+            return UnitFloat(OwenScramble(v, rng.Uniform32(p, 0, uint32_t(dimension))));
+        }
+
+        FloatN Sample1DN(Point2i p, int sampleIndex, int dimension) const
+        {
+            uint32_t v = SobolSample32(uint32_t(sampleIndex), dimension % NSobolDimensions);
+            return UnitFloat(OwenScramble(v, rng.Uniform32N(p, 0, uint32_t(dimension))));
+        }
+
+        void StartPixelSample(Point2i p, int index, int dim = 0)
+        {
+            pixel = p;
+            sampleIndex = index;
+            dimension = dim;
+        }
+
+        Float Get1D() { return Sample1D(pixel, sampleIndex, dimension++); }
+
+        Point2f Get2D()
+        {
+            dimension += 2;
+            return Point2f(Sample1D(pixel, sampleIndex, dimension - 2),
+                           Sample1D(pixel, sampleIndex, dimension - 1));
+        }
+
+        Point2f GetPixel2D() { return Point2f(Sample1D(pixel, sampleIndex, 0), Sample1D(pixel, sampleIndex, 1)); }
+
+    private:
+        int samplesPerPixel;
+        CounterRNG rng;
+        Point2i pixel;
+        int sampleIndex = 0, dimension = 0;
+    };
+}
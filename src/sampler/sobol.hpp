@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "core/simd.hpp"
+#include "util/math.hpp"
+
+namespace tfrt
+{
+    static constexpr int NSobolDimensions = 21;
+    static constexpr int SobolMatrixSize = 32;
+
+    namespace detail
+    {
+        // primitive polynomial of degree s with middle coefficients a, and initial direction numbers
+        struct SobolDirections
+        {
+            int s;
+            uint32_t a;
+            uint32_t m[7];
+        };
+
+        // dimensions 2 .. 21 of Joe and Kuo's new-joe-kuo-6.21201
+        static constexpr SobolDirections sobolDirections[NSobolDimensions - 1] = {
+            {1, 0, {1}},
+            {2, 1, {1, 3}},
+            {3, 1, {1, 3, 1}},
+            {3, 2, {1, 1, 1}},
+            {4, 1, {1, 1, 3, 3}},
+            {4, 4, {1, 3, 5, 13}},
+            {5, 2, {1, 1, 5, 5, 17}},
+            {5, 4, {1, 1, 5, 5, 5}},
+            {5, 7, {1, 1, 7, 11, 19}},
+            {5, 11, {1, 1, 5, 1, 1}},
+            {5, 13, {1, 1, 1, 3, 11}},
+            {5, 14, {1, 3, 5, 5, 31}},
+            {6, 1, {1, 3, 3, 9, 7, 49}},
+            {6, 13, {1, 1, 1, 15, 21, 21}},
+            {6, 16, {1, 3, 1, 13, 27, 49}},
+            {6, 19, {1, 1, 1, 15, 7, 5}},
+            {6, 22, {1, 3, 1, 15, 13, 25}},
+            {6, 25, {1, 1, 5, 5, 19, 61}},
+            {7, 1, {1, 3, 7, 11, 23, 15, 103}},
+            {7, 4, {1, 3, 7, 13, 13, 15, 69}}};
+
+        // column i of each matrix is the direction number for bit i of the index, first bit on top
+        constexpr std::array<uint32_t, NSobolDimensions * SobolMatrixSize> ComputeSobolMatrices()
+        {
+            std::array<uint32_t, NSobolDimensions * SobolMatrixSize> matrices{};
+            // the first dimension is the van der Corput sequence
+            for (int i = 0; i < SobolMatrixSize; ++i)
+                matrices[i] = 1u << (31 - i);
+
+            for (int dim = 1; dim < NSobolDimensions; ++dim)
+            {
+                const SobolDirections &dir = sobolDirections[dim - 1];
+                uint32_t *v = &matrices[dim * SobolMatrixSize];
+                for (int i = 0; i < dir.s; ++i)
+                    v[i] = dir.m[i] << (31 - i);
+                for (int i = dir.s; i < SobolMatrixSize; ++i)
+                {
+                    v[i] = v[i - dir.s] ^ (v[i - dir.s] >> dir.s);
+                    for (int k = 1; k < dir.s; ++k)
+                        if ((dir.a >> (dir.s - 1 - k)) & 1)
+                            v[i] ^= v[i - k];
+                }
+            }
+            return matrices;
+        }
+    }
+
+    // generator matrices, built at compile time
+    inline constexpr std::array<uint32_t, NSobolDimensions * SobolMatrixSize> SobolMatrices32 =
+        detail::ComputeSobolMatrices();
+
+    // dimension of the index-th Sobol point as a 0.32 fixed-point value
+    inline uint32_t SobolSample32(uint32_t index, int dimension)
+    {
+        DCHECK(dimension >= 0 && dimension < NSobolDimensions);
+        uint32_t v = 0;
+        for (int i = dimension * SobolMatrixSize; index != 0; index >>= 1, ++i)
+            if (index & 1)
+                v ^= SobolMatrices32[i];
+        return v;
+    }
+
+    /*
+     *  Owen scrambling of a 0.32 fixed-point value: a random flip of every
+     *  digit that depends only on the digits above it, so nets stay nets.
+     *  Hash-based (Laine and Karras, in the bit-reversed form of
+     *  Burley 2020): the multiplies carry only towards the reversed high
+     *  bits, i.e. from higher to lower digits of v. Seed is uint32_t or
+     *  UInt32N, one scramble per lane.
+     */
+    template <typename T>
+    inline T OwenScramble(uint32_t v, T seed)
+    {
+        T x(ReverseBits32(v));
+        x ^= x * T(0x3d20adeau);
+        x += seed;
+        x *= (seed >> 16) | T(1u);
+        x ^= x * T(0x05526c56u);
+        x ^= x * T(0x53a22864u);
+        return ReverseBits32(x);
+    }
+}
@@ -0,0 +1,1146 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/vecmath.hpp"
+#include "scene/interaction.hpp"
+#include "scene/shape.hpp"
+#include "util/math.hpp"
+#include "util/memory.hpp"
+#include "util/parallel.hpp"
+#include "util/stats.hpp"
+
+namespace tfrt
+{
+    struct BVHPrimitive
+    {
+        BVHPrimitive() = default;
+        BVHPrimitive(uint32_t primitiveIndex, const Bounds3f &bounds)
+            : primitiveIndex(primitiveIndex), bounds(bounds) {}
+
+        uint32_t primitiveIndex = 0;
+        Bounds3f bounds;
+
+        Point3f Centroid() const { return bounds.Centroid(); }
+    };
+
+    // Nodes are stored depth-first: an interior node's first child directly
+    // follows it, so only the offset of the second child is kept.
+    struct alignas(32) LinearBVHNode
+    {
+        Bounds3f bounds;
+        union
+        {
+            int primitivesOffset;  // leaf
+            int secondChildOffset; // interior
+        };
+        uint16_t nPrimitives; // 0 -> interior node
+        uint8_t axis;         // interior node split axis
+    };
+
+    static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should fit half a cache line");
+
+    enum class BVHBuildMethod
+    {
+        SAH,  // binned surface area heuristic, best trees, serial
+        LBVH, // parallel, split on Morton code bits all the way up
+        HLBVH // LBVH treelets under top levels chosen with the SAH
+    };
+
+    inline std::optional<BVHBuildMethod> ParseBVHBuildMethod(const std::string &name)
+    {
+        if (name == "sah")
+            return BVHBuildMethod::SAH;
+        if (name == "lbvh")
+            return BVHBuildMethod::LBVH;
+        if (name == "hlbvh")
+            return BVHBuildMethod::HLBVH;
+        return {};
+    }
+
+    // the name ParseBVHBuildMethod accepts for method
+    inline const char *BVHBuildMethodName(BVHBuildMethod method)
+    {
+        switch (method)
+        {
+        case BVHBuildMethod::SAH:
+            return "sah";
+        case BVHBuildMethod::LBVH:
+            return "lbvh";
+        case BVHBuildMethod::HLBVH:
+            return "hlbvh";
+        }
+        return "unknown";
+    }
+
+    // Morton code of a primitive centroid, radix sorted to build an LBVH
+    struct MortonPrimitive
+    {
+        uint32_t primitiveIndex;
+        uint32_t mortonCode;
+    };
+
+    /*
+     *  Bounding volume hierarchy over an abstract set of primitives. The BVH
+     *  only knows primitive bounds; intersecting the primitives in a leaf is
+     *  left to the caller. All build methods produce the same depth-first
+     *  node layout, so traversal does not depend on the builder.
+     */
+    class BVH
+    {
+    public:
+        static constexpr int MaxPrimsInNode = 255;
+        // Traversal stacks hold this many nodes, so no path from the root
+        // may pass more interior nodes. The builders switch to median splits
+        // before a subtree could grow deeper.
+        static constexpr int MaxDepth = 64;
+
+        BVH() = default;
+        // Callers that test leaf primitives in SIMD groups pass the group size
+        // as primsPerTest, so the SAH prices a leaf by the number of group
+        // tests rather than primitives and fills the groups.
+        explicit BVH(const std::vector<Bounds3f> &primBounds, int maxPrimsInNode = 4,
+                     BVHBuildMethod method = BVHBuildMethod::SAH, int primsPerTest = 1)
+            : maxPrimsInNode(std::min(MaxPrimsInNode, maxPrimsInNode)), primsPerTest(primsPerTest)
+        {
+            if (primBounds.empty())
+                return;
+
+            if (method != BVHBuildMethod::SAH)
+            {
+                buildHLBVH(primBounds, method == BVHBuildMethod::HLBVH);
+                return;
+            }
+
+            std::vector<BVHPrimitive> bvhPrimitives(primBounds.size());
+            for (size_t i = 0; i < primBounds.size(); ++i)
+                bvhPrimitives[i] = BVHPrimitive(uint32_t(i), primBounds[i]);
+
+            nodes.reserve(2 * primBounds.size() - 1);
+            buildRecursive(bvhPrimitives, 0, int(bvhPrimitives.size()), MaxDepth);
+            nodes.shrink_to_fit();
+
+            // leaves reference ranges of the partitioned primitive array
+            primIndices.resize(bvhPrimitives.size());
+            for (size_t i = 0; i < bvhPrimitives.size(); ++i)
+                primIndices[i] = bvhPrimitives[i].primitiveIndex;
+        }
+
+        // a BVH over nodes built earlier, e.g. borrowed from a cache file; leaves keep their ranges
+        BVH(Buffer<LinearBVHNode> nodes, Buffer<Bounds3f> endBounds, int maxPrimsInNode, int primsPerTest)
+            : maxPrimsInNode(maxPrimsInNode), primsPerTest(primsPerTest), nodes(std::move(nodes)),
+              endBounds(std::move(endBounds))
+        {
+            DCHECK(this->endBounds.empty() || this->endBounds.size() == this->nodes.size());
+        }
+
+        // bounds over the whole shutter interval for moving BVHs
+        Bounds3f Bounds() const
+        {
+            if (nodes.empty())
+                return Bounds3f();
+            return endBounds.empty() ? nodes[0].bounds : Union(nodes[0].bounds, endBounds[0]);
+        }
+
+        const Buffer<LinearBVHNode> &Nodes() const { return nodes; }
+
+        // node bounds at shutter close, empty unless the BVH has motion
+        const Buffer<Bounds3f> &EndBounds() const { return endBounds; }
+        bool HasMotion() const { return !endBounds.empty(); }
+
+        // leaf order -> index into the primitive array the BVH was built from
+        const std::vector<uint32_t> &PrimitiveIndices() const { return primIndices; }
+
+        // the same, moved out for a caller that stores its primitives in leaf order and needs no copy kept
+        std::vector<uint32_t> TakePrimitiveIndices() { return std::move(primIndices); }
+
+        // Re-points every leaf at storage owned by the caller, e.g. primitives
+        // packed into SIMD groups. f(primitivesOffset, nPrimitives) returns the
+        // new pair; the leaf ranges no longer index PrimitiveIndices() after.
+        template <typename F>
+        void RemapLeaves(F &&f)
+        {
+            for (LinearBVHNode &node : nodes)
+            {
+                if (node.nPrimitives == 0)
+                    continue;
+                std::pair<int, int> leaf = f(node.primitivesOffset, int(node.nPrimitives));
+                DCHECK(leaf.second > 0 && leaf.second <= 0xffff);
+                node.primitivesOffset = leaf.first;
+                node.nPrimitives = uint16_t(leaf.second);
+            }
+        }
+
+        /*
+         *  Recomputes every node's bounds bottom-up with the topology left as
+         *  is, e.g. after vertices moved. leafBounds(primitivesOffset,
+         *  nPrimitives) returns the new bounds of a leaf. Subtrees below the
+         *  top levels are contiguous in the depth-first layout and are refit
+         *  in parallel.
+         */
+        template <typename LeafFn>
+        void Refit(LeafFn &&leafBounds)
+        {
+            refit(leafBounds, [this](int i) -> Bounds3f & { return nodes[i].bounds; });
+        }
+
+        /*
+         *  Motion blur: Refit gives the node bounds at shutter open, RefitEnd
+         *  the bounds at shutter close. Traversal interpolates the two at
+         *  ray.time in [0, 1], which bounds primitives whose vertices move
+         *  linearly over the interval.
+         */
+        template <typename LeafFn>
+        void RefitEnd(LeafFn &&leafBounds)
+        {
+            endBounds.resize(nodes.size());
+            refit(leafBounds, [this](int i) -> Bounds3f & { return endBounds[i]; });
+        }
+
+        /*
+         *  Expected cost of a random ray relative to one leaf test, with the
+         *  constants of the SAH build. Refits let it grow as primitives move
+         *  apart; callers compare it to the cost right after a build to
+         *  decide when to rebuild instead.
+         */
+        Float SAHCost() const
+        {
+            if (nodes.empty())
+                return 0;
+            Float cost = 0;
+            for (const LinearBVHNode &node : nodes)
+                cost += node.bounds.SurfaceArea() *
+                        (node.nPrimitives > 0 ? testCost(node.nPrimitives) : Float(0.5));
+            return cost / nodes[0].bounds.SurfaceArea();
+        }
+
+        /*
+         *  Closest-hit traversal. Children are visited front to back along the
+         *  split axis, and intersectLeaf(primitivesOffset, nPrimitives, tMax)
+         *  is expected to shrink tMax and return true when it finds a hit.
+         */
+        template <typename LeafFn>
+        bool Intersect(const Ray &ray, LeafFn &&intersectLeaf) const
+        {
+            return HasMotion() ? intersect<true>(ray, intersectLeaf) : intersect<false>(ray, intersectLeaf);
+        }
+
+        /*
+         *  Packet traversal: a node is entered when any active lane hits its
+         *  box. Children are ordered by the direction of the first lane, which
+         *  is right for every lane of a coherent packet.
+         *  intersectLeaf(primitivesOffset, nPrimitives, tMax, active) tests
+         *  the lanes in active, those whose ray overlaps the leaf's box,
+         *  shrinks tMax in the lanes it hits and returns their mask.
+         */
+        template <typename LeafFn>
+        MaskN Intersect(const RayPacket &rays, LeafFn &&intersectLeaf) const
+        {
+            return HasMotion() ? intersect<true>(rays, intersectLeaf) : intersect<false>(rays, intersectLeaf);
+        }
+
+        /*
+         *  Any-hit traversal for shadow rays: returns true as soon as
+         *  occludedLeaf(primitivesOffset, nPrimitives) reports a hit closer
+         *  than ray.tMax. Since any hit will do, children are not ordered.
+         */
+        template <typename LeafFn>
+        bool IntersectP(const Ray &ray, LeafFn &&occludedLeaf) const
+        {
+            return HasMotion() ? intersectP<true>(ray, occludedLeaf) : intersectP<false>(ray, occludedLeaf);
+        }
+
+        /*
+         *  Any-hit traversal of a packet. occludedLeaf(primitivesOffset,
+         *  nPrimitives, active) tests the lanes in active and returns those
+         *  that are blocked. Blocked lanes drop out of the box tests and the
+         *  traversal ends once every lane is blocked.
+         */
+        template <typename LeafFn>
+        MaskN IntersectP(const RayPacket &rays, LeafFn &&occludedLeaf) const
+        {
+            return HasMotion() ? intersectP<true>(rays, occludedLeaf) : intersectP<false>(rays, occludedLeaf);
+        }
+
+    private:
+        /*
+         *  The traversals behind the public ones, instantiated for static
+         *  and for moving BVHs so the choice is made once per ray or packet
+         *  rather than at every node.
+         */
+        template <bool Moving, typename LeafFn>
+        bool intersect(const Ray &ray, LeafFn &&intersectLeaf) const
+        {
+            if (nodes.empty())
+                return false;
+
+            Float tMax = ray.tMax;
+            TraversalRay traversalRay(ray);
+            const int *dirIsNeg = traversalRay.dirIsNeg;
+
+            bool hit = false;
+            RayTraversalStats stats;
+            int toVisitOffset = 0, currentNodeIndex = 0;
+            int nodesToVisit[MaxDepth];
+            while (true)
+            {
+                const LinearBVHNode *node = &nodes[currentNodeIndex];
+                stats.VisitNode();
+                if (nodeBounds<Moving>(currentNodeIndex, ray.time).IntersectP(traversalRay, tMax))
+                {
+                    if (node->nPrimitives > 0)
+                    {
+                        stats.TestPrimitives(node->nPrimitives);
+                        if (intersectLeaf(node->primitivesOffset, int(node->nPrimitives), tMax))
+                            hit = true;
+                        if (toVisitOffset == 0)
+                            break;
+                        currentNodeIndex = nodesToVisit[--toVisitOffset];
+                    }
+                    else
+                    {
+                        // put the far child on the stack, visit the near child next
+                        DCHECK(toVisitOffset < MaxDepth);
+                        if (dirIsNeg[node->axis])
+                        {
+                            nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+                            currentNodeIndex = node->secondChildOffset;
+                        }
+                        else
+                        {
+                            nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                            currentNodeIndex = currentNodeIndex + 1;
+                        }
+                    }
+                }
+                else
+                {
+                    if (toVisitOffset == 0)
+                        break;
+                    currentNodeIndex = nodesToVisit[--toVisitOffset];
+                }
+            }
+            return hit;
+        }
+
+        template <bool Moving, typename LeafFn>
+        MaskN intersect(const RayPacket &rays, LeafFn &&intersectLeaf) const
+        {
+            MaskN hit(false);
+            if (nodes.empty())
+                return hit;
+
+            FloatN tMax = rays.tMax;
+            Vector3fN invDir(1 / rays.d.x, 1 / rays.d.y, 1 / rays.d.z);
+            int dirIsNeg[3] = {int(rays.d.x[0] < 0), int(rays.d.y[0] < 0), int(rays.d.z[0] < 0)};
+
+            // counted locally, the thread's statistics are touched once per packet
+            int64_t nodeVisits = 0, laneHits = 0, primitiveTests = 0;
+            int toVisitOffset = 0, currentNodeIndex = 0;
+            int nodesToVisit[MaxDepth];
+            while (true)
+            {
+                const LinearBVHNode *node = &nodes[currentNodeIndex];
+                ++nodeVisits;
+                MaskN overlap;
+                if constexpr (!Moving)
+                    overlap = tfrt::IntersectP(node->bounds, rays.o, rays.tMin, tMax, invDir);
+                else
+                {
+                    // every lane interpolates the box to its own time
+                    const Bounds3f &b0 = node->bounds, &b1 = endBounds[currentNodeIndex];
+                    FloatN t0 = FloatN(1.f) - rays.time;
+                    Point3fN pMin = Broadcast(b0.pMin) * t0 + Broadcast(b1.pMin) * rays.time;
+                    Point3fN pMax = Broadcast(b0.pMax) * t0 + Broadcast(b1.pMax) * rays.time;
+                    overlap = tfrt::IntersectP(pMin, pMax, rays.o, rays.tMin, tMax, invDir);
+                }
+                laneHits += PopCount(overlap.Bits());
+                if (overlap.Any())
+                {
+                    if (node->nPrimitives > 0)
+                    {
+                        primitiveTests += node->nPrimitives * PopCount(overlap.Bits());
+                        hit |= intersectLeaf(node->primitivesOffset, int(node->nPrimitives), tMax, overlap);
+                        if (toVisitOffset == 0)
+                            break;
+                        currentNodeIndex = nodesToVisit[--toVisitOffset];
+                    }
+                    else
+                    {
+                        DCHECK(toVisitOffset < MaxDepth);
+                        if (dirIsNeg[node->axis])
+                        {
+                            nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+                            currentNodeIndex = node->secondChildOffset;
+                        }
+                        else
+                        {
+                            nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                            currentNodeIndex = currentNodeIndex + 1;
+                        }
+                    }
+                }
+                else
+                {
+                    if (toVisitOffset == 0)
+                        break;
+                    currentNodeIndex = nodesToVisit[--toVisitOffset];
+                }
+            }
+            CountPacketTraversal(nodeVisits, laneHits, primitiveTests);
+            return hit;
+        }
+
+        template <bool Moving, typename LeafFn>
+        bool intersectP(const Ray &ray, LeafFn &&occludedLeaf) const
+        {
+            if (nodes.empty())
+                return false;
+
+            TraversalRay traversalRay(ray);
+            RayTraversalStats stats;
+            int toVisitOffset = 0, currentNodeIndex = 0;
+            int nodesToVisit[MaxDepth];
+            while (true)
+            {
+                const LinearBVHNode *node = &nodes[currentNodeIndex];
+                stats.VisitNode();
+                if (nodeBounds<Moving>(currentNodeIndex, ray.time).IntersectP(traversalRay, ray.tMax))
+                {
+                    if (node->nPrimitives > 0)
+                    {
+                        stats.TestPrimitives(node->nPrimitives);
+                        if (occludedLeaf(node->primitivesOffset, int(node->nPrimitives)))
+                            return true;
+                    }
+                    else
+                    {
+                        DCHECK(toVisitOffset < MaxDepth);
+                        nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                        currentNodeIndex = currentNodeIndex + 1;
+                        continue;
+                    }
+                }
+                if (toVisitOffset == 0)
+                    break;
+                currentNodeIndex = nodesToVisit[--toVisitOffset];
+            }
+            return false;
+        }
+
+        template <bool Moving, typename LeafFn>
+        MaskN intersectP(const RayPacket &rays, LeafFn &&occludedLeaf) const
+        {
+            MaskN occluded(false);
+            if (nodes.empty())
+                return occluded;
+
+            // padding lanes have an empty [tMin, tMax) and never count as blocked
+            MaskN live = rays.tMax > rays.tMin;
+            FloatN tMax = rays.tMax;
+            Vector3fN invDir(1 / rays.d.x, 1 / rays.d.y, 1 / rays.d.z);
+
+            int64_t nodeVisits = 0, laneHits = 0, primitiveTests = 0;
+            int toVisitOffset = 0, currentNodeIndex = 0;
+            int nodesToVisit[MaxDepth];
+            while (true)
+            {
+                const LinearBVHNode *node = &nodes[currentNodeIndex];
+                ++nodeVisits;
+                MaskN overlap;
+                if constexpr (!Moving)
+                    overlap = tfrt::IntersectP(node->bounds, rays.o, rays.tMin, tMax, invDir);
+                else
+                {
+                    const Bounds3f &b0 = node->bounds, &b1 = endBounds[currentNodeIndex];
+                    FloatN t0 = FloatN(1.f) - rays.time;
+                    Point3fN pMin = Broadcast(b0.pMin) * t0 + Broadcast(b1.pMin) * rays.time;
+                    Point3fN pMax = Broadcast(b0.pMax) * t0 + Broadcast(b1.pMax) * rays.time;
+                    overlap = tfrt::IntersectP(pMin, pMax, rays.o, rays.tMin, tMax, invDir);
+                }
+                laneHits += PopCount(overlap.Bits());
+                if (overlap.Any())
+                {
+                    if (node->nPrimitives > 0)
+                    {
+                        MaskN testing = AndNot(overlap, occluded);
+                        primitiveTests += node->nPrimitives * PopCount(testing.Bits());
+                        MaskN blocked = occludedLeaf(node->primitivesOffset, int(node->nPrimitives), testing);
+                        if (blocked.Any())
+                        {
+                            occluded |= blocked;
+                            if (AndNot(live, occluded).None())
+                            {
+                                CountPacketTraversal(nodeVisits, laneHits, primitiveTests);
+                                return occluded;
+                            }
+                            tMax = Select(occluded, FloatN(-Infinity), tMax);
+                        }
+                    }
+                    else
+                    {
+                        DCHECK(toVisitOffset < MaxDepth);
+                        nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                        currentNodeIndex = currentNodeIndex + 1;
+                        continue;
+                    }
+                }
+                if (toVisitOffset == 0)
+                    break;
+                currentNodeIndex = nodesToVisit[--toVisitOffset];
+            }
+            CountPacketTraversal(nodeVisits, laneHits, primitiveTests);
+            return occluded;
+        }
+
+        // the bounds of a node, interpolated to time only when Moving
+        template <bool Moving>
+        Bounds3f nodeBounds(int nodeIndex, Float time) const
+        {
+            if constexpr (Moving)
+                return boundsAt(nodeIndex, time);
+            else
+                return nodes[nodeIndex].bounds;
+        }
+
+        // levels of median splits it takes to bring n primitives down to one each
+        static int medianDepth(int64_t n)
+        {
+            int depth = 0;
+            while ((int64_t(1) << depth) < n)
+                ++depth;
+            return depth;
+        }
+
+        /*
+         *  depthLeft is how many interior levels the subtree may still use.
+         *  The SAH may split off a single primitive per level, so it only
+         *  gets to choose while median splits below the children would
+         *  still fit.
+         */
+        int buildRecursive(std::vector<BVHPrimitive> &bvhPrimitives, int start, int end, int depthLeft)
+        {
+            int nodeIndex = int(nodes.size());
+            nodes.emplace_back();
+
+            Bounds3f bounds;
+            for (int i = start; i < end; ++i)
+                bounds = Union(bounds, bvhPrimitives[i].bounds);
+
+            int nPrimitives = end - start;
+            if (bounds.SurfaceArea() == 0 || nPrimitives == 1)
+            {
+                initLeaf(nodeIndex, start, nPrimitives, bounds);
+                return nodeIndex;
+            }
+
+            Bounds3f centroidBounds;
+            for (int i = start; i < end; ++i)
+                centroidBounds = Union(centroidBounds, bvhPrimitives[i].Centroid());
+            int dim = centroidBounds.MaxDimension();
+
+            auto first = bvhPrimitives.begin() + start;
+            auto last = bvhPrimitives.begin() + end;
+            int mid = (start + end) / 2;
+
+            if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim])
+            {
+                // all centroids coincide, no split can separate them
+                if (nPrimitives <= maxPrimsInNode)
+                {
+                    initLeaf(nodeIndex, start, nPrimitives, bounds);
+                    return nodeIndex;
+                }
+            }
+            else if (nPrimitives <= 2 || 1 + medianDepth(nPrimitives) > depthLeft)
+            {
+                std::nth_element(first, bvhPrimitives.begin() + mid, last,
+                                 [dim](const BVHPrimitive &a, const BVHPrimitive &b) {
+                                     return a.Centroid()[dim] < b.Centroid()[dim];
+                                 });
+            }
+            else
+            {
+                // bin centroids along dim and evaluate the SAH at bucket boundaries
+                constexpr int nBuckets = 12;
+                struct BVHSplitBucket
+                {
+                    int count = 0;
+                    Bounds3f bounds;
+                };
+                BVHSplitBucket buckets[nBuckets];
+
+                auto bucketIndex = [&](const BVHPrimitive &prim) {
+                    int b = int(nBuckets * centroidBounds.Offset(prim.Centroid())[dim]);
+                    return std::min(b, nBuckets - 1);
+                };
+
+                for (int i = start; i < end; ++i)
+                {
+                    int b = bucketIndex(bvhPrimitives[i]);
+                    buckets[b].count++;
+                    buckets[b].bounds = Union(buckets[b].bounds, bvhPrimitives[i].bounds);
+                }
+
+                // costs[i] is the cost of splitting after bucket i
+                constexpr int nSplits = nBuckets - 1;
+                Float costs[nSplits] = {};
+
+                int countBelow = 0;
+                Bounds3f boundBelow;
+                for (int i = 0; i < nSplits; ++i)
+                {
+                    boundBelow = Union(boundBelow, buckets[i].bounds);
+                    countBelow += buckets[i].count;
+                    costs[i] += testCost(countBelow) * boundBelow.SurfaceArea();
+                }
+
+                int countAbove = 0;
+                Bounds3f boundAbove;
+                for (int i = nSplits; i >= 1; --i)
+                {
+                    boundAbove = Union(boundAbove, buckets[i].bounds);
+                    countAbove += buckets[i].count;
+                    costs[i - 1] += testCost(countAbove) * boundAbove.SurfaceArea();
+                }
+
+                int minCostSplitBucket = -1;
+                Float minCost = Infinity;
+                for (int i = 0; i < nSplits; ++i)
+                {
+                    if (costs[i] < minCost)
+                    {
+                        minCost = costs[i];
+                        minCostSplitBucket = i;
+                    }
+                }
+
+                // relative cost of traversing a node is 1/2 of a primitive test
+                Float leafCost = testCost(nPrimitives);
+                minCost = Float(0.5) + minCost / bounds.SurfaceArea();
+
+                if (nPrimitives > maxPrimsInNode || minCost < leafCost)
+                {
+                    auto midIter = std::partition(first, last, [&](const BVHPrimitive &prim) {
+                        return bucketIndex(prim) <= minCostSplitBucket;
+                    });
+                    mid = int(midIter - bvhPrimitives.begin());
+                }
+                else
+                {
+                    initLeaf(nodeIndex, start, nPrimitives, bounds);
+                    return nodeIndex;
+                }
+            }
+
+            // the first child is emitted right after its parent
+            buildRecursive(bvhPrimitives, start, mid, depthLeft - 1);
+            int secondChild = buildRecursive(bvhPrimitives, mid, end, depthLeft - 1);
+
+            LinearBVHNode &node = nodes[nodeIndex];
+            node.bounds = bounds;
+            node.secondChildOffset = secondChild;
+            node.nPrimitives = 0;
+            node.axis = uint8_t(dim);
+            return nodeIndex;
+        }
+
+        /*
+         *  HLBVH (Pantaleoni and Luebke 2010, as in pbrt-v3). Primitives are
+         *  sorted by the Morton code of their centroid. Runs sharing the top
+         *  12 code bits form treelets that are split on the remaining bits
+         *  independently and in parallel. The treelet roots are then joined
+         *  either with the SAH or by continuing to split on code bits.
+         */
+        void buildHLBVH(const std::vector<Bounds3f> &primBounds, bool sahTopLevels)
+        {
+            int nPrimitives = int(primBounds.size());
+            constexpr int chunkSize = 16384;
+            int nChunks = (nPrimitives + chunkSize - 1) / chunkSize;
+            auto chunkRange = [&](int64_t chunk) {
+                int start = int(chunk) * chunkSize;
+                return std::make_pair(start, std::min(start + chunkSize, nPrimitives));
+            };
+
+            std::vector<Bounds3f> chunkBounds(nChunks);
+            ParallelFor(0, nChunks, [&](int64_t chunk) {
+                std::pair<int, int> range = chunkRange(chunk);
+                for (int i = range.first; i < range.second; ++i)
+                    chunkBounds[chunk] = Union(chunkBounds[chunk], primBounds[i].Centroid());
+            });
+            Bounds3f centroidBounds;
+            for (const Bounds3f &b : chunkBounds)
+                centroidBounds = Union(centroidBounds, b);
+
+            // 10 bits per axis
+            constexpr int mortonBits = 10;
+            constexpr Float mortonScale = 1 << mortonBits;
+            std::vector<MortonPrimitive> mortonPrims(nPrimitives);
+            ParallelFor(0, nChunks, [&](int64_t chunk) {
+                std::pair<int, int> range = chunkRange(chunk);
+                for (int i = range.first; i < range.second; ++i)
+                {
+                    Vector3f offset = centroidBounds.Offset(primBounds[i].Centroid()) * mortonScale;
+                    mortonPrims[i] = {uint32_t(i), EncodeMorton3(offset.x, offset.y, offset.z)};
+                }
+            });
+            RadixSort(&mortonPrims);
+
+            primIndices.resize(nPrimitives);
+            for (int i = 0; i < nPrimitives; ++i)
+                primIndices[i] = mortonPrims[i].primitiveIndex;
+
+            // treelets are runs of equal top bits
+            constexpr int treeletBits = 12;
+            constexpr uint32_t treeletMask = ((1u << treeletBits) - 1) << (3 * mortonBits - treeletBits);
+            struct Treelet
+            {
+                int start, nPrimitives;
+                uint32_t code;
+                std::vector<LinearBVHNode> nodes;
+                int base = 0; // index of the root in the final node array
+            };
+            std::vector<Treelet> treelets;
+            for (int start = 0, end = 1; end <= nPrimitives; ++end)
+            {
+                if (end == nPrimitives ||
+                    (mortonPrims[start].mortonCode & treeletMask) != (mortonPrims[end].mortonCode & treeletMask))
+                {
+                    treelets.push_back(Treelet{start, end - start, mortonPrims[start].mortonCode & treeletMask, {}});
+                    start = end;
+                }
+            }
+
+            ParallelFor(0, int64_t(treelets.size()), [&](int64_t i) {
+                Treelet &tr = treelets[i];
+                tr.nodes.reserve(2 * tr.nPrimitives - 1);
+                emitLBVH(tr.nodes, primBounds, mortonPrims, tr.start, tr.nPrimitives,
+                         3 * mortonBits - treeletBits - 1);
+            });
+
+            // top levels are emitted in place, treelet nodes are copied behind them
+            size_t totalNodes = treelets.size() - 1;
+            for (const Treelet &tr : treelets)
+                totalNodes += tr.nodes.size();
+            nodes.reserve(totalNodes);
+            std::vector<int> order(treelets.size());
+            int maxTreeletPrims = 0;
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                order[i] = int(i);
+                maxTreeletPrims = std::max(maxTreeletPrims, treelets[i].nPrimitives);
+            }
+            // a treelet splits once per remaining code bit, then in the middle
+            int treeletDepth = 3 * mortonBits - treeletBits + medianDepth(maxTreeletPrims);
+            buildUpper(treelets, order, 0, int(order.size()), sahTopLevels,
+                       3 * mortonBits - 1, 3 * mortonBits - treeletBits, MaxDepth - treeletDepth);
+
+            ParallelFor(0, int64_t(treelets.size()), [&](int64_t i) {
+                const Treelet &tr = treelets[i];
+                for (size_t j = 0; j < tr.nodes.size(); ++j)
+                {
+                    LinearBVHNode node = tr.nodes[j];
+                    if (node.nPrimitives == 0)
+                        node.secondChildOffset += tr.base;
+                    nodes[tr.base + j] = node;
+                }
+            });
+        }
+
+        // LBVH below one treelet, split where the Morton bit bitIndex changes
+        int emitLBVH(std::vector<LinearBVHNode> &out, const std::vector<Bounds3f> &primBounds,
+                     const std::vector<MortonPrimitive> &mortonPrims, int start, int nPrimitives,
+                     int bitIndex) const
+        {
+            // skip bits that all primitives of the range share
+            while (bitIndex >= 0 && ((mortonPrims[start].mortonCode ^
+                                      mortonPrims[start + nPrimitives - 1].mortonCode) &
+                                     (1u << bitIndex)) == 0)
+                --bitIndex;
+
+            int nodeIndex = int(out.size());
+            out.emplace_back();
+            if (nPrimitives <= maxPrimsInNode)
+            {
+                Bounds3f bounds;
+                for (int i = start; i < start + nPrimitives; ++i)
+                    bounds = Union(bounds, primBounds[mortonPrims[i].primitiveIndex]);
+                LinearBVHNode &node = out[nodeIndex];
+                node.bounds = bounds;
+                node.primitivesOffset = start;
+                node.nPrimitives = uint16_t(nPrimitives);
+                node.axis = 0;
+                return nodeIndex;
+            }
+
+            // equal codes all the way down are split in the middle
+            int split = nPrimitives / 2;
+            if (bitIndex >= 0)
+            {
+                uint32_t mask = 1u << bitIndex;
+                auto first = mortonPrims.begin() + start;
+                split = int(std::partition_point(first, first + nPrimitives,
+                                                 [mask](const MortonPrimitive &p) {
+                                                     return (p.mortonCode & mask) == 0;
+                                                 }) - first);
+            }
+
+            emitLBVH(out, primBounds, mortonPrims, start, split, bitIndex - 1);
+            int secondChild = emitLBVH(out, primBounds, mortonPrims, start + split,
+                                       nPrimitives - split, bitIndex - 1);
+
+            LinearBVHNode &node = out[nodeIndex];
+            node.bounds = Union(out[nodeIndex + 1].bounds, out[secondChild].bounds);
+            node.secondChildOffset = secondChild;
+            node.nPrimitives = 0;
+            node.axis = uint8_t(bitIndex >= 0 ? bitIndex % 3 : 0);
+            return nodeIndex;
+        }
+
+        // joins treelets order[start, end) into the final node array within depthLeft levels
+        template <typename Treelet>
+        int buildUpper(std::vector<Treelet> &treelets, std::vector<int> &order, int start, int end,
+                       bool sah, int bitIndex, int lowestBit, int depthLeft)
+        {
+            if (end - start == 1)
+            {
+                Treelet &tr = treelets[order[start]];
+                tr.base = int(nodes.size());
+                nodes.resize(nodes.size() + tr.nodes.size());
+                return tr.base;
+            }
+
+            int nodeIndex = int(nodes.size());
+            nodes.emplace_back();
+
+            auto rootBounds = [&](int i) -> const Bounds3f & { return treelets[i].nodes[0].bounds; };
+            Bounds3f bounds, centroidBounds;
+            for (int i = start; i < end; ++i)
+            {
+                bounds = Union(bounds, rootBounds(order[i]));
+                centroidBounds = Union(centroidBounds, rootBounds(order[i]).Centroid());
+            }
+
+            int dim = centroidBounds.MaxDimension();
+            int mid = start + (end - start) / 2;
+            if (sah && centroidBounds.pMax[dim] > centroidBounds.pMin[dim] &&
+                1 + medianDepth(end - start) <= depthLeft)
+            {
+                // the same binned SAH as buildRecursive, but the top levels never form leaves
+                constexpr int nBuckets = 12;
+                int counts[nBuckets] = {};
+                Bounds3f bucketBounds[nBuckets];
+                auto bucketIndex = [&](int i) {
+                    int b = int(nBuckets * centroidBounds.Offset(rootBounds(i).Centroid())[dim]);
+                    return std::min(b, nBuckets - 1);
+                };
+                for (int i = start; i < end; ++i)
+                {
+                    int b = bucketIndex(order[i]);
+                    counts[b]++;
+                    bucketBounds[b] = Union(bucketBounds[b], rootBounds(order[i]));
+                }
+
+                Float costs[nBuckets - 1] = {};
+                int countBelow = 0, countAbove = 0;
+                Bounds3f boundBelow, boundAbove;
+                for (int i = 0; i < nBuckets - 1; ++i)
+                {
+                    boundBelow = Union(boundBelow, bucketBounds[i]);
+                    countBelow += counts[i];
+                    costs[i] += countBelow * boundBelow.SurfaceArea();
+                }
+                for (int i = nBuckets - 1; i >= 1; --i)
+                {
+                    boundAbove = Union(boundAbove, bucketBounds[i]);
+                    countAbove += counts[i];
+                    costs[i - 1] += countAbove * boundAbove.SurfaceArea();
+                }
+                int minCostSplitBucket = int(std::min_element(costs, costs + nBuckets - 1) - costs);
+
+                auto first = order.begin() + start, last = order.begin() + end;
+                int split = int(std::partition(first, last, [&](int i) {
+                                    return bucketIndex(i) <= minCostSplitBucket;
+                                }) - order.begin());
+                if (split != start && split != end)
+                    mid = split;
+            }
+            else if (!sah)
+            {
+                // treelets are in Morton order, split where the next code bit changes
+                while (bitIndex >= lowestBit &&
+                       ((treelets[order[start]].code ^ treelets[order[end - 1]].code) & (1u << bitIndex)) == 0)
+                    --bitIndex;
+                if (bitIndex >= lowestBit)
+                {
+                    uint32_t mask = 1u << bitIndex;
+                    mid = int(std::partition_point(order.begin() + start, order.begin() + end,
+                                                   [&](int i) { return (treelets[i].code & mask) == 0; }) -
+                              order.begin());
+                    dim = bitIndex % 3;
+                }
+            }
+
+            buildUpper(treelets, order, start, mid, sah, bitIndex - 1, lowestBit, depthLeft - 1);
+            int secondChild = buildUpper(treelets, order, mid, end, sah, bitIndex - 1, lowestBit, depthLeft - 1);
+
+            LinearBVHNode &node = nodes[nodeIndex];
+            node.bounds = bounds;
+            node.secondChildOffset = secondChild;
+            node.nPrimitives = 0;
+            node.axis = uint8_t(dim);
+            return nodeIndex;
+        }
+
+        // least significant digit first, each pass histograms and scatters chunks in parallel
+        static void RadixSort(std::vector<MortonPrimitive> *v)
+        {
+            std::vector<MortonPrimitive> tempVector(v->size());
+            constexpr int bitsPerPass = 6;
+            constexpr int nBits = 30;
+            constexpr int nPasses = nBits / bitsPerPass;
+            constexpr int nBuckets = 1 << bitsPerPass;
+            constexpr uint32_t bitMask = nBuckets - 1;
+
+            constexpr int64_t chunkSize = 1 << 16;
+            int64_t n = int64_t(v->size());
+            int64_t nChunks = (n + chunkSize - 1) / chunkSize;
+            std::vector<std::array<int, nBuckets>> chunkOffsets(nChunks);
+
+            for (int pass = 0; pass < nPasses; ++pass)
+            {
+                int lowBit = pass * bitsPerPass;
+                std::vector<MortonPrimitive> &in = (pass & 1) ? tempVector : *v;
+                std::vector<MortonPrimitive> &out = (pass & 1) ? *v : tempVector;
+
+                ParallelFor(0, nChunks, [&](int64_t chunk) {
+                    std::array<int, nBuckets> &count = chunkOffsets[chunk];
+                    count.fill(0);
+                    for (int64_t i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i)
+                        count[(in[i].mortonCode >> lowBit) & bitMask]++;
+                });
+
+                // bucket-major prefix sum keeps the sort stable across chunks
+                int offset = 0;
+                for (int b = 0; b < nBuckets; ++b)
+                    for (int64_t chunk = 0; chunk < nChunks; ++chunk)
+                    {
+                        int count = chunkOffsets[chunk][b];
+                        chunkOffsets[chunk][b] = offset;
+                        offset += count;
+                    }
+
+                ParallelFor(0, nChunks, [&](int64_t chunk) {
+                    std::array<int, nBuckets> &outIndex = chunkOffsets[chunk];
+                    for (int64_t i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i)
+                        out[outIndex[(in[i].mortonCode >> lowBit) & bitMask]++] = in[i];
+                });
+            }
+            // an odd number of passes leaves the result in the scratch vector
+            if (nPasses & 1)
+                std::swap(*v, tempVector);
+        }
+
+        void initLeaf(int nodeIndex, int offset, int nPrimitives, const Bounds3f &bounds)
+        {
+            LinearBVHNode &node = nodes[nodeIndex];
+            node.bounds = bounds;
+            node.primitivesOffset = offset;
+            node.nPrimitives = uint16_t(nPrimitives);
+            node.axis = 0;
+        }
+
+        Bounds3f boundsAt(int nodeIndex, Float time) const
+        {
+            const Bounds3f &b0 = nodes[nodeIndex].bounds, &b1 = endBounds[nodeIndex];
+            Bounds3f b;
+            b.pMin = Lerp(time, b0.pMin, b1.pMin);
+            b.pMax = Lerp(time, b0.pMax, b1.pMax);
+            return b;
+        }
+
+        template <typename LeafFn, typename BoundsFn>
+        void refit(LeafFn &leafBounds, BoundsFn &&nodeBounds)
+        {
+            if (nodes.empty())
+                return;
+
+            auto refitNode = [&](int i) {
+                const LinearBVHNode &node = nodes[i];
+                if (node.nPrimitives > 0)
+                    nodeBounds(i) = leafBounds(node.primitivesOffset, int(node.nPrimitives));
+                else
+                    nodeBounds(i) = Union(nodeBounds(i + 1), nodeBounds(node.secondChildOffset));
+            };
+
+            // nodes above refitDepth in preorder, and the index ranges of the subtrees below
+            constexpr int refitDepth = 6;
+            std::vector<int> topNodes;
+            std::vector<std::pair<int, int>> subtrees;
+            std::vector<std::pair<int, int>> stack = {{0, 0}};
+            while (!stack.empty())
+            {
+                auto [i, depth] = stack.back();
+                stack.pop_back();
+                if (depth == refitDepth || nodes[i].nPrimitives > 0)
+                {
+                    // the last node of a subtree is its rightmost leaf
+                    int last = i;
+                    while (nodes[last].nPrimitives == 0)
+                        last = nodes[last].secondChildOffset;
+                    subtrees.emplace_back(i, last + 1);
+                    continue;
+                }
+                topNodes.push_back(i);
+                stack.emplace_back(nodes[i].secondChildOffset, depth + 1);
+                stack.emplace_back(i + 1, depth + 1);
+            }
+
+            // children have larger indices than their parents, so walking a
+            // range backwards visits children first
+            ParallelFor(0, int64_t(subtrees.size()), [&](int64_t s) {
+                for (int i = subtrees[s].second - 1; i >= subtrees[s].first; --i)
+                    refitNode(i);
+            });
+            for (auto it = topNodes.rbegin(); it != topNodes.rend(); ++it)
+                refitNode(*it);
+        }
+
+        // relative cost of intersecting n primitives of one leaf
+        Float testCost(int n) const { return Float((n + primsPerTest - 1) / primsPerTest); }
+
+    private:
+        int maxPrimsInNode = 4;
+        int primsPerTest = 1;
+        Buffer<LinearBVHNode> nodes;
+        Buffer<Bounds3f> endBounds;
+        std::vector<uint32_t> primIndices;
+    };
+
+    /*
+     *  BVH that owns its shapes. Shapes are copied into leaf order so a leaf
+     *  visit walks a contiguous range of memory.
+     */
+    template <typename Prim>
+    class BVHAggregate
+    {
+    public:
+        BVHAggregate() = default;
+        explicit BVHAggregate(const std::vector<Prim> &primitives, int maxPrimsInNode = 4,
+                              BVHBuildMethod method = BVHBuildMethod::SAH)
+        {
+            std::vector<Bounds3f> primBounds;
+            primBounds.reserve(primitives.size());
+            for (const Prim &prim : primitives)
+                primBounds.push_back(prim.Bounds());
+
+            bvh = BVH(primBounds, maxPrimsInNode, method);
+
+            prims.reserve(primitives.size());
+            leafOrder.resize(primitives.size());
+            for (uint32_t index : bvh.PrimitiveIndices())
+            {
+                leafOrder[index] = uint32_t(prims.size());
+                prims.push_back(primitives[index]);
+            }
+        }
+
+        Bounds3f Bounds() const { return bvh.Bounds(); }
+
+        size_t size() const { return prims.size(); }
+
+        const BVH &GetBVH() const { return bvh; }
+
+        // primitive by its index in the input, as reported in primIndex
+        const Prim &GetPrimitive(uint32_t index) const { return prims[leafOrder[index]]; }
+
+        // full interaction of a closest hit, requires Prim to provide Interaction
+        SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const
+        {
+            return GetPrimitive(hit.primIndex).Interaction(ray, hit);
+        }
+
+        // closest hit in [ray.tMin, ray.tMax), primIndex refers to the input order
+        std::optional<ShapeHit> Intersect(const Ray &ray) const
+        {
+            std::optional<ShapeHit> closest;
+            const std::vector<uint32_t> &primIndices = bvh.PrimitiveIndices();
+            bvh.Intersect(ray, [&](int offset, int nPrimitives, Float &tMax) {
+                bool hit = false;
+                for (int i = offset; i < offset + nPrimitives; ++i)
+                {
+                    if (std::optional<ShapeHit> si = prims[i].Intersect(ray, tMax))
+                    {
+                        si->primIndex = primIndices[i];
+                        tMax = si->tHit;
+                        closest = si;
+                        hit = true;
+                    }
+                }
+                return hit;
+            });
+            return closest;
+        }
+
+        // closest hit per lane, requires Prim to provide the packet Intersect
+        RayPacketHit Intersect(const RayPacket &rays) const
+        {
+            RayPacketHit result;
+            const std::vector<uint32_t> &primIndices = bvh.PrimitiveIndices();
+            result.valid = bvh.Intersect(rays, [&](int offset, int nPrimitives, FloatN &tMax, MaskN active) {
+                // lanes that missed the leaf get an empty interval and cannot hit
+                FloatN leafTMax = Select(active, tMax, FloatN(-Infinity));
+                MaskN hit(false);
+                for (int i = offset; i < offset + nPrimitives; ++i)
+                {
+                    MaskN primHit = prims[i].Intersect(rays, leafTMax, &result.tHit);
+                    if (primHit.None())
+                        continue;
+                    leafTMax = Select(primHit, result.tHit, leafTMax);
+                    for (uint32_t bits = primHit.Bits(); bits != 0; bits &= bits - 1)
+                        result.primIndex[CountTrailingZeros(bits)] = primIndices[i];
+                    hit |= primHit;
+                }
+                tMax = Select(hit, leafTMax, tMax);
+                return hit;
+            });
+            return result;
+        }
+
+        // whether anything lies in [ray.tMin, ray.tMax)
+        bool IntersectP(const Ray &ray) const
+        {
+            return bvh.IntersectP(ray, [&](int offset, int nPrimitives) {
+                for (int i = offset; i < offset + nPrimitives; ++i)
+                    if (prims[i].IntersectP(ray, ray.tMax))
+                        return true;
+                return false;
+            });
+        }
+
+        // blocked lanes, requires Prim to provide the packet IntersectP
+        MaskN IntersectP(const RayPacket &rays) const
+        {
+            return bvh.IntersectP(rays, [&](int offset, int nPrimitives, MaskN active) {
+                MaskN blocked(false);
+                for (int i = offset; i < offset + nPrimitives && AndNot(active, blocked).Any(); ++i)
+                    blocked |= prims[i].IntersectP(rays, rays.tMax) & active;
+                return blocked;
+            });
+        }
+
+    private:
+        BVH bvh;
+        std::vector<Prim> prims;
+        std::vector<uint32_t> leafOrder;
+    };
+}
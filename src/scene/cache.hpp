@@ -0,0 +1,252 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+#include "core/bounds.hpp"
+#include "core/simd.hpp"
+#include "scene/bvh.hpp"
+#include "scene/triangle.hpp"
+#include "util/file.hpp"
+#include "util/memory.hpp"
+
+namespace tfrt
+{
+    /*
+     *  ------------- Triangle BVH Cache -------------
+     *
+     *  A built TriangleBVH as one binary file: the mesh's vertex and index
+     *  arrays, the SoA triangle groups of the leaves and the flattened
+     *  node array, each aligned to a cache line. MapTriangleCache maps the
+     *  file and hands those arrays to the mesh and the BVH as borrowed
+     *  Buffers, so nothing is parsed, built or copied; pages are read the
+     *  first time a ray touches them.
+     *
+     *  The arrays are stored in this build's memory layout. The header
+     *  records the format version, SIMDWidth and the element sizes, and a
+     *  file that does not match, was made from a different source or is
+     *  cut short is rejected rather than converted. Only the header and
+     *  array bounds are checked, reading every byte would cost what the
+     *  cache saves.
+     */
+    static constexpr uint32_t TriangleCacheVersion = 1;
+
+    enum class TriangleCacheArray
+    {
+        VertexIndices,
+        P,
+        PEnd,
+        N,
+        UV,
+        Nodes,
+        EndBounds,
+        Groups,
+        EndGroups,
+        Count
+    };
+
+    struct TriangleCacheHeader
+    {
+        char magic[8] = {'t', 'f', 'r', 't', 'b', 'v', 'h', '\0'};
+        uint32_t version = TriangleCacheVersion;
+        // layout of the arrays, which have to match this build to be used in place
+        uint32_t simdWidth = SIMDWidth;
+        uint32_t nodeSize = sizeof(LinearBVHNode);
+        uint32_t groupSize = sizeof(TriangleGroup);
+        uint32_t buildMethod = 0;
+        Float builtCost = 0;
+        // content hash of the asset the mesh was made from
+        uint64_t sourceHash = 0;
+        // byte offset and element count of every array
+        struct Array
+        {
+            uint64_t offset, count;
+        } arrays[int(TriangleCacheArray::Count)] = {};
+
+        // whether a file with this header can be used for sourceHash and method
+        bool Matches(uint64_t hash, BVHBuildMethod method) const
+        {
+            TriangleCacheHeader current;
+            return std::memcmp(magic, current.magic, sizeof(magic)) == 0 && version == current.version &&
+                   simdWidth == current.simdWidth && nodeSize == current.nodeSize &&
+                   groupSize == current.groupSize && sourceHash == hash && buildMethod == uint32_t(method);
+        }
+    };
+
+    namespace detail
+    {
+        // array a of a mapped cache file as a borrowed Buffer; clears valid if it lies outside the file
+        template <typename T>
+        Buffer<T> BorrowArray(const std::shared_ptr<const MappedFile> &file, const TriangleCacheHeader::Array &a,
+                              bool *valid)
+        {
+            if (a.offset % alignof(T) != 0 || a.offset > file->Size() ||
+                a.count > (file->Size() - a.offset) / sizeof(T))
+            {
+                *valid = false;
+                return {};
+            }
+            return Buffer<T>(reinterpret_cast<const T *>(file->Data() + a.offset), size_t(a.count), file);
+        }
+    }
+
+    /*
+     *  Where the cache of a source with the given content hash, built with
+     *  method, lives in directory. The name also holds SIMDWidth and the
+     *  format version, so caches that this build cannot use sit next to
+     *  its own instead of being overwritten by it.
+     */
+    inline std::string TriangleCacheFilename(const std::string &directory, uint64_t sourceHash,
+                                             BVHBuildMethod method = BVHBuildMethod::SAH)
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%016llx-%s-w%d-v%u.tfrtbvh", (unsigned long long)sourceHash,
+                      BVHBuildMethodName(method), SIMDWidth, unsigned(TriangleCacheVersion));
+        return directory.empty() ? name : directory + "/" + name;
+    }
+
+    /*
+     *  Writes bvh, its mesh included, to filename. The file is written
+     *  under a temporary name unique to the call and renamed into place, so
+     *  a reader never maps a partial cache and concurrent writers do not
+     *  write into each other's file. Returns false if anything failed.
+     */
+    inline bool WriteTriangleCache(const std::string &filename, const TriangleBVH &bvh, uint64_t sourceHash)
+    {
+        const TriangleMesh &mesh = bvh.Mesh();
+        TriangleCacheHeader header;
+        header.buildMethod = uint32_t(bvh.BuildMethod());
+        header.builtCost = bvh.BuiltCost();
+        header.sourceHash = sourceHash;
+
+        struct Source
+        {
+            const void *data;
+            size_t elementSize, count;
+        };
+        auto source = [](const auto &buffer) {
+            return Source{buffer.data(), sizeof(buffer[0]), buffer.size()};
+        };
+        // in the order of TriangleCacheArray
+        const Source sources[] = {source(mesh.vertexIndices), source(mesh.p), source(mesh.pEnd),
+                                  source(mesh.n), source(mesh.uv), source(bvh.Tree().Nodes()),
+                                  source(bvh.Tree().EndBounds()), source(bvh.Groups()), source(bvh.EndGroups())};
+        static_assert(sizeof(sources) / sizeof(sources[0]) == size_t(TriangleCacheArray::Count));
+
+        auto align = [](uint64_t offset) {
+            return (offset + CacheLineSize - 1) & ~uint64_t(CacheLineSize - 1);
+        };
+        uint64_t offset = align(sizeof(TriangleCacheHeader));
+        for (int i = 0; i < int(TriangleCacheArray::Count); ++i)
+        {
+            header.arrays[i] = {offset, sources[i].count};
+            offset = align(offset + sources[i].elementSize * sources[i].count);
+        }
+
+        // unique to this call, threads of one process may write the same cache at once
+        static std::atomic<uint64_t> nextTemporary{0};
+        std::string temporary = filename + "." + std::to_string(::getpid()) + "." +
+                                std::to_string(nextTemporary.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+        {
+            std::ofstream out(temporary, std::ofstream::binary | std::ofstream::trunc);
+            const char zeros[CacheLineSize] = {};
+            auto pad = [&](uint64_t to) {
+                out.write(zeros, std::streamsize(to - uint64_t(out.tellp())));
+            };
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            for (int i = 0; i < int(TriangleCacheArray::Count); ++i)
+            {
+                pad(header.arrays[i].offset);
+                out.write(static_cast<const char *>(sources[i].data),
+                          std::streamsize(sources[i].elementSize * sources[i].count));
+            }
+            pad(offset);
+            if (!out.flush())
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     *  The BVH cached in filename, used in place, or nullptr if there is
+     *  none that was built with method from the source with sourceHash.
+     *  The mapping lives as long as the BVH or its mesh.
+     */
+    inline std::shared_ptr<const TriangleBVH> MapTriangleCache(const std::string &filename, uint64_t sourceHash,
+                                                               BVHBuildMethod method = BVHBuildMethod::SAH)
+    {
+        std::shared_ptr<const MappedFile> file = MappedFile::Open(filename);
+        if (!file || file->Size() < sizeof(TriangleCacheHeader))
+            return nullptr;
+        TriangleCacheHeader header;
+        std::memcpy(&header, file->Data(), sizeof(header));
+        if (!header.Matches(sourceHash, method))
+            return nullptr;
+
+        bool valid = true;
+        auto array = [&](TriangleCacheArray i) { return header.arrays[int(i)]; };
+        Buffer<int> vertexIndices =
+            detail::BorrowArray<int>(file, array(TriangleCacheArray::VertexIndices), &valid);
+        Buffer<Point3f> p = detail::BorrowArray<Point3f>(file, array(TriangleCacheArray::P), &valid);
+        Buffer<Point3f> pEnd = detail::BorrowArray<Point3f>(file, array(TriangleCacheArray::PEnd), &valid);
+        Buffer<Normal3f> n = detail::BorrowArray<Normal3f>(file, array(TriangleCacheArray::N), &valid);
+        Buffer<Point2f> uv = detail::BorrowArray<Point2f>(file, array(TriangleCacheArray::UV), &valid);
+        Buffer<LinearBVHNode> nodes =
+            detail::BorrowArray<LinearBVHNode>(file, array(TriangleCacheArray::Nodes), &valid);
+        Buffer<Bounds3f> endBounds =
+            detail::BorrowArray<Bounds3f>(file, array(TriangleCacheArray::EndBounds), &valid);
+        Buffer<TriangleGroup> groups =
+            detail::BorrowArray<TriangleGroup>(file, array(TriangleCacheArray::Groups), &valid);
+        Buffer<TriangleGroup> endGroups =
+            detail::BorrowArray<TriangleGroup>(file, array(TriangleCacheArray::EndGroups), &valid);
+        // optional arrays are empty or have one element per vertex, node or group
+        auto optional = [](size_t size, size_t expected) { return size == 0 || size == expected; };
+        if (!valid || vertexIndices.size() % 3 != 0 || !optional(pEnd.size(), p.size()) ||
+            !optional(n.size(), p.size()) || !optional(uv.size(), p.size()) ||
+            !optional(endBounds.size(), nodes.size()) || !optional(endGroups.size(), groups.size()))
+            return nullptr;
+
+        auto mesh =
+            std::make_shared<TriangleMesh>(std::move(vertexIndices), std::move(p), std::move(n), std::move(uv));
+        mesh->pEnd = std::move(pEnd);
+        BVH bvh(std::move(nodes), std::move(endBounds), SIMDWidth, SIMDWidth);
+        return std::make_shared<const TriangleBVH>(std::move(mesh), std::move(bvh), std::move(groups),
+                                                   std::move(endGroups), method, header.builtCost);
+    }
+
+    /*
+     *  The BVH of the asset with content hash sourceHash: mapped from its
+     *  cache in directory when there is one, otherwise built over the mesh
+     *  loadMesh() returns and written there for next time. The hash has to
+     *  cover everything the mesh depends on, a transform applied at load
+     *  time included.
+     */
+    template <typename LoadMesh>
+    std::shared_ptr<const TriangleBVH> CachedTriangleBVH(const std::string &directory, uint64_t sourceHash,
+                                                         LoadMesh &&loadMesh,
+                                                         BVHBuildMethod method = BVHBuildMethod::SAH)
+    {
+        std::string filename = TriangleCacheFilename(directory, sourceHash, method);
+        if (std::shared_ptr<const TriangleBVH> cached = MapTriangleCache(filename, sourceHash, method))
+            return cached;
+        auto bvh = std::make_shared<const TriangleBVH>(std::shared_ptr<const TriangleMesh>(loadMesh()), method);
+        // a cache that cannot be written only costs the next run the build
+        WriteTriangleCache(filename, *bvh, sourceHash);
+        return bvh;
+    }
+}
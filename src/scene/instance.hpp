@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/transform.hpp"
+#include "scene/bvh.hpp"
+#include "scene/interaction.hpp"
+#include "scene/shape.hpp"
+#include "scene/triangle.hpp"
+#include "util/math.hpp"
+
+namespace tfrt
+{
+    /*
+     *  One placement of a shared mesh BVH. Only the BVH pointer and the
+     *  transform are stored per copy, so memory grows with the number of
+     *  unique meshes rather than the number of instances. Rays move into
+     *  instance space when they reach the instance; the direction is not
+     *  renormalized, so hit distances need no conversion back.
+     */
+    class Instance
+    {
+    public:
+        Instance(std::shared_ptr<const TriangleBVH> object, const Transform &renderFromInstance)
+            : object(std::move(object)), renderFromInstance(renderFromInstance),
+              bounds(renderFromInstance(this->object->Bounds())),
+              identity(renderFromInstance.IsIdentity()) {}
+
+        Bounds3f Bounds() const { return bounds; }
+
+        const TriangleBVH &Object() const { return *object; }
+        const Transform &RenderFromInstance() const { return renderFromInstance; }
+
+        // primIndex of the hit is the triangle within the shared mesh
+        std::optional<ShapeHit> Intersect(const Ray &ray, Float tMax) const
+        {
+            Ray r = identity ? ray : renderFromInstance.ApplyInverse(ray);
+            r.tMax = tMax;
+            return object->Intersect(r);
+        }
+
+        RayPacketHit Intersect(const RayPacket &rays, FloatN tMax) const
+        {
+            RayPacket r = identity ? rays : renderFromInstance.ApplyInverse(rays);
+            r.tMax = tMax;
+            return object->Intersect(r);
+        }
+
+        // interaction of a hit from Intersect, built in instance space and moved to render space
+        SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const
+        {
+            if (identity)
+                return object->Interaction(ray, hit);
+            return renderFromInstance(object->Interaction(renderFromInstance.ApplyInverse(ray), hit));
+        }
+
+        bool IntersectP(const Ray &ray) const
+        {
+            return object->IntersectP(identity ? ray : renderFromInstance.ApplyInverse(ray));
+        }
+
+        MaskN IntersectP(const RayPacket &rays) const
+        {
+            return object->IntersectP(identity ? rays : renderFromInstance.ApplyInverse(rays));
+        }
+
+    private:
+        std::shared_ptr<const TriangleBVH> object;
+        Transform renderFromInstance;
+        Bounds3f bounds;
+        bool identity;
+    };
+
+    // up to SIMDWidth consecutive instances of a leaf with their bounds in SoA form
+    struct InstanceGroup
+    {
+        Bounds3fN bounds;
+        uint32_t first;
+        int count;
+    };
+
+    /*
+     *  Top level of the two-level structure: a BVH over instance bounds.
+     *  Instances are stored in leaf order and each leaf is split into
+     *  InstanceGroups, so one 8-wide box test decides which instances of the
+     *  leaf the ray has to be transformed for. Hits carry the index of the
+     *  instance in the input vector in geomIndex.
+     */
+    class InstanceBVH
+    {
+    public:
+        InstanceBVH() = default;
+        explicit InstanceBVH(const std::vector<Instance> &input,
+                             BVHBuildMethod method = BVHBuildMethod::SAH)
+        {
+            std::vector<Bounds3f> instanceBounds;
+            instanceBounds.reserve(input.size());
+            for (const Instance &instance : input)
+                instanceBounds.push_back(instance.Bounds());
+            bvh = BVH(instanceBounds, SIMDWidth, method, SIMDWidth);
+
+            instances.reserve(input.size());
+            leafOrder.resize(input.size());
+            for (uint32_t index : bvh.PrimitiveIndices())
+            {
+                leafOrder[index] = uint32_t(instances.size());
+                instances.push_back(input[index]);
+                instanceIndices.push_back(index);
+            }
+
+            bvh.RemapLeaves([&](int offset, int nInstances) {
+                int firstGroup = int(groups.size());
+                for (int i = 0; i < nInstances; i += SIMDWidth)
+                {
+                    InstanceGroup group;
+                    group.first = uint32_t(offset + i);
+                    group.count = std::min(SIMDWidth, nInstances - i);
+                    Bounds3f boxes[SIMDWidth];
+                    for (int j = 0; j < group.count; ++j)
+                        boxes[j] = instances[group.first + j].Bounds();
+                    group.bounds = Bounds3fN(boxes, group.count);
+                    groups.push_back(group);
+                }
+                return std::make_pair(firstGroup, int(groups.size()) - firstGroup);
+            });
+        }
+
+        Bounds3f Bounds() const { return bvh.Bounds(); }
+
+        size_t size() const { return instances.size(); }
+
+        // instance by its index in the input, as reported in geomIndex
+        const Instance &GetInstance(uint32_t index) const { return instances[leafOrder[index]]; }
+
+        SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const
+        {
+            return GetInstance(hit.geomIndex).Interaction(ray, hit);
+        }
+
+        std::optional<ShapeHit> Intersect(const Ray &ray) const
+        {
+            TraversalRay traversalRay(ray);
+            std::optional<ShapeHit> closest;
+            bvh.Intersect(ray, [&](int offset, int nGroups, Float &tMax) {
+                bool hit = false;
+                for (int g = offset; g < offset + nGroups; ++g)
+                {
+                    const InstanceGroup &group = groups[g];
+                    MaskN overlap = tfrt::IntersectP(group.bounds, traversalRay, tMax);
+                    for (uint32_t bits = overlap.Bits(); bits != 0; bits &= bits - 1)
+                    {
+                        uint32_t i = group.first + CountTrailingZeros(bits);
+                        if (std::optional<ShapeHit> si = instances[i].Intersect(ray, tMax))
+                        {
+                            si->geomIndex = instanceIndices[i];
+                            tMax = si->tHit;
+                            closest = si;
+                            hit = true;
+                        }
+                    }
+                }
+                return hit;
+            });
+            return closest;
+        }
+
+        // a packet is transformed into an instance only when one of its lanes reaches the instance's box
+        RayPacketHit Intersect(const RayPacket &rays) const
+        {
+            TraversalRay laneRays[SIMDWidth];
+            traversalRays(rays, laneRays);
+            RayPacketHit result;
+            result.valid = bvh.Intersect(rays, [&](int offset, int nGroups, FloatN &tMax, MaskN active) {
+                MaskN hit(false);
+                for (int g = offset; g < offset + nGroups; ++g)
+                {
+                    const InstanceGroup &group = groups[g];
+                    uint32_t lanes[SIMDWidth];
+                    overlappingLanes(group, laneRays, tMax, active, lanes);
+                    for (int k = 0; k < group.count; ++k)
+                    {
+                        if (lanes[k] == 0)
+                            continue;
+                        uint32_t i = group.first + uint32_t(k);
+                        MaskN reached = MaskN::FromBits(lanes[k]);
+                        RayPacketHit instanceHit =
+                            instances[i].Intersect(rays, Select(reached, tMax, FloatN(-Infinity)));
+                        if (instanceHit.valid.None())
+                            continue;
+                        MaskN h = instanceHit.valid;
+                        tMax = Select(h, instanceHit.tHit, tMax);
+                        result.tHit = Select(h, instanceHit.tHit, result.tHit);
+                        result.u = Select(h, instanceHit.u, result.u);
+                        result.v = Select(h, instanceHit.v, result.v);
+                        for (uint32_t bits = h.Bits(); bits != 0; bits &= bits - 1)
+                        {
+                            int lane = CountTrailingZeros(bits);
+                            result.primIndex[lane] = instanceHit.primIndex[lane];
+                            result.geomIndex[lane] = instanceIndices[i];
+                        }
+                        hit |= h;
+                    }
+                }
+                return hit;
+            });
+            return result;
+        }
+
+        // whether any instance blocks [ray.tMin, ray.tMax)
+        bool IntersectP(const Ray &ray) const
+        {
+            TraversalRay traversalRay(ray);
+            return bvh.IntersectP(ray, [&](int offset, int nGroups) {
+                for (int g = offset; g < offset + nGroups; ++g)
+                {
+                    const InstanceGroup &group = groups[g];
+                    MaskN overlap = tfrt::IntersectP(group.bounds, traversalRay, ray.tMax);
+                    for (uint32_t bits = overlap.Bits(); bits != 0; bits &= bits - 1)
+                        if (instances[group.first + CountTrailingZeros(bits)].IntersectP(ray))
+                            return true;
+                }
+                return false;
+            });
+        }
+
+        MaskN IntersectP(const RayPacket &rays) const
+        {
+            TraversalRay laneRays[SIMDWidth];
+            traversalRays(rays, laneRays);
+            return bvh.IntersectP(rays, [&](int offset, int nGroups, MaskN active) {
+                MaskN blocked(false);
+                RayPacket r = rays;
+                for (int g = offset; g < offset + nGroups; ++g)
+                {
+                    const InstanceGroup &group = groups[g];
+                    uint32_t lanes[SIMDWidth];
+                    overlappingLanes(group, laneRays, rays.tMax, AndNot(active, blocked), lanes);
+                    for (int k = 0; k < group.count; ++k)
+                    {
+                        // lanes already blocked are switched off for the remaining instances
+                        MaskN testing = AndNot(MaskN::FromBits(lanes[k]), blocked);
+                        if (testing.None())
+                            continue;
+                        r.tMax = Select(testing, rays.tMax, FloatN(-Infinity));
+                        blocked |= instances[group.first + uint32_t(k)].IntersectP(r) & testing;
+                        if (AndNot(active, blocked).None())
+                            return blocked;
+                    }
+                }
+                return blocked;
+            });
+        }
+
+    private:
+        // the traversal ray of each lane, set up once per packet
+        static void traversalRays(const RayPacket &rays, TraversalRay laneRays[SIMDWidth])
+        {
+            alignas(32) float o[3][SIMDWidth], d[3][SIMDWidth], tMin[SIMDWidth];
+            for (int c = 0; c < 3; ++c)
+            {
+                rays.o[c].Store(o[c]);
+                rays.d[c].Store(d[c]);
+            }
+            rays.tMin.Store(tMin);
+            for (int lane = 0; lane < SIMDWidth; ++lane)
+            {
+                Ray ray(Point3f(o[0][lane], o[1][lane], o[2][lane]), Vector3f(d[0][lane], d[1][lane], d[2][lane]));
+                ray.tMin = tMin[lane];
+                laneRays[lane] = TraversalRay(ray);
+            }
+        }
+
+        // for each instance of group, the bits of the lanes in active whose ray overlaps its box
+        static void overlappingLanes(const InstanceGroup &group, const TraversalRay laneRays[SIMDWidth],
+                                     FloatN tMax, MaskN active, uint32_t lanes[SIMDWidth])
+        {
+            alignas(32) float tMaxLanes[SIMDWidth];
+            tMax.Store(tMaxLanes);
+            std::fill(lanes, lanes + SIMDWidth, 0u);
+            for (uint32_t bits = active.Bits(); bits != 0; bits &= bits - 1)
+            {
+                int lane = CountTrailingZeros(bits);
+                MaskN overlap = tfrt::IntersectP(group.bounds, laneRays[lane], tMaxLanes[lane]);
+                for (uint32_t boxes = overlap.Bits(); boxes != 0; boxes &= boxes - 1)
+                    lanes[CountTrailingZeros(boxes)] |= 1u << lane;
+            }
+        }
+
+        BVH bvh;
+        std::vector<Instance> instances;
+        std::vector<uint32_t> instanceIndices, leafOrder;
+        std::vector<InstanceGroup> groups;
+    };
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/ray.hpp"
+#include "core/transform.hpp"
+#include "core/vecmath.hpp"
+
+namespace tfrt
+{
+    /*
+     *  Local differential geometry at a ray-surface hit.
+     *
+     *  Interactions are built in two phases. Traversal only carries the
+     *  ShapeHit of the closest candidate so far (t, primitive and
+     *  geometry index, barycentrics or (u, v)), since most candidates are
+     *  replaced by closer hits before traversal ends. Once the closest hit
+     *  is known, the shape that produced it rebuilds the full interaction
+     *  from it, e.g. through Scene::Interaction(ray, hit).
+     */
+    class SurfaceInteraction
+    {
+    public:
+        Point3f p;
+        Float time = 0;
+        // direction towards the ray origin, normalized
+        Vector3f wo;
+        // geometric normal, on the side given by the orientation of dpdu x dpdv
+        Normal3f n;
+        Point2f uv;
+        Vector3f dpdu, dpdv;
+        Normal3f dndu, dndv;
+
+        // perturbed frame used for shading, equal to the geometric one by default
+        struct
+        {
+            Normal3f n;
+            Vector3f dpdu, dpdv;
+            Normal3f dndu, dndv;
+        } shading;
+
+        uint32_t primIndex = 0, geomIndex = 0;
+
+    public:
+        SurfaceInteraction() = default;
+
+        // flipNormal reverses the orientation, e.g. for left-handed transforms
+        SurfaceInteraction(Point3f p, Point2f uv, Vector3f wo, Vector3f dpdu, Vector3f dpdv,
+                           Normal3f dndu, Normal3f dndv, Float time, bool flipNormal)
+            : p(p), time(time), wo(Normalize(wo)), n(Normalize(Cross(dpdu, dpdv))), uv(uv),
+              dpdu(dpdu), dpdv(dpdv), dndu(dndu), dndv(dndv)
+        {
+            if (flipNormal)
+                n = -n;
+            shading.n = n;
+            shading.dpdu = dpdu;
+            shading.dpdv = dpdv;
+            shading.dndu = dndu;
+            shading.dndv = dndv;
+        }
+
+        /*
+         *  Sets the shading frame, e.g. from interpolated vertex normals. The
+         *  geometric normal is flipped to the side of the shading normal when
+         *  orientationIsAuthoritative, otherwise the shading normal follows
+         *  the geometric one.
+         */
+        void SetShadingGeometry(Normal3f ns, Vector3f dpdus, Vector3f dpdvs, Normal3f dndus,
+                                Normal3f dndvs, bool orientationIsAuthoritative)
+        {
+            shading.n = ns;
+            if (orientationIsAuthoritative)
+                n = FaceForward(n, shading.n);
+            else
+                shading.n = FaceForward(shading.n, n);
+            shading.dpdu = dpdus;
+            shading.dpdv = dpdvs;
+            shading.dndu = dndus;
+            shading.dndv = dndvs;
+        }
+
+        /*
+         *  Ray leaving the surface in direction d. Hit points carry no error
+         *  bounds, so the origin is pushed off the surface along n, to the
+         *  side d points to, by a margin relative to the magnitude of p.
+         */
+        Ray SpawnRay(Vector3f d) const
+        {
+            Float offset = 1e-4f * (1 + MaxComponentValue(Abs(Vector3f(p))));
+            Vector3f offsetN = Vector3f(n) * (Dot(n, d) < 0 ? -offset : offset);
+            return Ray(p + offsetN, d, time);
+        }
+    };
+
+    inline SurfaceInteraction Transform::operator()(const SurfaceInteraction &si) const
+    {
+        SurfaceInteraction ret = si;
+        ret.p = (*this)(si.p);
+        ret.wo = Normalize((*this)(si.wo));
+        ret.n = Normalize((*this)(si.n));
+        ret.dpdu = (*this)(si.dpdu);
+        ret.dpdv = (*this)(si.dpdv);
+        ret.dndu = (*this)(si.dndu);
+        ret.dndv = (*this)(si.dndv);
+        ret.shading.n = FaceForward(Normalize((*this)(si.shading.n)), ret.n);
+        ret.shading.dpdu = (*this)(si.shading.dpdu);
+        ret.shading.dpdv = (*this)(si.shading.dpdv);
+        ret.shading.dndu = (*this)(si.shading.dndu);
+        ret.shading.dndv = (*this)(si.shading.dndv);
+        return ret;
+    }
+}
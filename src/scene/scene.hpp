@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/features.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/transform.hpp"
+#include "scene/bvh.hpp"
+#include "scene/instance.hpp"
+#include "scene/interaction.hpp"
+#include "scene/shape.hpp"
+#include "scene/sphere.hpp"
+#include "scene/triangle.hpp"
+
+namespace tfrt
+{
+    /*
+     *  Spheres share one SphereSet. Triangle meshes are instances of per-mesh
+     *  BVHs under one top-level BVH; a plain mesh is an instance with the
+     *  identity transform. Hits carry geomIndex 0 for spheres, i + 1 for
+     *  meshes[i] and meshes.size() + 1 + j for instances[j].
+     */
+    class Scene
+    {
+    public:
+        Scene() = default;
+        explicit Scene(const std::vector<Sphere> &spheres,
+                       const std::vector<std::shared_ptr<const TriangleMesh>> &meshes = {},
+                       const std::vector<Instance> &instances = {},
+                       BVHBuildMethod method = BVHBuildMethod::SAH)
+            : spheres(spheres, method)
+        {
+            std::vector<Instance> all;
+            all.reserve(meshes.size() + instances.size());
+            for (const std::shared_ptr<const TriangleMesh> &mesh : meshes)
+                all.emplace_back(std::make_shared<const TriangleBVH>(mesh, method), Transform());
+            all.insert(all.end(), instances.begin(), instances.end());
+            this->instances = InstanceBVH(all, method);
+        }
+
+        Bounds3f Bounds() const { return Union(spheres.Bounds(), instances.Bounds()); }
+
+        // what DispatchFeatures needs to know about the geometry
+        bool HasSpheres() const { return spheres.size() > 0; }
+        bool HasTriangles() const { return instances.size() > 0; }
+
+        /*
+         *  The queries below take the KernelFeatures of the calling kernel.
+         *  An instantiation without spheres or triangles skips that part of
+         *  the scene entirely, so it is only valid for scenes without it.
+         */
+
+        // closest hit along the ray, honoring ray.tMin and ray.tMax
+        template <typename Features = AllFeatures>
+        std::optional<ShapeHit> Intersect(const Ray &ray) const
+        {
+            std::optional<ShapeHit> closest;
+            if constexpr (Features::spheres)
+                closest = spheres.Intersect(ray);
+            if (!Features::triangles || instances.size() == 0)
+                return closest;
+
+            Ray r = ray;
+            if (closest)
+                r.tMax = closest->tHit;
+            if (std::optional<ShapeHit> hit = instances.Intersect(r))
+            {
+                closest = hit;
+                closest->geomIndex += 1;
+            }
+            return closest;
+        }
+
+        // closest hit for each lane of a coherent packet
+        template <typename Features = AllFeatures>
+        RayPacketHit Intersect(const RayPacket &rays) const
+        {
+            RayPacketHit result;
+            if constexpr (Features::spheres)
+                result = spheres.Intersect(rays);
+            if (!Features::triangles || instances.size() == 0)
+                return result;
+
+            RayPacket r = rays;
+            r.tMax = Select(result.valid, result.tHit, rays.tMax);
+            RayPacketHit hit = instances.Intersect(r);
+            if (hit.valid.None())
+                return result;
+            result.tHit = Select(hit.valid, hit.tHit, result.tHit);
+            result.u = Select(hit.valid, hit.u, result.u);
+            result.v = Select(hit.valid, hit.v, result.v);
+            for (uint32_t bits = hit.valid.Bits(); bits != 0; bits &= bits - 1)
+            {
+                int lane = CountTrailingZeros(bits);
+                result.primIndex[lane] = hit.primIndex[lane];
+                result.geomIndex[lane] = hit.geomIndex[lane] + 1;
+            }
+            result.valid = result.valid | hit.valid;
+            return result;
+        }
+
+        /*
+         *  Second phase of a closest-hit query: the full interaction of the
+         *  hit returned by Intersect(ray), built only for that final hit.
+         */
+        SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const
+        {
+            if (hit.geomIndex == 0)
+                return spheres.Interaction(ray, hit);
+            ShapeHit instanceHit = hit;
+            instanceHit.geomIndex -= 1;
+            SurfaceInteraction si = instances.Interaction(ray, instanceHit);
+            si.geomIndex = hit.geomIndex;
+            return si;
+        }
+
+        /*
+         *  Shadow and occlusion queries: whether anything lies in
+         *  [ray.tMin, ray.tMax). The search stops at the first hit found,
+         *  which need not be the closest.
+         */
+        template <typename Features = AllFeatures>
+        bool IntersectP(const Ray &ray) const
+        {
+            return (Features::spheres && spheres.IntersectP(ray)) ||
+                   (Features::triangles && instances.size() > 0 && instances.IntersectP(ray));
+        }
+
+        template <typename Features = AllFeatures>
+        MaskN IntersectP(const RayPacket &rays) const
+        {
+            MaskN blocked(false);
+            if constexpr (Features::spheres)
+                blocked = spheres.IntersectP(rays);
+            if (!Features::triangles || instances.size() == 0 || (blocked | !(rays.tMax > rays.tMin)).All())
+                return blocked;
+            RayPacket r = rays;
+            r.tMax = Select(blocked, FloatN(-Infinity), rays.tMax);
+            return blocked | instances.IntersectP(r);
+        }
+
+        // batched shadow rays, gathered into packets; occluded[i] is set for rays[i]
+        template <typename Features = AllFeatures>
+        void IntersectP(const Ray *rays, int n, bool *occluded) const
+        {
+            for (int i = 0; i < n; i += SIMDWidth)
+            {
+                int nRays = std::min(SIMDWidth, n - i);
+                uint32_t blocked = IntersectP<Features>(RayPacket(rays + i, nRays)).Bits();
+                for (int j = 0; j < nRays; ++j)
+                    occluded[i + j] = (blocked >> j) & 1;
+            }
+        }
+
+    private:
+        SphereSet spheres;
+        InstanceBVH instances;
+    };
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/tfrt.hpp"
+
+namespace tfrt
+{
+    /*
+     *  Shapes are plain value types that the BVH stores directly in its leaf
+     *  order. A shape provides
+     *
+     *      Bounds3f Bounds() const;
+     *      std::optional<ShapeHit> Intersect(const Ray &ray, Float tMax) const;
+     *      SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const;
+     *
+     *  where Intersect only reports hits in [ray.tMin, tMax). Traversal
+     *  keeps only the ShapeHit of the closest candidate; Interaction builds
+     *  the full SurfaceInteraction once, for the final hit.
+     */
+
+    // Result of a ray-shape test, kept small so it is cheap to carry
+    // through traversal.
+    struct ShapeHit
+    {
+        Float tHit = Infinity;
+        uint32_t primIndex = 0;
+        // surface parameterization of the hit, barycentrics b1, b2 for triangles
+        Float u = 0, v = 0;
+        // which of the scene's aggregates primIndex refers to, 0 for the spheres
+        uint32_t geomIndex = 0;
+    };
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/vecmath.hpp"
+#include "scene/bvh.hpp"
+#include "scene/interaction.hpp"
+#include "scene/shape.hpp"
+#include "util/math.hpp"
+
+namespace tfrt
+{
+    /*
+     *  Nearest root in [tMin, tMax) of |oc + t * d|^2 = radius^2, where oc
+     *  is the ray origin relative to the sphere center.
+     *
+     *  b^2 - 4ac cancels catastrophically when the sphere is small compared
+     *  to its distance from the origin, which is the common case for
+     *  particles. The discriminant is therefore computed from the distance
+     *  between the center and the ray's line as 4a (r - l)(r + l). The far
+     *  root comes from t0 * t1 = c / a, so neither root subtracts two
+     *  nearly equal values.
+     */
+    inline std::optional<Float> IntersectSphere(Vector3f oc, Vector3f d, Float radius, Float tMin,
+                                                Float tMax)
+    {
+        Float a = LengthSquared(d);
+        Float b = 2 * Dot(d, oc);
+        Float c = FMA(-radius, radius, LengthSquared(oc));
+
+        // vec runs from the center to the closest point of the line
+        Vector3f vec = oc - d * (b / (2 * a));
+        Float l = Length(vec);
+        Float discrim = 4 * a * (radius + l) * (radius - l);
+        if (discrim < 0)
+            return {};
+
+        Float rootDiscrim = std::sqrt(discrim);
+        Float q = (b < 0) ? -0.5f * (b - rootDiscrim) : -0.5f * (b + rootDiscrim);
+        Float t0 = q / a, t1 = c / q;
+        if (t0 > t1)
+            std::swap(t0, t1);
+
+        Float t = (t0 < tMin) ? t1 : t0;
+        if (!(t >= tMin && t < tMax))
+            return {};
+        return t;
+    }
+
+    // IntersectSphere for SIMDWidth ray-sphere pairs, sets tHit in the lanes that hit
+    inline MaskN IntersectSphereLanes(const Vector3fN &oc, const Vector3fN &d, FloatN radius,
+                                      FloatN tMin, FloatN tMax, FloatN *tHit)
+    {
+        FloatN a = LengthSquared(d);
+        FloatN b = 2 * Dot(d, oc);
+        FloatN c = FMA(-radius, radius, LengthSquared(oc));
+
+        Vector3fN vec = oc - d * (b / (2 * a));
+        FloatN l = Length(vec);
+        FloatN discrim = 4 * a * (radius + l) * (radius - l);
+        MaskN hit = discrim >= FloatN(0.f);
+        if (hit.None())
+            return hit;
+
+        FloatN rootDiscrim = sqrt(max(discrim, FloatN(0.f)));
+        FloatN q = FloatN(-0.5f) * Select(b < FloatN(0.f), b - rootDiscrim, b + rootDiscrim);
+        FloatN t0 = q / a, t1 = c / q;
+        FloatN tNear = min(t0, t1), tFar = max(t0, t1);
+
+        FloatN t = Select(tNear < tMin, tFar, tNear);
+        hit &= (t >= tMin) & (t < tMax);
+        *tHit = Select(hit, t, *tHit);
+        return hit;
+    }
+
+    class Sphere
+    {
+    public:
+        Point3f center;
+        Float radius = 1;
+
+    public:
+        Sphere() = default;
+        Sphere(Point3f center, Float radius) : center(center), radius(radius) {}
+
+        Bounds3f Bounds() const
+        {
+            Vector3f r(radius, radius, radius);
+            return Bounds3f(center - r, center + r);
+        }
+
+        std::optional<ShapeHit> Intersect(const Ray &ray, Float tMax) const
+        {
+            std::optional<Float> t = IntersectSphere(ray.o - center, ray.d, radius, ray.tMin, tMax);
+            if (!t)
+                return {};
+            ShapeHit hit;
+            hit.tHit = *t;
+            return hit;
+        }
+
+        // packet version of Intersect, sets tHit in the lanes that hit
+        MaskN Intersect(const RayPacket &rays, FloatN tMax, FloatN *tHit) const
+        {
+            return IntersectSphereLanes(rays.o - Broadcast(center), rays.d, FloatN(radius), rays.tMin,
+                                        tMax, tHit);
+        }
+
+        /*
+         *  Full interaction for a hit returned by Intersect. u runs around
+         *  the z axis from +x, v from the -z pole to the +z pole, and the
+         *  normal points outwards.
+         */
+        SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const
+        {
+            // project the hit back onto the surface to drop the error of ray(t)
+            Vector3f pLocal = ray(hit.tHit) - center;
+            pLocal *= radius / Length(pLocal);
+            if (pLocal.x == 0 && pLocal.y == 0)
+                pLocal.x = 1e-5f * radius;
+
+            Float phi = std::atan2(pLocal.y, pLocal.x);
+            if (phi < 0)
+                phi += 2 * Pi;
+            Float cosTheta = Clamp(pLocal.z / radius, -1, 1);
+            Float theta = SafeACos(cosTheta);
+            Point2f uv(phi / (2 * Pi), 1 - theta / Pi);
+
+            Float zRadius = std::sqrt(Sqr(pLocal.x) + Sqr(pLocal.y));
+            Float cosPhi = pLocal.x / zRadius, sinPhi = pLocal.y / zRadius;
+            Float sinTheta = SafeSqrt(1 - Sqr(cosTheta));
+            Vector3f dpdu(-2 * Pi * pLocal.y, 2 * Pi * pLocal.x, 0);
+            Vector3f dpdv = Pi * Vector3f(-pLocal.z * cosPhi, -pLocal.z * sinPhi, radius * sinTheta);
+
+            // the outward normal is (p - center) / radius, so its derivatives scale those of p
+            Normal3f dndu(dpdu / radius), dndv(dpdv / radius);
+
+            SurfaceInteraction si(center + pLocal, uv, -ray.d, dpdu, dpdv, dndu, dndv, ray.time, false);
+            si.primIndex = hit.primIndex;
+            si.geomIndex = hit.geomIndex;
+            return si;
+        }
+
+        // any-hit tests for shadow rays; a sphere hit carries nothing beyond t
+        bool IntersectP(const Ray &ray, Float tMax) const { return Intersect(ray, tMax).has_value(); }
+
+        MaskN IntersectP(const RayPacket &rays, FloatN tMax) const
+        {
+            FloatN tHit(0.f);
+            return Intersect(rays, tMax, &tHit);
+        }
+    };
+
+    /*
+     *  Many spheres, e.g. particles. Centers and radii are stored SoA in
+     *  BVH leaf order, 16 bytes per sphere plus its share of the nodes, and
+     *  every leaf holds up to SIMDWidth consecutive spheres, so a ray tests
+     *  a whole leaf with one load per coordinate. Hits report the sphere's
+     *  leaf slot in primIndex, which is what GetSphere and Interaction
+     *  take. No mapping back to the input order is kept; a caller that
+     *  needs one passes inputIndices to receive the input index of every
+     *  slot and keeps it itself.
+     */
+    class SphereSet
+    {
+    public:
+        SphereSet() = default;
+        explicit SphereSet(const std::vector<Sphere> &spheres,
+                           BVHBuildMethod method = BVHBuildMethod::SAH,
+                           std::vector<uint32_t> *inputIndices = nullptr)
+        {
+            std::vector<Bounds3f> sphereBounds;
+            sphereBounds.reserve(spheres.size());
+            for (const Sphere &sphere : spheres)
+                sphereBounds.push_back(sphere.Bounds());
+            bvh = BVH(sphereBounds, SIMDWidth, method, SIMDWidth);
+
+            // a leaf at the end reads up to SIMDWidth - 1 lanes past the last sphere
+            count = spheres.size();
+            size_t nPadded = count + SIMDWidth - 1;
+            for (std::vector<float> *v : {&cx, &cy, &cz, &r})
+                v->assign(nPadded, 0.f);
+            std::vector<uint32_t> primIndices = bvh.TakePrimitiveIndices();
+            for (size_t i = 0; i < primIndices.size(); ++i)
+            {
+                const Sphere &sphere = spheres[primIndices[i]];
+                cx[i] = sphere.center.x;
+                cy[i] = sphere.center.y;
+                cz[i] = sphere.center.z;
+                r[i] = sphere.radius;
+            }
+            if (inputIndices)
+                *inputIndices = std::move(primIndices);
+        }
+
+        Bounds3f Bounds() const { return bvh.Bounds(); }
+
+        size_t size() const { return count; }
+
+        // sphere by its leaf slot, as reported in primIndex
+        Sphere GetSphere(uint32_t slot) const { return Sphere(Point3f(cx[slot], cy[slot], cz[slot]), r[slot]); }
+
+        std::optional<ShapeHit> Intersect(const Ray &ray) const
+        {
+            std::optional<ShapeHit> closest;
+            Vector3fN d = Broadcast(ray.d);
+            bvh.Intersect(ray, [&](int offset, int nSpheres, Float &tMax) {
+                FloatN t(Infinity);
+                MaskN hit = intersectLeaf(offset, nSpheres, ray.o, d, ray.tMin, tMax, &t);
+                if (hit.None())
+                    return false;
+
+                // closest lane of the leaf
+                Float tClosest = ReduceMin(Select(hit, t, FloatN(Infinity)));
+                int lane = CountTrailingZeros((hit & (t == FloatN(tClosest))).Bits());
+                tMax = tClosest;
+                closest = ShapeHit{tClosest, uint32_t(offset + lane)};
+                return true;
+            });
+            return closest;
+        }
+
+        // closest hit per lane; coherent packets test each sphere of a leaf against all lanes
+        RayPacketHit Intersect(const RayPacket &rays) const
+        {
+            RayPacketHit result;
+            result.valid = bvh.Intersect(rays, [&](int offset, int nSpheres, FloatN &tMax, MaskN active) {
+                // lanes that missed the leaf get an empty interval and cannot hit
+                FloatN leafTMax = Select(active, tMax, FloatN(-Infinity));
+                MaskN hit(false);
+                for (int i = offset; i < offset + nSpheres; ++i)
+                {
+                    MaskN sphereHit = IntersectSphereLanes(rays.o - Point3fN(cx[i], cy[i], cz[i]), rays.d,
+                                                           FloatN(r[i]), rays.tMin, leafTMax, &result.tHit);
+                    if (sphereHit.None())
+                        continue;
+                    leafTMax = Select(sphereHit, result.tHit, leafTMax);
+                    for (uint32_t bits = sphereHit.Bits(); bits != 0; bits &= bits - 1)
+                        result.primIndex[CountTrailingZeros(bits)] = uint32_t(i);
+                    hit |= sphereHit;
+                }
+                tMax = Select(hit, leafTMax, tMax);
+                return hit;
+            });
+            return result;
+        }
+
+        bool IntersectP(const Ray &ray) const
+        {
+            Vector3fN d = Broadcast(ray.d);
+            return bvh.IntersectP(ray, [&](int offset, int nSpheres) {
+                FloatN t(Infinity);
+                return intersectLeaf(offset, nSpheres, ray.o, d, ray.tMin, ray.tMax, &t).Any();
+            });
+        }
+
+        MaskN IntersectP(const RayPacket &rays) const
+        {
+            return bvh.IntersectP(rays, [&](int offset, int nSpheres, MaskN active) {
+                MaskN blocked(false);
+                FloatN t(Infinity);
+                for (int i = offset; i < offset + nSpheres && AndNot(active, blocked).Any(); ++i)
+                    blocked |= IntersectSphereLanes(rays.o - Point3fN(cx[i], cy[i], cz[i]), rays.d,
+                                                    FloatN(r[i]), rays.tMin, rays.tMax, &t) & active;
+                return blocked;
+            });
+        }
+
+        SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const
+        {
+            return GetSphere(hit.primIndex).Interaction(ray, hit);
+        }
+
+    private:
+        // one ray against the nSpheres spheres starting at offset, all in one go
+        MaskN intersectLeaf(int offset, int nSpheres, Point3f o, const Vector3fN &d, Float tMin,
+                            Float tMax, FloatN *t) const
+        {
+            Vector3fN oc(FloatN(o.x) - FloatN::Load(&cx[offset]), FloatN(o.y) - FloatN::Load(&cy[offset]),
+                         FloatN(o.z) - FloatN::Load(&cz[offset]));
+            MaskN active = MaskN::FromBits((1u << nSpheres) - 1);
+            return IntersectSphereLanes(oc, d, FloatN::Load(&r[offset]), FloatN(tMin), FloatN(tMax), t) &
+                   active;
+        }
+
+    private:
+        BVH bvh;
+        std::vector<float> cx, cy, cz, r;
+        size_t count = 0;
+    };
+}
@@ -0,0 +1,711 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/transform.hpp"
+#include "core/vecmath.hpp"
+#include "scene/bvh.hpp"
+#include "scene/interaction.hpp"
+#include "scene/shape.hpp"
+#include "util/math.hpp"
+#include "util/memory.hpp"
+#include "util/parallel.hpp"
+
+namespace tfrt
+{
+    /*
+     *  Triangles sharing one vertex pool, three vertexIndices per triangle.
+     *  The arrays are usually owned, but can also be borrowed from a mapped
+     *  cache file.
+     */
+    class TriangleMesh
+    {
+    public:
+        TriangleMesh(Buffer<int> vertexIndices, Buffer<Point3f> p, Buffer<Normal3f> n = {},
+                     Buffer<Point2f> uv = {})
+            : nTriangles(int(vertexIndices.size() / 3)), nVertices(int(p.size())),
+              vertexIndices(std::move(vertexIndices)), p(std::move(p)), n(std::move(n)),
+              uv(std::move(uv))
+        {
+            DCHECK(this->vertexIndices.size() % 3 == 0);
+            DCHECK(this->n.empty() || int(this->n.size()) == nVertices);
+            DCHECK(this->uv.empty() || int(this->uv.size()) == nVertices);
+        }
+
+        // vertices and normals are moved into render space once, at load time
+        TriangleMesh(const Transform &renderFromObject, Buffer<int> vertexIndices, Buffer<Point3f> p,
+                     Buffer<Normal3f> n = {}, Buffer<Point2f> uv = {})
+            : TriangleMesh(std::move(vertexIndices), std::move(p), std::move(n), std::move(uv))
+        {
+            renderFromObject.ApplyPoints(this->p.data(), this->p.data(), this->p.size());
+            renderFromObject.ApplyNormals(this->n.data(), this->n.data(), this->n.size());
+        }
+
+        const int *Indices(int triIndex) const { return &vertexIndices[3 * triIndex]; }
+
+        // vertices move linearly from p to pEnd over the shutter interval
+        bool IsAnimated() const { return !pEnd.empty(); }
+
+        // bounds over the whole shutter interval
+        Bounds3f TriangleBounds(int triIndex) const
+        {
+            const int *v = Indices(triIndex);
+            Bounds3f b = Union(Bounds3f(p[v[0]], p[v[1]]), p[v[2]]);
+            if (IsAnimated())
+                b = Union(Union(Union(b, pEnd[v[0]]), pEnd[v[1]]), pEnd[v[2]]);
+            return b;
+        }
+
+        /*
+         *  Full interaction at barycentrics (b1, b2) of a triangle, at the
+         *  given time for animated meshes. Without uv the triangle is mapped
+         *  to (0, 0), (1, 0), (1, 1). The geometric normal is flipped to the
+         *  side of the interpolated vertex normal when the mesh has normals.
+         */
+        SurfaceInteraction Interaction(int triIndex, Float b1, Float b2, Float time, Vector3f wo) const
+        {
+            const int *v = Indices(triIndex);
+            Point3f p0 = p[v[0]], p1 = p[v[1]], p2 = p[v[2]];
+            if (IsAnimated())
+            {
+                p0 = Lerp(time, p0, pEnd[v[0]]);
+                p1 = Lerp(time, p1, pEnd[v[1]]);
+                p2 = Lerp(time, p2, pEnd[v[2]]);
+            }
+            Point2f uv0(0, 0), uv1(1, 0), uv2(1, 1);
+            if (!uv.empty())
+            {
+                uv0 = uv[v[0]];
+                uv1 = uv[v[1]];
+                uv2 = uv[v[2]];
+            }
+            Float b0 = 1 - b1 - b2;
+
+            // solve dp02 = duv02.u * dpdu + duv02.v * dpdv, same for dp12
+            Vector2f duv02 = uv0 - uv2, duv12 = uv1 - uv2;
+            Vector3f dp02 = p0 - p2, dp12 = p1 - p2;
+            Float determinant = DifferenceOfProducts(duv02[0], duv12[1], duv02[1], duv12[0]);
+            bool degenerateUV = std::abs(determinant) < 1e-9f;
+            Vector3f dpdu, dpdv;
+            if (!degenerateUV)
+            {
+                Float invDet = 1 / determinant;
+                dpdu = DifferenceOfProducts(duv12[1], dp02, duv02[1], dp12) * invDet;
+                dpdv = DifferenceOfProducts(duv02[0], dp12, duv12[0], dp02) * invDet;
+            }
+            if (degenerateUV || LengthSquared(Cross(dpdu, dpdv)) == 0)
+                CoordinateSystem(Normalize(Cross(p2 - p0, p1 - p0)), &dpdu, &dpdv);
+
+            Point3f pHit = Point3f(b0 * Vector3f(p0) + b1 * Vector3f(p1) + b2 * Vector3f(p2));
+            Point2f uvHit = Point2f(b0 * Vector2f(uv0) + b1 * Vector2f(uv1) + b2 * Vector2f(uv2));
+            SurfaceInteraction si(pHit, uvHit, wo, dpdu, dpdv, Normal3f(), Normal3f(), time, false);
+            // orient by the winding instead of by the uv parameterization
+            si.n = si.shading.n = Normalize(Normal3f(Cross(dp02, dp12)));
+            if (n.empty())
+                return si;
+
+            Normal3f n0 = n[v[0]], n1 = n[v[1]], n2 = n[v[2]];
+            Normal3f ns = b0 * n0 + b1 * n1 + b2 * n2;
+            ns = LengthSquared(ns) > 0 ? Normalize(ns) : si.n;
+
+            // shading tangents orthogonal to ns, following dpdu where possible
+            Vector3f ss = Normalize(si.dpdu);
+            Vector3f ts = Cross(Vector3f(ns), ss);
+            if (LengthSquared(ts) > 0)
+                ss = Cross(ts, Vector3f(ns));
+            else
+                CoordinateSystem(Vector3f(ns), &ss, &ts);
+
+            Normal3f dndu, dndv;
+            if (degenerateUV)
+            {
+                Vector3f dn = Cross(Vector3f(n2 - n0), Vector3f(n1 - n0));
+                if (LengthSquared(dn) != 0)
+                {
+                    Vector3f dnu, dnv;
+                    CoordinateSystem(dn, &dnu, &dnv);
+                    dndu = Normal3f(dnu);
+                    dndv = Normal3f(dnv);
+                }
+            }
+            else
+            {
+                Float invDet = 1 / determinant;
+                Normal3f dn1 = n0 - n2, dn2 = n1 - n2;
+                dndu = DifferenceOfProducts(duv12[1], dn1, duv02[1], dn2) * invDet;
+                dndv = DifferenceOfProducts(duv02[0], dn2, duv12[0], dn1) * invDet;
+            }
+            si.SetShadingGeometry(ns, ss, ts, dndu, dndv, true);
+            return si;
+        }
+
+    public:
+        int nTriangles, nVertices;
+        Buffer<int> vertexIndices;
+        Buffer<Point3f> p;
+        // render-space vertices at shutter close, empty for static meshes
+        Buffer<Point3f> pEnd;
+        Buffer<Normal3f> n;
+        Buffer<Point2f> uv;
+    };
+
+    struct TriangleIntersection
+    {
+        Float b0, b1, b2;
+        Float t;
+    };
+
+    /*
+     *  Per-ray setup of the watertight test, shared by every triangle the ray
+     *  meets: the axis permutation that makes z the dominant direction and the
+     *  shear that maps the ray onto +z.
+     */
+    struct TriangleRay
+    {
+        TriangleRay() = default;
+        explicit TriangleRay(const Ray &ray) : o(ray.o)
+        {
+            kz = MaxComponentIndex(Abs(ray.d));
+            kx = kz + 1;
+            if (kx == 3)
+                kx = 0;
+            ky = kx + 1;
+            if (ky == 3)
+                ky = 0;
+            int perm[3] = {kx, ky, kz};
+            Vector3f d = Permute(ray.d, perm);
+            Sx = -d.x / d.z;
+            Sy = -d.y / d.z;
+            Sz = 1 / d.z;
+        }
+
+        Point3f o;
+        int kx, ky, kz;
+        Float Sx, Sy, Sz;
+    };
+
+    // watertight ray-triangle test, no gaps or double hits along shared edges
+    inline std::optional<TriangleIntersection> IntersectTriangle(const TriangleRay &r, Float tMin,
+                                                                 Float tMax, Point3f p0,
+                                                                 Point3f p1, Point3f p2)
+    {
+        if (LengthSquared(Cross(p2 - p0, p1 - p0)) == 0)
+            return {};
+
+        // translate to the ray origin, permute and shear
+        Point3f p0t(p0[r.kx] - r.o[r.kx], p0[r.ky] - r.o[r.ky], p0[r.kz] - r.o[r.kz]);
+        Point3f p1t(p1[r.kx] - r.o[r.kx], p1[r.ky] - r.o[r.ky], p1[r.kz] - r.o[r.kz]);
+        Point3f p2t(p2[r.kx] - r.o[r.kx], p2[r.ky] - r.o[r.ky], p2[r.kz] - r.o[r.kz]);
+        p0t.x = FMA(r.Sx, p0t.z, p0t.x);
+        p0t.y = FMA(r.Sy, p0t.z, p0t.y);
+        p1t.x = FMA(r.Sx, p1t.z, p1t.x);
+        p1t.y = FMA(r.Sy, p1t.z, p1t.y);
+        p2t.x = FMA(r.Sx, p2t.z, p2t.x);
+        p2t.y = FMA(r.Sy, p2t.z, p2t.y);
+
+        // edge functions, recomputed in double when one is exactly zero
+        Float e0 = DifferenceOfProducts(p1t.x, p2t.y, p1t.y, p2t.x);
+        Float e1 = DifferenceOfProducts(p2t.x, p0t.y, p2t.y, p0t.x);
+        Float e2 = DifferenceOfProducts(p0t.x, p1t.y, p0t.y, p1t.x);
+        if (sizeof(Float) == sizeof(float) && (e0 == 0 || e1 == 0 || e2 == 0))
+        {
+            double p2txp1ty = double(p2t.x) * double(p1t.y);
+            double p2typ1tx = double(p2t.y) * double(p1t.x);
+            e0 = Float(p2typ1tx - p2txp1ty);
+            double p0txp2ty = double(p0t.x) * double(p2t.y);
+            double p0typ2tx = double(p0t.y) * double(p2t.x);
+            e1 = Float(p0typ2tx - p0txp2ty);
+            double p1txp0ty = double(p1t.x) * double(p0t.y);
+            double p1typ0tx = double(p1t.y) * double(p0t.x);
+            e2 = Float(p1typ0tx - p1txp0ty);
+        }
+
+        if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
+            return {};
+        Float det = e0 + e1 + e2;
+        if (det == 0)
+            return {};
+
+        // scaled hit distance, compared against tMax without dividing
+        p0t.z *= r.Sz;
+        p1t.z *= r.Sz;
+        p2t.z *= r.Sz;
+        Float tScaled = FMA(e0, p0t.z, FMA(e1, p1t.z, e2 * p2t.z));
+        if (det < 0 && (tScaled >= 0 || tScaled < tMax * det))
+            return {};
+        if (det > 0 && (tScaled <= 0 || tScaled > tMax * det))
+            return {};
+
+        Float invDet = 1 / det;
+        Float b0 = e0 * invDet, b1 = e1 * invDet, b2 = e2 * invDet;
+        Float t = tScaled * invDet;
+
+        // reject hits too close to the origin to be sure t > 0
+        Float maxZt = MaxComponentValue(Abs(Vector3f(p0t.z, p1t.z, p2t.z)));
+        Float deltaZ = gamma(3) * maxZt;
+        Float maxXt = MaxComponentValue(Abs(Vector3f(p0t.x, p1t.x, p2t.x)));
+        Float maxYt = MaxComponentValue(Abs(Vector3f(p0t.y, p1t.y, p2t.y)));
+        Float deltaX = gamma(5) * (maxXt + maxZt);
+        Float deltaY = gamma(5) * (maxYt + maxZt);
+        Float deltaE = 2 * (gamma(2) * maxXt * maxYt + deltaY * maxXt + deltaX * maxYt);
+        Float maxE = MaxComponentValue(Abs(Vector3f(e0, e1, e2)));
+        Float deltaT =
+            3 * (gamma(3) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE) * std::abs(invDet);
+        if (t <= deltaT || t < tMin)
+            return {};
+
+        return TriangleIntersection{b0, b1, b2, t};
+    }
+
+    /*
+     *  SIMDWidth triangles with their vertices stored SoA, p[vertex][axis]
+     *  holds that coordinate for every triangle of the group. BVH leaves
+     *  point at groups, so a leaf visit tests all of its triangles at once.
+     */
+    struct TriangleGroup
+    {
+        FloatN p[3][3];
+        uint32_t triIndex[SIMDWidth];
+        int count;
+
+        Point3f Vertex(int lane, int vertex) const
+        {
+            return Point3f(p[vertex][0][lane], p[vertex][1][lane], p[vertex][2][lane]);
+        }
+    };
+
+    /*
+     *  Vectorized part of the group test: returns the lanes hit in
+     *  [tMin, tMax) and, if t is given, stores their t, b1 and b2. Lanes
+     *  with an exactly zero edge function are left to the scalar test and
+     *  returned in zeroEdgeLanes.
+     */
+    inline MaskN IntersectTriangleLanes(const TriangleGroup &g, const TriangleRay &r, Float tMin,
+                                        Float tMax, MaskN *zeroEdgeLanes, float *tLanes = nullptr,
+                                        float *b1Lanes = nullptr, float *b2Lanes = nullptr)
+    {
+        MaskN active = MaskN::FromBits((1u << g.count) - 1);
+
+        FloatN x[3], y[3], z[3];
+        for (int v = 0; v < 3; ++v)
+        {
+            x[v] = g.p[v][r.kx] - FloatN(r.o[r.kx]);
+            y[v] = g.p[v][r.ky] - FloatN(r.o[r.ky]);
+            z[v] = g.p[v][r.kz] - FloatN(r.o[r.kz]);
+            x[v] = FMA(FloatN(r.Sx), z[v], x[v]);
+            y[v] = FMA(FloatN(r.Sy), z[v], y[v]);
+        }
+
+        FloatN e0 = DifferenceOfProducts(x[1], y[2], y[1], x[2]);
+        FloatN e1 = DifferenceOfProducts(x[2], y[0], y[2], x[0]);
+        FloatN e2 = DifferenceOfProducts(x[0], y[1], y[0], x[1]);
+
+        // lanes with an exactly zero edge go through the scalar test and its double fallback
+        const FloatN zero(0.f);
+        MaskN zeroEdge = ((e0 == zero) | (e1 == zero) | (e2 == zero)) & active;
+        *zeroEdgeLanes = zeroEdge;
+        MaskN mask = AndNot(active, zeroEdge);
+        mask = AndNot(mask, ((e0 < zero) | (e1 < zero) | (e2 < zero)) &
+                                ((e0 > zero) | (e1 > zero) | (e2 > zero)));
+        FloatN det = e0 + e1 + e2;
+        mask &= det != zero;
+
+        if (mask.Any())
+        {
+            FloatN Sz(r.Sz);
+            for (int v = 0; v < 3; ++v)
+                z[v] *= Sz;
+            FloatN tScaled = FMA(e0, z[0], FMA(e1, z[1], e2 * z[2]));
+            FloatN tMaxDet = FloatN(tMax) * det;
+            mask = AndNot(mask, (det < zero) & ((tScaled >= zero) | (tScaled < tMaxDet)));
+            mask = AndNot(mask, (det > zero) & ((tScaled <= zero) | (tScaled > tMaxDet)));
+
+            FloatN invDet = 1 / det;
+            FloatN t = tScaled * invDet;
+
+            FloatN maxZt = max(abs(z[0]), max(abs(z[1]), abs(z[2])));
+            FloatN maxXt = max(abs(x[0]), max(abs(x[1]), abs(x[2])));
+            FloatN maxYt = max(abs(y[0]), max(abs(y[1]), abs(y[2])));
+            FloatN deltaZ = gamma(3) * maxZt;
+            FloatN deltaX = gamma(5) * (maxXt + maxZt);
+            FloatN deltaY = gamma(5) * (maxYt + maxZt);
+            FloatN deltaE = 2 * (gamma(2) * maxXt * maxYt + deltaY * maxXt + deltaX * maxYt);
+            FloatN maxE = max(abs(e0), max(abs(e1), abs(e2)));
+            FloatN deltaT = 3 * (gamma(3) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE) * abs(invDet);
+            mask &= (t > deltaT) & (t >= FloatN(tMin));
+
+            if (tLanes)
+            {
+                t.Store(tLanes);
+                (e1 * invDet).Store(b1Lanes);
+                (e2 * invDet).Store(b2Lanes);
+            }
+        }
+        return mask;
+    }
+
+    // closest hit among the triangles of g in [tMin, tMax), same rules as IntersectTriangle
+    inline bool IntersectTriangleGroup(const TriangleGroup &g, const TriangleRay &r, Float tMin,
+                                       Float tMax, ShapeHit *hit)
+    {
+        alignas(32) float tLanes[SIMDWidth], b1Lanes[SIMDWidth], b2Lanes[SIMDWidth];
+        MaskN zeroEdge;
+        MaskN mask = IntersectTriangleLanes(g, r, tMin, tMax, &zeroEdge, tLanes, b1Lanes, b2Lanes);
+
+        bool found = false;
+        Float tClosest = tMax;
+        for (uint32_t bits = mask.Bits(); bits != 0; bits &= bits - 1)
+        {
+            int lane = CountTrailingZeros(bits);
+            if (tLanes[lane] < tClosest)
+            {
+                tClosest = tLanes[lane];
+                *hit = ShapeHit{tLanes[lane], g.triIndex[lane], b1Lanes[lane], b2Lanes[lane]};
+                found = true;
+            }
+        }
+        for (uint32_t bits = zeroEdge.Bits(); bits != 0; bits &= bits - 1)
+        {
+            int lane = CountTrailingZeros(bits);
+            std::optional<TriangleIntersection> ti = IntersectTriangle(
+                r, tMin, tClosest, g.Vertex(lane, 0), g.Vertex(lane, 1), g.Vertex(lane, 2));
+            if (ti)
+            {
+                tClosest = ti->t;
+                *hit = ShapeHit{ti->t, g.triIndex[lane], ti->b1, ti->b2};
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // whether any triangle of g is hit in [tMin, tMax), without computing the hit
+    inline bool IntersectPTriangleGroup(const TriangleGroup &g, const TriangleRay &r, Float tMin,
+                                        Float tMax)
+    {
+        MaskN zeroEdge;
+        if (IntersectTriangleLanes(g, r, tMin, tMax, &zeroEdge).Any())
+            return true;
+        for (uint32_t bits = zeroEdge.Bits(); bits != 0; bits &= bits - 1)
+        {
+            int lane = CountTrailingZeros(bits);
+            if (IntersectTriangle(r, tMin, tMax, g.Vertex(lane, 0), g.Vertex(lane, 1), g.Vertex(lane, 2)))
+                return true;
+        }
+        return false;
+    }
+
+    /*
+     *  BVH over one mesh. Each leaf's triangles are copied into SoA groups of
+     *  SIMDWidth in depth-first order, and leaves index those groups.
+     *
+     *  Animated meshes keep a second set of groups at shutter close and
+     *  interpolate a leaf's groups to the ray time when it is visited; the
+     *  node bounds are refit at both ends of the interval. For meshes that
+     *  deform between frames, Update refits in place and only rebuilds when
+     *  the tree has degraded too far.
+     */
+    class TriangleBVH
+    {
+    public:
+        TriangleBVH() = default;
+        explicit TriangleBVH(std::shared_ptr<const TriangleMesh> m,
+                             BVHBuildMethod method = BVHBuildMethod::SAH)
+            : mesh(std::move(m)), method(method)
+        {
+            std::vector<Bounds3f> triBounds(mesh->nTriangles);
+            for (int i = 0; i < mesh->nTriangles; ++i)
+                triBounds[i] = mesh->TriangleBounds(i);
+            bvh = BVH(triBounds, SIMDWidth, method, SIMDWidth);
+
+            const std::vector<uint32_t> &primIndices = bvh.PrimitiveIndices();
+            bvh.RemapLeaves([&](int offset, int nPrimitives) {
+                int firstGroup = int(groups.size());
+                for (int i = 0; i < nPrimitives; i += SIMDWidth)
+                    groups.push_back(makeGroup(&primIndices[offset + i],
+                                               std::min(SIMDWidth, nPrimitives - i)));
+                return std::make_pair(firstGroup, int(groups.size()) - firstGroup);
+            });
+
+            // the build saw the union over the interval, tighten to each end
+            if (mesh->IsAnimated())
+                refit();
+            builtCost = bvh.SAHCost();
+        }
+
+        // a BVH put together from the parts of one built earlier, as the cache maps them
+        TriangleBVH(std::shared_ptr<const TriangleMesh> m, BVH bvh, Buffer<TriangleGroup> groups,
+                    Buffer<TriangleGroup> endGroups, BVHBuildMethod method, Float builtCost)
+            : mesh(std::move(m)), method(method), bvh(std::move(bvh)), groups(std::move(groups)),
+              endGroups(std::move(endGroups)), builtCost(builtCost) {}
+
+        /*
+         *  Moves the BVH to a new pose of the same mesh: same triangles and
+         *  vertex indices, new positions. The tree is refit unless its SAH
+         *  cost grew past rebuildThreshold times the cost after the last
+         *  build, in which case it is rebuilt; returns whether it was.
+         *  Instances built over this BVH have to be recreated either way.
+         */
+        bool Update(std::shared_ptr<const TriangleMesh> m, Float rebuildThreshold = 1.5f)
+        {
+            DCHECK(m->vertexIndices == mesh->vertexIndices);
+            mesh = std::move(m);
+            refit();
+            if (bvh.SAHCost() <= rebuildThreshold * builtCost)
+                return false;
+            *this = TriangleBVH(std::move(mesh), method);
+            return true;
+        }
+
+        Bounds3f Bounds() const { return bvh.Bounds(); }
+
+        const TriangleMesh &Mesh() const { return *mesh; }
+
+        size_t NodeCount() const { return bvh.Nodes().size(); }
+
+        // the parts the constructor above takes
+        const BVH &Tree() const { return bvh; }
+        const Buffer<TriangleGroup> &Groups() const { return groups; }
+        const Buffer<TriangleGroup> &EndGroups() const { return endGroups; }
+        BVHBuildMethod BuildMethod() const { return method; }
+        Float BuiltCost() const { return builtCost; }
+
+        // closest hit, primIndex is the triangle index and (u, v) = (b1, b2)
+        std::optional<ShapeHit> Intersect(const Ray &ray) const
+        {
+            TriangleRay triRay(ray);
+            std::optional<ShapeHit> closest;
+            TriangleGroup scratch;
+            bvh.Intersect(ray, [&](int offset, int nGroups, Float &tMax) {
+                bool hit = false;
+                for (int i = offset; i < offset + nGroups; ++i)
+                {
+                    ShapeHit si;
+                    if (IntersectTriangleGroup(groupAt(i, ray.time, scratch), triRay, ray.tMin, tMax, &si))
+                    {
+                        tMax = si.tHit;
+                        closest = si;
+                        hit = true;
+                    }
+                }
+                return hit;
+            });
+            return closest;
+        }
+
+        // packets share node fetches; leaves test the lanes that overlap them against the groups
+        RayPacketHit Intersect(const RayPacket &rays) const
+        {
+            alignas(32) float tMin[SIMDWidth], time[SIMDWidth];
+            rays.tMin.Store(tMin);
+            rays.time.Store(time);
+            TriangleRay triRays[SIMDWidth];
+            laneRays(rays, triRays);
+            TriangleGroup scratch;
+
+            RayPacketHit result;
+            alignas(32) float tHit[SIMDWidth], u[SIMDWidth], v[SIMDWidth];
+            result.tHit.Store(tHit);
+            result.u.Store(u);
+            result.v.Store(v);
+
+            result.valid = bvh.Intersect(rays, [&](int offset, int nGroups, FloatN &tMax, MaskN active) {
+                alignas(32) float tMaxLanes[SIMDWidth];
+                tMax.Store(tMaxLanes);
+                uint32_t hitBits = 0;
+                for (uint32_t bits = active.Bits(); bits != 0; bits &= bits - 1)
+                {
+                    int lane = CountTrailingZeros(bits);
+                    for (int i = offset; i < offset + nGroups; ++i)
+                    {
+                        ShapeHit si;
+                        if (IntersectTriangleGroup(groupAt(i, time[lane], scratch), triRays[lane], tMin[lane],
+                                                   tMaxLanes[lane], &si))
+                        {
+                            tMaxLanes[lane] = tHit[lane] = si.tHit;
+                            u[lane] = si.u;
+                            v[lane] = si.v;
+                            result.primIndex[lane] = si.primIndex;
+                            hitBits |= 1u << lane;
+                        }
+                    }
+                }
+                tMax = FloatN::Load(tMaxLanes);
+                return MaskN::FromBits(hitBits);
+            });
+
+            result.tHit = FloatN::Load(tHit);
+            result.u = FloatN::Load(u);
+            result.v = FloatN::Load(v);
+            return result;
+        }
+
+        // full interaction for a hit returned by Intersect
+        SurfaceInteraction Interaction(const Ray &ray, const ShapeHit &hit) const
+        {
+            SurfaceInteraction si = mesh->Interaction(int(hit.primIndex), hit.u, hit.v, ray.time, -ray.d);
+            si.primIndex = hit.primIndex;
+            si.geomIndex = hit.geomIndex;
+            return si;
+        }
+
+        // whether any triangle lies in [ray.tMin, ray.tMax)
+        bool IntersectP(const Ray &ray) const
+        {
+            TriangleRay triRay(ray);
+            TriangleGroup scratch;
+            return bvh.IntersectP(ray, [&](int offset, int nGroups) {
+                for (int i = offset; i < offset + nGroups; ++i)
+                    if (IntersectPTriangleGroup(groupAt(i, ray.time, scratch), triRay, ray.tMin, ray.tMax))
+                        return true;
+                return false;
+            });
+        }
+
+        // blocked lanes of a packet of shadow rays
+        MaskN IntersectP(const RayPacket &rays) const
+        {
+            alignas(32) float tMin[SIMDWidth], tMax[SIMDWidth], time[SIMDWidth];
+            rays.tMin.Store(tMin);
+            rays.tMax.Store(tMax);
+            rays.time.Store(time);
+            TriangleRay triRays[SIMDWidth];
+            laneRays(rays, triRays);
+            TriangleGroup scratch;
+
+            return bvh.IntersectP(rays, [&](int offset, int nGroups, MaskN active) {
+                uint32_t blocked = 0;
+                for (uint32_t bits = active.Bits(); bits != 0; bits &= bits - 1)
+                {
+                    int lane = CountTrailingZeros(bits);
+                    for (int i = offset; i < offset + nGroups; ++i)
+                    {
+                        if (IntersectPTriangleGroup(groupAt(i, time[lane], scratch), triRays[lane], tMin[lane],
+                                                    tMax[lane]))
+                        {
+                            blocked |= 1u << lane;
+                            break;
+                        }
+                    }
+                }
+                return MaskN::FromBits(blocked);
+            });
+        }
+
+    private:
+        // the projected ray of each lane, set up once per packet rather than at every leaf
+        static void laneRays(const RayPacket &rays, TriangleRay triRays[SIMDWidth])
+        {
+            alignas(32) float o[3][SIMDWidth], d[3][SIMDWidth];
+            for (int c = 0; c < 3; ++c)
+            {
+                rays.o[c].Store(o[c]);
+                rays.d[c].Store(d[c]);
+            }
+            for (int lane = 0; lane < SIMDWidth; ++lane)
+                triRays[lane] = TriangleRay(Ray(Point3f(o[0][lane], o[1][lane], o[2][lane]),
+                                                Vector3f(d[0][lane], d[1][lane], d[2][lane])));
+        }
+
+        // group i at the given time, written to scratch when the mesh moves
+        const TriangleGroup &groupAt(int i, Float time, TriangleGroup &scratch) const
+        {
+            if (endGroups.empty())
+                return groups[i];
+            const TriangleGroup &g0 = groups[i], &g1 = endGroups[i];
+            FloatN t1(time), t0(1 - time);
+            for (int vertex = 0; vertex < 3; ++vertex)
+                for (int axis = 0; axis < 3; ++axis)
+                    scratch.p[vertex][axis] = g0.p[vertex][axis] * t0 + g1.p[vertex][axis] * t1;
+            std::copy(g0.triIndex, g0.triIndex + SIMDWidth, scratch.triIndex);
+            scratch.count = g0.count;
+            return scratch;
+        }
+
+        static Bounds3f groupBounds(const TriangleGroup &g)
+        {
+            Point3f pMin, pMax;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                FloatN lo = min(g.p[0][axis], min(g.p[1][axis], g.p[2][axis]));
+                FloatN hi = max(g.p[0][axis], max(g.p[1][axis], g.p[2][axis]));
+                // padding lanes repeat a real triangle, so all lanes can be reduced
+                pMin[axis] = ReduceMin(lo);
+                pMax[axis] = ReduceMax(hi);
+            }
+            return Bounds3f(pMin, pMax);
+        }
+
+        // repacks the groups from the current mesh positions and refits the tree to them
+        void refit()
+        {
+            auto repack = [&](Buffer<TriangleGroup> &target, const Buffer<Point3f> &p) {
+                target.resize(groups.size());
+                ParallelFor(0, int64_t(groups.size()), [&](int64_t i) {
+                    target[i] = makeGroup(groups[i].triIndex, groups[i].count, p);
+                });
+            };
+            auto leafBounds = [](const Buffer<TriangleGroup> &g) {
+                return [&g](int offset, int nGroups) {
+                    Bounds3f b;
+                    for (int i = offset; i < offset + nGroups; ++i)
+                        b = Union(b, groupBounds(g[i]));
+                    return b;
+                };
+            };
+
+            // the triangle order of the groups is kept, only positions change
+            repack(groups, mesh->p);
+            bvh.Refit(leafBounds(groups));
+            if (mesh->IsAnimated())
+            {
+                repack(endGroups, mesh->pEnd);
+                bvh.RefitEnd(leafBounds(endGroups));
+            }
+            else
+                endGroups.clear();
+        }
+
+        TriangleGroup makeGroup(const uint32_t *triIndices, int count) const
+        {
+            return makeGroup(triIndices, count, mesh->p);
+        }
+
+        TriangleGroup makeGroup(const uint32_t *triIndices, int count, const Buffer<Point3f> &p) const
+        {
+            alignas(32) float lanes[3][3][SIMDWidth] = {};
+            TriangleGroup group;
+            group.count = count;
+            for (int lane = 0; lane < SIMDWidth; ++lane)
+            {
+                // padding lanes repeat the last triangle and stay masked off
+                uint32_t triIndex = triIndices[std::min(lane, count - 1)];
+                group.triIndex[lane] = triIndex;
+                const int *v = mesh->Indices(int(triIndex));
+                for (int vertex = 0; vertex < 3; ++vertex)
+                    for (int axis = 0; axis < 3; ++axis)
+                        lanes[vertex][axis][lane] = p[v[vertex]][axis];
+            }
+            for (int vertex = 0; vertex < 3; ++vertex)
+                for (int axis = 0; axis < 3; ++axis)
+                    group.p[vertex][axis] = FloatN::Load(lanes[vertex][axis]);
+            return group;
+        }
+
+    private:
+        std::shared_ptr<const TriangleMesh> mesh;
+        BVHBuildMethod method = BVHBuildMethod::SAH;
+        BVH bvh;
+        Buffer<TriangleGroup> groups, endGroups;
+        Float builtCost = 0;
+    };
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "core/tfrt.hpp"
+#include "core/vecmath.hpp"
+
+namespace tfrt
+{
+    // linear RGB triple; T is float for RGB, double where radiance is accumulated in double
+    template <typename T>
+    class RGBT
+    {
+    public:
+        T r = 0, g = 0, b = 0;
+
+    public:
+        RGBT() = default;
+        RGBT(T r, T g, T b) : r(r), g(g), b(b) {}
+
+        template <typename U>
+        explicit RGBT(RGBT<U> c) : r(T(c.r)), g(T(c.g)), b(T(c.b)) {}
+
+        RGBT operator+(RGBT s) const { return {r + s.r, g + s.g, b + s.b}; }
+        RGBT &operator+=(RGBT s)
+        {
+            r += s.r;
+            g += s.g;
+            b += s.b;
+            return *this;
+        }
+
+        RGBT operator-(RGBT s) const { return {r - s.r, g - s.g, b - s.b}; }
+
+        RGBT operator*(RGBT s) const { return {r * s.r, g * s.g, b * s.b}; }
+        RGBT operator*(T a) const { return {a * r, a * g, a * b}; }
+        RGBT &operator*=(T a)
+        {
+            r *= a;
+            g *= a;
+            b *= a;
+            return *this;
+        }
+
+        friend RGBT operator*(T a, RGBT s) { return s * a; }
+
+        RGBT operator/(T d) const
+        {
+            DCHECK_NE(d, 0);
+            return {r / d, g / d, b / d};
+        }
+
+        bool operator==(RGBT s) const { return r == s.r && g == s.g && b == s.b; }
+        bool operator!=(RGBT s) const { return !(*this == s); }
+
+        T operator[](int c) const
+        {
+            DCHECK(c >= 0 && c < 3);
+            return (c == 0) ? r : (c == 1) ? g : b;
+        }
+
+        T Average() const { return (r + g + b) / 3; }
+
+        std::string ToString() const
+        {
+            return "r:" + std::to_string(r) + ",g:" + std::to_string(g) + ",b:" + std::to_string(b);
+        }
+    };
+
+    using RGB = RGBT<Float>;
+
+    /*
+     *  ------------- sRGB Encoding -------------
+     */
+
+    inline Float LinearToSRGB(Float value)
+    {
+        if (value <= 0.0031308f)
+            return 12.92f * value;
+        return 1.055f * std::pow(value, Float(1 / 2.4)) - 0.055f;
+    }
+
+    inline Float SRGBToLinear(Float value)
+    {
+        if (value <= 0.04045f)
+            return value * (1 / 12.92f);
+        return std::pow((value + 0.055f) * (1 / 1.055f), Float(2.4));
+    }
+
+    // sRGB encoded 8-bit value for linear values sampled uniformly over [0, 1]
+    inline const std::array<uint8_t, 16384> &SRGB8Table()
+    {
+        static const std::array<uint8_t, 16384> table = [] {
+            std::array<uint8_t, 16384> t{};
+            for (size_t i = 0; i < t.size(); ++i)
+                t[i] = uint8_t(std::lround(255 * LinearToSRGB(Float(i) / (t.size() - 1))));
+            return t;
+        }();
+        return table;
+    }
+
+    inline uint8_t LinearToSRGB8(Float value)
+    {
+        const std::array<uint8_t, 16384> &table = SRGB8Table();
+        if (!(value > 0))
+            return 0;
+        if (value >= 1)
+            return 255;
+        return table[size_t(value * (table.size() - 1) + 0.5f)];
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tfrt
+{
+    /*
+     *  A whole file mapped read-only. Pages are read in by the kernel when
+     *  they are first touched, so opening even a large file costs next to
+     *  nothing, and mappings of the same file share the page cache.
+     */
+    class MappedFile
+    {
+    public:
+        // nullptr if the file cannot be opened or mapped
+        static std::shared_ptr<const MappedFile> Open(const std::string &filename)
+        {
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+                return nullptr;
+            struct stat st;
+            void *data = nullptr;
+            bool ok = ::fstat(fd, &st) == 0;
+            if (ok && st.st_size > 0)
+            {
+                data = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                ok = data != MAP_FAILED;
+            }
+            // the mapping stays valid without the descriptor
+            ::close(fd);
+            if (!ok)
+                return nullptr;
+            return std::shared_ptr<const MappedFile>(new MappedFile(data, data ? size_t(st.st_size) : 0));
+        }
+
+        ~MappedFile()
+        {
+            if (data)
+                ::munmap(data, size);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *Data() const { return static_cast<const char *>(data); }
+        size_t Size() const { return size; }
+
+    private:
+        MappedFile(void *data, size_t size) : data(data), size(size) {}
+
+        void *data;
+        size_t size;
+    };
+
+    /*
+     *  64-bit content hash of size bytes (MurmurHash64A), eight bytes per
+     *  step. Good for telling assets apart, not against deliberate
+     *  collisions.
+     */
+    inline uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0)
+    {
+        constexpr uint64_t m = 0xc6a4a7935bd1e995ull;
+        constexpr int r = 47;
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        uint64_t h = seed ^ (uint64_t(size) * m);
+        size_t nWords = size / 8;
+        for (size_t i = 0; i < nWords; ++i)
+        {
+            uint64_t k;
+            std::memcpy(&k, bytes + 8 * i, 8);
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+            h ^= k;
+            h *= m;
+        }
+        if (size_t rest = size % 8)
+        {
+            // the tail as a little-endian word
+            uint64_t k = 0;
+            for (size_t i = 0; i < rest; ++i)
+                k |= uint64_t(bytes[8 * nWords + i]) << (8 * i);
+            h ^= k;
+            h *= m;
+        }
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+        return h;
+    }
+
+    // hash of a file's contents, none if it cannot be read
+    inline std::optional<uint64_t> HashFile(const std::string &filename, uint64_t seed = 0)
+    {
+        std::shared_ptr<const MappedFile> file = MappedFile::Open(filename);
+        if (!file)
+            return {};
+        return HashBytes(file->Data(), file->Size(), seed);
+    }
+}
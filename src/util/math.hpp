@@ -1,6 +1,20 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if !defined(TFRT_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#include <xmmintrin.h>
+#endif
 
 namespace tfrt {
 
@@ -13,6 +27,11 @@ namespace tfrt {
     inline constexpr T Sqr(T v) {
         return v * v;
     }
+
+    template <typename T>
+    inline T CopySign(T mag, T sign) {
+        return std::copysign(mag, sign);
+    }
     
     template <typename Ta, typename Tb, typename Tc, typename Td>
     inline auto SumOfProducts(Ta a, Tb b, Tc c, Td d) {
@@ -21,4 +40,521 @@ namespace tfrt {
         auto error = FMA(c, d, -cd);
         return sumOfProducts + error;
     }
-}
\ No newline at end of file
+
+    template <typename Ta, typename Tb, typename Tc, typename Td>
+    inline auto DifferenceOfProducts(Ta a, Tb b, Tc c, Td d) {
+        auto cd = c * d;
+        auto differenceOfProducts = FMA(a, b, -cd);
+        auto error = FMA(-c, d, cd);
+        return differenceOfProducts + error;
+    }
+
+    // index of the lowest set bit, v must not be 0
+    inline int CountTrailingZeros(uint32_t v) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, v);
+        return int(index);
+#else
+        return __builtin_ctz(v);
+#endif
+    }
+
+    // number of set bits
+    inline int PopCount(uint32_t v) {
+#if defined(_MSC_VER)
+        return int(__popcnt(v));
+#else
+        return __builtin_popcount(v);
+#endif
+    }
+
+    // bit i moves to bit 31 - i; T is uint32_t or a lane-wise integer type
+    template <typename T>
+    inline T ReverseBits32(T v)
+    {
+        v = ((v >> 1) & T(0x55555555u)) | ((v & T(0x55555555u)) << 1);
+        v = ((v >> 2) & T(0x33333333u)) | ((v & T(0x33333333u)) << 2);
+        v = ((v >> 4) & T(0x0f0f0f0fu)) | ((v & T(0x0f0f0f0fu)) << 4);
+        v = ((v >> 8) & T(0x00ff00ffu)) | ((v & T(0x00ff00ffu)) << 8);
+        return (v >> 16) | (v << 16);
+    }
+
+    // spreads the low 10 bits of x so two zero bits follow each one
+    inline constexpr uint32_t LeftShift3(uint32_t x)
+    {
+        if (x == (1 << 10))
+            --x;
+        x = (x | (x << 16)) & 0b00000011000000000000000011111111;
+        x = (x | (x << 8)) & 0b00000011000000001111000000001111;
+        x = (x | (x << 4)) & 0b00000011000011000011000011000011;
+        x = (x | (x << 2)) & 0b00001001001001001001001001001001;
+        return x;
+    }
+
+    // 30-bit Morton code of a point with coordinates in [0, 1024], x in the lowest bit
+    inline constexpr uint32_t EncodeMorton3(float x, float y, float z)
+    {
+        return (LeftShift3(uint32_t(z)) << 2) | (LeftShift3(uint32_t(y)) << 1) | LeftShift3(uint32_t(x));
+    }
+
+    static constexpr float Pi = 3.14159265358979323846f;
+
+    template <typename T, typename U, typename V>
+    inline constexpr T Clamp(T val, U low, V high) {
+        if (val < low)
+            return T(low);
+        if (val > high)
+            return T(high);
+        return val;
+    }
+
+    // sqrt and acos of values that rounding may have pushed just out of the domain
+    inline float SafeSqrt(float x) { return std::sqrt(std::max(0.f, x)); }
+
+    inline float SafeACos(float x) { return std::acos(Clamp(x, -1, 1)); }
+
+    inline constexpr float Radians(float deg) { return (Pi / 180) * deg; }
+    inline constexpr float Degrees(float rad) { return (180 / Pi) * rad; }
+
+    /*
+     *  ------------- Transcendentals -------------
+     *
+     *  Every function takes a float or a FloatN and comes in two tiers.
+     *  The exact tier (RSqrt, Exp, ...) returns what the standard library
+     *  returns, lane by lane for FloatN. The fast tier (FastRSqrt, FastExp,
+     *  ...) is branch-free polynomial code that vectorizes, within a few
+     *  ulps over the domains stated with each function; it does not handle
+     *  NaN arguments. The scalar building blocks below have FloatN
+     *  overloads in simd.hpp, which the templates find through ADL.
+     */
+
+    inline float Select(bool mask, float t, float f) { return mask ? t : f; }
+
+    // a * b + c, fused where the target has FMA; unlike FMA never a libm call
+    inline float MulAdd(float a, float b, float c)
+    {
+#if defined(__FMA__)
+        return std::fma(a, b, c);
+#else
+        return a * b + c;
+#endif
+    }
+
+    inline uint32_t FloatToBits(float f)
+    {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+
+    inline float BitsToFloat(uint32_t u)
+    {
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    // u read as a signed int32, as ToFloat(UInt32N) does per lane
+    inline float ToFloat(uint32_t u) { return float(int32_t(u)); }
+
+    // 1 / sqrt(x) to about 12 bits where the target has an instruction for it
+    inline float RSqrtEstimate(float x)
+    {
+#if !defined(TFRT_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+        return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+        return 1 / std::sqrt(x);
+#endif
+    }
+
+    // f applied to each lane; a float has one
+    template <typename F>
+    inline float MapLanes(float a, F &&f)
+    {
+        return f(a);
+    }
+
+    template <typename F>
+    inline float MapLanes(float a, float b, F &&f)
+    {
+        return f(a, b);
+    }
+
+    namespace detail
+    {
+        // adding 1.5 * 2^23 rounds a float below 2^22 to the nearest integer n,
+        // which then sits in the low mantissa bits as 0x4B400000 + n
+        static constexpr float RoundMagic = 12582912.f;
+
+        // 2^n for an integer-valued n in [-126, 127]
+        template <typename T>
+        inline T Exp2Integer(T n)
+        {
+            return BitsToFloat((FloatToBits(n + RoundMagic) + (127u - 0x4B400000u)) << 23);
+        }
+
+        // sin and cos of r in [-pi/4, pi/4]
+        template <typename T>
+        inline T SinPolynomial(T r, T r2)
+        {
+            T p = MulAdd(MulAdd(T(-1.9515295891e-4f), r2, T(8.3321608736e-3f)), r2, T(-1.6666654611e-1f));
+            return MulAdd(p * r2, r, r);
+        }
+
+        template <typename T>
+        inline T CosPolynomial(T r2)
+        {
+            T p = MulAdd(MulAdd(T(2.443315711809948e-5f), r2, T(-1.388731625493765e-3f)), r2,
+                         T(4.166664568298827e-2f));
+            return MulAdd(p * r2, r2, MulAdd(T(-0.5f), r2, T(1)));
+        }
+
+        /*
+         *  sin(x + quadrant * pi / 2): x is reduced by the nearest multiple q
+         *  of pi / 2, with pi / 2 split in three so the reduction stays exact
+         *  for |x| < 8192, and q + quadrant picks the polynomial and sign.
+         */
+        template <typename T>
+        inline T SinQuadrant(T x, uint32_t quadrant)
+        {
+            T q = (x * T(0.636619772367581343f) + RoundMagic) - RoundMagic;
+            T r = MulAdd(q, T(-1.5703125f), x);
+            r = MulAdd(q, T(-4.837512969970703125e-4f), r);
+            r = MulAdd(q, T(-7.54978995489188216e-8f), r);
+            T r2 = r * r;
+
+            auto k = FloatToBits(q + RoundMagic) + quadrant;
+            auto odd = ToFloat(k & 1u) != T(0);
+            T v = Select(odd, CosPolynomial(r2), SinPolynomial(r, r2));
+            return v * (T(1) - ToFloat(k & 2u));
+        }
+
+        // atan of t in [0, 1], reduced around tan(pi / 8)
+        template <typename T>
+        inline T ATanUnit(T t)
+        {
+            auto large = t > T(0.414213562373095f);
+            T offset = Select(large, T(Pi / 4), T(0));
+            t = Select(large, (t - T(1)) / (t + T(1)), t);
+            T t2 = t * t;
+            T p = MulAdd(MulAdd(MulAdd(T(8.05374449538e-2f), t2, T(-1.38776856032e-1f)), t2, T(1.99777106478e-1f)),
+                         t2, T(-3.33329491539e-1f));
+            return MulAdd(p * t2, t, t) + offset;
+        }
+
+        // asin of a in [0, 0.5], z = a * a
+        template <typename T>
+        inline T ASinPolynomial(T a, T z)
+        {
+            T p = MulAdd(MulAdd(MulAdd(MulAdd(T(4.2163199048e-2f), z, T(2.4181311049e-2f)), z, T(4.5470025998e-2f)),
+                                z, T(7.4953002686e-2f)),
+                         z, T(1.6666752422e-1f));
+            return MulAdd(p * z, a, a);
+        }
+    }
+
+    // exact tier
+
+    template <typename T>
+    inline T RSqrt(T x)
+    {
+        using std::sqrt;
+        return T(1) / sqrt(x);
+    }
+
+    template <typename T>
+    inline T Exp(T x)
+    {
+        return MapLanes(x, [](float v) { return std::exp(v); });
+    }
+
+    template <typename T>
+    inline T Log(T x)
+    {
+        return MapLanes(x, [](float v) { return std::log(v); });
+    }
+
+    template <typename T>
+    inline T Pow(T x, T y)
+    {
+        return MapLanes(x, y, [](float a, float b) { return std::pow(a, b); });
+    }
+
+    template <typename T>
+    inline T Sin(T x)
+    {
+        return MapLanes(x, [](float v) { return std::sin(v); });
+    }
+
+    template <typename T>
+    inline T Cos(T x)
+    {
+        return MapLanes(x, [](float v) { return std::cos(v); });
+    }
+
+    template <typename T>
+    inline T ATan2(T y, T x)
+    {
+        return MapLanes(y, x, [](float a, float b) { return std::atan2(a, b); });
+    }
+
+    template <typename T>
+    inline T ACos(T x)
+    {
+        return MapLanes(x, [](float v) { return std::acos(v); });
+    }
+
+    // fast tier
+
+    // x > 0, normal or large; the estimate refined by one Newton step
+    template <typename T>
+    inline T FastRSqrt(T x)
+    {
+        T y = RSqrtEstimate(x);
+        return y * MulAdd(T(-0.5f) * x, y * y, T(1.5f));
+    }
+
+    // results below 2^-126 are denormals and lose precision, above 88.72 overflow to inf
+    template <typename T>
+    inline T FastExp(T x)
+    {
+        using std::max;
+        using std::min;
+        x = min(max(x, T(-104.f)), T(89.f));
+        T n = (x * T(1.44269504088896341f) + detail::RoundMagic) - detail::RoundMagic;
+        // Cody-Waite: ln 2 in two parts keeps x - n ln 2 exact
+        T r = MulAdd(n, T(-0.693359375f), x);
+        r = MulAdd(n, T(2.12194440e-4f), r);
+
+        T p = MulAdd(T(1.9875691500e-4f), r, T(1.3981999507e-3f));
+        p = MulAdd(p, r, T(8.3334519073e-3f));
+        p = MulAdd(p, r, T(4.1665795894e-2f));
+        p = MulAdd(p, r, T(1.6666665459e-1f));
+        p = MulAdd(p, r, T(5.0000001201e-1f));
+        p = MulAdd(p, r * r, r + T(1));
+
+        // 2^n in two halves, so n = 128 and the denormal range work too
+        T n1 = (n * T(0.5f) + detail::RoundMagic) - detail::RoundMagic;
+        return p * detail::Exp2Integer(n1) * detail::Exp2Integer(n - n1);
+    }
+
+    // log(0) = -inf, log(inf) = inf and negative x give NaN
+    template <typename T>
+    inline T FastLog(T x)
+    {
+        // denormals are scaled up into the normal range first
+        auto tiny = x < T(1.17549435e-38f);
+        T xn = Select(tiny, x * T(8388608.f), x);
+        auto bits = FloatToBits(xn);
+        // xn = m * 2^e with m in [sqrt(1/2), sqrt(2))
+        T e = ToFloat(bits >> 23) - Select(tiny, T(126 + 23), T(126));
+        T m = BitsToFloat((bits & 0x7FFFFFu) | 0x3F000000u);
+        auto low = m < T(0.707106781186547524f);
+        e = Select(low, e - T(1), e);
+        m = Select(low, m + m, m) - T(1);
+
+        T z = m * m;
+        T p = MulAdd(T(7.0376836292e-2f), m, T(-1.1514610310e-1f));
+        p = MulAdd(p, m, T(1.1676998740e-1f));
+        p = MulAdd(p, m, T(-1.2420140846e-1f));
+        p = MulAdd(p, m, T(1.4249322787e-1f));
+        p = MulAdd(p, m, T(-1.6668057665e-1f));
+        p = MulAdd(p, m, T(2.0000714765e-1f));
+        p = MulAdd(p, m, T(-2.4999993993e-1f));
+        p = MulAdd(p, m, T(3.3333331174e-1f));
+        T y = MulAdd(p * m, z, e * T(-2.12194440e-4f));
+        y = MulAdd(T(-0.5f), z, y);
+        T r = MulAdd(e, T(0.693359375f), m + y);
+
+        r = Select(x == T(std::numeric_limits<float>::infinity()), x, r);
+        r = Select(x == T(0), T(-std::numeric_limits<float>::infinity()), r);
+        return Select(x >= T(0), r, T(std::numeric_limits<float>::quiet_NaN()));
+    }
+
+    // x > 0; the error grows with |y * log(x)|, as every exp(y log x) does
+    template <typename T>
+    inline T FastPow(T x, T y)
+    {
+        return FastExp(y * FastLog(x));
+    }
+
+    // |x| < 8192; near the zeros of larger arguments the error is small only absolutely
+    template <typename T>
+    inline T FastSin(T x)
+    {
+        return detail::SinQuadrant(x, 0);
+    }
+
+    template <typename T>
+    inline T FastCos(T x)
+    {
+        return detail::SinQuadrant(x, 1);
+    }
+
+    // finite y and x, atan2(0, 0) = 0
+    template <typename T>
+    inline T FastATan2(T y, T x)
+    {
+        using std::abs;
+        using std::max;
+        using std::min;
+        T ax = abs(x), ay = abs(y);
+        T hi = max(ax, ay);
+        T t = Select(hi == T(0), T(0), min(ax, ay) / hi);
+        T a = detail::ATanUnit(t);
+        a = Select(ay > ax, T(Pi / 2) - a, a);
+        a = Select(x < T(0), T(Pi) - a, a);
+        return Select(y < T(0), -a, a);
+    }
+
+    // |x| <= 1
+    template <typename T>
+    inline T FastACos(T x)
+    {
+        using std::abs;
+        using std::sqrt;
+        T a = abs(x);
+        // near |x| = 1, acos(|x|) = 2 asin(sqrt((1 - |x|) / 2)) has no cancellation
+        T z = T(0.5f) - T(0.5f) * a;
+        T s = sqrt(z);
+        T edge = T(2) * detail::ASinPolynomial(s, z);
+        T edgeACos = Select(x < T(0), T(Pi) - edge, edge);
+        T centre = T(Pi / 2) - detail::ASinPolynomial(x, x * x);
+        return Select(a > T(0.5f), edgeACos, centre);
+    }
+
+    /*
+     *  ------------- SquareMatrix -------------
+     */
+
+    template <int N>
+    class SquareMatrix
+    {
+    public:
+        // identity
+        SquareMatrix()
+        {
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    m[i][j] = (i == j) ? 1 : 0;
+        }
+
+        SquareMatrix(const float mat[N][N])
+        {
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    m[i][j] = mat[i][j];
+        }
+
+        // N * N values in row-major order
+        template <typename... Args>
+        SquareMatrix(float v, Args... args)
+        {
+            static_assert(1 + sizeof...(Args) == N * N, "SquareMatrix needs N * N values");
+            const float values[] = {v, float(args)...};
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    m[i][j] = values[i * N + j];
+        }
+
+        const float *operator[](int i) const { return m[i]; }
+        float *operator[](int i) { return m[i]; }
+
+        bool operator==(const SquareMatrix &o) const
+        {
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    if (m[i][j] != o.m[i][j])
+                        return false;
+            return true;
+        }
+        bool operator!=(const SquareMatrix &o) const { return !(*this == o); }
+
+        bool IsIdentity() const { return *this == SquareMatrix(); }
+
+        SquareMatrix operator*(const SquareMatrix &o) const
+        {
+            SquareMatrix r;
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                {
+                    float sum = 0;
+                    for (int k = 0; k < N; ++k)
+                        sum = FMA(m[i][k], o.m[k][j], sum);
+                    r.m[i][j] = sum;
+                }
+            return r;
+        }
+
+        std::string ToString() const
+        {
+            std::string s = "[ ";
+            for (int i = 0; i < N; ++i)
+            {
+                s += "[ ";
+                for (int j = 0; j < N; ++j)
+                    s += std::to_string(m[i][j]) + (j + 1 < N ? ", " : " ");
+                s += "] ";
+            }
+            return s + "]";
+        }
+
+    private:
+        float m[N][N];
+    };
+
+    template <int N>
+    inline SquareMatrix<N> Transpose(const SquareMatrix<N> &m)
+    {
+        SquareMatrix<N> r;
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+                r[i][j] = m[j][i];
+        return r;
+    }
+
+    // Gauss-Jordan elimination with partial pivoting in double, empty when singular
+    template <int N>
+    inline std::optional<SquareMatrix<N>> Inverse(const SquareMatrix<N> &m)
+    {
+        double a[N][2 * N];
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+            {
+                a[i][j] = m[i][j];
+                a[i][N + j] = (i == j) ? 1 : 0;
+            }
+
+        for (int col = 0; col < N; ++col)
+        {
+            int pivot = col;
+            for (int row = col + 1; row < N; ++row)
+                if (std::abs(a[row][col]) > std::abs(a[pivot][col]))
+                    pivot = row;
+            if (a[pivot][col] == 0)
+                return {};
+            if (pivot != col)
+                for (int j = 0; j < 2 * N; ++j)
+                    std::swap(a[pivot][j], a[col][j]);
+
+            double invPivot = 1 / a[col][col];
+            for (int j = 0; j < 2 * N; ++j)
+                a[col][j] *= invPivot;
+            for (int row = 0; row < N; ++row)
+            {
+                if (row == col || a[row][col] == 0)
+                    continue;
+                double f = a[row][col];
+                for (int j = 0; j < 2 * N; ++j)
+                    a[row][j] -= f * a[col][j];
+            }
+        }
+
+        SquareMatrix<N> r;
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+                r[i][j] = float(a[i][N + j]);
+        return r;
+    }
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "core/vecmath.hpp"
+
+namespace tfrt
+{
+    static constexpr size_t CacheLineSize = 64;
+
+    /*
+     *  Bump-pointer arena for temporaries that live while one tile (or one
+     *  sample of it) is rendered: queues, ray storage, interactions. Alloc
+     *  is a pointer increment and nothing is freed individually; Reset
+     *  releases everything at once. Allocations that do not fit start a
+     *  new block, and the next Reset merges all blocks into one big enough
+     *  for the whole high-water mark, so a loop that allocates the same
+     *  amount every time stops touching the heap after its first pass.
+     *
+     *  Objects are not destroyed, only trivially destructible types or
+     *  containers that clean up themselves (ScratchAllocator) belong here.
+     *  A ScratchBuffer is used by one thread at a time.
+     */
+    class ScratchBuffer
+    {
+    public:
+        explicit ScratchBuffer(size_t size = 256 * 1024) : size(size)
+        {
+            block = allocBlock(size);
+        }
+
+        ~ScratchBuffer()
+        {
+            Reset();
+            freeBlock(block, size);
+        }
+
+        ScratchBuffer(const ScratchBuffer &) = delete;
+        ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+
+        void *Alloc(size_t bytes, size_t align)
+        {
+            DCHECK(align > 0 && (align & (align - 1)) == 0 && align <= CacheLineSize);
+            offset = (offset + align - 1) & ~(align - 1);
+            if (offset + bytes > size)
+                grow(bytes);
+            void *p = block + offset;
+            offset += bytes;
+            return p;
+        }
+
+        template <typename T, typename... Args>
+        T *Alloc(Args &&...args)
+        {
+            return new (Alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // n default-initialized Ts starting on a cache line, arrays of floats and ints are left as they are
+        template <typename T>
+        T *AllocArray(size_t n)
+        {
+            T *p = static_cast<T *>(Alloc(n * sizeof(T), std::max(alignof(T), CacheLineSize)));
+            for (size_t i = 0; i < n; ++i)
+                new (&p[i]) T;
+            return p;
+        }
+
+        // frees everything allocated so far, keeping a single block large enough for all of it
+        void Reset()
+        {
+            if (!retired.empty())
+            {
+                size_t total = size;
+                for (const std::pair<char *, size_t> &b : retired)
+                {
+                    total += b.second;
+                    freeBlock(b.first, b.second);
+                }
+                retired.clear();
+                freeBlock(block, size);
+                size = total;
+                block = allocBlock(size);
+            }
+            offset = 0;
+        }
+
+        // bytes handed out since the last Reset, padding included
+        size_t BytesAllocated() const
+        {
+            size_t bytes = offset;
+            for (const std::pair<char *, size_t> &b : retired)
+                bytes += b.second;
+            return bytes;
+        }
+
+        size_t Capacity() const { return size; }
+
+    private:
+        static char *allocBlock(size_t bytes)
+        {
+            return static_cast<char *>(::operator new(bytes, std::align_val_t(CacheLineSize)));
+        }
+
+        static void freeBlock(char *p, size_t bytes)
+        {
+            ::operator delete(p, bytes, std::align_val_t(CacheLineSize));
+        }
+
+        void grow(size_t bytes)
+        {
+            retired.emplace_back(block, size);
+            size = std::max(2 * size, bytes);
+            block = allocBlock(size);
+            offset = 0;
+        }
+
+        char *block = nullptr;
+        size_t size = 0, offset = 0;
+        // full blocks still holding live allocations, freed by Reset
+        std::vector<std::pair<char *, size_t>> retired;
+    };
+
+    // the calling thread's arena; whatever renders a tile on the thread owns it and resets it afterwards
+    inline ScratchBuffer &ThreadScratchBuffer()
+    {
+        thread_local ScratchBuffer scratch;
+        return scratch;
+    }
+
+    /*
+     *  Standard allocator drawing from a ScratchBuffer, so containers of
+     *  per-tile temporaries avoid the heap. deallocate does nothing; the
+     *  memory comes back with the buffer's Reset, so containers must not
+     *  outlive it.
+     */
+    template <typename T>
+    class ScratchAllocator
+    {
+    public:
+        using value_type = T;
+
+        explicit ScratchAllocator(ScratchBuffer &buffer) : buffer(&buffer) {}
+        template <typename U>
+        ScratchAllocator(const ScratchAllocator<U> &other) : buffer(other.Buffer()) {}
+
+        T *allocate(size_t n)
+        {
+            return static_cast<T *>(buffer->Alloc(n * sizeof(T), std::max(alignof(T), CacheLineSize)));
+        }
+
+        void deallocate(T *, size_t) {}
+
+        ScratchBuffer *Buffer() const { return buffer; }
+
+        template <typename U>
+        bool operator==(const ScratchAllocator<U> &other) const { return buffer == other.Buffer(); }
+        template <typename U>
+        bool operator!=(const ScratchAllocator<U> &other) const { return buffer != other.Buffer(); }
+
+    private:
+        ScratchBuffer *buffer;
+    };
+
+    template <typename T>
+    using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+    /*
+     *  Contiguous array that either owns its elements, in a std::vector, or
+     *  refers to elements stored elsewhere, such as a memory-mapped cache
+     *  file, which owner keeps alive. Reads go straight to the elements
+     *  either way. Anything that changes a borrowed array first copies it
+     *  into owned storage, so borrowed memory is never written.
+     */
+    template <typename T>
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(std::vector<T> v) : owned(std::move(v)) { sync(); }
+        Buffer(std::initializer_list<T> values) : owned(values) { sync(); }
+        Buffer(const T *elements, size_t count, std::shared_ptr<const void> owner)
+            : elements(elements), count(count), owner(std::move(owner)) {}
+
+        Buffer(const Buffer &b) : owned(b.owned), elements(b.elements), count(b.count), owner(b.owner)
+        {
+            if (!owner)
+                sync();
+        }
+        // a moved vector keeps its storage, so elements stays valid
+        Buffer(Buffer &&b) noexcept
+            : owned(std::move(b.owned)), elements(b.elements), count(b.count), owner(std::move(b.owner))
+        {
+            b.elements = nullptr;
+            b.count = 0;
+        }
+        Buffer &operator=(Buffer b) noexcept
+        {
+            std::swap(owned, b.owned);
+            std::swap(elements, b.elements);
+            std::swap(count, b.count);
+            std::swap(owner, b.owner);
+            return *this;
+        }
+
+        // whether the elements live in someone else's memory
+        bool IsBorrowed() const { return owner != nullptr; }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const T *data() const { return elements; }
+        const T &operator[](size_t i) const { return elements[i]; }
+        const T *begin() const { return elements; }
+        const T *end() const { return elements + count; }
+
+        T *data()
+        {
+            own();
+            return owned.data();
+        }
+        T &operator[](size_t i)
+        {
+            own();
+            return owned[i];
+        }
+        T *begin() { return data(); }
+        T *end() { return data() + count; }
+
+        void reserve(size_t n) { change([&] { owned.reserve(n); }); }
+        void resize(size_t n) { change([&] { owned.resize(n); }); }
+        void shrink_to_fit() { change([&] { owned.shrink_to_fit(); }); }
+        void clear() { change([&] { owned.clear(); }); }
+        void push_back(const T &value) { change([&] { owned.push_back(value); }); }
+        template <typename... Args>
+        void emplace_back(Args &&...args)
+        {
+            change([&] { owned.emplace_back(std::forward<Args>(args)...); });
+        }
+
+        friend bool operator==(const Buffer &a, const Buffer &b)
+        {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end());
+        }
+        friend bool operator!=(const Buffer &a, const Buffer &b) { return !(a == b); }
+
+    private:
+        // copies borrowed elements into owned storage
+        void own()
+        {
+            if (!owner)
+                return;
+            owned.assign(elements, elements + count);
+            owner.reset();
+            sync();
+        }
+
+        template <typename F>
+        void change(F &&f)
+        {
+            own();
+            f();
+            sync();
+        }
+
+        void sync()
+        {
+            elements = owned.data();
+            count = owned.size();
+        }
+
+        std::vector<T> owned;
+        const T *elements = nullptr;
+        size_t count = 0;
+        std::shared_ptr<const void> owner;
+    };
+}
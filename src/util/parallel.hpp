@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/bounds.hpp"
+
+namespace tfrt
+{
+    inline int AvailableCores()
+    {
+        return std::max(1, int(std::thread::hardware_concurrency()));
+    }
+
+    namespace detail
+    {
+        // worker index of the current thread, the thread calling ParallelFor is 0
+        inline thread_local int threadIndex = 0;
+        inline thread_local bool insideParallelTask = false;
+    }
+
+    /*
+     *  Persistent pool of worker threads. Every worker owns a deque of task
+     *  indices: it takes work from the front of its own deque and, once that
+     *  runs dry, steals from the back of the other workers' deques. The
+     *  thread calling ParallelFor joins in as worker 0.
+     */
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(int nThreads = AvailableCores())
+            : nWorkers(std::max(1, nThreads)), queues(new WorkQueue[std::max(1, nThreads)])
+        {
+            for (int i = 1; i < nWorkers; ++i)
+                threads.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                shutdown = true;
+            }
+            workCV.notify_all();
+            for (std::thread &thread : threads)
+                thread.join();
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        int size() const { return nWorkers; }
+
+        // calls func(i) for each i in [begin, end) and returns once all calls are done
+        void ParallelFor(int64_t begin, int64_t end, const std::function<void(int64_t)> &func)
+        {
+            if (begin >= end)
+                return;
+            // nested loops run inline on the calling worker
+            if (nWorkers == 1 || detail::insideParallelTask)
+            {
+                for (int64_t i = begin; i < end; ++i)
+                    func(i);
+                return;
+            }
+
+            std::lock_guard<std::mutex> jobLock(jobMutex);
+            int64_t count = end - begin;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                task = &func;
+                remaining.store(count);
+                // contiguous blocks keep each worker walking its share in order
+                for (int w = 0; w < nWorkers; ++w)
+                {
+                    int64_t b = begin + count * w / nWorkers;
+                    int64_t e = begin + count * (w + 1) / nWorkers;
+                    std::lock_guard<std::mutex> queueLock(queues[w].mutex);
+                    for (int64_t i = b; i < e; ++i)
+                        queues[w].tasks.push_back(i);
+                }
+                ++generation;
+            }
+            workCV.notify_all();
+
+            runTasks(0);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            doneCV.wait(lock, [this] { return remaining.load() == 0; });
+            task = nullptr;
+        }
+
+    private:
+        struct alignas(64) WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<int64_t> tasks;
+        };
+
+        bool popLocal(int w, int64_t &index)
+        {
+            std::lock_guard<std::mutex> lock(queues[w].mutex);
+            if (queues[w].tasks.empty())
+                return false;
+            index = queues[w].tasks.front();
+            queues[w].tasks.pop_front();
+            return true;
+        }
+
+        bool steal(int w, int64_t &index)
+        {
+            for (int k = 1; k < nWorkers; ++k)
+            {
+                WorkQueue &victim = queues[(w + k) % nWorkers];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    index = victim.tasks.back();
+                    victim.tasks.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void runTasks(int w)
+        {
+            detail::insideParallelTask = true;
+            int64_t index;
+            while (popLocal(w, index) || steal(w, index))
+            {
+                (*task)(index);
+                if (remaining.fetch_sub(1) == 1)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    doneCV.notify_all();
+                }
+            }
+            detail::insideParallelTask = false;
+        }
+
+        void workerLoop(int w)
+        {
+            detail::threadIndex = w;
+            uint64_t seenGeneration = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    workCV.wait(lock, [&] { return shutdown || generation != seenGeneration; });
+                    if (shutdown)
+                        return;
+                    seenGeneration = generation;
+                }
+                runTasks(w);
+            }
+        }
+
+    private:
+        int nWorkers;
+        std::unique_ptr<WorkQueue[]> queues;
+        std::vector<std::thread> threads;
+
+        std::mutex jobMutex; // one ParallelFor at a time
+        std::mutex mutex;
+        std::condition_variable workCV, doneCV;
+        uint64_t generation = 0;
+        bool shutdown = false;
+
+        const std::function<void(int64_t)> *task = nullptr;
+        std::atomic<int64_t> remaining{0};
+    };
+
+    /*
+     *  ------------- Global Pool -------------
+     */
+
+    inline std::unique_ptr<ThreadPool> &GlobalThreadPool()
+    {
+        static std::unique_ptr<ThreadPool> pool;
+        return pool;
+    }
+
+    inline void ParallelInit(int nThreads = AvailableCores())
+    {
+        GlobalThreadPool() = std::make_unique<ThreadPool>(nThreads);
+    }
+
+    inline void ParallelCleanup() { GlobalThreadPool().reset(); }
+
+    // number of workers, per-thread data can be indexed by ThreadIndex()
+    inline int MaxThreadIndex()
+    {
+        return GlobalThreadPool() ? GlobalThreadPool()->size() : 1;
+    }
+
+    inline int ThreadIndex() { return detail::threadIndex; }
+
+    inline void ParallelFor(int64_t begin, int64_t end, const std::function<void(int64_t)> &func)
+    {
+        if (GlobalThreadPool())
+            GlobalThreadPool()->ParallelFor(begin, end, func);
+        else
+            for (int64_t i = begin; i < end; ++i)
+                func(i);
+    }
+
+    // splits extent into tileSize x tileSize tiles in scanline order
+    inline std::vector<Bounds2i> GenerateTiles(const Bounds2i &extent, int tileSize)
+    {
+        std::vector<Bounds2i> tiles;
+        for (int y = extent.pMin.y; y < extent.pMax.y; y += tileSize)
+            for (int x = extent.pMin.x; x < extent.pMax.x; x += tileSize)
+                tiles.push_back(Intersect(extent, Bounds2i(Point2i(x, y),
+                                                           Point2i(x + tileSize, y + tileSize))));
+        return tiles;
+    }
+
+    inline void ParallelForTiles(const Bounds2i &extent, int tileSize,
+                                 const std::function<void(Bounds2i)> &func)
+    {
+        std::vector<Bounds2i> tiles = GenerateTiles(extent, tileSize);
+        ParallelFor(0, int64_t(tiles.size()), [&](int64_t i) { func(tiles[i]); });
+    }
+}
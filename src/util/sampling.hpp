@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cmath>
+
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/tfrt.hpp"
+#include "core/vecmath.hpp"
+#include "util/math.hpp"
+
+namespace tfrt
+{
+    // maps [0, 1)^2 to the unit disk, keeping strata compact (Shirley and Chiu)
+    inline Point2f SampleUniformDiskConcentric(Point2f u)
+    {
+        Float ox = 2 * u.x - 1, oy = 2 * u.y - 1;
+        if (ox == 0 && oy == 0)
+            return Point2f(0, 0);
+        Float r, theta;
+        if (std::abs(ox) > std::abs(oy))
+        {
+            r = ox;
+            theta = (Pi / 4) * (oy / ox);
+        }
+        else
+        {
+            r = oy;
+            theta = Pi / 2 - (Pi / 4) * (ox / oy);
+        }
+        return Point2f(r * std::cos(theta), r * std::sin(theta));
+    }
+
+    // direction about +z with density cos(theta) / pi (Malley's method)
+    inline Vector3f SampleCosineHemisphere(Point2f u)
+    {
+        Point2f d = SampleUniformDiskConcentric(u);
+        Float z = SafeSqrt(1 - Sqr(d.x) - Sqr(d.y));
+        return Vector3f(d.x, d.y, z);
+    }
+
+    // SampleCosineHemisphere of (u0, u1) for SIMDWidth samples, the disk cases selected per lane
+    inline Vector3fN SampleCosineHemisphere(FloatN u0, FloatN u1)
+    {
+        FloatN ox = 2 * u0 - 1, oy = 2 * u1 - 1;
+        MaskN xMajor = abs(ox) > abs(oy);
+        FloatN r = Select(xMajor, ox, oy);
+        FloatN theta = Select(xMajor, (Pi / 4) * (oy / ox), Pi / 2 - (Pi / 4) * (ox / oy));
+        // the centre maps to itself, whatever the 0 / 0 angle came out as
+        MaskN centre = (ox == FloatN(0.f)) & (oy == FloatN(0.f));
+        FloatN dx = Select(centre, FloatN(0.f), r * Cos(theta));
+        FloatN dy = Select(centre, FloatN(0.f), r * Sin(theta));
+        FloatN z = SafeSqrt(1 - Sqr(dx) - Sqr(dy));
+        return Vector3fN(dx, dy, z);
+    }
+
+    inline Float CosineHemispherePDF(Float cosTheta) { return cosTheta / Pi; }
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+namespace tfrt
+{
+    // set by the TFRT_STATS build option; without it every Count* call compiles to nothing
+#ifdef TFRT_STATS
+    static constexpr bool StatsEnabled = true;
+#else
+    static constexpr bool StatsEnabled = false;
+#endif
+
+    enum class RayKind
+    {
+        Camera,
+        Bounce,
+        Shadow
+    };
+    static constexpr int NumRayKinds = 3;
+
+    // paths of this many vertices or more share the last bucket
+    static constexpr int PathLengthBuckets = 16;
+    // bucket i holds tiles that took [2^i, 2^(i+1)) microseconds
+    static constexpr int TileTimeBuckets = 32;
+
+    /*
+     *  What a render did, for finding out why it is slow. Every thread
+     *  counts into its own RenderStats; GatherStats adds them up.
+     *
+     *  Single rays and packets are counted apart: a packet visits a node
+     *  for all its lanes at once, and laneHits / (packetNodeVisits *
+     *  SIMDWidth) is how much of each fetch the packet used. A BVH below
+     *  an instance counts as a traversal of its own. primitiveTests are
+     *  BVH primitives handed to a leaf test times the rays testing them.
+     */
+    struct RenderStats
+    {
+        int64_t rays[NumRayKinds] = {};
+        int64_t rayTraversals = 0, rayNodeVisits = 0;
+        int64_t packetTraversals = 0, packetNodeVisits = 0, laneHits = 0;
+        int64_t primitiveTests = 0;
+        // paths by number of surface vertices, 0 for a camera ray that missed
+        int64_t pathLengths[PathLengthBuckets] = {};
+        int64_t tiles = 0, tileNanoseconds = 0;
+        int64_t tileTimes[TileTimeBuckets] = {};
+
+        RenderStats &operator+=(const RenderStats &s)
+        {
+            for (int i = 0; i < NumRayKinds; ++i)
+                rays[i] += s.rays[i];
+            rayTraversals += s.rayTraversals;
+            rayNodeVisits += s.rayNodeVisits;
+            packetTraversals += s.packetTraversals;
+            packetNodeVisits += s.packetNodeVisits;
+            laneHits += s.laneHits;
+            primitiveTests += s.primitiveTests;
+            for (int i = 0; i < PathLengthBuckets; ++i)
+                pathLengths[i] += s.pathLengths[i];
+            tiles += s.tiles;
+            tileNanoseconds += s.tileNanoseconds;
+            for (int i = 0; i < TileTimeBuckets; ++i)
+                tileTimes[i] += s.tileTimes[i];
+            return *this;
+        }
+
+        int64_t Rays() const { return rays[0] + rays[1] + rays[2]; }
+
+        // share of the lanes of each packet node fetch that needed the node
+        double LaneUtilization(int simdWidth) const
+        {
+            return packetNodeVisits > 0 ? double(laneHits) / (double(packetNodeVisits) * simdWidth) : 0;
+        }
+
+        // the end-of-render summary, histograms as one line per bucket with a bar
+        void Print(std::ostream &os, int simdWidth) const
+        {
+            auto ratio = [](int64_t a, int64_t b) { return b > 0 ? double(a) / b : 0.; };
+            char line[160];
+            os << "statistics:\n";
+            std::snprintf(line, sizeof(line), "  rays               %lld camera, %lld bounce, %lld shadow\n",
+                          (long long)rays[0], (long long)rays[1], (long long)rays[2]);
+            os << line;
+            std::snprintf(line, sizeof(line),
+                          "  BVH single rays    %lld traversals, %.1f nodes each\n"
+                          "  BVH packets        %lld traversals, %.1f nodes each, %.1f%% of lanes active\n",
+                          (long long)rayTraversals, ratio(rayNodeVisits, rayTraversals),
+                          (long long)packetTraversals, ratio(packetNodeVisits, packetTraversals),
+                          100 * LaneUtilization(simdWidth));
+            os << line;
+            std::snprintf(line, sizeof(line), "  primitive tests    %lld, %.1f per ray\n", (long long)primitiveTests,
+                          ratio(primitiveTests, Rays()));
+            os << line;
+
+            os << "  path length (surface vertices)\n";
+            printHistogram(os, pathLengths, PathLengthBuckets, [](int i) {
+                return std::to_string(i) + (i + 1 == PathLengthBuckets ? "+" : "");
+            });
+
+            std::snprintf(line, sizeof(line), "  tile time          %lld tiles, %.3f ms each on average\n",
+                          (long long)tiles, ratio(tileNanoseconds, tiles) * 1e-6);
+            os << line;
+            printHistogram(os, tileTimes, TileTimeBuckets, [](int i) {
+                char range[32];
+                std::snprintf(range, sizeof(range), "%.3g - %.3g ms", std::ldexp(1e-3, i), std::ldexp(1e-3, i + 1));
+                return std::string(range);
+            });
+        }
+
+    private:
+        // buckets from the first to the last non-empty one, bars scaled to the fullest
+        template <typename LabelFn>
+        static void printHistogram(std::ostream &os, const int64_t *counts, int n, LabelFn &&label)
+        {
+            int first = 0, last = n - 1;
+            while (first < n && counts[first] == 0)
+                ++first;
+            while (last > first && counts[last] == 0)
+                --last;
+            int64_t total = 0, most = 0;
+            for (int i = 0; i < n; ++i)
+            {
+                total += counts[i];
+                most = std::max(most, counts[i]);
+            }
+            char line[160];
+            for (int i = first; i <= last; ++i)
+            {
+                std::snprintf(line, sizeof(line), "    %-20s %12lld %6.2f%% ", label(i).c_str(),
+                              (long long)counts[i], 100. * counts[i] / total);
+                os << line << std::string(size_t(40 * counts[i] / most), '#') << '\n';
+            }
+        }
+    };
+
+    namespace detail
+    {
+        // one per thread that has counted, linked into a list that is only ever pushed to
+        struct ThreadStatsBlock
+        {
+            RenderStats stats;
+            std::atomic<bool> inUse{true};
+            ThreadStatsBlock *next = nullptr;
+        };
+
+        inline std::atomic<ThreadStatsBlock *> statsBlocks{nullptr};
+        inline thread_local RenderStats *threadStats = nullptr;
+
+        // gives the block back when its thread exits, the counts stay in it
+        struct ThreadStatsRelease
+        {
+            ThreadStatsBlock *block;
+            ~ThreadStatsRelease() { block->inUse.store(false, std::memory_order_release); }
+        };
+
+        inline RenderStats &AcquireThreadStats()
+        {
+            // reuse the block of a finished thread, else push a new one; blocks are never freed
+            ThreadStatsBlock *block = statsBlocks.load(std::memory_order_acquire);
+            for (; block; block = block->next)
+            {
+                bool free = false;
+                if (block->inUse.compare_exchange_strong(free, true, std::memory_order_acquire))
+                    break;
+            }
+            if (!block)
+            {
+                block = new ThreadStatsBlock;
+                block->next = statsBlocks.load(std::memory_order_relaxed);
+                while (!statsBlocks.compare_exchange_weak(block->next, block, std::memory_order_release,
+                                                          std::memory_order_relaxed))
+                    ;
+            }
+            thread_local ThreadStatsRelease release{block};
+            threadStats = &block->stats;
+            return block->stats;
+        }
+    }
+
+    // the calling thread's counters
+    inline RenderStats &ThreadStats()
+    {
+        RenderStats *stats = detail::threadStats;
+        return stats ? *stats : detail::AcquireThreadStats();
+    }
+
+    /*
+     *  Sums the counters of every thread. Threads count without any
+     *  synchronization, so call it while no render is running, e.g. after
+     *  the ParallelFor that rendered the image has returned.
+     */
+    inline RenderStats GatherStats()
+    {
+        RenderStats total;
+        for (detail::ThreadStatsBlock *block = detail::statsBlocks.load(std::memory_order_acquire); block;
+             block = block->next)
+            total += block->stats;
+        return total;
+    }
+
+    // zeroes every thread's counters, with the same restriction as GatherStats
+    inline void ResetStats()
+    {
+        for (detail::ThreadStatsBlock *block = detail::statsBlocks.load(std::memory_order_acquire); block;
+             block = block->next)
+            block->stats = RenderStats();
+    }
+
+    inline void CountRays(RayKind kind, int64_t n)
+    {
+        if constexpr (StatsEnabled)
+            ThreadStats().rays[int(kind)] += n;
+    }
+
+    /*
+     *  Counts one single-ray BVH traversal straight into the thread's
+     *  statistics, which measured cheaper in the traversal loop than local
+     *  counters added at the end. Does nothing without TFRT_STATS.
+     */
+    class RayTraversalStats
+    {
+    public:
+        RayTraversalStats()
+        {
+            if constexpr (StatsEnabled)
+            {
+                stats = &ThreadStats();
+                ++stats->rayTraversals;
+            }
+        }
+
+        void VisitNode()
+        {
+            if constexpr (StatsEnabled)
+                ++stats->rayNodeVisits;
+        }
+
+        void TestPrimitives(int n)
+        {
+            if constexpr (StatsEnabled)
+                stats->primitiveTests += n;
+        }
+
+    private:
+        RenderStats *stats = nullptr;
+    };
+
+    inline void CountPacketTraversal(int64_t nodeVisits, int64_t laneHits, int64_t primitiveTests)
+    {
+        if constexpr (StatsEnabled)
+        {
+            RenderStats &stats = ThreadStats();
+            ++stats.packetTraversals;
+            stats.packetNodeVisits += nodeVisits;
+            stats.laneHits += laneHits;
+            stats.primitiveTests += primitiveTests;
+        }
+    }
+
+    // n paths that ended after the given number of surface vertices
+    inline void CountPathLength(int vertices, int64_t n = 1)
+    {
+        if constexpr (StatsEnabled)
+            ThreadStats().pathLengths[std::min(vertices, PathLengthBuckets - 1)] += n;
+    }
+
+    inline void CountTile(double seconds)
+    {
+        if constexpr (StatsEnabled)
+        {
+            RenderStats &stats = ThreadStats();
+            ++stats.tiles;
+            stats.tileNanoseconds += int64_t(seconds * 1e9);
+            int bucket = seconds * 1e6 >= 1 ? int(std::log2(seconds * 1e6)) : 0;
+            ++stats.tileTimes[std::min(bucket, TileTimeBuckets - 1)];
+        }
+    }
+}
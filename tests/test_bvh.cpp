@@ -0,0 +1,342 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "scene/bvh.hpp"
+#include "scene/sphere.hpp"
+#include "util/math.hpp"
+#include "util/parallel.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+std::vector<tfrt::Sphere> RandomSpheres(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(-10.f, 10.f);
+    std::uniform_real_distribution<float> rad(0.05f, 0.5f);
+    std::vector<tfrt::Sphere> spheres;
+    for (int i = 0; i < n; ++i)
+        spheres.emplace_back(tfrt::Point3f(pos(rng), pos(rng), pos(rng)), rad(rng));
+    return spheres;
+}
+
+std::optional<tfrt::ShapeHit> BruteForce(const std::vector<tfrt::Sphere> &spheres,
+                                         const tfrt::Ray &ray) {
+    std::optional<tfrt::ShapeHit> closest;
+    tfrt::Float tMax = ray.tMax;
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        if (auto si = spheres[i].Intersect(ray, tMax)) {
+            tMax = si->tHit;
+            si->primIndex = uint32_t(i);
+            closest = si;
+        }
+    }
+    return closest;
+}
+
+}
+
+/**
+ * ---------------- Bounds3 Test -------------------
+ */
+
+TEST_CASE("Bounds3 union and surface area", "[Bounds3]") {
+    tfrt::Bounds3f b(tfrt::Point3f(0, 0, 0), tfrt::Point3f(1, 2, 3));
+    REQUIRE_THAT(b.SurfaceArea(), WithinULP(22.0f, 0));
+    REQUIRE(b.MaxDimension() == 2);
+
+    auto u = tfrt::Union(b, tfrt::Point3f(-1, 0, 0));
+    REQUIRE_THAT(u.pMin.x, WithinULP(-1.0f, 0));
+    REQUIRE(tfrt::Inside(tfrt::Point3f(0.5f, 1, 1), u));
+    REQUIRE_FALSE(tfrt::Inside(tfrt::Point3f(0.5f, 3, 1), u));
+}
+
+TEST_CASE("Bounds3 slab test with cached reciprocal direction", "[Bounds3]") {
+    tfrt::Bounds3f b(tfrt::Point3f(-1, -1, -1), tfrt::Point3f(1, 1, 1));
+
+    tfrt::Ray ray(tfrt::Point3f(0, 0, -5), tfrt::Vector3f(0, 0, 1));
+    REQUIRE(b.IntersectP(tfrt::TraversalRay(ray), tfrt::Infinity));
+    REQUIRE_FALSE(b.IntersectP(tfrt::TraversalRay(ray), 3.5f));
+
+    // origin behind the ray start interval
+    ray.tMin = 7;
+    REQUIRE_FALSE(b.IntersectP(tfrt::TraversalRay(ray), tfrt::Infinity));
+
+    // origin on a slab plane with a zero direction component gives 0 * inf
+    tfrt::Ray grazing(tfrt::Point3f(1, 0, -5), tfrt::Vector3f(0, 0, 1));
+    REQUIRE(b.IntersectP(tfrt::TraversalRay(grazing), tfrt::Infinity));
+    tfrt::Ray outside(tfrt::Point3f(1.5f, 0, -5), tfrt::Vector3f(0, 0, 1));
+    REQUIRE_FALSE(b.IntersectP(tfrt::TraversalRay(outside), tfrt::Infinity));
+}
+
+TEST_CASE("Bounds3 slab test works on integer bounds", "[Bounds3]") {
+    tfrt::Bounds3i b(tfrt::Point3i(0, 0, 0), tfrt::Point3i(2, 2, 2));
+    tfrt::Ray ray(tfrt::Point3f(1, 1, -5), tfrt::Vector3f(0, 0, 1));
+    REQUIRE(b.IntersectP(tfrt::TraversalRay(ray), tfrt::Infinity));
+    REQUIRE_FALSE(b.IntersectP(tfrt::TraversalRay(ray), 4.5f));
+    tfrt::Ray past(tfrt::Point3f(2.5f, 1, -5), tfrt::Vector3f(0, 0, 1));
+    REQUIRE_FALSE(b.IntersectP(tfrt::TraversalRay(past), tfrt::Infinity));
+}
+
+TEST_CASE("Bounds3fN tests one ray against several boxes", "[Bounds3]") {
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> u(-5.f, 5.f);
+    for (int i = 0; i < 200; ++i) {
+        tfrt::Bounds3f boxes[tfrt::SIMDWidth];
+        int n = 1 + i % tfrt::SIMDWidth;
+        for (int j = 0; j < n; ++j)
+            boxes[j] = tfrt::Bounds3f(tfrt::Point3f(u(rng), u(rng), u(rng)),
+                                      tfrt::Point3f(u(rng), u(rng), u(rng)));
+        tfrt::Bounds3fN wide(boxes, n);
+
+        tfrt::Ray ray(tfrt::Point3f(u(rng), u(rng), u(rng)),
+                      tfrt::Vector3f(u(rng), u(rng), i % 4 == 0 ? 0.f : u(rng)));
+        tfrt::TraversalRay traversalRay(ray);
+        float tMax = i % 3 == 0 ? 2.f : tfrt::Infinity;
+
+        tfrt::FloatN tEntry;
+        tfrt::MaskN hits = tfrt::IntersectP(wide, traversalRay, tMax, &tEntry);
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            bool expected = j < n && boxes[j].IntersectP(traversalRay, tMax);
+            REQUIRE(hits[j] == expected);
+            if (expected)
+                REQUIRE(tEntry[j] < tMax);
+        }
+    }
+}
+
+TEST_CASE("Packet slab test agrees with the scalar test on grazing rays", "[Bounds3]") {
+    // origins on the slab planes with zero direction components of either sign give 0 * inf
+    tfrt::Bounds3f b(tfrt::Point3f(-1, -1, -1), tfrt::Point3f(1, 1, 1));
+    const float origins[] = {-1.f, 1.f, 0.f, 1.5f, -5.f};
+    const float directions[] = {0.f, -0.f, 1.f, -1.f, 0.3f};
+    std::mt19937 rng(29);
+    std::uniform_int_distribution<int> pickOrigin(0, 4), pickDirection(0, 4);
+    for (int i = 0; i < 500; ++i) {
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        for (tfrt::Ray &ray : rays) {
+            ray = tfrt::Ray(tfrt::Point3f(origins[pickOrigin(rng)], origins[pickOrigin(rng)], -5),
+                            tfrt::Vector3f(directions[pickDirection(rng)], directions[pickDirection(rng)],
+                                           directions[pickDirection(rng)]));
+            ray.tMax = i % 3 == 0 ? 4.5f : tfrt::Infinity;
+        }
+        tfrt::RayPacket packet(rays, tfrt::SIMDWidth);
+        tfrt::Vector3fN invDir(1 / packet.d.x, 1 / packet.d.y, 1 / packet.d.z);
+        tfrt::MaskN hits = tfrt::IntersectP(b, packet.o, packet.tMin, packet.tMax, invDir);
+        for (int j = 0; j < tfrt::SIMDWidth; ++j)
+            REQUIRE(hits[j] == b.IntersectP(tfrt::TraversalRay(rays[j]), rays[j].tMax));
+    }
+}
+
+/**
+ * ---------------- BVH Test -------------------
+ */
+
+TEST_CASE("BVH nodes are 32 bytes", "[BVH]") {
+    REQUIRE(sizeof(tfrt::LinearBVHNode) == 32);
+}
+
+TEST_CASE("BVH closest hit matches brute force", "[BVH]") {
+    auto spheres = RandomSpheres(2000, 7);
+    tfrt::BVHAggregate<tfrt::Sphere> bvh(spheres);
+    REQUIRE(bvh.size() == spheres.size());
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    for (int i = 0; i < 500; ++i) {
+        tfrt::Ray ray(tfrt::Point3f(u(rng) * 15, u(rng) * 15, -20),
+                      tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.5f, u(rng) * 0.5f, 1)));
+        auto expected = BruteForce(spheres, ray);
+        auto actual = bvh.Intersect(ray);
+        REQUIRE(expected.has_value() == actual.has_value());
+        if (expected) {
+            REQUIRE(expected->primIndex == actual->primIndex);
+            REQUIRE_THAT(actual->tHit, WithinULP(expected->tHit, 0));
+        }
+    }
+}
+
+TEST_CASE("BVH honors ray tMax", "[BVH]") {
+    std::vector<tfrt::Sphere> spheres{tfrt::Sphere(tfrt::Point3f(0, 0, 0), 1),
+                                      tfrt::Sphere(tfrt::Point3f(0, 0, 5), 1)};
+    tfrt::BVHAggregate<tfrt::Sphere> bvh(spheres);
+
+    tfrt::Ray ray(tfrt::Point3f(0, 0, -5), tfrt::Vector3f(0, 0, 1));
+    auto hit = bvh.Intersect(ray);
+    REQUIRE(hit);
+    REQUIRE(hit->primIndex == 0);
+    REQUIRE_THAT(hit->tHit, WithinAbs(4.0f, 1e-5));
+
+    ray.tMax = 3.5f;
+    REQUIRE_FALSE(bvh.Intersect(ray));
+}
+
+/**
+ * ---------------- LBVH Test -------------------
+ */
+
+namespace {
+
+// every primitive in exactly one leaf and every child inside its parent
+void RequireWellFormed(const tfrt::BVH &bvh, size_t nPrimitives) {
+    const tfrt::Buffer<tfrt::LinearBVHNode> &nodes = bvh.Nodes();
+    std::vector<int> seen(nPrimitives, 0);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const tfrt::LinearBVHNode &node = nodes[i];
+        if (node.nPrimitives > 0) {
+            for (int j = node.primitivesOffset; j < node.primitivesOffset + node.nPrimitives; ++j)
+                seen[bvh.PrimitiveIndices()[j]]++;
+            continue;
+        }
+        for (int child : {int(i) + 1, node.secondChildOffset}) {
+            REQUIRE(child > int(i));
+            REQUIRE(child < int(nodes.size()));
+            REQUIRE(tfrt::Union(node.bounds, nodes[child].bounds) == node.bounds);
+        }
+    }
+    for (int count : seen)
+        REQUIRE(count == 1);
+}
+
+} // namespace
+
+TEST_CASE("Morton codes interleave x in the lowest bit", "[LBVH]") {
+    REQUIRE(tfrt::EncodeMorton3(1, 0, 0) == 1);
+    REQUIRE(tfrt::EncodeMorton3(0, 1, 0) == 2);
+    REQUIRE(tfrt::EncodeMorton3(0, 0, 1) == 4);
+    REQUIRE(tfrt::EncodeMorton3(1024, 1024, 1024) == (1u << 30) - 1);
+}
+
+TEST_CASE("LBVH and HLBVH builds match brute force", "[LBVH]") {
+    tfrt::ParallelInit(4);
+    auto spheres = RandomSpheres(5000, 19);
+    std::vector<tfrt::Bounds3f> bounds;
+    for (const tfrt::Sphere &s : spheres)
+        bounds.push_back(s.Bounds());
+
+    for (tfrt::BVHBuildMethod method : {tfrt::BVHBuildMethod::LBVH, tfrt::BVHBuildMethod::HLBVH}) {
+        RequireWellFormed(tfrt::BVH(bounds, 4, method), spheres.size());
+
+        tfrt::BVHAggregate<tfrt::Sphere> bvh(spheres, 4, method);
+        std::mt19937 rng(21);
+        std::uniform_real_distribution<float> u(-1.f, 1.f);
+        for (int i = 0; i < 300; ++i) {
+            tfrt::Ray ray(tfrt::Point3f(u(rng) * 15, u(rng) * 15, -20),
+                          tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.5f, u(rng) * 0.5f, 1)));
+            auto expected = BruteForce(spheres, ray);
+            auto actual = bvh.Intersect(ray);
+            REQUIRE(expected.has_value() == actual.has_value());
+            if (expected) {
+                REQUIRE(expected->primIndex == actual->primIndex);
+                REQUIRE_THAT(actual->tHit, WithinULP(expected->tHit, 0));
+            }
+        }
+    }
+    tfrt::ParallelCleanup();
+}
+
+TEST_CASE("LBVH splits primitives with identical centroids", "[LBVH]") {
+    // more coincident primitives than a leaf can hold, plus a few elsewhere
+    std::vector<tfrt::Bounds3f> bounds(1000, tfrt::Bounds3f(tfrt::Point3f(0, 0, 0), tfrt::Point3f(1, 1, 1)));
+    for (int i = 0; i < 10; ++i)
+        bounds.emplace_back(tfrt::Point3f(float(i), 5, 5), tfrt::Point3f(i + 1.f, 6, 6));
+    for (tfrt::BVHBuildMethod method : {tfrt::BVHBuildMethod::LBVH, tfrt::BVHBuildMethod::HLBVH}) {
+        tfrt::BVH bvh(bounds, 4, method);
+        RequireWellFormed(bvh, bounds.size());
+        for (const tfrt::LinearBVHNode &node : bvh.Nodes())
+            REQUIRE(node.nPrimitives <= 4);
+    }
+}
+
+TEST_CASE("HLBVH build over many primitives is well formed", "[LBVH]") {
+    // enough primitives for several radix sort chunks and thousands of treelets
+    tfrt::ParallelInit(4);
+    auto spheres = RandomSpheres(200000, 27);
+    std::vector<tfrt::Bounds3f> bounds;
+    for (const tfrt::Sphere &s : spheres)
+        bounds.push_back(s.Bounds());
+    tfrt::BVH bvh(bounds, 4, tfrt::BVHBuildMethod::HLBVH);
+    RequireWellFormed(bvh, bounds.size());
+    tfrt::ParallelCleanup();
+}
+
+TEST_CASE("BVH depth stays within the traversal stack on skewed input", "[BVH]") {
+    // boxes shrinking geometrically towards the origin down to denormals: the binned SAH
+    // only splits off a few of them per level, the deepest trees it builds from floats
+    std::vector<tfrt::Bounds3f> bounds;
+    for (int k = 0; k < 2500; ++k) {
+        float x = float(std::ldexp(std::pow(0.95, k), 40)), h = 100 * x;
+        bounds.emplace_back(tfrt::Point3f(x - h, -h, -h), tfrt::Point3f(x + h, h, h));
+    }
+
+    tfrt::ParallelInit(1);
+    for (tfrt::BVHBuildMethod method :
+         {tfrt::BVHBuildMethod::SAH, tfrt::BVHBuildMethod::LBVH, tfrt::BVHBuildMethod::HLBVH}) {
+        tfrt::BVH bvh(bounds, 1, method);
+        RequireWellFormed(bvh, bounds.size());
+
+        // interior nodes on the path to each node; the first child directly follows its parent
+        const tfrt::Buffer<tfrt::LinearBVHNode> &nodes = bvh.Nodes();
+        std::vector<int> depth(nodes.size(), 0);
+        int maxDepth = 0;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (nodes[i].nPrimitives > 0)
+                continue;
+            depth[i + 1] = depth[nodes[i].secondChildOffset] = depth[i] + 1;
+            maxDepth = std::max(maxDepth, depth[i] + 1);
+        }
+        REQUIRE(maxDepth <= tfrt::BVH::MaxDepth);
+    }
+    tfrt::ParallelCleanup();
+}
+
+/**
+ * ---------------- Refit Test -------------------
+ */
+
+TEST_CASE("BVH refit keeps the topology and encloses moved primitives", "[Refit]") {
+    auto spheres = RandomSpheres(5000, 29);
+    std::vector<tfrt::Bounds3f> bounds;
+    for (const tfrt::Sphere &s : spheres)
+        bounds.push_back(s.Bounds());
+    tfrt::BVH bvh(bounds);
+    tfrt::Buffer<tfrt::LinearBVHNode> before = bvh.Nodes();
+    tfrt::Float cost = bvh.SAHCost();
+    REQUIRE(cost > 0);
+
+    // shift every primitive by its own offset
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    tfrt::Bounds3f all;
+    for (tfrt::Bounds3f &b : bounds) {
+        tfrt::Vector3f offset(u(rng), u(rng), u(rng));
+        b = tfrt::Bounds3f(b.pMin + offset, b.pMax + offset);
+        all = tfrt::Union(all, b);
+    }
+    const std::vector<uint32_t> &indices = bvh.PrimitiveIndices();
+    bvh.Refit([&](int offset, int n) {
+        tfrt::Bounds3f b;
+        for (int i = offset; i < offset + n; ++i)
+            b = tfrt::Union(b, bounds[indices[i]]);
+        return b;
+    });
+
+    RequireWellFormed(bvh, bounds.size());
+    REQUIRE(bvh.Bounds() == all);
+    REQUIRE(bvh.Nodes().size() == before.size());
+    for (size_t i = 0; i < before.size(); ++i) {
+        REQUIRE(bvh.Nodes()[i].secondChildOffset == before[i].secondChildOffset);
+        REQUIRE(bvh.Nodes()[i].nPrimitives == before[i].nPrimitives);
+    }
+    REQUIRE(bvh.SAHCost() > cost);
+    REQUIRE_FALSE(bvh.HasMotion());
+}
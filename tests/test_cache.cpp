@@ -0,0 +1,297 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "scene/cache.hpp"
+#include "scene/instance.hpp"
+#include "scene/scene.hpp"
+#include "scene/triangle.hpp"
+#include "util/file.hpp"
+#include "util/memory.hpp"
+
+namespace {
+
+// small random triangles with normals and uvs, moving along x when animated
+std::shared_ptr<tfrt::TriangleMesh> RandomMesh(int nTriangles, unsigned seed, bool animated = false) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(-10.f, 10.f), offset(-1.f, 1.f), unit(0.f, 1.f);
+    std::vector<tfrt::Point3f> p;
+    std::vector<tfrt::Normal3f> n;
+    std::vector<tfrt::Point2f> uv;
+    std::vector<int> indices;
+    for (int i = 0; i < nTriangles; ++i) {
+        tfrt::Point3f c(pos(rng), pos(rng), pos(rng));
+        for (int v = 0; v < 3; ++v) {
+            indices.push_back(int(p.size()));
+            p.push_back(c + tfrt::Vector3f(offset(rng), offset(rng), offset(rng)));
+            n.push_back(tfrt::Normalize(tfrt::Normal3f(offset(rng), offset(rng), 1)));
+            uv.emplace_back(unit(rng), unit(rng));
+        }
+    }
+    auto mesh = std::make_shared<tfrt::TriangleMesh>(indices, p, n, uv);
+    if (animated)
+        for (const tfrt::Point3f &q : p)
+            mesh->pEnd.push_back(q + tfrt::Vector3f(2, 0, 0));
+    return mesh;
+}
+
+std::vector<tfrt::Ray> RandomRays(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(-1.f, 1.f), t(0.f, 1.f);
+    std::vector<tfrt::Ray> rays(n);
+    for (tfrt::Ray &ray : rays)
+        ray = tfrt::Ray(tfrt::Point3f(u(rng) * 15, u(rng) * 15, u(rng) * 15),
+                        tfrt::Normalize(tfrt::Vector3f(u(rng), u(rng), u(rng))), t(rng));
+    return rays;
+}
+
+// the same closest hits, interactions and shadow results, for single rays and packets
+void RequireSameHits(const tfrt::TriangleBVH &a, const tfrt::TriangleBVH &b) {
+    std::vector<tfrt::Ray> rays = RandomRays(2048, 3);
+    int nHits = 0;
+    for (const tfrt::Ray &ray : rays) {
+        std::optional<tfrt::ShapeHit> ha = a.Intersect(ray), hb = b.Intersect(ray);
+        REQUIRE(ha.has_value() == hb.has_value());
+        REQUIRE(a.IntersectP(ray) == b.IntersectP(ray));
+        if (!ha)
+            continue;
+        ++nHits;
+        REQUIRE(ha->tHit == hb->tHit);
+        REQUIRE(ha->primIndex == hb->primIndex);
+        tfrt::SurfaceInteraction sa = a.Interaction(ray, *ha), sb = b.Interaction(ray, *hb);
+        REQUIRE(sa.p == sb.p);
+        REQUIRE(sa.shading.n == sb.shading.n);
+        REQUIRE(sa.uv == sb.uv);
+    }
+    REQUIRE(nHits > 100);
+
+    for (size_t i = 0; i + tfrt::SIMDWidth <= rays.size(); i += tfrt::SIMDWidth) {
+        tfrt::RayPacket packet(&rays[i], tfrt::SIMDWidth);
+        tfrt::RayPacketHit ha = a.Intersect(packet), hb = b.Intersect(packet);
+        REQUIRE(ha.valid.Bits() == hb.valid.Bits());
+        REQUIRE(a.IntersectP(packet).Bits() == b.IntersectP(packet).Bits());
+    }
+}
+
+std::string ReadFile(const std::string &filename) {
+    std::ifstream in(filename, std::ifstream::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string &filename, const std::string &data) {
+    std::ofstream(filename, std::ofstream::binary | std::ofstream::trunc).write(data.data(), data.size());
+}
+
+} // namespace
+
+/**
+ * ---------------- Buffer Test -------------------
+ */
+
+TEST_CASE("A borrowed buffer is copied into its own storage before it changes", "[Cache]") {
+    auto storage = std::make_shared<std::vector<int>>(std::vector<int>{1, 2, 3});
+    const tfrt::Buffer<int> borrowed(storage->data(), storage->size(), storage);
+    REQUIRE(borrowed.IsBorrowed());
+    REQUIRE(borrowed.data() == storage->data());
+
+    // reading does not copy, only changing does
+    tfrt::Buffer<int> copy = borrowed;
+    REQUIRE(std::as_const(copy).data() == storage->data());
+    copy.push_back(4);
+    REQUIRE(!copy.IsBorrowed());
+    REQUIRE(copy == tfrt::Buffer<int>{1, 2, 3, 4});
+    copy[0] = 7;
+    REQUIRE((*storage)[0] == 1);
+    REQUIRE(borrowed == tfrt::Buffer<int>{1, 2, 3});
+
+    tfrt::Buffer<int> owned{5, 6};
+    tfrt::Buffer<int> ownedCopy = owned;
+    ownedCopy[1] = 8;
+    REQUIRE(owned[1] == 6);
+    tfrt::Buffer<int> moved = std::move(ownedCopy);
+    REQUIRE(moved == tfrt::Buffer<int>{5, 8});
+}
+
+/**
+ * ---------------- Content Hash Test -------------------
+ */
+
+TEST_CASE("Content hashes tell apart every byte and length", "[Cache]") {
+    std::string data = "the quick brown fox jumps over the lazy dog";
+    uint64_t h = tfrt::HashBytes(data.data(), data.size());
+    REQUIRE(h == tfrt::HashBytes(data.data(), data.size()));
+    REQUIRE(h != tfrt::HashBytes(data.data(), data.size() - 1));
+    REQUIRE(h != tfrt::HashBytes(data.data(), data.size(), 1));
+    for (size_t i = 0; i < data.size(); ++i) {
+        std::string changed = data;
+        changed[i] ^= 1;
+        REQUIRE(h != tfrt::HashBytes(changed.data(), changed.size()));
+    }
+
+    std::string filename = "tfrt_test_asset.txt";
+    WriteFile(filename, data);
+    REQUIRE(tfrt::HashFile(filename) == h);
+    WriteFile(filename, "");
+    REQUIRE(tfrt::HashFile(filename) == tfrt::HashBytes(nullptr, 0));
+    std::remove(filename.c_str());
+    REQUIRE(!tfrt::HashFile(filename));
+}
+
+/**
+ * ---------------- Triangle Cache Test -------------------
+ */
+
+TEST_CASE("A mapped cache traces like the BVH it was written from", "[Cache]") {
+    for (bool animated : {false, true}) {
+        auto built = std::make_shared<const tfrt::TriangleBVH>(RandomMesh(3000, 1, animated));
+        std::string filename = "tfrt_test_cache.tfrtbvh";
+        REQUIRE(tfrt::WriteTriangleCache(filename, *built, 42));
+
+        std::shared_ptr<const tfrt::TriangleBVH> mapped = tfrt::MapTriangleCache(filename, 42);
+        REQUIRE(mapped);
+        // used in place, nothing copied
+        REQUIRE(mapped->Groups().IsBorrowed());
+        REQUIRE(mapped->Tree().Nodes().IsBorrowed());
+        REQUIRE(mapped->Mesh().p.IsBorrowed());
+        REQUIRE(mapped->Mesh().nTriangles == 3000);
+        REQUIRE(mapped->Mesh().IsAnimated() == animated);
+        REQUIRE(mapped->Tree().HasMotion() == animated);
+        REQUIRE(mapped->NodeCount() == built->NodeCount());
+        REQUIRE(mapped->Bounds() == built->Bounds());
+        RequireSameHits(*built, *mapped);
+
+        // the mapping outlives the file name and serves scenes like any other BVH
+        std::remove(filename.c_str());
+        tfrt::Scene scene({}, {}, {tfrt::Instance(mapped, tfrt::Transform())});
+        tfrt::Ray ray = RandomRays(1, 5)[0];
+        REQUIRE(scene.Intersect(ray).has_value() == built->Intersect(ray).has_value());
+    }
+}
+
+TEST_CASE("Caches of another source, build method or format are rejected", "[Cache]") {
+    tfrt::TriangleBVH built(RandomMesh(500, 2));
+    std::string filename = "tfrt_test_cache.tfrtbvh";
+    REQUIRE(tfrt::WriteTriangleCache(filename, built, 7));
+    REQUIRE(tfrt::MapTriangleCache(filename, 7));
+    REQUIRE(!tfrt::MapTriangleCache(filename, 8));
+    REQUIRE(!tfrt::MapTriangleCache(filename, 7, tfrt::BVHBuildMethod::LBVH));
+    REQUIRE(!tfrt::MapTriangleCache("tfrt_no_such_cache.tfrtbvh", 7));
+
+    std::string data = ReadFile(filename);
+    tfrt::TriangleCacheHeader header;
+    std::string older = data;
+    header.version = tfrt::TriangleCacheVersion - 1;
+    std::memcpy(&older[offsetof(tfrt::TriangleCacheHeader, version)], &header.version, sizeof(header.version));
+    WriteFile(filename, older);
+    REQUIRE(!tfrt::MapTriangleCache(filename, 7));
+
+    // cut short, the last array no longer fits
+    WriteFile(filename, data.substr(0, data.size() / 2));
+    REQUIRE(!tfrt::MapTriangleCache(filename, 7));
+    WriteFile(filename, data.substr(0, sizeof(tfrt::TriangleCacheHeader) - 1));
+    REQUIRE(!tfrt::MapTriangleCache(filename, 7));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("CachedTriangleBVH builds once and maps from then on", "[Cache]") {
+    uint64_t hash = tfrt::HashBytes("asset", 5);
+    std::string filename = tfrt::TriangleCacheFilename(".", hash, tfrt::BVHBuildMethod::SAH);
+    std::remove(filename.c_str());
+    int nLoads = 0;
+    auto load = [&] {
+        ++nLoads;
+        return RandomMesh(800, 4);
+    };
+
+    std::shared_ptr<const tfrt::TriangleBVH> first = tfrt::CachedTriangleBVH(".", hash, load);
+    REQUIRE(nLoads == 1);
+    REQUIRE(!first->Groups().IsBorrowed());
+    std::shared_ptr<const tfrt::TriangleBVH> second = tfrt::CachedTriangleBVH(".", hash, load);
+    REQUIRE(nLoads == 1);
+    REQUIRE(second->Groups().IsBorrowed());
+    RequireSameHits(*first, *second);
+
+    // another build method is another BVH
+    tfrt::CachedTriangleBVH(".", hash, load, tfrt::BVHBuildMethod::HLBVH);
+    REQUIRE(nLoads == 2);
+    std::remove(filename.c_str());
+    std::remove(tfrt::TriangleCacheFilename(".", hash, tfrt::BVHBuildMethod::HLBVH).c_str());
+}
+
+TEST_CASE("Caches of one source built with different methods live side by side", "[Cache]") {
+    uint64_t hash = tfrt::HashBytes("methods", 7);
+    const tfrt::BVHBuildMethod methods[] = {tfrt::BVHBuildMethod::SAH, tfrt::BVHBuildMethod::HLBVH};
+    REQUIRE(tfrt::TriangleCacheFilename(".", hash, methods[0]) !=
+            tfrt::TriangleCacheFilename(".", hash, methods[1]));
+    for (tfrt::BVHBuildMethod method : methods)
+        std::remove(tfrt::TriangleCacheFilename(".", hash, method).c_str());
+    int nLoads = 0;
+    auto load = [&] {
+        ++nLoads;
+        return RandomMesh(300, 5);
+    };
+
+    // each method builds once, then alternating between them only maps
+    for (int i = 0; i < 4; ++i) {
+        std::shared_ptr<const tfrt::TriangleBVH> bvh = tfrt::CachedTriangleBVH(".", hash, load, methods[i % 2]);
+        REQUIRE(bvh->BuildMethod() == methods[i % 2]);
+        REQUIRE(bvh->Groups().IsBorrowed() == (i >= 2));
+    }
+    REQUIRE(nLoads == 2);
+    for (tfrt::BVHBuildMethod method : methods)
+        std::remove(tfrt::TriangleCacheFilename(".", hash, method).c_str());
+}
+
+TEST_CASE("Threads writing the same cache at once leave a complete file", "[Cache]") {
+    auto mesh = RandomMesh(2000, 8);
+    tfrt::TriangleBVH built(mesh);
+    std::string filename = "tfrt_test_concurrent.tfrtbvh";
+    std::remove(filename.c_str());
+
+    std::vector<std::thread> writers;
+    bool written[4] = {};
+    for (int t = 0; t < 4; ++t)
+        writers.emplace_back([&, t] { written[t] = tfrt::WriteTriangleCache(filename, built, 11); });
+    for (std::thread &writer : writers)
+        writer.join();
+    for (bool w : written)
+        REQUIRE(w);
+
+    std::shared_ptr<const tfrt::TriangleBVH> mapped = tfrt::MapTriangleCache(filename, 11);
+    REQUIRE(mapped);
+    RequireSameHits(built, *mapped);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("Updating a mapped BVH leaves the cache file as it was", "[Cache]") {
+    auto mesh = RandomMesh(400, 6);
+    tfrt::TriangleBVH built(mesh);
+    std::string filename = "tfrt_test_cache.tfrtbvh";
+    REQUIRE(tfrt::WriteTriangleCache(filename, built, 9));
+    std::string before = ReadFile(filename);
+
+    std::shared_ptr<const tfrt::TriangleBVH> mapped = tfrt::MapTriangleCache(filename, 9);
+    REQUIRE(mapped);
+    tfrt::TriangleBVH updated = *mapped;
+    auto moved = std::make_shared<tfrt::TriangleMesh>(*mesh);
+    for (tfrt::Point3f &p : moved->p)
+        p += tfrt::Vector3f(0, 1, 0);
+    updated.Update(moved);
+    REQUIRE(!updated.Groups().IsBorrowed());
+    REQUIRE(updated.Bounds() != mapped->Bounds());
+    REQUIRE(ReadFile(filename) == before);
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <vector>
+
+#include "camera/camera.hpp"
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/transform.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+void RequireNear(tfrt::Vector3f a, tfrt::Vector3f b, float eps) {
+    REQUIRE_THAT(a.x, WithinAbs(b.x, eps));
+    REQUIRE_THAT(a.y, WithinAbs(b.y, eps));
+    REQUIRE_THAT(a.z, WithinAbs(b.z, eps));
+}
+
+void RequireNear(tfrt::Point3f a, tfrt::Point3f b, float eps) {
+    RequireNear(tfrt::Vector3f(a), tfrt::Vector3f(b), eps);
+}
+
+tfrt::Transform RenderFromCamera(tfrt::Point3f pos, tfrt::Point3f look) {
+    return tfrt::Inverse(tfrt::LookAt(pos, look, tfrt::Vector3f(0, 1, 0)));
+}
+
+} // namespace
+
+/**
+ * ---------------- Camera Test -------------------
+ */
+
+TEST_CASE("Perspective rays start at the eye and span the field of view", "[Camera]") {
+    tfrt::PerspectiveCamera camera(RenderFromCamera(tfrt::Point3f(1, 2, -8), tfrt::Point3f(1, 2, 0)),
+                                   tfrt::Point2i(200, 100), 90);
+
+    tfrt::Ray center = camera.GenerateRay(tfrt::Point2f(100, 50));
+    RequireNear(center.o, tfrt::Point3f(1, 2, -8), 1e-6f);
+    RequireNear(center.d, tfrt::Vector3f(0, 0, 1), 1e-5f);
+
+    // the shorter axis spans 90 degrees, raster y points down
+    RequireNear(camera.GenerateRay(tfrt::Point2f(100, 0)).d,
+                tfrt::Normalize(tfrt::Vector3f(0, 1, 1)), 1e-5f);
+    RequireNear(camera.GenerateRay(tfrt::Point2f(0, 50)).d,
+                tfrt::Normalize(tfrt::Vector3f(-2, 0, 1)), 1e-5f);
+}
+
+TEST_CASE("Ray differentials point at the neighbouring pixels", "[Camera]") {
+    tfrt::PerspectiveCamera camera(RenderFromCamera(tfrt::Point3f(0, 0, 0), tfrt::Point3f(1, 1, 1)),
+                                   tfrt::Point2i(64, 48), 60);
+    tfrt::RayDifferential ray = camera.GenerateRayDifferential(tfrt::Point2f(10.5f, 20.5f));
+    REQUIRE(ray.hasDifferentials);
+    RequireNear(ray.rxDirection, camera.GenerateRay(tfrt::Point2f(11.5f, 20.5f)).d, 1e-6f);
+    RequireNear(ray.ryDirection, camera.GenerateRay(tfrt::Point2f(10.5f, 21.5f)).d, 1e-6f);
+    RequireNear(ray.rxOrigin, ray.o, 0);
+}
+
+TEST_CASE("Orthographic rays are parallel and spread over the screen window", "[Camera]") {
+    tfrt::Bounds2f window(tfrt::Point2f(-4, -2), tfrt::Point2f(4, 2));
+    tfrt::OrthographicCamera camera(tfrt::Translate(tfrt::Vector3f(0, 0, -5)), tfrt::Point2i(80, 40),
+                                    window);
+    tfrt::RayDifferential ray = camera.GenerateRayDifferential(tfrt::Point2f(0, 0));
+    RequireNear(ray.o, tfrt::Point3f(-4, 2, -5), 1e-5f);
+    RequireNear(ray.d, tfrt::Vector3f(0, 0, 1), 0);
+    RequireNear(ray.rxOrigin - ray.o, tfrt::Vector3f(0.1f, 0, 0), 1e-6f);
+    RequireNear(ray.ryOrigin - ray.o, tfrt::Vector3f(0, -0.1f, 0), 1e-6f);
+    RequireNear(ray.rxDirection, ray.d, 0);
+}
+
+TEST_CASE("Tile batches match single camera rays", "[Camera]") {
+    tfrt::PerspectiveCamera perspective(RenderFromCamera(tfrt::Point3f(3, 1, -4), tfrt::Point3f(0, 0, 0)),
+                                        tfrt::Point2i(40, 30), 50);
+    tfrt::OrthographicCamera orthographic(RenderFromCamera(tfrt::Point3f(3, 1, -4), tfrt::Point3f(0, 0, 0)),
+                                          tfrt::Point2i(40, 30));
+    // 13 pixels wide, so every row ends in a partial group
+    tfrt::Bounds2i tile(tfrt::Point2i(27, 5), tfrt::Point2i(40, 9));
+    std::vector<float> storage(tfrt::RayDifferentialSoA::FloatsPerRay * 64);
+    tfrt::RayDifferentialSoA rays(storage.data(), 64);
+
+    for (const tfrt::ProjectiveCamera *camera :
+         {static_cast<const tfrt::ProjectiveCamera *>(&perspective),
+          static_cast<const tfrt::ProjectiveCamera *>(&orthographic)}) {
+        camera->GenerateTile(tile, rays, tfrt::Point2f(0.25f, 0.75f), 0.5f);
+        REQUIRE(rays.count == 13 * 4);
+        for (int y = 5; y < 9; ++y) {
+            for (int x = 27; x < 40; ++x) {
+                tfrt::RayDifferential expected =
+                    camera->GenerateRayDifferential(tfrt::Point2f(x + 0.25f, y + 0.75f), 0.5f);
+                tfrt::RayDifferential actual = rays[(y - 5) * 13 + (x - 27)];
+                RequireNear(actual.o, expected.o, 1e-5f);
+                RequireNear(actual.d, expected.d, 1e-6f);
+                RequireNear(actual.rxOrigin, expected.rxOrigin, 1e-5f);
+                RequireNear(actual.ryOrigin, expected.ryOrigin, 1e-5f);
+                RequireNear(actual.rxDirection, expected.rxDirection, 1e-6f);
+                RequireNear(actual.ryDirection, expected.ryDirection, 1e-6f);
+                REQUIRE(actual.time == 0.5f);
+            }
+        }
+
+        // packets load straight from the batch, missing lanes never hit
+        tfrt::RayPacket packet = rays.Packet(8, 5);
+        for (int i = 0; i < tfrt::SIMDWidth; ++i) {
+            REQUIRE((packet.tMax[i] > packet.tMin[i]) == (i < 5));
+            if (i < 5)
+                REQUIRE(packet.d.x[i] == rays.d[0][8 + i]);
+        }
+
+        // without differentials only origins and directions are written
+        camera->GenerateTile<false>(tile, rays, tfrt::Point2f(0.25f, 0.75f), 0.5f);
+        tfrt::RayDifferential expected = camera->GenerateRayDifferential(tfrt::Point2f(30.25f, 6.75f), 0.5f);
+        tfrt::RayDifferential actual = rays[13 + 3];
+        RequireNear(actual.o, expected.o, 1e-5f);
+        RequireNear(actual.d, expected.d, 1e-6f);
+        REQUIRE(!actual.hasDifferentials);
+    }
+}
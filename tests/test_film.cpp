@@ -0,0 +1,93 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+#include "core/bounds.hpp"
+#include "film/film.hpp"
+#include "util/color.hpp"
+#include "util/parallel.hpp"
+
+using namespace Catch::Matchers;
+
+/**
+ * ---------------- Film Test -------------------
+ */
+
+TEST_CASE("Film buffer is contiguous, aligned and cleared", "[Film]") {
+    tfrt::Film film(37, 11);
+    REQUIRE(reinterpret_cast<uintptr_t>(film.Row(0)) % 64 == 0);
+    REQUIRE(film.Row(1) == film.Row(0) + 37);
+    REQUIRE(film.GetPixelRGB(tfrt::Point2i(36, 10)) == tfrt::RGB());
+}
+
+TEST_CASE("Film averages weighted samples", "[Film]") {
+    tfrt::Film film(4, 4);
+    film.AddSample(tfrt::Point2i(1, 2), tfrt::RGB(1, 0, 0), 1);
+    film.AddSample(tfrt::Point2i(1, 2), tfrt::RGB(0, 1, 0), 3);
+    tfrt::RGB rgb = film.GetPixelRGB(tfrt::Point2i(1, 2));
+    REQUIRE_THAT(rgb.r, WithinULP(0.25f, 0));
+    REQUIRE_THAT(rgb.g, WithinULP(0.75f, 0));
+    REQUIRE_THAT(rgb.b, WithinULP(0.0f, 0));
+
+    film.Clear();
+    REQUIRE(film.GetPixel(tfrt::Point2i(1, 2)).weightSum == 0);
+}
+
+TEST_CASE("Film tiles merge back into the framebuffer", "[Film]") {
+    tfrt::ThreadPool pool(4);
+    tfrt::Film film(50, 30);
+    auto tiles = tfrt::GenerateTiles(film.PixelBounds(), 16);
+    pool.ParallelFor(0, int64_t(tiles.size()), [&](int64_t i) {
+        tfrt::FilmTile tile = film.GetFilmTile(tiles[i]);
+        for (int y = tiles[i].pMin.y; y < tiles[i].pMax.y; ++y)
+            for (int x = tiles[i].pMin.x; x < tiles[i].pMax.x; ++x)
+                tile.AddSample(tfrt::Point2i(x, y), tfrt::RGB(float(x), float(y), 1));
+        film.MergeFilmTile(tile);
+    });
+
+    for (int y = 0; y < 30; ++y) {
+        for (int x = 0; x < 50; ++x) {
+            tfrt::RGB rgb = film.GetPixelRGB(tfrt::Point2i(x, y));
+            REQUIRE(rgb == tfrt::RGB(float(x), float(y), 1));
+        }
+    }
+}
+
+TEST_CASE("Variance estimates merge like a single pass over all samples", "[Film]") {
+    float values[10] = {0.5f, 1, 2, 0.25f, 3, 3, 1.5f, 0, 2.5f, 1};
+    tfrt::VarianceEstimator all, first, second;
+    double sum = 0, sumSq = 0;
+    for (int i = 0; i < 10; ++i) {
+        all.Add(values[i]);
+        (i < 4 ? first : second).Add(values[i]);
+        sum += values[i];
+        sumSq += double(values[i]) * values[i];
+    }
+    double mean = sum / 10, variance = (sumSq - 10 * mean * mean) / 9;
+    REQUIRE_THAT(all.mean, WithinRel(float(mean), 1e-6f));
+    REQUIRE_THAT(all.Variance(), WithinRel(float(variance), 1e-5f));
+
+    first.Merge(second);
+    REQUIRE(first.count == 10);
+    REQUIRE_THAT(first.mean, WithinRel(all.mean, 1e-6f));
+    REQUIRE_THAT(first.Variance(), WithinRel(all.Variance(), 1e-5f));
+    REQUIRE_THAT(first.RelativeError(0.01f), WithinRel(std::sqrt(all.Variance() / 10) / all.mean, 1e-5f));
+}
+
+TEST_CASE("Film tracks the variance of merged tile samples", "[Film]") {
+    tfrt::Film film(8, 8);
+    tfrt::FilmTile tile = film.GetFilmTile(film.PixelBounds());
+    for (int i = 0; i < 4; ++i) {
+        tile.AddSample(tfrt::Point2i(2, 3), tfrt::RGB(1, 1, 1));
+        tile.AddSample(tfrt::Point2i(5, 3), tfrt::RGB(float(i % 2), float(i % 2), float(i % 2)));
+    }
+    film.MergeFilmTile(tile);
+
+    REQUIRE(film.GetVariance(tfrt::Point2i(2, 3)).Variance() == 0);
+    REQUIRE_THAT(film.GetVariance(tfrt::Point2i(5, 3)).Variance(), WithinRel(1.f / 3, 1e-6f));
+    REQUIRE(film.MaxRelativeError(tfrt::Bounds2i(tfrt::Point2i(0, 0), tfrt::Point2i(4, 4)), 0.01f) ==
+            tfrt::Infinity);
+    REQUIRE(film.MaxRelativeError(tfrt::Bounds2i(tfrt::Point2i(2, 3), tfrt::Point2i(3, 4)), 0.01f) == 0);
+}
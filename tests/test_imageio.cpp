@@ -0,0 +1,120 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "film/film.hpp"
+#include "film/imageio.hpp"
+#include "util/color.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+std::string ReadFile(const std::string &filename) {
+    std::ifstream in(filename, std::ifstream::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+tfrt::Film GradientFilm(int width, int height) {
+    tfrt::Film film(width, height);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            film.AddSample(tfrt::Point2i(x, y), tfrt::RGB(float(x) / width, float(y) / height, 0.5f));
+    return film;
+}
+
+}
+
+/**
+ * ---------------- sRGB Test -------------------
+ */
+
+TEST_CASE("sRGB table quantization matches the exact curve", "[imageio]") {
+    for (int i = 0; i <= 1000; ++i) {
+        float v = i / 1000.f;
+        long exact = std::lround(255 * tfrt::LinearToSRGB(v));
+        REQUIRE(std::abs(long(tfrt::LinearToSRGB8(v)) - exact) <= 1);
+    }
+    REQUIRE(tfrt::LinearToSRGB8(-1.f) == 0);
+    REQUIRE(tfrt::LinearToSRGB8(std::nanf("")) == 0);
+    REQUIRE(tfrt::LinearToSRGB8(7.f) == 255);
+    REQUIRE(tfrt::LinearToSRGB8(tfrt::SRGBToLinear(128.f / 255)) == 128);
+}
+
+/**
+ * ---------------- Image Writer Test -------------------
+ */
+
+TEST_CASE("Binary PPM is written to the given path", "[imageio]") {
+    tfrt::Film film = GradientFilm(5, 3);
+    std::string filename = "tfrt_test_image.ppm";
+    REQUIRE(tfrt::WriteImage(filename, film));
+
+    std::string data = ReadFile(filename);
+    std::string header = "P6\n5 3\n255\n";
+    REQUIRE(data.size() == header.size() + 5 * 3 * 3);
+    REQUIRE(data.compare(0, header.size(), header) == 0);
+
+    // pixel (4, 2)
+    size_t offset = header.size() + (2 * 5 + 4) * 3;
+    REQUIRE(uint8_t(data[offset + 0]) == tfrt::LinearToSRGB8(4.f / 5));
+    REQUIRE(uint8_t(data[offset + 1]) == tfrt::LinearToSRGB8(2.f / 3));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("PFM rows are written bottom to top from out of order bands", "[imageio]") {
+    tfrt::Film film = GradientFilm(4, 6);
+    std::string filename = "tfrt_test_image.pfm";
+    {
+        tfrt::ImageWriter writer(filename, film);
+        writer.WriteRows(4, 6);
+        writer.WriteRows(0, 2);
+        writer.WriteRows(2, 4);
+        REQUIRE(writer.Finish());
+    }
+
+    std::string data = ReadFile(filename);
+    std::string header = "PF\n4 6\n-1\n";
+    REQUIRE(data.size() == header.size() + 4 * 6 * 3 * sizeof(float));
+    REQUIRE(data.compare(0, header.size(), header) == 0);
+
+    const float *rgb = reinterpret_cast<const float *>(data.data() + header.size());
+    for (int fileRow = 0; fileRow < 6; ++fileRow) {
+        int y = 5 - fileRow;
+        for (int x = 0; x < 4; ++x) {
+            const float *p = rgb + 3 * (fileRow * 4 + x);
+            REQUIRE_THAT(p[0], WithinULP(float(x) / 4, 0));
+            REQUIRE_THAT(p[1], WithinULP(float(y) / 6, 0));
+        }
+    }
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("Heatmap colours every tile by its value", "[imageio]") {
+    // 5 x 3 pixels in 2 x 2 tiles, three tiles per row
+    std::vector<double> values{0, 1, 2, 3, 4, 6};
+    std::string filename = "tfrt_test_heatmap.pfm";
+    REQUIRE(tfrt::WriteHeatmap(filename, tfrt::Point2i(5, 3), 2, values));
+
+    std::string data = ReadFile(filename);
+    std::string header = "PF\n5 3\n-1\n";
+    REQUIRE(data.size() == header.size() + 5 * 3 * 3 * sizeof(float));
+    auto pixel = [&](int x, int y) {
+        const float *p = reinterpret_cast<const float *>(data.data() + header.size()) + 3 * ((2 - y) * 5 + x);
+        return tfrt::RGB(p[0], p[1], p[2]);
+    };
+    REQUIRE(pixel(0, 0) == tfrt::RGB(0, 0, 0));
+    REQUIRE(pixel(3, 1) == tfrt::RGB(0.5f, 0, 0));
+    REQUIRE(pixel(4, 0) == tfrt::RGB(1, 0, 0));
+    REQUIRE(pixel(1, 2) == tfrt::RGB(1, 0.5f, 0));
+    REQUIRE(pixel(2, 2) == tfrt::RGB(1, 1, 0));
+    REQUIRE(pixel(4, 2) == tfrt::RGB(1, 1, 1));
+    std::remove(filename.c_str());
+}
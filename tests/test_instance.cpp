@@ -0,0 +1,226 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/transform.hpp"
+#include "scene/instance.hpp"
+#include "scene/scene.hpp"
+#include "scene/triangle.hpp"
+#include "util/stats.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+// closed unit cube around the origin, 12 triangles
+std::vector<int> CubeIndices() {
+    return {0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+            2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+}
+
+std::vector<tfrt::Point3f> CubeVertices() {
+    std::vector<tfrt::Point3f> p;
+    for (int i = 0; i < 8; ++i)
+        p.emplace_back(i & 4 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 1 ? 0.5f : -0.5f);
+    return p;
+}
+
+std::vector<tfrt::Transform> RandomPlacements(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(-10.f, 10.f);
+    std::uniform_real_distribution<float> angle(0.f, 360.f);
+    std::uniform_real_distribution<float> scale(0.3f, 1.5f);
+    std::vector<tfrt::Transform> placements;
+    for (int i = 0; i < n; ++i)
+        placements.push_back(tfrt::Translate(tfrt::Vector3f(pos(rng), pos(rng), pos(rng))) *
+                             tfrt::Rotate(angle(rng), tfrt::Vector3f(pos(rng), pos(rng), 1)) *
+                             tfrt::Scale(scale(rng), scale(rng), scale(rng)));
+    return placements;
+}
+
+} // namespace
+
+/**
+ * ---------------- Instance Test -------------------
+ */
+
+TEST_CASE("Instances share one mesh BVH", "[Instance]") {
+    auto cube = std::make_shared<const tfrt::TriangleMesh>(CubeIndices(), CubeVertices());
+    auto object = std::make_shared<const tfrt::TriangleBVH>(cube);
+    std::vector<tfrt::Instance> instances;
+    for (const tfrt::Transform &t : RandomPlacements(100, 1))
+        instances.emplace_back(object, t);
+    tfrt::InstanceBVH tlas(instances);
+    REQUIRE(tlas.size() == 100);
+    // one copy of the mesh BVH: ours, the input vector's and the top level's
+    REQUIRE(object.use_count() == 1 + 2 * 100);
+}
+
+TEST_CASE("InstanceBVH matches flattened copies", "[Instance]") {
+    auto cube = std::make_shared<const tfrt::TriangleMesh>(CubeIndices(), CubeVertices());
+    auto object = std::make_shared<const tfrt::TriangleBVH>(cube);
+    std::vector<tfrt::Transform> placements = RandomPlacements(300, 2);
+
+    std::vector<tfrt::Instance> instances;
+    std::vector<tfrt::TriangleBVH> flattened;
+    for (const tfrt::Transform &t : placements) {
+        instances.emplace_back(object, t);
+        flattened.emplace_back(std::make_shared<const tfrt::TriangleMesh>(t, CubeIndices(), CubeVertices()));
+    }
+    tfrt::InstanceBVH tlas(instances);
+
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    for (int i = 0; i < 500; ++i) {
+        tfrt::Ray ray(tfrt::Point3f(u(rng) * 12, u(rng) * 12, -20),
+                      tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.3f, u(rng) * 0.3f, 1)));
+        std::optional<tfrt::ShapeHit> expected;
+        for (size_t j = 0; j < flattened.size(); ++j) {
+            tfrt::Ray r = ray;
+            if (expected)
+                r.tMax = expected->tHit;
+            if (auto si = flattened[j].Intersect(r)) {
+                expected = si;
+                expected->geomIndex = uint32_t(j);
+            }
+        }
+
+        auto actual = tlas.Intersect(ray);
+        REQUIRE(expected.has_value() == actual.has_value());
+        if (expected) {
+            REQUIRE(actual->geomIndex == expected->geomIndex);
+            REQUIRE(actual->primIndex == expected->primIndex);
+            REQUIRE_THAT(actual->tHit, WithinRel(expected->tHit, 1e-4f));
+        }
+    }
+}
+
+TEST_CASE("InstanceBVH packets match single rays", "[Instance]") {
+    auto cube = std::make_shared<const tfrt::TriangleMesh>(CubeIndices(), CubeVertices());
+    auto object = std::make_shared<const tfrt::TriangleBVH>(cube);
+    std::vector<tfrt::Instance> instances;
+    for (const tfrt::Transform &t : RandomPlacements(200, 5))
+        instances.emplace_back(object, t);
+    tfrt::Scene scene({}, {}, instances);
+
+    std::mt19937 rng(6);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    for (int i = 0; i < 100; ++i) {
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        int n = 1 + i % tfrt::SIMDWidth;
+        for (int j = 0; j < n; ++j)
+            rays[j] = tfrt::Ray(tfrt::Point3f(u(rng) * 10, u(rng) * 10, -20),
+                                tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.2f, u(rng) * 0.2f, 1)));
+        tfrt::RayPacketHit hits = scene.Intersect(tfrt::RayPacket(rays, n));
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            auto expected = j < n ? scene.Intersect(rays[j]) : std::nullopt;
+            REQUIRE(hits.valid[j] == expected.has_value());
+            if (expected) {
+                REQUIRE(hits.geomIndex[j] == expected->geomIndex);
+                REQUIRE(hits.primIndex[j] == expected->primIndex);
+                REQUIRE_THAT(hits.tHit[j], WithinRel(expected->tHit, 1e-5f));
+            }
+        }
+    }
+}
+
+TEST_CASE("Packets enter only the instances their lanes reach", "[Instance]") {
+    auto cube = std::make_shared<const tfrt::TriangleMesh>(CubeIndices(), CubeVertices());
+    auto object = std::make_shared<const tfrt::TriangleBVH>(cube);
+    // a row of cubes that fits one leaf
+    std::vector<tfrt::Instance> instances;
+    for (int i = 0; i < tfrt::SIMDWidth; ++i)
+        instances.emplace_back(object, tfrt::Translate(tfrt::Vector3f(1.5f * i, 0, 0)));
+    tfrt::InstanceBVH tlas(instances);
+
+    // every lane aims at the first cube only
+    tfrt::Ray rays[tfrt::SIMDWidth];
+    for (int j = 0; j < tfrt::SIMDWidth; ++j)
+        rays[j] = tfrt::Ray(tfrt::Point3f(-0.2f + 0.05f * j, 0.1f, -5), tfrt::Vector3f(0, 0, 1));
+    tfrt::RayPacket packet(rays, tfrt::SIMDWidth);
+    tfrt::ResetStats();
+    tfrt::RayPacketHit hits = tlas.Intersect(packet);
+    tfrt::MaskN blocked = tlas.IntersectP(packet);
+    tfrt::RenderStats stats = tfrt::GatherStats();
+
+    for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+        REQUIRE(hits.valid[j]);
+        REQUIRE(hits.geomIndex[j] == 0);
+        REQUIRE(blocked[j]);
+    }
+    // the top level and the first cube, once per query
+    if (tfrt::StatsEnabled)
+        REQUIRE(stats.packetTraversals == 4);
+}
+
+/**
+ * ---------------- Shadow Ray Test -------------------
+ */
+
+TEST_CASE("Shadow rays agree with closest hits", "[Shadow]") {
+    std::mt19937 rng(8);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    std::uniform_real_distribution<float> t(0.f, 1.f);
+
+    std::vector<tfrt::Sphere> spheres;
+    for (int i = 0; i < 50; ++i)
+        spheres.emplace_back(tfrt::Point3f(u(rng) * 10, u(rng) * 10, u(rng) * 10), 0.2f + t(rng));
+    auto moving = std::make_shared<tfrt::TriangleMesh>(CubeIndices(), CubeVertices());
+    for (const tfrt::Point3f &p : moving->p)
+        moving->pEnd.push_back(p + tfrt::Vector3f(3, 0, 0));
+    auto cube = std::make_shared<const tfrt::TriangleBVH>(
+        std::make_shared<const tfrt::TriangleMesh>(CubeIndices(), CubeVertices()));
+    std::vector<tfrt::Instance> instances;
+    for (const tfrt::Transform &placement : RandomPlacements(100, 9))
+        instances.emplace_back(cube, placement);
+    tfrt::Scene scene(spheres, {moving}, instances);
+
+    // incoherent segments of random length, like shadow rays towards lights
+    std::vector<tfrt::Ray> rays(1000);
+    for (tfrt::Ray &ray : rays) {
+        ray = tfrt::Ray(tfrt::Point3f(u(rng) * 12, u(rng) * 12, u(rng) * 12),
+                        tfrt::Normalize(tfrt::Vector3f(u(rng), u(rng), u(rng))), t(rng));
+        ray.tMax = 20 * t(rng);
+    }
+    std::unique_ptr<bool[]> occluded(new bool[rays.size()]);
+    scene.IntersectP(rays.data(), int(rays.size()), occluded.get());
+
+    int nOccluded = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        bool expected = scene.Intersect(rays[i]).has_value();
+        REQUIRE(scene.IntersectP(rays[i]) == expected);
+        REQUIRE(occluded[i] == expected);
+        nOccluded += expected;
+    }
+    // both outcomes are exercised
+    REQUIRE(nOccluded > 100);
+    REQUIRE(nOccluded < 900);
+}
+
+TEST_CASE("Shadow ray ends before the occluder", "[Shadow]") {
+    auto cube = std::make_shared<const tfrt::TriangleMesh>(CubeIndices(), CubeVertices());
+    tfrt::Scene scene({tfrt::Sphere(tfrt::Point3f(0, 0, 5), 1)}, {cube});
+
+    // the cube's face is 1.5 away, the sphere 5.5
+    tfrt::Ray ray(tfrt::Point3f(0, 0, -2), tfrt::Vector3f(0, 0, 1));
+    ray.tMax = 1.49f;
+    REQUIRE_FALSE(scene.IntersectP(ray));
+    ray.tMax = 1.51f;
+    REQUIRE(scene.IntersectP(ray));
+
+    tfrt::Ray fromInside(tfrt::Point3f(0, 0, 2.5f), tfrt::Vector3f(0, 0, 1));
+    fromInside.tMax = 1.4f;
+    REQUIRE_FALSE(scene.IntersectP(fromInside));
+    fromInside.tMax = 1.6f;
+    REQUIRE(scene.IntersectP(fromInside));
+
+    tfrt::Ray rays[3] = {ray, fromInside, tfrt::Ray(tfrt::Point3f(5, 5, 5), tfrt::Vector3f(1, 0, 0))};
+    tfrt::MaskN blocked = scene.IntersectP(tfrt::RayPacket(rays, 3));
+    REQUIRE(blocked.Bits() == 3u);
+}
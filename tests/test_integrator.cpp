@@ -0,0 +1,281 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "camera/camera.hpp"
+#include "core/bounds.hpp"
+#include "core/features.hpp"
+#include "core/transform.hpp"
+#include "film/film.hpp"
+#include "render/integrator.hpp"
+#include "render/wavefront.hpp"
+#include "sampler/sampler.hpp"
+#include "scene/scene.hpp"
+#include "scene/sphere.hpp"
+#include "scene/triangle.hpp"
+#include "util/color.hpp"
+#include "util/parallel.hpp"
+#include "util/sampling.hpp"
+#include "util/stats.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+// 20 x 20 ground quad at y = 0
+std::shared_ptr<const tfrt::TriangleMesh> Ground() {
+    std::vector<tfrt::Point3f> p{{-10, 0, -10}, {10, 0, -10}, {10, 0, 10}, {-10, 0, 10}};
+    return std::make_shared<const tfrt::TriangleMesh>(std::vector<int>{0, 1, 2, 0, 2, 3}, p);
+}
+
+// orthographic view straight down onto the ground
+tfrt::OrthographicCamera TopView(tfrt::Point2i resolution) {
+    return tfrt::OrthographicCamera(
+        tfrt::Inverse(tfrt::LookAt(tfrt::Point3f(0, 5, 0), tfrt::Point3f(0, 0, 0), tfrt::Vector3f(0, 0, 1))),
+        resolution);
+}
+
+template <typename Integrator>
+void RenderAll(tfrt::Film &film, const Integrator &integrator, int tileSize, int spp) {
+    tfrt::ParallelForTiles(film.PixelBounds(), tileSize, [&](tfrt::Bounds2i b) {
+        tfrt::FilmTile tile = film.GetFilmTile(b);
+        integrator.RenderTile(tile, 0, spp);
+        film.MergeFilmTile(tile);
+    });
+}
+
+void RequireNear(tfrt::RGB a, tfrt::RGB b, float eps) {
+    for (int c = 0; c < 3; ++c)
+        REQUIRE_THAT(a[c], WithinAbs(b[c], eps));
+}
+
+// the integrator of kind Integrator that DispatchFeatures picks for scene and settings, rendered into film
+template <template <class> class Integrator, typename Float = tfrt::Float>
+void RenderSpecialized(tfrt::Film &film, const tfrt::Scene &scene, const tfrt::ProjectiveCamera &camera,
+                       const tfrt::SobolSampler &sampler, const tfrt::PathSettings &settings, int spp) {
+    tfrt::DispatchFeatures<Float>(tfrt::PathFeatures(scene, settings), [&](auto features) {
+        RenderAll(film, Integrator<decltype(features)>(scene, camera, sampler, settings), 8, spp);
+    });
+}
+
+} // namespace
+
+/**
+ * ---------------- Sampling Test -------------------
+ */
+
+TEST_CASE("Cosine hemisphere samples are unit vectors with mean cosine 2/3", "[Sampling]") {
+    tfrt::SobolSampler sampler(1024, 3);
+    double sumCos = 0;
+    for (int i = 0; i < 1024; ++i) {
+        tfrt::Point2f u(sampler.Sample1D(tfrt::Point2i(0, 0), i, 2), sampler.Sample1D(tfrt::Point2i(0, 0), i, 3));
+        tfrt::Vector3f w = tfrt::SampleCosineHemisphere(u);
+        REQUIRE_THAT(tfrt::Length(w), WithinAbs(1, 1e-5));
+        REQUIRE(w.z >= 0);
+        sumCos += w.z;
+    }
+    REQUIRE_THAT(sumCos / 1024, WithinAbs(2. / 3, 2e-3));
+
+    tfrt::Normal3f n = tfrt::Normalize(tfrt::Normal3f(1, -2, 0.5f));
+    tfrt::Vector3f w = tfrt::SampleDiffuseBounce(n, tfrt::Point2f(0.5f, 0.5f));
+    REQUIRE_THAT(tfrt::Dot(w, n), WithinAbs(1, 1e-5));
+}
+
+TEST_CASE("Packet sun light and bounce sampling match the scalar lanes", "[Sampling]") {
+    // flipped axis-aligned normals carry -0 components, which pick the tangent frame
+    tfrt::Normal3f normals[8] = {{0, 1, 0}, {-1, -0.f, -0.f}, {1, 0, 0}, {0, 0, -1},
+                                 {0.6f, -0.8f, 0}, {-0.f, -1, -0.f}, {0.48f, 0.6f, -0.64f}, {0, 0, 1}};
+    float u0[8] = {0.5f, 0.1f, 0.9f, 0.25f, 0.7f, 0.5f, 0.33f, 0.99f};
+    float u1[8] = {0.5f, 0.8f, 0.2f, 0.75f, 0.05f, 0.6f, 0.66f, 0.01f};
+    float n[3][8];
+    for (int i = 0; i < 8; ++i)
+        for (int c = 0; c < 3; ++c)
+            n[c][i] = normals[i][c];
+    tfrt::Vector3fN nN(tfrt::FloatN::Load(n[0]), tfrt::FloatN::Load(n[1]), tfrt::FloatN::Load(n[2]));
+
+    tfrt::PathSettings settings;
+    tfrt::RGBT<tfrt::FloatN> sun = tfrt::DiffuseSunLight(settings, nN);
+    tfrt::Vector3fN w = tfrt::SampleDiffuseBounce(nN, tfrt::FloatN::Load(u0), tfrt::FloatN::Load(u1));
+    for (int i = 0; i < 8; ++i) {
+        tfrt::RGB expectedSun = tfrt::DiffuseSunLight(settings, normals[i]);
+        tfrt::Vector3f expected = tfrt::SampleDiffuseBounce(normals[i], tfrt::Point2f(u0[i], u1[i]));
+        for (int c = 0; c < 3; ++c) {
+            REQUIRE_THAT(sun[c][i], WithinAbs(expectedSun[c], 1e-6));
+            REQUIRE_THAT(w[c][i], WithinAbs(expected[c], 1e-6));
+        }
+    }
+}
+
+/**
+ * ---------------- Integrator Test -------------------
+ */
+
+TEST_CASE("Camera rays that miss everything see the sky", "[Integrator]") {
+    tfrt::Scene scene(std::vector<tfrt::Sphere>{});
+    tfrt::OrthographicCamera camera = TopView(tfrt::Point2i(8, 8));
+    tfrt::SobolSampler sampler(4, 0);
+    tfrt::PathSettings settings;
+    tfrt::Film recursive(8, 8), wavefront(8, 8);
+    RenderAll(recursive, tfrt::RecursivePathIntegrator(scene, camera, sampler, settings), 8, 4);
+    RenderAll(wavefront, tfrt::WavefrontPathIntegrator(scene, camera, sampler, settings), 8, 4);
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            RequireNear(recursive.GetPixelRGB(tfrt::Point2i(x, y)), settings.skyRadiance, 1e-6f);
+            RequireNear(wavefront.GetPixelRGB(tfrt::Point2i(x, y)), settings.skyRadiance, 1e-6f);
+        }
+    }
+}
+
+TEST_CASE("An unoccluded ground facing the sun reflects albedo E / pi", "[Integrator]") {
+    tfrt::Scene scene({}, {Ground()});
+    tfrt::OrthographicCamera camera = TopView(tfrt::Point2i(8, 8));
+    tfrt::SobolSampler sampler(2, 0);
+    tfrt::PathSettings settings;
+    settings.maxDepth = 1;
+    settings.sunDirection = tfrt::Vector3f(0, 1, 0);
+    tfrt::RGB expected = settings.albedo * settings.sunIrradiance / tfrt::Pi;
+
+    tfrt::Film recursive(8, 8), wavefront(8, 8);
+    RenderAll(recursive, tfrt::RecursivePathIntegrator(scene, camera, sampler, settings), 4, 2);
+    RenderAll(wavefront, tfrt::WavefrontPathIntegrator(scene, camera, sampler, settings), 4, 2);
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            RequireNear(recursive.GetPixelRGB(tfrt::Point2i(x, y)), expected, 1e-5f);
+            RequireNear(wavefront.GetPixelRGB(tfrt::Point2i(x, y)), expected, 1e-5f);
+        }
+    }
+}
+
+TEST_CASE("Wavefront and recursive path tracing produce the same image", "[Integrator]") {
+    std::vector<tfrt::Sphere> spheres{tfrt::Sphere(tfrt::Point3f(0, 1, 0), 1),
+                                      tfrt::Sphere(tfrt::Point3f(2.5f, 0.5f, 1), 0.5f),
+                                      tfrt::Sphere(tfrt::Point3f(-2, 1.5f, -1), 1.5f)};
+    tfrt::Scene scene(spheres, {Ground()});
+    tfrt::Point2i resolution(48, 32);
+    tfrt::PerspectiveCamera camera(
+        tfrt::Inverse(tfrt::LookAt(tfrt::Point3f(0, 3, -8), tfrt::Point3f(0, 1, 0), tfrt::Vector3f(0, 1, 0))),
+        resolution, 45);
+    tfrt::SobolSampler sampler(8, 7);
+    tfrt::PathSettings settings;
+    settings.maxDepth = 4;
+
+    tfrt::Film recursive(resolution.x, resolution.y), wavefront(resolution.x, resolution.y);
+    RenderAll(recursive, tfrt::RecursivePathIntegrator(scene, camera, sampler, settings), 16, 8);
+    // few paths in flight, so tiles are split into several batches
+    tfrt::WavefrontOptions options;
+    options.maxPaths = 600;
+    RenderAll(wavefront, tfrt::WavefrontPathIntegrator(scene, camera, sampler, settings, options), 16, 8);
+
+    int nSky = 0;
+    for (int y = 0; y < resolution.y; ++y) {
+        for (int x = 0; x < resolution.x; ++x) {
+            tfrt::Point2i p(x, y);
+            RequireNear(wavefront.GetPixelRGB(p), recursive.GetPixelRGB(p), 1e-4f);
+            REQUIRE(wavefront.GetPixel(p).weightSum == 8);
+            nSky += recursive.GetPixelRGB(p) == settings.skyRadiance;
+        }
+    }
+    // most of the frame is geometry, not the sky
+    REQUIRE(nSky < resolution.x * resolution.y / 2);
+}
+
+TEST_CASE("Sorting bounce rays keeps the image and makes packets more coherent", "[Integrator]") {
+    // a grid of small spheres on the ground, enough nodes for traversal order to matter
+    std::vector<tfrt::Sphere> spheres;
+    for (int i = 0; i < 20; ++i)
+        for (int j = 0; j < 20; ++j)
+            spheres.push_back(tfrt::Sphere(tfrt::Point3f(i - 9.5f, 0.3f, j - 9.5f), 0.3f));
+    tfrt::Scene scene(spheres, {Ground()});
+    tfrt::Point2i resolution(32, 32);
+    tfrt::PerspectiveCamera camera(
+        tfrt::Inverse(tfrt::LookAt(tfrt::Point3f(0, 6, -12), tfrt::Point3f(0, 0, 0), tfrt::Vector3f(0, 1, 0))),
+        resolution, 50);
+    tfrt::SobolSampler sampler(4, 1);
+    tfrt::PathSettings settings;
+
+    tfrt::WavefrontOptions sortedOptions;
+    sortedOptions.sortRays = true;
+    tfrt::WavefrontPathIntegrator unsorted(scene, camera, sampler, settings);
+    tfrt::WavefrontPathIntegrator sorted(scene, camera, sampler, settings, sortedOptions);
+    tfrt::Film a(resolution.x, resolution.y), b(resolution.x, resolution.y);
+    RenderAll(a, unsorted, 32, 4);
+    RenderAll(b, sorted, 32, 4);
+
+    for (int y = 0; y < resolution.y; ++y)
+        for (int x = 0; x < resolution.x; ++x)
+            RequireNear(b.GetPixelRGB(tfrt::Point2i(x, y)), a.GetPixelRGB(tfrt::Point2i(x, y)), 1e-6f);
+
+    tfrt::WavefrontStats before = unsorted.Stats(), after = sorted.Stats();
+    REQUIRE(before.rays > 0);
+    REQUIRE(after.rays == before.rays);
+    // node visits come from the render statistics
+    if (tfrt::StatsEnabled) {
+        REQUIRE(after.NodeVisitsPerRay() < before.NodeVisitsPerRay());
+        REQUIRE(after.LaneUtilization() > before.LaneUtilization());
+    }
+}
+
+/**
+ * ---------------- Kernel Dispatch Test -------------------
+ */
+
+TEST_CASE("DispatchFeatures instantiates the kernel for the flags it is given", "[Integrator]") {
+    tfrt::FeatureSet set;
+    set.triangles = false;
+    set.differentials = false;
+    int flags = tfrt::DispatchFeatures(set, [](auto features) {
+        using Features = decltype(features);
+        static_assert(std::is_same_v<typename Features::Float, tfrt::Float>);
+        return Features::spheres | Features::triangles << 1 | Features::bounces << 2 | Features::differentials << 3;
+    });
+    REQUIRE(flags == 0b0101);
+    bool isDouble = tfrt::DispatchFeatures<double>(tfrt::FeatureSet(), [](auto features) {
+        using Features = decltype(features);
+        return Features::spheres && Features::triangles && Features::bounces && Features::differentials &&
+               std::is_same_v<typename Features::Float, double>;
+    });
+    REQUIRE(isDouble);
+
+    tfrt::PathSettings settings;
+    settings.maxDepth = 1;
+    tfrt::FeatureSet path = tfrt::PathFeatures(tfrt::Scene({}, {Ground()}), settings);
+    REQUIRE((!path.spheres && path.triangles && !path.bounces && !path.differentials));
+}
+
+TEST_CASE("Specialized integrators render the same image as the generic ones", "[Integrator]") {
+    std::vector<tfrt::Sphere> spheres{tfrt::Sphere(tfrt::Point3f(0, 1, 0), 1),
+                                      tfrt::Sphere(tfrt::Point3f(2.5f, 0.5f, 1), 0.5f)};
+    tfrt::Point2i resolution(24, 16);
+    tfrt::PerspectiveCamera camera(
+        tfrt::Inverse(tfrt::LookAt(tfrt::Point3f(0, 3, -8), tfrt::Point3f(0, 1, 0), tfrt::Vector3f(0, 1, 0))),
+        resolution, 45);
+    tfrt::SobolSampler sampler(4, 2);
+    tfrt::Scene spheresOnly(spheres), groundOnly({}, {Ground()}), both(spheres, {Ground()});
+
+    for (const tfrt::Scene *scene : {&spheresOnly, &groundOnly, &both}) {
+        for (int maxDepth : {1, 3}) {
+            tfrt::PathSettings settings;
+            settings.maxDepth = maxDepth;
+            tfrt::Film generic(resolution.x, resolution.y), recursive(resolution.x, resolution.y),
+                wavefront(resolution.x, resolution.y), precise(resolution.x, resolution.y);
+            RenderAll(generic, tfrt::RecursivePathIntegrator(*scene, camera, sampler, settings), 8, 4);
+            RenderSpecialized<tfrt::RecursivePathIntegrator>(recursive, *scene, camera, sampler, settings, 4);
+            RenderSpecialized<tfrt::WavefrontPathIntegrator>(wavefront, *scene, camera, sampler, settings, 4);
+            RenderSpecialized<tfrt::WavefrontPathIntegrator, double>(precise, *scene, camera, sampler, settings,
+                                                                     4);
+            for (int y = 0; y < resolution.y; ++y) {
+                for (int x = 0; x < resolution.x; ++x) {
+                    tfrt::Point2i p(x, y);
+                    // only what the scene lacks is left out, so the paths are the same
+                    REQUIRE(recursive.GetPixelRGB(p) == generic.GetPixelRGB(p));
+                    RequireNear(wavefront.GetPixelRGB(p), generic.GetPixelRGB(p), 1e-4f);
+                    RequireNear(precise.GetPixelRGB(p), wavefront.GetPixelRGB(p), 1e-5f);
+                }
+            }
+        }
+    }
+}
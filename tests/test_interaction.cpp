@@ -0,0 +1,114 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "core/ray.hpp"
+#include "core/transform.hpp"
+#include "scene/interaction.hpp"
+#include "scene/scene.hpp"
+#include "scene/sphere.hpp"
+#include "scene/triangle.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+void RequireNear(tfrt::Vector3f a, tfrt::Vector3f b, float eps) {
+    REQUIRE_THAT(a.x, WithinAbs(b.x, eps));
+    REQUIRE_THAT(a.y, WithinAbs(b.y, eps));
+    REQUIRE_THAT(a.z, WithinAbs(b.z, eps));
+}
+
+void RequireNear(tfrt::Point3f a, tfrt::Point3f b, float eps) {
+    RequireNear(tfrt::Vector3f(a), tfrt::Vector3f(b), eps);
+}
+
+void RequireNear(tfrt::Normal3f a, tfrt::Normal3f b, float eps) {
+    RequireNear(tfrt::Vector3f(a), tfrt::Vector3f(b), eps);
+}
+
+} // namespace
+
+/**
+ * ---------------- SurfaceInteraction Test -------------------
+ */
+
+TEST_CASE("Sphere interaction lies on the surface with an outward normal", "[Interaction]") {
+    tfrt::Sphere sphere(tfrt::Point3f(1, 2, 3), 2);
+    tfrt::Ray ray(tfrt::Point3f(-5, 2.5f, 3.5f), tfrt::Normalize(tfrt::Vector3f(1, 0.1f, 0.05f)));
+    std::optional<tfrt::ShapeHit> hit = sphere.Intersect(ray, tfrt::Infinity);
+    REQUIRE(hit);
+    tfrt::SurfaceInteraction si = sphere.Interaction(ray, *hit);
+
+    REQUIRE_THAT(tfrt::Distance(si.p, sphere.center), WithinAbs(2, 1e-5));
+    RequireNear(si.p, ray(hit->tHit), 1e-4f);
+    RequireNear(si.n, tfrt::Normal3f((si.p - sphere.center) / 2), 1e-5f);
+    RequireNear(si.wo, -ray.d, 1e-6f);
+    REQUIRE(si.uv.x >= 0);
+    REQUIRE(si.uv.x <= 1);
+    REQUIRE(si.uv.y >= 0);
+    REQUIRE(si.uv.y <= 1);
+
+    // dpdu, dpdv are tangent and dndu = dpdu / r
+    REQUIRE_THAT(tfrt::Dot(si.n, si.dpdu), WithinAbs(0, 1e-4));
+    REQUIRE_THAT(tfrt::Dot(si.n, si.dpdv), WithinAbs(0, 1e-4));
+    RequireNear(si.dndu, tfrt::Normal3f(si.dpdu / 2), 1e-5f);
+    RequireNear(si.shading.n, si.n, 0);
+}
+
+TEST_CASE("Triangle interaction interpolates positions, uv and normals", "[Interaction]") {
+    std::vector<tfrt::Point3f> p{{0, 0, 0}, {2, 0, 0}, {0, 2, 0}};
+    std::vector<tfrt::Normal3f> n{{0, 0, 1}, {0, 0, 1}, tfrt::Normalize(tfrt::Normal3f(1, 0, 1))};
+    std::vector<tfrt::Point2f> uv{{0, 0}, {1, 0}, {0, 1}};
+    auto mesh = std::make_shared<const tfrt::TriangleMesh>(std::vector<int>{0, 1, 2}, p, n, uv);
+    tfrt::TriangleBVH bvh(mesh);
+
+    tfrt::Ray ray(tfrt::Point3f(0.5f, 0.5f, 3), tfrt::Vector3f(0, 0, -1));
+    std::optional<tfrt::ShapeHit> hit = bvh.Intersect(ray);
+    REQUIRE(hit);
+    tfrt::SurfaceInteraction si = bvh.Interaction(ray, *hit);
+
+    RequireNear(si.p, tfrt::Point3f(0.5f, 0.5f, 0), 1e-6f);
+    REQUIRE_THAT(si.uv.x, WithinAbs(0.25f, 1e-6));
+    REQUIRE_THAT(si.uv.y, WithinAbs(0.25f, 1e-6));
+    RequireNear(si.dpdu, tfrt::Vector3f(2, 0, 0), 1e-6f);
+    RequireNear(si.dpdv, tfrt::Vector3f(0, 2, 0), 1e-6f);
+
+    // geometric normal faces the vertex normals, shading normal is their blend
+    RequireNear(si.n, tfrt::Normal3f(0, 0, 1), 1e-6f);
+    REQUIRE(si.shading.n.x > 0);
+    REQUIRE_THAT(tfrt::Length(si.shading.n), WithinAbs(1, 1e-6));
+    REQUIRE_THAT(tfrt::Dot(si.shading.n, si.shading.dpdu), WithinAbs(0, 1e-6));
+    REQUIRE(si.shading.dndv.x > 0);
+}
+
+TEST_CASE("Instance interactions match flattened meshes", "[Interaction]") {
+    std::vector<int> indices{0, 1, 2, 0, 2, 3};
+    std::vector<tfrt::Point3f> quad{{-1, -1, 0}, {1, -1, 0}, {1, 1, 0}, {-1, 1, 0}};
+    auto object = std::make_shared<const tfrt::TriangleBVH>(
+        std::make_shared<const tfrt::TriangleMesh>(indices, quad));
+    tfrt::Transform placement = tfrt::Translate(tfrt::Vector3f(0, 0, 5)) *
+                                tfrt::RotateY(30) * tfrt::Scale(2, 1, 1);
+    tfrt::Scene instanced({}, {}, {tfrt::Instance(object, placement)});
+    tfrt::Scene flattened({}, {std::make_shared<const tfrt::TriangleMesh>(placement, indices, quad)});
+
+    for (float x : {-0.5f, 0.f, 0.7f}) {
+        tfrt::Ray ray(tfrt::Point3f(x, 0.3f, -1), tfrt::Normalize(tfrt::Vector3f(0.05f, 0, 1)));
+        std::optional<tfrt::ShapeHit> a = instanced.Intersect(ray), b = flattened.Intersect(ray);
+        REQUIRE(a);
+        REQUIRE(b);
+        tfrt::SurfaceInteraction si = instanced.Interaction(ray, *a);
+        tfrt::SurfaceInteraction expected = flattened.Interaction(ray, *b);
+        REQUIRE(si.geomIndex == 1);
+        RequireNear(si.p, expected.p, 1e-4f);
+        RequireNear(si.n, expected.n, 1e-5f);
+        RequireNear(si.dpdu, expected.dpdu, 1e-4f);
+        RequireNear(si.dpdv, expected.dpdv, 1e-4f);
+        RequireNear(si.wo, -ray.d, 1e-6f);
+        REQUIRE_THAT(si.uv.x, WithinAbs(expected.uv.x, 1e-5));
+        REQUIRE_THAT(si.uv.y, WithinAbs(expected.uv.y, 1e-5));
+    }
+}
@@ -0,0 +1,198 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "core/vecmath.hpp"
+#include "util/math.hpp"
+
+namespace {
+
+// distance of a float result from the exact value in units in the last place of the float nearest to it
+double UlpError(float result, double exact) {
+    if (std::abs(exact) > FLT_MAX)
+        return result == float(exact) ? 0 : std::numeric_limits<double>::infinity();
+    if (std::isnan(result))
+        return std::numeric_limits<double>::infinity();
+    int exponent;
+    std::frexp(std::max(std::abs(exact), double(FLT_MIN)), &exponent);
+    return std::abs(result - exact) / std::ldexp(1., exponent - 24);
+}
+
+// the largest error of both f(float) and f(FloatN) at n arguments spread evenly over [lo, hi],
+// logarithmically for a positive lo
+template <typename F, typename Exact>
+double MaxUlpError(F f, Exact exact, double lo, double hi, bool logarithmic = false, int n = 1 << 20) {
+    double maxError = 0;
+    for (int i = 0; i < n; i += tfrt::SIMDWidth) {
+        float args[tfrt::SIMDWidth];
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            double t = (i + j + 0.5) / n;
+            args[j] = float(logarithmic ? lo * std::pow(hi / lo, t) : lo + t * (hi - lo));
+        }
+        tfrt::FloatN lanes = f(tfrt::FloatN::Load(args));
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            double e = exact(double(args[j]));
+            maxError = std::max({maxError, UlpError(f(args[j]), e), UlpError(lanes[j], e)});
+        }
+    }
+    return maxError;
+}
+
+// the same for two arguments, n random pairs from [lo0, hi0] x [lo1, hi1] that accept() lets through
+template <typename F, typename Exact, typename Accept>
+double MaxUlpError2(F f, Exact exact, Accept accept, float lo0, float hi0, float lo1, float hi1, int n = 1 << 20) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> u0(lo0, hi0), u1(lo1, hi1);
+    double maxError = 0;
+    for (int i = 0; i < n; i += tfrt::SIMDWidth) {
+        float a[tfrt::SIMDWidth], b[tfrt::SIMDWidth];
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            a[j] = u0(rng);
+            b[j] = u1(rng);
+        }
+        tfrt::FloatN lanes = f(tfrt::FloatN::Load(a), tfrt::FloatN::Load(b));
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            if (!accept(a[j], b[j]))
+                continue;
+            double e = exact(double(a[j]), double(b[j]));
+            maxError = std::max({maxError, UlpError(f(a[j], b[j]), e), UlpError(lanes[j], e)});
+        }
+    }
+    return maxError;
+}
+
+// a generic lambda turns a function template into something MaxUlpError can call with float and FloatN
+#define TFRT_LANES(F) [](auto... x) { return tfrt::F(x...); }
+
+} // namespace
+
+/**
+ * ---------------- Exact Tier Test -------------------
+ */
+
+TEST_CASE("The exact tier matches the standard library in every lane", "[math]") {
+    float args[tfrt::SIMDWidth] = {0.1f, 0.5f, 0.9f, 1.f, 2.5f, 10.f, 42.f, 80.f};
+    tfrt::FloatN x = tfrt::FloatN::Load(args) * 0.0125f, y = tfrt::FloatN(1.75f);
+    tfrt::FloatN exp = tfrt::Exp(x), log = tfrt::Log(x), pow = tfrt::Pow(x, y), sin = tfrt::Sin(x),
+                 cos = tfrt::Cos(x), atan2 = tfrt::ATan2(y, x), acos = tfrt::ACos(x);
+    for (int i = 0; i < tfrt::SIMDWidth; ++i) {
+        float v = x[i];
+        REQUIRE(exp[i] == std::exp(v));
+        REQUIRE(log[i] == std::log(v));
+        REQUIRE(pow[i] == std::pow(v, 1.75f));
+        REQUIRE(sin[i] == std::sin(v));
+        REQUIRE(cos[i] == std::cos(v));
+        REQUIRE(atan2[i] == std::atan2(1.75f, v));
+        REQUIRE(acos[i] == std::acos(v));
+        REQUIRE(tfrt::Exp(v) == std::exp(v));
+    }
+    REQUIRE(MaxUlpError(TFRT_LANES(RSqrt), [](double x) { return 1 / std::sqrt(x); }, 1e-37, 1e37, true) <= 1.5);
+}
+
+/**
+ * ---------------- Fast Tier Test -------------------
+ */
+
+TEST_CASE("FastRSqrt is within 4 ulps over the normal range", "[math]") {
+    REQUIRE(MaxUlpError(TFRT_LANES(FastRSqrt), [](double x) { return 1 / std::sqrt(x); }, 1e-37, 1e37, true) <= 4);
+}
+
+TEST_CASE("FastExp is within 2 ulps up to overflow", "[math]") {
+    auto exact = [](double x) { return std::exp(x); };
+    REQUIRE(MaxUlpError(TFRT_LANES(FastExp), exact, -87.3, 88.7) <= 2);
+    REQUIRE(MaxUlpError(TFRT_LANES(FastExp), exact, -1, 1) <= 2);
+    // denormal results are rounded once, to their coarser spacing
+    REQUIRE(MaxUlpError(TFRT_LANES(FastExp), exact, -103, -87.4) <= 1);
+
+    REQUIRE(tfrt::FastExp(0.f) == 1);
+    REQUIRE(tfrt::FastExp(89.f) == tfrt::Infinity);
+    REQUIRE(tfrt::FastExp(-200.f) == 0);
+}
+
+TEST_CASE("FastLog is within 1 ulp, denormals included", "[math]") {
+    auto exact = [](double x) { return std::log(x); };
+    REQUIRE(MaxUlpError(TFRT_LANES(FastLog), exact, 1e-37, 3e38, true) <= 1);
+    REQUIRE(MaxUlpError(TFRT_LANES(FastLog), exact, 0.5, 2) <= 1);
+    REQUIRE(MaxUlpError(TFRT_LANES(FastLog), exact, 1e-44, 1e-38, true) <= 1);
+
+    REQUIRE(tfrt::FastLog(1.f) == 0);
+    REQUIRE(tfrt::FastLog(0.f) == -tfrt::Infinity);
+    REQUIRE(tfrt::FastLog(tfrt::Infinity) == tfrt::Infinity);
+    REQUIRE(std::isnan(tfrt::FastLog(-1.f)));
+    REQUIRE(tfrt::IsNaN(tfrt::FastLog(tfrt::FloatN(-1.f))));
+}
+
+TEST_CASE("FastPow loses accuracy only with the size of y log x", "[math]") {
+    auto pow = TFRT_LANES(FastPow);
+    auto exact = [](double x, double y) { return std::pow(x, y); };
+    // the rounding of y * log(x) is magnified by exp
+    REQUIRE(MaxUlpError2(pow, exact, [](float x, float y) { return std::abs(y * std::log(x)) <= 1; }, 0.01f, 10,
+                         -8, 8) <= 2);
+    REQUIRE(MaxUlpError2(pow, exact, [](float x, float y) { return std::abs(y * std::log(x)) <= 8; }, 0.01f, 10,
+                         -8, 8) <= 16);
+    REQUIRE(tfrt::FastPow(2.f, 10.f) == 1024);
+}
+
+TEST_CASE("FastSin and FastCos are within 2 ulps over a period", "[math]") {
+    auto sin = [](double x) { return std::sin(x); };
+    auto cos = [](double x) { return std::cos(x); };
+    REQUIRE(MaxUlpError(TFRT_LANES(FastSin), sin, -tfrt::Pi, tfrt::Pi) <= 2);
+    REQUIRE(MaxUlpError(TFRT_LANES(FastCos), cos, -tfrt::Pi, tfrt::Pi) <= 2);
+    // farther out, results near the zeros inherit the error of the reduction
+    REQUIRE(MaxUlpError(TFRT_LANES(FastSin), sin, -100, 100) <= 8);
+    REQUIRE(MaxUlpError(TFRT_LANES(FastCos), cos, -100, 100) <= 8);
+    // up to 8192 the absolute error stays that of a result near 1
+    float maxError = 0;
+    for (float x = -8192; x < 8192; x += 0.0173f) {
+        maxError = std::max(maxError, float(std::abs(tfrt::FastSin(x) - std::sin(double(x)))));
+        maxError = std::max(maxError, float(std::abs(tfrt::FastCos(x) - std::cos(double(x)))));
+    }
+    REQUIRE(maxError <= 2 * tfrt::MachineEpsilon);
+
+    REQUIRE(tfrt::FastSin(0.f) == 0);
+    REQUIRE(tfrt::FastCos(0.f) == 1);
+}
+
+TEST_CASE("FastATan2 is within 4 ulps in every quadrant", "[math]") {
+    auto atan2 = TFRT_LANES(FastATan2);
+    auto exact = [](double y, double x) { return std::atan2(y, x); };
+    auto all = [](float, float) { return true; };
+    REQUIRE(MaxUlpError2(atan2, exact, all, -10, 10, -10, 10) <= 4);
+    REQUIRE(MaxUlpError2(atan2, exact, all, -1e-3f, 1e-3f, -10, 10) <= 4);
+    REQUIRE(MaxUlpError2(atan2, exact, all, -10, 10, -1e-3f, 1e-3f) <= 4);
+
+    REQUIRE(tfrt::FastATan2(0.f, 0.f) == 0);
+    REQUIRE(tfrt::FastATan2(1.f, 0.f) == tfrt::Pi / 2);
+    REQUIRE(tfrt::FastATan2(0.f, -1.f) == tfrt::Pi);
+}
+
+TEST_CASE("FastACos is within 2 ulps over [-1, 1]", "[math]") {
+    REQUIRE(MaxUlpError(TFRT_LANES(FastACos), [](double x) { return std::acos(x); }, -1, 1) <= 2);
+    REQUIRE(tfrt::FastACos(1.f) == 0);
+    REQUIRE(tfrt::FastACos(-1.f) == tfrt::Pi);
+    REQUIRE(std::isnan(tfrt::FastACos(1.5f)));
+}
+
+TEST_CASE("FastNormalize is within a few ulps of Normalize", "[math]") {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> u(-100, 100);
+    for (int i = 0; i < 1000; ++i) {
+        tfrt::Vector3f v(u(rng), u(rng), u(rng));
+        tfrt::Vector3f n = tfrt::FastNormalize(v);
+        tfrt::Vector3f exact = tfrt::Normalize(v);
+        REQUIRE(std::abs(tfrt::Length(n) - 1) < 8 * tfrt::MachineEpsilon);
+        for (int c = 0; c < 3; ++c)
+            REQUIRE(std::abs(n[c] - exact[c]) <= 8 * tfrt::MachineEpsilon);
+    }
+
+    tfrt::Vector3fN vN(tfrt::FloatN(3.f), tfrt::FloatN(0.f), tfrt::FloatN(-4.f));
+    tfrt::Vector3fN nN = tfrt::FastNormalize(vN);
+    REQUIRE(std::abs(nN.x[5] - 0.6f) <= 4 * tfrt::MachineEpsilon);
+    REQUIRE(std::abs(nN.z[2] + 0.8f) <= 4 * tfrt::MachineEpsilon);
+}
@@ -0,0 +1,160 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "camera/camera.hpp"
+#include "core/transform.hpp"
+#include "film/film.hpp"
+#include "render/integrator.hpp"
+#include "render/wavefront.hpp"
+#include "sampler/sampler.hpp"
+#include "scene/scene.hpp"
+#include "scene/sphere.hpp"
+#include "scene/triangle.hpp"
+#include "util/memory.hpp"
+
+namespace {
+
+// heap allocations made by the current thread, counted by the operator new replacements below
+thread_local int64_t heapAllocations = 0;
+
+void *CountedAlloc(std::size_t size, std::size_t align) {
+    ++heapAllocations;
+    size = size == 0 ? align : (size + align - 1) / align * align;
+    if (void *p = align <= alignof(std::max_align_t) ? std::malloc(size) : std::aligned_alloc(align, size))
+        return p;
+    throw std::bad_alloc();
+}
+
+struct alignas(32) Lobe {
+    float weight[8];
+    int type;
+};
+
+} // namespace
+
+void *operator new(std::size_t size) { return CountedAlloc(size, alignof(std::max_align_t)); }
+void *operator new(std::size_t size, std::align_val_t align) { return CountedAlloc(size, std::size_t(align)); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+/**
+ * ---------------- ScratchBuffer Test -------------------
+ */
+
+TEST_CASE("ScratchBuffer hands out aligned, disjoint memory", "[ScratchBuffer]") {
+    tfrt::ScratchBuffer scratch(1024);
+    char *c = scratch.Alloc<char>('x');
+    Lobe *lobe = scratch.Alloc<Lobe>();
+    float *array = scratch.AllocArray<float>(5);
+    double *d = scratch.Alloc<double>(2.5);
+
+    REQUIRE(*c == 'x');
+    REQUIRE(reinterpret_cast<uintptr_t>(lobe) % alignof(Lobe) == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(array) % tfrt::CacheLineSize == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(d) % alignof(double) == 0);
+    REQUIRE(reinterpret_cast<char *>(lobe) >= c + 1);
+    REQUIRE(reinterpret_cast<char *>(array) >= reinterpret_cast<char *>(lobe + 1));
+    REQUIRE(reinterpret_cast<char *>(d) >= reinterpret_cast<char *>(array + 5));
+    REQUIRE(*d == 2.5);
+
+    // Reset hands the same memory out again
+    scratch.Reset();
+    REQUIRE(scratch.BytesAllocated() == 0);
+    REQUIRE(scratch.Alloc<char>('y') == c);
+}
+
+TEST_CASE("ScratchBuffer grows past its block and merges blocks on Reset", "[ScratchBuffer]") {
+    tfrt::ScratchBuffer scratch(256);
+    std::vector<int *> arrays;
+    for (int i = 0; i < 20; ++i) {
+        arrays.push_back(scratch.AllocArray<int>(100));
+        for (int j = 0; j < 100; ++j)
+            arrays.back()[j] = i * 100 + j;
+    }
+    // earlier blocks stay valid after growing
+    for (int i = 0; i < 20; ++i)
+        for (int j = 0; j < 100; ++j)
+            REQUIRE(arrays[i][j] == i * 100 + j);
+    size_t used = scratch.BytesAllocated();
+    REQUIRE(used >= 20 * 100 * sizeof(int));
+
+    scratch.Reset();
+    REQUIRE(scratch.Capacity() >= 20 * 100 * sizeof(int));
+
+    // the same allocations now fit without touching the heap
+    int64_t before = heapAllocations;
+    for (int i = 0; i < 20; ++i)
+        scratch.AllocArray<int>(100);
+    REQUIRE(heapAllocations == before);
+}
+
+TEST_CASE("STL containers allocate from a ScratchBuffer", "[ScratchBuffer]") {
+    tfrt::ScratchBuffer scratch, other;
+    int64_t before = heapAllocations;
+    {
+        tfrt::ScratchVector<int> v{tfrt::ScratchAllocator<int>(scratch)};
+        for (int i = 0; i < 1000; ++i)
+            v.push_back(i);
+        for (int i = 0; i < 1000; ++i)
+            REQUIRE(v[i] == i);
+        REQUIRE(reinterpret_cast<uintptr_t>(v.data()) % tfrt::CacheLineSize == 0);
+
+        // rebinding keeps the buffer
+        tfrt::ScratchAllocator<double> rebound(v.get_allocator());
+        REQUIRE(rebound == v.get_allocator());
+        REQUIRE(rebound != tfrt::ScratchAllocator<double>(other));
+    }
+    REQUIRE(heapAllocations == before);
+    REQUIRE(scratch.BytesAllocated() >= 1000 * sizeof(int));
+}
+
+TEST_CASE("The steady-state render loop does not allocate", "[ScratchBuffer]") {
+    std::vector<tfrt::Sphere> spheres{tfrt::Sphere(tfrt::Point3f(0, 1, 0), 1),
+                                      tfrt::Sphere(tfrt::Point3f(2, 0.5f, 1), 0.5f)};
+    std::vector<tfrt::Point3f> p{{-10, 0, -10}, {10, 0, -10}, {10, 0, 10}, {-10, 0, 10}};
+    auto ground = std::make_shared<const tfrt::TriangleMesh>(std::vector<int>{0, 1, 2, 0, 2, 3}, p);
+    tfrt::Scene scene(spheres, {ground});
+    tfrt::PerspectiveCamera camera(
+        tfrt::Inverse(tfrt::LookAt(tfrt::Point3f(0, 3, -8), tfrt::Point3f(0, 1, 0), tfrt::Vector3f(0, 1, 0))),
+        tfrt::Point2i(32, 32), 45);
+    tfrt::SobolSampler sampler(4, 0);
+    tfrt::PathSettings settings;
+    tfrt::WavefrontOptions options;
+    options.sortRays = true;
+    options.maxPaths = 1000;
+    tfrt::WavefrontPathIntegrator wavefront(scene, camera, sampler, settings, options);
+    tfrt::RecursivePathIntegrator recursive(scene, camera, sampler, settings);
+
+    // tiles as the render loop hands them out, smaller ones along the right and bottom edges
+    tfrt::Film film(32, 32);
+    std::vector<tfrt::Bounds2i> tiles;
+    for (int y = 0; y < 32; y += 12)
+        for (int x = 0; x < 32; x += 12)
+            tiles.emplace_back(tfrt::Point2i(x, y), tfrt::Point2i(x + 12, y + 12));
+    auto renderPass = [&](int firstSample) {
+        for (const tfrt::Bounds2i &b : tiles) {
+            tfrt::FilmTile &tile = tfrt::ThreadFilmTile();
+            film.GetFilmTile(b, &tile);
+            wavefront.RenderTile(tile, firstSample, 4);
+            recursive.RenderTile(tile, firstSample, 4);
+            film.MergeFilmTile(tile);
+        }
+    };
+    // the first pass sizes the thread's scratch buffer and film tile
+    renderPass(0);
+
+    int64_t before = heapAllocations;
+    for (int pass = 1; pass < 4; ++pass)
+        renderPass(4 * pass);
+    REQUIRE(heapAllocations == before);
+    REQUIRE(film.GetPixel(tfrt::Point2i(16, 16)).weightSum == 4 * 8);
+    REQUIRE(film.GetPixel(tfrt::Point2i(31, 31)).weightSum == 4 * 8);
+}
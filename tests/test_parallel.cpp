@@ -0,0 +1,44 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "util/parallel.hpp"
+
+/**
+ * ---------------- ThreadPool Test -------------------
+ */
+
+TEST_CASE("ThreadPool runs every index exactly once", "[parallel]") {
+    tfrt::ThreadPool pool(8);
+    std::vector<std::atomic<int>> counts(10000);
+    for (int pass = 0; pass < 3; ++pass)
+        pool.ParallelFor(0, int64_t(counts.size()), [&](int64_t i) { counts[i]++; });
+
+    for (auto &c : counts)
+        REQUIRE(c.load() == 3);
+}
+
+TEST_CASE("ThreadPool runs nested loops inline", "[parallel]") {
+    tfrt::ThreadPool pool(4);
+    std::atomic<int> total{0};
+    pool.ParallelFor(0, 16, [&](int64_t) {
+        pool.ParallelFor(0, 16, [&](int64_t) { total++; });
+    });
+    REQUIRE(total.load() == 256);
+}
+
+TEST_CASE("Tiles cover the image in scanline order", "[parallel]") {
+    tfrt::Bounds2i extent(tfrt::Point2i(0, 0), tfrt::Point2i(70, 33));
+    auto tiles = tfrt::GenerateTiles(extent, 16);
+    REQUIRE(tiles.size() == 5 * 3);
+    REQUIRE(tiles[1].pMin.x == 16);
+    REQUIRE(tiles[1].pMin.y == 0);
+    REQUIRE(tiles[5].pMin.y == 16);
+
+    int area = 0;
+    for (const auto &tile : tiles)
+        area += tile.Area();
+    REQUIRE(area == 70 * 33);
+}
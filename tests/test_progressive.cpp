@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "core/bounds.hpp"
+#include "film/film.hpp"
+#include "render/progressive.hpp"
+#include "sampler/rng.hpp"
+#include "util/color.hpp"
+#include "util/parallel.hpp"
+
+namespace {
+
+// constant in the left half of the image, noisy in the right half
+void AddSamples(tfrt::FilmTile &tile, int firstSample, int nSamples) {
+    tfrt::CounterRNG rng(5);
+    tfrt::Bounds2i b = tile.PixelBounds();
+    for (int s = firstSample; s < firstSample + nSamples; ++s) {
+        for (int y = b.pMin.y; y < b.pMax.y; ++y) {
+            for (int x = b.pMin.x; x < b.pMax.x; ++x) {
+                float v = x < 32 ? 0.5f : rng.Uniform(tfrt::Point2i(x, y), uint32_t(s), 0);
+                tile.AddSample(tfrt::Point2i(x, y), tfrt::RGB(v, v, v));
+            }
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * ---------------- Progressive Test -------------------
+ */
+
+TEST_CASE("Converged tiles stop while noisy tiles take the remaining samples", "[Progressive]") {
+    tfrt::Film film(64, 32);
+    tfrt::ProgressiveOptions options;
+    options.samplesPerPass = 8;
+    options.maxSamples = 64;
+    options.errorThreshold = 0.01f;
+    tfrt::ProgressiveStats stats = tfrt::RenderProgressive(film, 16, options, AddSamples);
+
+    REQUIRE(stats.nTiles == 8);
+    REQUIRE(stats.convergedTiles == 4);
+    REQUIRE(stats.passes == 8);
+    REQUIRE(stats.pixelSamples == 32 * 32 * (8 + 64));
+    REQUIRE(film.GetPixel(tfrt::Point2i(10, 10)).weightSum == 8);
+    REQUIRE(film.GetPixel(tfrt::Point2i(40, 10)).weightSum == 64);
+}
+
+TEST_CASE("Progressive images do not depend on the thread count", "[Progressive]") {
+    tfrt::ProgressiveOptions options;
+    options.samplesPerPass = 4;
+    options.maxSamples = 32;
+    options.errorThreshold = 0.1f;
+
+    tfrt::Film serial(64, 32), parallel(64, 32);
+    tfrt::RenderProgressive(serial, 8, options, AddSamples);
+    tfrt::ParallelInit(4);
+    tfrt::RenderProgressive(parallel, 8, options, AddSamples);
+    tfrt::ParallelCleanup();
+
+    for (int y = 0; y < 32; ++y)
+        for (int x = 0; x < 64; ++x)
+            REQUIRE(serial.GetPixelRGB(tfrt::Point2i(x, y)) == parallel.GetPixelRGB(tfrt::Point2i(x, y)));
+}
+
+TEST_CASE("The time budget ends rendering early", "[Progressive]") {
+    tfrt::Film film(64, 64);
+    tfrt::ProgressiveOptions options;
+    options.samplesPerPass = 1;
+    options.maxSamples = 1 << 20;
+    options.timeBudget = 0.05;
+    tfrt::ProgressiveStats stats =
+        tfrt::RenderProgressive(film, 8, options, [](tfrt::FilmTile &tile, int firstSample, int nSamples) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            AddSamples(tile, firstSample, nSamples);
+        });
+
+    REQUIRE(stats.pixelSamples > 0);
+    REQUIRE(stats.pixelSamples < int64_t(64) * 64 * 1000);
+    REQUIRE(stats.seconds < 1);
+}
@@ -0,0 +1,150 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "core/simd.hpp"
+#include "core/vecmath.hpp"
+#include "sampler/rng.hpp"
+#include "sampler/sampler.hpp"
+#include "sampler/sobol.hpp"
+#include "util/math.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+// whether the first 2^log2n values fall one into each interval [i / 2^log2n, (i + 1) / 2^log2n)
+bool Stratified(const std::vector<uint32_t> &values, int log2n) {
+    std::vector<int> counts(size_t(1) << log2n, 0);
+    for (size_t i = 0; i < (size_t(1) << log2n); ++i)
+        if (counts[values[i] >> 1 >> (31 - log2n)]++ != 0)
+            return false;
+    return true;
+}
+
+// RMS error over many pixels of the fraction of each pixel covered by a quarter disk
+template <typename Sampler>
+double CoverageError(const Sampler &sampler) {
+    const double exact = tfrt::Pi / 8;
+    double sumSq = 0;
+    int nPixels = 256;
+    for (int p = 0; p < nPixels; ++p) {
+        tfrt::Point2i pixel(p % 16, p / 16);
+        int inside = 0;
+        for (int i = 0; i < sampler.SamplesPerPixel(); ++i) {
+            float u = sampler.Sample1D(pixel, i, 0), v = sampler.Sample1D(pixel, i, 1);
+            inside += u * u + v * v < 0.5f;
+        }
+        sumSq += tfrt::Sqr(double(inside) / sampler.SamplesPerPixel() - exact);
+    }
+    return std::sqrt(sumSq / nPixels);
+}
+
+} // namespace
+
+/**
+ * ---------------- Sobol Test -------------------
+ */
+
+TEST_CASE("Sobol dimensions are stratified at every power of two", "[Sampler]") {
+    for (int dim = 0; dim < tfrt::NSobolDimensions; ++dim) {
+        std::vector<uint32_t> values, scrambled;
+        for (uint32_t i = 0; i < 1024; ++i) {
+            values.push_back(tfrt::SobolSample32(i, dim));
+            scrambled.push_back(tfrt::OwenScramble(values.back(), 0x12345678u + uint32_t(dim)));
+        }
+        for (int log2n = 0; log2n <= 10; ++log2n) {
+            REQUIRE(Stratified(values, log2n));
+            REQUIRE(Stratified(scrambled, log2n));
+        }
+    }
+}
+
+TEST_CASE("The first two Sobol dimensions form a (0, 2)-sequence", "[Sampler]") {
+    // every elementary interval of area 1/n holds exactly one of the first n points
+    for (int log2n = 0; log2n <= 8; ++log2n) {
+        uint32_t n = 1u << log2n;
+        for (int log2x = 0; log2x <= log2n; ++log2x) {
+            int log2y = log2n - log2x;
+            std::vector<int> counts(n, 0);
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t x = tfrt::SobolSample32(i, 0) >> 1 >> (31 - log2x);
+                uint32_t y = tfrt::SobolSample32(i, 1) >> 1 >> (31 - log2y);
+                ++counts[(y << log2x) | x];
+            }
+            for (int count : counts)
+                REQUIRE(count == 1);
+        }
+    }
+}
+
+TEST_CASE("ReverseBits32 matches a bit loop", "[Sampler]") {
+    for (uint32_t v : {0u, 1u, 0x80000000u, 0xdeadbeefu, 0x12345678u}) {
+        uint32_t expected = 0;
+        for (int i = 0; i < 32; ++i)
+            expected |= ((v >> i) & 1) << (31 - i);
+        REQUIRE(tfrt::ReverseBits32(v) == expected);
+        REQUIRE(tfrt::ReverseBits32(tfrt::UInt32N(v))[5] == expected);
+    }
+}
+
+/**
+ * ---------------- Sampler Test -------------------
+ */
+
+TEST_CASE("Counter-based samples depend only on the key and the seed", "[Sampler]") {
+    tfrt::CounterRNG rng(7), same(7), other(8);
+    tfrt::Point2i p(13, 42);
+    REQUIRE(rng.Uniform32(p, 3, 5) == same.Uniform32(p, 3, 5));
+    REQUIRE(rng.Uniform32(p, 3, 5) != other.Uniform32(p, 3, 5));
+    REQUIRE(rng.Uniform32(p, 3, 5) != rng.Uniform32(tfrt::Point2i(14, 42), 3, 5));
+    REQUIRE(rng.Uniform32(p, 3, 5) != rng.Uniform32(tfrt::Point2i(13, 43), 3, 5));
+    REQUIRE(rng.Uniform32(p, 3, 5) != rng.Uniform32(p, 4, 5));
+    REQUIRE(rng.Uniform32(p, 3, 5) != rng.Uniform32(p, 3, 6));
+
+    float u = rng.Uniform(p, 3, 5);
+    REQUIRE((u >= 0 && u < 1));
+}
+
+TEST_CASE("SIMD sample lanes equal scalar samples of neighbouring pixels", "[Sampler]") {
+    tfrt::IndependentSampler independent(16, 3);
+    tfrt::SobolSampler sobol(16, 3);
+    tfrt::Point2i p(-5, 9);
+    for (int sampleIndex : {0, 1, 15}) {
+        for (int dim : {0, 1, 2, tfrt::NSobolDimensions, 50}) {
+            tfrt::FloatN a = independent.Sample1DN(p, sampleIndex, dim);
+            tfrt::FloatN b = sobol.Sample1DN(p, sampleIndex, dim);
+            for (int i = 0; i < tfrt::SIMDWidth; ++i) {
+                tfrt::Point2i pi(p.x + i, p.y);
+                REQUIRE(a[i] == independent.Sample1D(pi, sampleIndex, dim));
+                REQUIRE(b[i] == sobol.Sample1D(pi, sampleIndex, dim));
+            }
+        }
+    }
+}
+
+TEST_CASE("Sampler walks the dimensions of a sample", "[Sampler]") {
+    tfrt::SobolSampler sampler(8, 1);
+    tfrt::Point2i p(3, 4);
+    sampler.StartPixelSample(p, 5, 2);
+    REQUIRE(sampler.Get1D() == sampler.Sample1D(p, 5, 2));
+    tfrt::Point2f u = sampler.Get2D();
+    REQUIRE(u.x == sampler.Sample1D(p, 5, 3));
+    REQUIRE(u.y == sampler.Sample1D(p, 5, 4));
+    REQUIRE(sampler.GetPixel2D().x == sampler.Sample1D(p, 5, 0));
+
+    // every pixel gets its own scramble
+    REQUIRE(sampler.Sample1D(p, 0, 0) != sampler.Sample1D(tfrt::Point2i(4, 4), 0, 0));
+}
+
+TEST_CASE("Sobol samples converge faster than independent ones", "[Sampler]") {
+    double sobolError = CoverageError(tfrt::SobolSampler(64, 11));
+    double independentError = CoverageError(tfrt::IndependentSampler(64, 11));
+    REQUIRE(sobolError < 0.5 * independentError);
+
+    // and need far fewer samples for the error of independent sampling
+    REQUIRE(CoverageError(tfrt::SobolSampler(16, 11)) < independentError);
+}
@@ -0,0 +1,172 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "core/simd.hpp"
+#include "scene/bvh.hpp"
+#include "scene/sphere.hpp"
+
+using namespace Catch::Matchers;
+
+/**
+ * ---------------- FloatN Test -------------------
+ */
+
+TEST_CASE("FloatN arithmetic matches scalar lanes", "[simd]") {
+    float a[8] = {1, -2, 3, -4, 5, -6, 7, -8};
+    float b[8] = {0.5f, 2, -1, 4, 10, 3, -7, 1};
+    tfrt::FloatN va = tfrt::FloatN::Load(a), vb = tfrt::FloatN::Load(b);
+
+    tfrt::FloatN sum = va + vb, prod = va * vb, quot = va / vb;
+    tfrt::FloatN lo = min(va, vb), hi = max(va, vb), fma = FMA(va, vb, tfrt::FloatN(1.f));
+    for (int i = 0; i < 8; ++i) {
+        REQUIRE_THAT(sum[i], WithinULP(a[i] + b[i], 0));
+        REQUIRE_THAT(prod[i], WithinULP(a[i] * b[i], 0));
+        REQUIRE_THAT(quot[i], WithinULP(a[i] / b[i], 0));
+        REQUIRE_THAT(lo[i], WithinULP(std::min(a[i], b[i]), 0));
+        REQUIRE_THAT(hi[i], WithinULP(std::max(a[i], b[i]), 0));
+        REQUIRE_THAT(fma[i], WithinULP(a[i] * b[i] + 1, 1));
+        REQUIRE_THAT(abs(va)[i], WithinULP(std::abs(a[i]), 0));
+    }
+}
+
+TEST_CASE("FloatN negation and CopySign keep the sign of zero", "[simd]") {
+    float a[8] = {0, -0.f, 1, -1, 2.5f, -3, 0, -0.f};
+    float b[8] = {-1, 1, -0.f, 0, -2, 4, -0.f, 0};
+    tfrt::FloatN va = tfrt::FloatN::Load(a), vb = tfrt::FloatN::Load(b);
+
+    tfrt::FloatN neg = -va, sign = tfrt::CopySign(va, vb);
+    for (int i = 0; i < 8; ++i) {
+        REQUIRE(neg[i] == -a[i]);
+        REQUIRE(std::signbit(neg[i]) == std::signbit(-a[i]));
+        REQUIRE(sign[i] == std::copysign(a[i], b[i]));
+        REQUIRE(std::signbit(sign[i]) == std::signbit(std::copysign(a[i], b[i])));
+    }
+}
+
+TEST_CASE("MaskN comparisons and selection", "[simd]") {
+    float a[8] = {1, -2, 3, -4, 5, -6, 7, -8};
+    tfrt::FloatN va = tfrt::FloatN::Load(a);
+    tfrt::MaskN neg = va < tfrt::FloatN(0.f);
+    REQUIRE(neg.Bits() == 0xAAu);
+    REQUIRE(neg.Any());
+    REQUIRE_FALSE(neg.All());
+    REQUIRE((!neg).Bits() == 0x55u);
+    REQUIRE(tfrt::MaskN::FromBits(0x81u).Bits() == 0x81u);
+
+    tfrt::FloatN s = Select(neg, tfrt::FloatN(0.f), va);
+    for (int i = 0; i < 8; ++i)
+        REQUIRE(s[i] == (a[i] < 0 ? 0 : a[i]));
+
+    REQUIRE(tfrt::IsNaN(tfrt::FloatN(std::nanf(""))));
+    REQUIRE_FALSE(tfrt::IsNaN(va));
+}
+
+TEST_CASE("UInt32N arithmetic wraps like uint32_t lanes", "[simd]") {
+    uint32_t a[8] = {0, 1, 0x80000000u, 0xffffffffu, 12345, 0xdeadbeefu, 7, 0x7fffffffu};
+    uint32_t b[8] = {3, 0xffffffffu, 2, 0xffffffffu, 67890, 0x9e3779b9u, 0, 1};
+    tfrt::UInt32N va = tfrt::UInt32N::Load(a), vb = tfrt::UInt32N::Load(b);
+
+    tfrt::UInt32N sum = va + vb, prod = va * vb, x = va ^ vb, o = va | vb, n = va & vb;
+    tfrt::UInt32N left = va << 7, right = va >> 13;
+    tfrt::FloatN f = ToFloat(va >> 8);
+    for (int i = 0; i < 8; ++i) {
+        REQUIRE(sum[i] == a[i] + b[i]);
+        REQUIRE(prod[i] == a[i] * b[i]);
+        REQUIRE(x[i] == (a[i] ^ b[i]));
+        REQUIRE(o[i] == (a[i] | b[i]));
+        REQUIRE(n[i] == (a[i] & b[i]));
+        REQUIRE(left[i] == a[i] << 7);
+        REQUIRE(right[i] == a[i] >> 13);
+        REQUIRE(f[i] == float(a[i] >> 8));
+    }
+}
+
+TEST_CASE("Vector3 of FloatN reuses the Tuple3 operators", "[simd]") {
+    tfrt::Vector3fN a(1.f, 2.f, 3.f), b(4.f, -1.f, 0.f);
+    tfrt::Vector3fN c = a + b * 2.f;
+    REQUIRE_THAT(c.x[3], WithinULP(9.0f, 0));
+    REQUIRE_THAT(tfrt::Dot(a, b)[7], WithinULP(2.0f, 0));
+    REQUIRE_THAT(tfrt::Length(tfrt::Normalize(a))[0], WithinAbs(1.0f, 1e-6));
+}
+
+/**
+ * ---------------- RayPacket Test -------------------
+ */
+
+TEST_CASE("Packet BVH traversal matches single rays", "[simd]") {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> pos(-10.f, 10.f);
+    std::uniform_real_distribution<float> rad(0.1f, 1.f);
+    std::vector<tfrt::Sphere> spheres;
+    for (int i = 0; i < 500; ++i)
+        spheres.emplace_back(tfrt::Point3f(pos(rng), pos(rng), pos(rng)), rad(rng));
+    tfrt::BVHAggregate<tfrt::Sphere> bvh(spheres);
+
+    for (int p = 0; p < 200; ++p) {
+        // a bundle of nearby rays, the last packet is partially filled
+        int n = (p % 8) + 1;
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        tfrt::Point3f o(pos(rng), pos(rng), -20);
+        for (int i = 0; i < n; ++i)
+            rays[i] = tfrt::Ray(o, tfrt::Normalize(tfrt::Vector3f(0.01f * i, pos(rng) * 0.02f, 1)));
+
+        tfrt::RayPacketHit hits = bvh.Intersect(tfrt::RayPacket(rays, n));
+        for (int i = 0; i < tfrt::SIMDWidth; ++i) {
+            if (i >= n) {
+                REQUIRE_FALSE(hits.valid[i]);
+                continue;
+            }
+            auto hit = bvh.Intersect(rays[i]);
+            REQUIRE(hit.has_value() == hits.valid[i]);
+            if (hit) {
+                REQUIRE(hit->primIndex == hits.primIndex[i]);
+                REQUIRE_THAT(hits.tHit[i], WithinRel(hit->tHit, 1e-4f));
+            }
+        }
+    }
+}
+
+TEST_CASE("Packet leaves are told which lanes overlap their box", "[simd]") {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> pos(-10.f, 10.f), dir(-1.f, 1.f);
+    std::vector<tfrt::Bounds3f> boxes;
+    for (int i = 0; i < 300; ++i) {
+        tfrt::Point3f c(pos(rng), pos(rng), pos(rng));
+        boxes.emplace_back(c - tfrt::Vector3f(0.5f, 0.5f, 0.5f), c + tfrt::Vector3f(0.5f, 0.5f, 0.5f));
+    }
+    tfrt::BVH bvh(boxes);
+    const tfrt::Buffer<tfrt::LinearBVHNode> &nodes = bvh.Nodes();
+
+    int nLeaves = 0, nSkipped = 0;
+    for (int p = 0; p < 50; ++p) {
+        // incoherent rays, so most leaves are entered for some lanes only
+        int n = (p % 8) + 1;
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        for (int i = 0; i < n; ++i)
+            rays[i] = tfrt::Ray(tfrt::Point3f(pos(rng), pos(rng), pos(rng)),
+                                tfrt::Normalize(tfrt::Vector3f(dir(rng), dir(rng), dir(rng))));
+        bvh.Intersect(tfrt::RayPacket(rays, n), [&](int offset, int, tfrt::FloatN &tMax, tfrt::MaskN active) {
+            const tfrt::LinearBVHNode *leaf = nullptr;
+            for (const tfrt::LinearBVHNode &node : nodes)
+                if (node.nPrimitives > 0 && node.primitivesOffset == offset)
+                    leaf = &node;
+            REQUIRE(leaf);
+            ++nLeaves;
+            for (int i = 0; i < tfrt::SIMDWidth; ++i) {
+                bool overlaps = i < n && leaf->bounds.IntersectP(tfrt::TraversalRay(rays[i]), tMax[i]);
+                REQUIRE(active[i] == overlaps);
+                nSkipped += !overlaps;
+            }
+            return tfrt::MaskN(false);
+        });
+    }
+    REQUIRE(nLeaves > 0);
+    REQUIRE(nSkipped > 0);
+}
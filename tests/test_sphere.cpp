@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "scene/sphere.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+std::vector<tfrt::Sphere> Particles(int n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(-10.f, 10.f);
+    std::uniform_real_distribution<float> rad(0.01f, 0.3f);
+    std::vector<tfrt::Sphere> spheres;
+    for (int i = 0; i < n; ++i)
+        spheres.emplace_back(tfrt::Point3f(pos(rng), pos(rng), pos(rng)), rad(rng));
+    return spheres;
+}
+
+std::optional<tfrt::ShapeHit> BruteForce(const std::vector<tfrt::Sphere> &spheres, const tfrt::Ray &ray) {
+    std::optional<tfrt::ShapeHit> closest;
+    tfrt::Float tMax = ray.tMax;
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        if (auto hit = spheres[i].Intersect(ray, tMax)) {
+            tMax = hit->tHit;
+            closest = hit;
+            closest->primIndex = uint32_t(i);
+        }
+    }
+    return closest;
+}
+
+} // namespace
+
+/**
+ * ---------------- Sphere Test -------------------
+ */
+
+TEST_CASE("Sphere roots stay accurate for small distant spheres", "[Sphere]") {
+    // b^2 and 4ac agree in about their first seven digits here
+    float r = 0.01f;
+    tfrt::Sphere sphere(tfrt::Point3f(0, 0, 2000), r);
+    for (float offset : {0.f, 0.5f, 0.9f, 0.99f}) {
+        tfrt::Ray ray(tfrt::Point3f(offset * r, 0, 0), tfrt::Vector3f(0, 0, 1));
+        auto hit = sphere.Intersect(ray, tfrt::Infinity);
+        REQUIRE(hit);
+        float expected = 2000 - r * std::sqrt(1 - offset * offset);
+        REQUIRE_THAT(hit->tHit, WithinAbs(expected, 2e-3));
+    }
+    tfrt::Ray miss(tfrt::Point3f(1.01f * r, 0, 0), tfrt::Vector3f(0, 0, 1));
+    REQUIRE_FALSE(sphere.Intersect(miss, tfrt::Infinity));
+}
+
+TEST_CASE("Sphere reports the nearest root in [tMin, tMax)", "[Sphere]") {
+    tfrt::Sphere sphere(tfrt::Point3f(1, 2, 3), 2);
+    tfrt::Ray ray(tfrt::Point3f(1, 2, -2), tfrt::Vector3f(0, 0, 2));
+    REQUIRE_THAT(sphere.Intersect(ray, tfrt::Infinity)->tHit, WithinAbs(1.5f, 1e-6));
+    REQUIRE_FALSE(sphere.Intersect(ray, 1.5f));
+
+    // from inside only the far root is in front
+    ray.tMin = 2;
+    REQUIRE_THAT(sphere.Intersect(ray, tfrt::Infinity)->tHit, WithinAbs(3.5f, 1e-6));
+    ray.tMin = 3.6f;
+    REQUIRE_FALSE(sphere.Intersect(ray, tfrt::Infinity));
+}
+
+TEST_CASE("SphereSet matches brute force", "[Sphere]") {
+    std::vector<tfrt::Sphere> spheres = Particles(5000, 19);
+    std::vector<uint32_t> inputIndices;
+    tfrt::SphereSet set(spheres, tfrt::BVHBuildMethod::SAH, &inputIndices);
+    REQUIRE(set.size() == spheres.size());
+    REQUIRE(inputIndices.size() == spheres.size());
+    for (uint32_t slot = 0; slot < uint32_t(spheres.size()); ++slot) {
+        REQUIRE(set.GetSphere(slot).center == spheres[inputIndices[slot]].center);
+        REQUIRE(set.GetSphere(slot).radius == spheres[inputIndices[slot]].radius);
+    }
+
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    for (int i = 0; i < 200; ++i) {
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        for (tfrt::Ray &ray : rays)
+            ray = tfrt::Ray(tfrt::Point3f(u(rng) * 10, u(rng) * 10, -20),
+                            tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.3f, u(rng) * 0.3f, 1)));
+        tfrt::RayPacket packet(rays, tfrt::SIMDWidth);
+        tfrt::RayPacketHit hits = set.Intersect(packet);
+        tfrt::MaskN blocked = set.IntersectP(packet);
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            auto expected = BruteForce(spheres, rays[j]);
+            auto actual = set.Intersect(rays[j]);
+            REQUIRE(expected.has_value() == actual.has_value());
+            REQUIRE(set.IntersectP(rays[j]) == expected.has_value());
+            REQUIRE(hits.valid[j] == expected.has_value());
+            REQUIRE(blocked[j] == expected.has_value());
+            if (expected) {
+                // hits name leaf slots
+                REQUIRE(inputIndices[actual->primIndex] == expected->primIndex);
+                REQUIRE(hits.primIndex[j] == actual->primIndex);
+                REQUIRE_THAT(actual->tHit, WithinRel(expected->tHit, 1e-5f));
+                REQUIRE_THAT(hits.tHit[j], WithinRel(expected->tHit, 1e-5f));
+            }
+        }
+    }
+}
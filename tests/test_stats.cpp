@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "camera/camera.hpp"
+#include "core/transform.hpp"
+#include "film/film.hpp"
+#include "render/integrator.hpp"
+#include "render/wavefront.hpp"
+#include "sampler/sampler.hpp"
+#include "scene/scene.hpp"
+#include "scene/sphere.hpp"
+#include "scene/triangle.hpp"
+#include "util/parallel.hpp"
+#include "util/stats.hpp"
+
+namespace {
+
+// renders every tile of film with all samples and returns what the render counted
+template <typename Integrator>
+tfrt::RenderStats RenderAndGather(tfrt::Film &film, const Integrator &integrator, int spp) {
+    tfrt::ResetStats();
+    tfrt::ParallelForTiles(film.PixelBounds(), 8, [&](tfrt::Bounds2i b) {
+        tfrt::FilmTile tile = film.GetFilmTile(b);
+        integrator.RenderTile(tile, 0, spp);
+        film.MergeFilmTile(tile);
+    });
+    return tfrt::GatherStats();
+}
+
+} // namespace
+
+/**
+ * ---------------- Render Statistics Test -------------------
+ */
+
+TEST_CASE("Statistics of every thread are gathered, also after it exits", "[stats]") {
+    tfrt::ResetStats();
+    tfrt::ParallelFor(0, 1000, [](int64_t i) {
+        tfrt::CountRays(tfrt::RayKind::Shadow, 2);
+        tfrt::CountPathLength(int(i % 20));
+        tfrt::CountTile(3e-6);
+    });
+    // a thread's counts outlive it, and the next thread takes over its block
+    for (int t = 0; t < 3; ++t)
+        std::thread([] { tfrt::CountRays(tfrt::RayKind::Camera, 5); }).join();
+
+    tfrt::RenderStats stats = tfrt::GatherStats();
+    if (!tfrt::StatsEnabled) {
+        REQUIRE(stats.Rays() == 0);
+        REQUIRE(stats.tiles == 0);
+        return;
+    }
+    REQUIRE(stats.rays[int(tfrt::RayKind::Camera)] == 15);
+    REQUIRE(stats.rays[int(tfrt::RayKind::Shadow)] == 2000);
+    REQUIRE(stats.pathLengths[3] == 50);
+    // longer paths share the last bucket
+    REQUIRE(stats.pathLengths[tfrt::PathLengthBuckets - 1] == 5 * 50);
+    REQUIRE(stats.tiles == 1000);
+    REQUIRE(stats.tileTimes[1] == 1000);
+
+    std::ostringstream summary;
+    stats.Print(summary, tfrt::SIMDWidth);
+    REQUIRE(summary.str().find("15 camera, 0 bounce, 2000 shadow") != std::string::npos);
+
+    tfrt::ResetStats();
+    REQUIRE(tfrt::GatherStats().Rays() == 0);
+}
+
+TEST_CASE("Both path integrators count the same rays and path lengths", "[stats]") {
+    std::vector<tfrt::Sphere> spheres{tfrt::Sphere(tfrt::Point3f(0, 1, 0), 1),
+                                      tfrt::Sphere(tfrt::Point3f(2, 0.5f, 1), 0.5f)};
+    std::vector<tfrt::Point3f> p{{-10, 0, -10}, {10, 0, -10}, {10, 0, 10}, {-10, 0, 10}};
+    auto ground = std::make_shared<const tfrt::TriangleMesh>(std::vector<int>{0, 1, 2, 0, 2, 3}, p);
+    tfrt::Scene scene(spheres, {ground});
+    tfrt::Point2i resolution(24, 24);
+    tfrt::PerspectiveCamera camera(
+        tfrt::Inverse(tfrt::LookAt(tfrt::Point3f(0, 3, -8), tfrt::Point3f(0, 1, 0), tfrt::Vector3f(0, 1, 0))),
+        resolution, 60);
+    tfrt::SobolSampler sampler(4, 0);
+    tfrt::PathSettings settings;
+    settings.maxDepth = 3;
+
+    tfrt::Film a(resolution.x, resolution.y), b(resolution.x, resolution.y);
+    tfrt::RenderStats recursive =
+        RenderAndGather(a, tfrt::RecursivePathIntegrator(scene, camera, sampler, settings), 4);
+    tfrt::RenderStats wavefront =
+        RenderAndGather(b, tfrt::WavefrontPathIntegrator(scene, camera, sampler, settings), 4);
+    if (!tfrt::StatsEnabled) {
+        REQUIRE(recursive.Rays() == 0);
+        REQUIRE(wavefront.Rays() == 0);
+        return;
+    }
+
+    int64_t nPaths = int64_t(resolution.x) * resolution.y * 4;
+    REQUIRE(recursive.rays[int(tfrt::RayKind::Camera)] == nPaths);
+    REQUIRE(recursive.rays[int(tfrt::RayKind::Bounce)] > 0);
+    REQUIRE(recursive.rays[int(tfrt::RayKind::Shadow)] > 0);
+    int64_t pathSum = 0;
+    for (int i = 0; i < tfrt::PathLengthBuckets; ++i) {
+        pathSum += recursive.pathLengths[i];
+        // both trace the same paths, one at a time or stage by stage
+        REQUIRE(wavefront.pathLengths[i] == recursive.pathLengths[i]);
+    }
+    REQUIRE(pathSum == nPaths);
+    REQUIRE(recursive.pathLengths[settings.maxDepth] > 0);
+    for (int k = 0; k < tfrt::NumRayKinds; ++k)
+        REQUIRE(wavefront.rays[k] == recursive.rays[k]);
+
+    // single rays against packets
+    REQUIRE(recursive.rayTraversals > 0);
+    REQUIRE(recursive.rayNodeVisits >= recursive.rayTraversals);
+    REQUIRE(recursive.packetTraversals == 0);
+    REQUIRE(wavefront.rayTraversals == 0);
+    REQUIRE(wavefront.packetNodeVisits >= wavefront.packetTraversals);
+    REQUIRE(wavefront.laneHits > 0);
+    REQUIRE(wavefront.LaneUtilization(tfrt::SIMDWidth) <= 1);
+    REQUIRE(recursive.primitiveTests > 0);
+    REQUIRE(wavefront.primitiveTests > 0);
+}
@@ -0,0 +1,130 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <random>
+#include <vector>
+
+#include "core/bounds.hpp"
+#include "core/ray.hpp"
+#include "core/transform.hpp"
+#include "core/vecmath.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+tfrt::Transform SomeTransform() {
+    return tfrt::Translate(tfrt::Vector3f(1, -2, 3)) * tfrt::Rotate(30, tfrt::Vector3f(1, 1, 0)) *
+           tfrt::Scale(2, 0.5f, 3);
+}
+
+template <typename Tuple>
+void RequireNear(Tuple a, Tuple b, float eps = 1e-5f) {
+    REQUIRE_THAT(a.x, WithinAbs(b.x, eps));
+    REQUIRE_THAT(a.y, WithinAbs(b.y, eps));
+    REQUIRE_THAT(a.z, WithinAbs(b.z, eps));
+}
+
+} // namespace
+
+/**
+ * ---------------- Transform Test -------------------
+ */
+
+TEST_CASE("Transform stores a matching inverse", "[Transform]") {
+    tfrt::Transform t = SomeTransform();
+    tfrt::Transform general(t.GetMatrix());
+    tfrt::SquareMatrix<4> product = t.GetMatrix() * general.GetInverseMatrix();
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            REQUIRE_THAT(product[i][j], WithinAbs(i == j ? 1.0f : 0.0f, 1e-6));
+
+    tfrt::Point3f p(0.3f, -4, 7);
+    RequireNear(tfrt::Inverse(t)(t(p)), p);
+    RequireNear(t.ApplyInverse(t(p)), p);
+    REQUIRE(tfrt::Transform().IsIdentity());
+    REQUIRE((t * tfrt::Inverse(t)).IsAffine());
+}
+
+TEST_CASE("Transform applies to points, vectors and normals", "[Transform]") {
+    tfrt::Transform t = tfrt::Translate(tfrt::Vector3f(1, 2, 3));
+    RequireNear(t(tfrt::Point3f(1, 1, 1)), tfrt::Point3f(2, 3, 4));
+    RequireNear(t(tfrt::Vector3f(1, 1, 1)), tfrt::Vector3f(1, 1, 1));
+
+    // normals stay perpendicular to surface vectors under non-uniform scale
+    tfrt::Transform s = tfrt::Scale(4, 1, 0.5f) * tfrt::RotateZ(20);
+    tfrt::Vector3f tangent(1, 1, 0);
+    tfrt::Normal3f n(1, -1, 0);
+    tfrt::Vector3f tt = s(tangent);
+    tfrt::Normal3f tn = s(n);
+    REQUIRE_THAT(tt.x * tn.x + tt.y * tn.y + tt.z * tn.z, WithinAbs(0.0f, 1e-5));
+}
+
+TEST_CASE("Transform keeps ray parameterization", "[Transform]") {
+    tfrt::Transform t = SomeTransform();
+    tfrt::Ray ray(tfrt::Point3f(1, 2, 3), tfrt::Vector3f(0.5f, -1, 2));
+    ray.tMax = 5;
+    tfrt::Ray tr = t(ray);
+    REQUIRE(tr.tMax == 5);
+    RequireNear(tr(2.5f), t(ray(2.5f)), 1e-4f);
+
+    tfrt::RayDifferential rd(ray);
+    rd.hasDifferentials = true;
+    rd.rxOrigin = tfrt::Point3f(1.1f, 2, 3);
+    rd.rxDirection = tfrt::Vector3f(0.5f, -1, 2.1f);
+    tfrt::RayDifferential trd = t(rd);
+    REQUIRE(trd.hasDifferentials);
+    RequireNear(trd.rxOrigin, t(rd.rxOrigin));
+    RequireNear(trd.rxDirection, t(rd.rxDirection));
+}
+
+TEST_CASE("Transform of bounds encloses the transformed corners", "[Transform]") {
+    tfrt::Bounds3f b(tfrt::Point3f(-1, 0, 2), tfrt::Point3f(3, 1, 5));
+    for (const tfrt::Transform &t : {SomeTransform(), tfrt::Perspective(60, 0.1f, 100)}) {
+        tfrt::Bounds3f corners;
+        for (int i = 0; i < 8; ++i)
+            corners = tfrt::Union(corners, t(tfrt::Point3f(b[i & 1].x, b[(i >> 1) & 1].y,
+                                                           b[(i >> 2) & 1].z)));
+        tfrt::Bounds3f tb = t(b);
+        RequireNear(tb.pMin, corners.pMin, 1e-4f);
+        RequireNear(tb.pMax, corners.pMax, 1e-4f);
+    }
+    REQUIRE(SomeTransform()(tfrt::Bounds3f()).IsDegenerate());
+}
+
+TEST_CASE("Transform batch APIs match single transforms", "[Transform]") {
+    std::mt19937 rng(29);
+    std::uniform_real_distribution<float> u(-10.f, 10.f);
+    std::vector<tfrt::Point3f> p(37);
+    std::vector<tfrt::Vector3f> v(p.size());
+    std::vector<tfrt::Normal3f> n(p.size());
+    for (size_t i = 0; i < p.size(); ++i) {
+        p[i] = tfrt::Point3f(u(rng), u(rng), u(rng));
+        v[i] = tfrt::Vector3f(u(rng), u(rng), u(rng));
+        n[i] = tfrt::Normal3f(u(rng), u(rng), u(rng));
+    }
+
+    for (const tfrt::Transform &t : {SomeTransform(), tfrt::Perspective(45, 1, 50)}) {
+        std::vector<tfrt::Point3f> pOut(p.size());
+        std::vector<tfrt::Vector3f> vOut = v;
+        std::vector<tfrt::Normal3f> nOut(n.size());
+        t.ApplyPoints(p.data(), pOut.data(), p.size());
+        t.ApplyVectors(vOut.data(), vOut.data(), vOut.size()); // in place
+        t.ApplyNormals(n.data(), nOut.data(), n.size());
+        for (size_t i = 0; i < p.size(); ++i) {
+            RequireNear(pOut[i], t(p[i]), 1e-3f);
+            RequireNear(vOut[i], t(v[i]), 1e-3f);
+            RequireNear(nOut[i], t(n[i]), 1e-3f);
+        }
+    }
+}
+
+TEST_CASE("LookAt maps the eye to the origin and the target onto +z", "[Transform]") {
+    tfrt::Point3f eye(3, 4, 5), target(-1, 0, 2);
+    tfrt::Transform cameraFromWorld = tfrt::LookAt(eye, target, tfrt::Vector3f(0, 1, 0));
+    RequireNear(cameraFromWorld(eye), tfrt::Point3f(0, 0, 0));
+    tfrt::Point3f t = cameraFromWorld(target);
+    REQUIRE_THAT(t.x, WithinAbs(0.0f, 1e-5));
+    REQUIRE_THAT(t.y, WithinAbs(0.0f, 1e-5));
+    REQUIRE_THAT(t.z, WithinAbs(tfrt::Distance(eye, target), 1e-5));
+}
@@ -0,0 +1,309 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "core/ray.hpp"
+#include "core/raypacket.hpp"
+#include "scene/scene.hpp"
+#include "scene/triangle.hpp"
+
+using namespace Catch::Matchers;
+
+namespace {
+
+// n x n quads in the z = 0 plane over [0, n]^2, two triangles each
+std::shared_ptr<const tfrt::TriangleMesh> GridMesh(int n) {
+    std::vector<tfrt::Point3f> p;
+    for (int y = 0; y <= n; ++y)
+        for (int x = 0; x <= n; ++x)
+            p.emplace_back(float(x), float(y), 0.f);
+    std::vector<int> indices;
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            int v0 = y * (n + 1) + x, v1 = v0 + 1, v2 = v0 + n + 1, v3 = v2 + 1;
+            indices.insert(indices.end(), {v0, v1, v3, v0, v3, v2});
+        }
+    }
+    return std::make_shared<tfrt::TriangleMesh>(indices, p);
+}
+
+std::shared_ptr<const tfrt::TriangleMesh> RandomMesh(int nTriangles, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(-10.f, 10.f);
+    std::uniform_real_distribution<float> offset(-1.f, 1.f);
+    std::vector<tfrt::Point3f> p;
+    std::vector<int> indices;
+    for (int i = 0; i < nTriangles; ++i) {
+        tfrt::Point3f c(pos(rng), pos(rng), pos(rng));
+        for (int v = 0; v < 3; ++v) {
+            indices.push_back(int(p.size()));
+            p.push_back(c + tfrt::Vector3f(offset(rng), offset(rng), offset(rng)));
+        }
+    }
+    return std::make_shared<tfrt::TriangleMesh>(indices, p);
+}
+
+std::optional<tfrt::ShapeHit> BruteForce(const tfrt::TriangleMesh &mesh, const tfrt::Ray &ray) {
+    tfrt::TriangleRay triRay(ray);
+    std::optional<tfrt::ShapeHit> closest;
+    tfrt::Float tMax = ray.tMax;
+    for (int i = 0; i < mesh.nTriangles; ++i) {
+        const int *v = mesh.Indices(i);
+        if (auto ti = tfrt::IntersectTriangle(triRay, ray.tMin, tMax, mesh.p[v[0]], mesh.p[v[1]],
+                                              mesh.p[v[2]])) {
+            tMax = ti->t;
+            closest = tfrt::ShapeHit{ti->t, uint32_t(i), ti->b1, ti->b2};
+        }
+    }
+    return closest;
+}
+
+} // namespace
+
+/**
+ * ---------------- Triangle Test -------------------
+ */
+
+TEST_CASE("Triangle hit reports distance and barycentrics", "[Triangle]") {
+    tfrt::Ray ray(tfrt::Point3f(0.25f, 0.5f, -2), tfrt::Vector3f(0, 0, 1));
+    auto ti = tfrt::IntersectTriangle(tfrt::TriangleRay(ray), 0, tfrt::Infinity,
+                                      tfrt::Point3f(0, 0, 0), tfrt::Point3f(1, 0, 0),
+                                      tfrt::Point3f(0, 1, 0));
+    REQUIRE(ti);
+    REQUIRE_THAT(ti->t, WithinAbs(2.0f, 1e-6));
+    REQUIRE_THAT(ti->b1, WithinAbs(0.25f, 1e-6));
+    REQUIRE_THAT(ti->b2, WithinAbs(0.5f, 1e-6));
+    REQUIRE_FALSE(tfrt::IntersectTriangle(tfrt::TriangleRay(ray), 0, 1.5f, tfrt::Point3f(0, 0, 0),
+                                          tfrt::Point3f(1, 0, 0), tfrt::Point3f(0, 1, 0)));
+}
+
+TEST_CASE("TriangleMesh moves vertices into render space", "[Triangle]") {
+    tfrt::Transform t = tfrt::Translate(tfrt::Vector3f(0, 0, 5)) * tfrt::Scale(2, 2, 2);
+    tfrt::TriangleMesh mesh(t, {0, 1, 2}, {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}}, {{0, 0, 1}, {0, 0, 1}, {0, 0, 1}});
+    REQUIRE(mesh.p[1] == tfrt::Point3f(2, 0, 5));
+    REQUIRE(mesh.n[0] == tfrt::Normal3f(0, 0, 0.5f));
+}
+
+TEST_CASE("Triangle test is watertight along shared edges", "[Triangle]") {
+    auto mesh = GridMesh(4);
+    tfrt::TriangleBVH bvh(mesh);
+
+    // rays aimed exactly at grid lines, diagonals and vertices
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> tilt(-0.3f, 0.3f);
+    for (int i = 0; i <= 64; ++i) {
+        for (int j = 0; j <= 64; ++j) {
+            tfrt::Point3f target(0.25f + 3.5f * i / 64, 0.25f + 3.5f * j / 64, 0);
+            if (i % 8 == 0)
+                target.x = float(1 + (i / 8) % 3); // interior grid lines
+            if (j % 8 == 0)
+                target.y = target.x;
+            tfrt::Vector3f d(tilt(rng), tilt(rng), 1);
+            tfrt::Ray ray(target - 3 * d, d);
+            REQUIRE(BruteForce(*mesh, ray));
+            REQUIRE(bvh.Intersect(ray));
+        }
+    }
+}
+
+TEST_CASE("TriangleBVH closest hit matches brute force", "[Triangle]") {
+    auto mesh = RandomMesh(3000, 5);
+    tfrt::TriangleBVH bvh(mesh);
+
+    std::mt19937 rng(9);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    for (int i = 0; i < 500; ++i) {
+        tfrt::Ray ray(tfrt::Point3f(u(rng) * 12, u(rng) * 12, -20),
+                      tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.5f, u(rng) * 0.5f, 1)));
+        auto expected = BruteForce(*mesh, ray);
+        auto actual = bvh.Intersect(ray);
+        REQUIRE(expected.has_value() == actual.has_value());
+        if (expected) {
+            REQUIRE(expected->primIndex == actual->primIndex);
+            REQUIRE_THAT(actual->tHit, WithinRel(expected->tHit, 1e-5f));
+            REQUIRE_THAT(actual->u, WithinAbs(expected->u, 1e-4));
+            REQUIRE_THAT(actual->v, WithinAbs(expected->v, 1e-4));
+        }
+    }
+}
+
+TEST_CASE("TriangleBVH packets match single rays", "[Triangle]") {
+    auto mesh = RandomMesh(1000, 13);
+    tfrt::TriangleBVH bvh(mesh);
+
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    for (int i = 0; i < 100; ++i) {
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        int n = 1 + i % tfrt::SIMDWidth;
+        for (int j = 0; j < n; ++j)
+            rays[j] = tfrt::Ray(tfrt::Point3f(u(rng) * 10, u(rng) * 10, -20),
+                                tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.2f, u(rng) * 0.2f, 1)));
+        tfrt::RayPacketHit hits = bvh.Intersect(tfrt::RayPacket(rays, n));
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            auto expected = j < n ? bvh.Intersect(rays[j]) : std::nullopt;
+            REQUIRE(hits.valid[j] == expected.has_value());
+            if (expected) {
+                REQUIRE(hits.primIndex[j] == expected->primIndex);
+                REQUIRE_THAT(hits.tHit[j], WithinULP(expected->tHit, 0));
+            }
+        }
+    }
+}
+
+TEST_CASE("TriangleBVH incoherent packets match single rays", "[Triangle]") {
+    auto mesh = RandomMesh(1000, 19);
+    tfrt::TriangleBVH bvh(mesh);
+
+    // lanes scattered in origin and direction, so leaves are entered by a few lanes at a time
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    for (int i = 0; i < 200; ++i) {
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        int n = 1 + i % tfrt::SIMDWidth;
+        for (int j = 0; j < n; ++j) {
+            rays[j] = tfrt::Ray(tfrt::Point3f(u(rng) * 12, u(rng) * 12, u(rng) * 12),
+                                tfrt::Normalize(tfrt::Vector3f(u(rng), u(rng), u(rng))));
+            rays[j].tMax = 10 + 10 * u(rng);
+        }
+        tfrt::RayPacket packet(rays, n);
+        tfrt::RayPacketHit hits = bvh.Intersect(packet);
+        tfrt::MaskN blocked = bvh.IntersectP(packet);
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            auto expected = j < n ? bvh.Intersect(rays[j]) : std::nullopt;
+            REQUIRE(hits.valid[j] == expected.has_value());
+            REQUIRE(blocked[j] == (j < n && bvh.IntersectP(rays[j])));
+            if (expected) {
+                REQUIRE(hits.primIndex[j] == expected->primIndex);
+                REQUIRE_THAT(hits.tHit[j], WithinULP(expected->tHit, 0));
+            }
+        }
+    }
+}
+
+TEST_CASE("Scene reports which aggregate was hit", "[Triangle]") {
+    std::vector<tfrt::Sphere> spheres{tfrt::Sphere(tfrt::Point3f(2, 2, 5), 1)};
+    tfrt::Scene scene(spheres, {GridMesh(4)});
+
+    tfrt::Ray throughGrid(tfrt::Point3f(2.1f, 2.2f, -5), tfrt::Vector3f(0, 0, 1));
+    auto hit = scene.Intersect(throughGrid);
+    REQUIRE(hit);
+    REQUIRE(hit->geomIndex == 1);
+    REQUIRE_THAT(hit->tHit, WithinAbs(5.0f, 1e-5));
+
+    tfrt::Ray fromAbove(tfrt::Point3f(2, 2, 10), tfrt::Vector3f(0, 0, -1));
+    hit = scene.Intersect(fromAbove);
+    REQUIRE(hit);
+    REQUIRE(hit->geomIndex == 0);
+
+    tfrt::Ray rays[2] = {throughGrid, fromAbove};
+    tfrt::RayPacketHit hits = scene.Intersect(tfrt::RayPacket(rays, 2));
+    REQUIRE(hits.valid[0]);
+    REQUIRE(hits.valid[1]);
+    REQUIRE(hits.geomIndex[0] == 1);
+    REQUIRE(hits.geomIndex[1] == 0);
+}
+
+/**
+ * ---------------- Motion Test -------------------
+ */
+
+namespace {
+
+// closest hit against the mesh with its vertices interpolated to ray.time
+std::optional<tfrt::ShapeHit> BruteForceAtTime(const tfrt::TriangleMesh &mesh, const tfrt::Ray &ray) {
+    tfrt::TriangleMesh posed = mesh;
+    for (int i = 0; i < mesh.nVertices; ++i)
+        posed.p[i] = tfrt::Lerp(ray.time, mesh.p[i], mesh.pEnd[i]);
+    return BruteForce(posed, ray);
+}
+
+} // namespace
+
+TEST_CASE("TriangleBVH Update refits small motion and rebuilds large motion", "[Motion]") {
+    auto mesh = RandomMesh(2000, 37);
+    tfrt::TriangleBVH bvh(mesh);
+
+    std::mt19937 rng(41);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    auto requireMatches = [&](const tfrt::TriangleMesh &m) {
+        for (int i = 0; i < 200; ++i) {
+            tfrt::Ray ray(tfrt::Point3f(u(rng) * 12, u(rng) * 12, -20),
+                          tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.5f, u(rng) * 0.5f, 1)));
+            auto expected = BruteForce(m, ray);
+            auto actual = bvh.Intersect(ray);
+            REQUIRE(expected.has_value() == actual.has_value());
+            if (expected) {
+                REQUIRE(expected->primIndex == actual->primIndex);
+                REQUIRE_THAT(actual->tHit, WithinRel(expected->tHit, 1e-5f));
+            }
+        }
+    };
+
+    // jitter keeps the tree close to what a rebuild would give
+    auto jittered = std::make_shared<tfrt::TriangleMesh>(*mesh);
+    for (tfrt::Point3f &p : jittered->p)
+        p += tfrt::Vector3f(u(rng), u(rng), u(rng)) * 0.05f;
+    REQUIRE_FALSE(bvh.Update(jittered));
+    requireMatches(*jittered);
+
+    // scattering whole triangles makes the old leaves span the scene
+    auto scattered = std::make_shared<tfrt::TriangleMesh>(*mesh);
+    for (int i = 0; i < scattered->nTriangles; ++i) {
+        tfrt::Vector3f offset(u(rng) * 10, u(rng) * 10, u(rng) * 10);
+        for (int v = 0; v < 3; ++v)
+            scattered->p[3 * i + v] += offset;
+    }
+    REQUIRE(bvh.Update(scattered));
+    requireMatches(*scattered);
+}
+
+TEST_CASE("Moving triangle is hit where it is at the ray time", "[Motion]") {
+    auto mesh = std::make_shared<tfrt::TriangleMesh>(
+        std::vector<int>{0, 1, 2},
+        std::vector<tfrt::Point3f>{{-1, -1, 0}, {1, -1, 0}, {0, 1, 0}});
+    mesh->pEnd = {{-1, -1, 4}, {1, -1, 4}, {0, 1, 4}};
+    tfrt::TriangleBVH bvh(mesh);
+    REQUIRE(bvh.Bounds() == tfrt::Bounds3f(tfrt::Point3f(-1, -1, 0), tfrt::Point3f(1, 1, 4)));
+
+    for (float time : {0.f, 0.25f, 0.5f, 1.f}) {
+        tfrt::Ray ray(tfrt::Point3f(0, 0, -2), tfrt::Vector3f(0, 0, 1), time);
+        auto hit = bvh.Intersect(ray);
+        REQUIRE(hit);
+        REQUIRE_THAT(hit->tHit, WithinAbs(2 + 4 * time, 1e-5));
+    }
+}
+
+TEST_CASE("Motion blur BVH matches interpolated brute force", "[Motion]") {
+    auto mesh = std::make_shared<tfrt::TriangleMesh>(*RandomMesh(1500, 43));
+    std::mt19937 rng(47);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    std::uniform_real_distribution<float> time(0.f, 1.f);
+    for (const tfrt::Point3f &p : mesh->p)
+        mesh->pEnd.push_back(p + tfrt::Vector3f(u(rng), u(rng), u(rng)) * 2.f);
+    tfrt::TriangleBVH bvh(mesh);
+
+    for (int i = 0; i < 300; ++i) {
+        tfrt::Ray rays[tfrt::SIMDWidth];
+        for (tfrt::Ray &ray : rays)
+            ray = tfrt::Ray(tfrt::Point3f(u(rng) * 12, u(rng) * 12, -20),
+                            tfrt::Normalize(tfrt::Vector3f(u(rng) * 0.3f, u(rng) * 0.3f, 1)), time(rng));
+        tfrt::RayPacketHit hits = bvh.Intersect(tfrt::RayPacket(rays, tfrt::SIMDWidth));
+        for (int j = 0; j < tfrt::SIMDWidth; ++j) {
+            auto expected = BruteForceAtTime(*mesh, rays[j]);
+            auto actual = bvh.Intersect(rays[j]);
+            REQUIRE(expected.has_value() == actual.has_value());
+            REQUIRE(hits.valid[j] == actual.has_value());
+            if (expected) {
+                REQUIRE(expected->primIndex == actual->primIndex);
+                REQUIRE_THAT(actual->tHit, WithinRel(expected->tHit, 1e-4f));
+                REQUIRE(hits.primIndex[j] == actual->primIndex);
+                REQUIRE_THAT(hits.tHit[j], WithinULP(actual->tHit, 0));
+            }
+        }
+    }
+}
@@ -78,4 +78,29 @@ TEST_CASE("Vector3 distance squared", "[Vector3]") {}
 
 /**
  * ---------------- Point3 Test -------------------
- */
\ No newline at end of file
+ */
+/**
+ * ---------------- Normal3 Test -------------------
+ */
+
+TEST_CASE("CoordinateSystem completes an orthonormal basis", "[Normal3]") {
+    for (tfrt::Vector3f v1 : {tfrt::Vector3f(0, 0, 1), tfrt::Vector3f(0, 0, -1),
+                              tfrt::Normalize(tfrt::Vector3f(1, -2, 3))}) {
+        tfrt::Vector3f v2, v3;
+        tfrt::CoordinateSystem(v1, &v2, &v3);
+        REQUIRE_THAT(tfrt::Length(v2), WithinAbs(1, 1e-6));
+        REQUIRE_THAT(tfrt::Length(v3), WithinAbs(1, 1e-6));
+        REQUIRE_THAT(tfrt::Dot(v1, v2), WithinAbs(0, 1e-6));
+        REQUIRE_THAT(tfrt::Dot(v1, v3), WithinAbs(0, 1e-6));
+        REQUIRE_THAT(tfrt::Dot(v2, v3), WithinAbs(0, 1e-6));
+    }
+}
+
+TEST_CASE("Normal3 dot, normalize and face forward", "[Normal3]") {
+    tfrt::Normal3f n(0, 3, 4);
+    REQUIRE(tfrt::Length(n) == 5);
+    REQUIRE(tfrt::Normalize(n) == tfrt::Normal3f(0, 0.6f, 0.8f));
+    REQUIRE(tfrt::Dot(n, tfrt::Vector3f(1, 1, 1)) == 7);
+    REQUIRE(tfrt::FaceForward(n, tfrt::Vector3f(0, -1, 0)) == tfrt::Normal3f(0, -3, -4));
+    REQUIRE(tfrt::FaceForward(n, tfrt::Normal3f(0, 0, 1)) == n);
+}